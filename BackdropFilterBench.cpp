@@ -0,0 +1,4252 @@
+// Headless benchmarks for the CPU blur paths, builds on Windows and Linux
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CpuBlur.h"
+#include "CpuBlurTiled.h"
+#include "CpuBlurFixed.h"
+#include "CpuKawase.h"
+#include "BlurKernels.h"
+#include "DirtyRegion.h"
+#include "FrameSource.h"
+#include "BlurPipeline.h"
+#include "CpuComposite.h"
+#include "Trace.h"
+#include "MaskLayer.h"
+#include "MaskTiles.h"
+#include "CpuIirGaussian.h"
+#include "BlurCache.h"
+#include "FrameScheduler.h"
+#include "FramePipeline.h"
+#include "DesktopLayout.h"
+#include "BlurRegions.h"
+#include "ResourcePool.h"
+#include "ShaderCache.h"
+#include "EffectChain.h"
+#include "ImageView.h"
+#include "CaptureRecording.h"
+#include "BlurTuner.h"
+#include "CpuSummedArea.h"
+#include "CpuPlanar.h"
+
+struct BenchImage
+{
+	int width;
+	int height;
+	std::vector<uint8_t> input;
+	std::vector<uint8_t> mask;
+	std::vector<uint8_t> output;
+};
+
+static void MakeBenchImage(BenchImage& image, int width, int height)
+{
+	image.width = width;
+	image.height = height;
+	image.input.resize((size_t)width * height * 4);
+	image.mask.assign((size_t)width * height * 4, 255);
+	image.output.resize((size_t)width * height * 4);
+
+	uint32_t seed = 12345;
+	for (uint8_t& value : image.input)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		value = (uint8_t)(seed >> 24);
+	}
+}
+
+static int CountImageDiffs(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+{
+	int diffs = 0;
+	for (size_t i = 0; i < a.size(); i += 4)
+		diffs += memcmp(&a[i], &b[i], 4) != 0;
+	return diffs;
+}
+
+// Correctness checks print through here and count what failed, main returns nonzero if any did
+static int g_BenchFailures = 0;
+
+static const char* CheckResult(bool ok, const char* pass = "ok", const char* fail = "FAIL")
+{
+	if (!ok)
+		++g_BenchFailures;
+	return ok ? pass : fail;
+}
+
+static double NowMs()
+{
+	using namespace std::chrono;
+	return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+static const int Resolutions[][2] = {
+	{ 800, 600 },
+	{ 1920, 1080 },
+	{ 3840, 2160 },
+};
+
+// Thread scaling of CpuTiledBlurRun, 1 to maxThreads in powers of two
+static void BenchThreadScaling(int maxThreads, int tileSize, float radius, int frames)
+{
+	printf("Tiled blur scaling (radius %.0f, tile %dx%d, %d frames)\n", radius, tileSize, tileSize, frames);
+	printf("%-12s %8s %10s %10s %8s\n", "resolution", "threads", "ms/frame", "MP/s", "speedup");
+
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	for (const int* resolution : Resolutions)
+	{
+		BenchImage image;
+		MakeBenchImage(image, resolution[0], resolution[1]);
+
+		BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, radius, 0.0f };
+		CpuImage input = { image.input.data(), image.width * 4 };
+		CpuImage output = { image.output.data(), image.width * 4 };
+		CpuMask mask = { image.mask.data() + 3, image.width * 4, 4 };
+
+		double singleThreadMs = 0.0;
+		for (int threads : threadCounts)
+		{
+			CpuTiledBlur blur;
+			CpuTiledBlurStart(blur, threads, tileSize, tileSize);
+
+			CpuTiledBlurRun(blur, input, mask, output, constants);  // Warm up scratch buffers
+			double start = NowMs();
+			for (int frame = 0; frame < frames; ++frame)
+				CpuTiledBlurRun(blur, input, mask, output, constants);
+			double ms = (NowMs() - start) / frames;
+
+			CpuTiledBlurStop(blur);
+
+			if (threads == 1) singleThreadMs = ms;
+			double megapixels = (double)image.width * image.height / 1.0e6;
+			char name[32];
+			snprintf(name, sizeof(name), "%dx%d", image.width, image.height);
+			printf("%-12s %8d %10.3f %10.1f %7.2fx\n", name, threads, ms, megapixels / (ms / 1000.0), singleThreadMs / ms);
+		}
+	}
+}
+
+// Pixels of `output` inside `rect` that differ from `reference`, plus any pixel outside it
+// that isn't `untouched` anymore
+static int CountRectDiffs(const std::vector<uint8_t>& output, const std::vector<uint8_t>& reference, int width, int height,
+						  const BlurRect& rect, uint8_t untouched)
+{
+	int diffs = 0;
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			const size_t i = ((size_t)y * width + x) * 4;
+			const bool inside = x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom;
+			for (int c = 0; c < 4; ++c)
+				diffs += output[i + c] != (inside ? reference[i + c] : untouched);
+		}
+	}
+	return diffs ? 1 + (diffs - 1) / 4 : 0;
+}
+
+// The scalar and AVX2 sliding-window kernels against the shader's nested loop, byte for byte:
+// radius 0, 1, 13 and past the image, rects on every edge, odd widths for the AVX2 tail and a
+// mask with empty, partial and full coverage
+static void BenchReference()
+{
+	struct Size
+	{
+		int width;
+		int height;
+	};
+	static const Size Sizes[] = { { 37, 23 }, { 67, 41 }, { 1, 1 }, { 9, 130 } };
+
+	printf("Box blur kernels vs CpuBoxBlurReference\n");
+	printf("%-8s %8s %-8s %8s %8s %8s %6s\n", "size", "radius", "rect", "scalar", "avx2", "dispatch", "ok");
+	for (const Size& size : Sizes)
+	{
+		BenchImage image;
+		MakeBenchImage(image, size.width, size.height);
+		uint32_t seed = 99;
+		for (size_t i = 3; i < image.mask.size(); i += 4)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			const uint8_t value = (uint8_t)(seed >> 24);
+			image.mask[i] = value < 64 ? 0 : (value < 128 ? 255 : value);
+		}
+
+		const int width = size.width, height = size.height;
+		const BlurRect rects[] = {
+			{ 0, 0, width, height },
+			{ 0, 0, std::max(width / 3, 1), height },
+			{ 0, 0, width, std::max(height / 3, 1) },
+			{ width - std::max(width / 3, 1), 0, width, height },
+			{ 0, height - std::max(height / 3, 1), width, height },
+			{ width / 4, height / 4, width - width / 4, height - height / 4 },
+		};
+		static const char* const RectNames[] = { "whole", "left", "top", "right", "bottom", "inside" };
+
+		std::vector<uint8_t> reference(image.output.size());
+		CpuImage input = { image.input.data(), width * 4 };
+		CpuImage output = { image.output.data(), width * 4 };
+		CpuImage referenceImage = { reference.data(), width * 4 };
+		CpuMask mask = { image.mask.data() + 3, width * 4, 4 };
+		CpuBlurScratch scratch;
+
+		for (float radius : { 0.0f, 1.0f, 13.0f, (float)(std::max(width, height) + 7) })
+		{
+			BlurConstants constants = { (uint32_t)width, (uint32_t)height, radius, 0.0f };
+			CpuBoxBlurReference(input, mask, referenceImage, constants);
+
+			for (size_t r = 0; r < sizeof(rects) / sizeof(rects[0]); ++r)
+			{
+				const BlurRect& rect = rects[r];
+				if (rect.left >= rect.right || rect.top >= rect.bottom)
+					continue;
+
+				std::fill(image.output.begin(), image.output.end(), 0xCD);
+				CpuBoxBlurRectScalar(input, mask, output, constants, rect, scratch);
+				const int scalarDiffs = CountRectDiffs(image.output, reference, width, height, rect, 0xCD);
+
+				int avx2Diffs = 0;
+#if defined(__AVX2__)
+				std::fill(image.output.begin(), image.output.end(), 0xCD);
+				CpuBoxBlurRectAvx2(input, mask, output, constants, rect, scratch);
+				avx2Diffs = CountRectDiffs(image.output, reference, width, height, rect, 0xCD);
+#endif
+				std::fill(image.output.begin(), image.output.end(), 0xCD);
+				CpuBoxBlurRect(input, mask, output, constants, rect, scratch);
+				const int dispatchDiffs = CountRectDiffs(image.output, reference, width, height, rect, 0xCD);
+
+				char name[32];
+				snprintf(name, sizeof(name), "%dx%d", width, height);
+#if defined(__AVX2__)
+				char avx2[16];
+				snprintf(avx2, sizeof(avx2), "%d", avx2Diffs);
+#else
+				const char* avx2 = "-";
+#endif
+				printf("%-8s %8.0f %-8s %8d %8s %8d %6s\n", name, radius, RectNames[r], scalarDiffs, avx2, dispatchDiffs,
+					   CheckResult(!scalarDiffs && !avx2Diffs && !dispatchDiffs));
+			}
+		}
+	}
+}
+
+// Flat BGRA image of `color`, mask alpha `coverage` everywhere, buffers sized exactly so
+// sanitizers catch reads past them
+static void MakeFlatImage(BenchImage& image, int width, int height, const uint8_t* color, uint8_t coverage)
+{
+	MakeBenchImage(image, width, height);
+	for (size_t i = 0; i < image.input.size(); i += 4)
+	{
+		memcpy(&image.input[i], color, 4);
+		image.mask[i + 3] = coverage;
+	}
+}
+
+// Pixels more than `tolerance` away from `expected` in any channel
+static int CountOffPixels(const std::vector<uint8_t>& pixels, const uint8_t* expected, int tolerance)
+{
+	int off = 0;
+	for (size_t i = 0; i < pixels.size(); i += 4)
+	{
+		bool differs = false;
+		for (int c = 0; c < 4; ++c)
+			differs |= abs(pixels[i + c] - expected[c]) > tolerance;
+		off += differs;
+	}
+	return off;
+}
+
+// CpuKawaseBlur on images whose result is known: flat stays flat, the mask gates and scales
+// alpha, level choice switches at the midpoints of the equivalent radii, and odd and tiny sizes
+// down to 1x1 run every level they are given, plus the deepest chain whose last levels are 1 pixel
+static void BenchKawaseChecks()
+{
+	static const uint8_t Color[4] = { 90, 140, 200, 230 };
+	static const uint8_t Black[4] = {};
+	CpuKawaseScratch scratch;
+
+	printf("Dual-Kawase checks\n");
+	printf("%-8s %8s %10s %12s %14s %6s\n", "size", "levels", "flat off", "mask 0 off", "mask 128 off", "ok");
+	static const int Sizes[][2] = { { 1, 1 }, { 2, 1 }, { 1, 7 }, { 3, 3 }, { 5, 2 }, { 17, 9 }, { 97, 61 }, { 640, 360 } };
+	for (const int* size : Sizes)
+	{
+		const int width = size[0], height = size[1];
+		BlurConstants constants = { (uint32_t)width, (uint32_t)height, 1000.0f, 0.0f };
+		std::vector<int> levelCounts;
+		for (int levels = 1; levels <= CpuKawaseLevelsForRadius(constants.blurRadius, width, height); ++levels)
+			levelCounts.push_back(levels);
+		if (levelCounts.back() < CpuKawaseMaxLevels)
+			levelCounts.push_back(CpuKawaseMaxLevels);
+
+		for (int levels : levelCounts)
+		{
+			BenchImage image;
+			MakeFlatImage(image, width, height, Color, 255);
+			CpuImage input = { image.input.data(), width * 4 };
+			CpuImage output = { image.output.data(), width * 4 };
+			CpuMask mask = { image.mask.data() + 3, width * 4, 4 };
+
+			CpuKawaseBlur(input, mask, output, constants, levels, scratch);
+			const int flatOff = CountOffPixels(image.output, Color, 0);
+
+			for (size_t i = 3; i < image.mask.size(); i += 4)
+				image.mask[i] = 0;
+			CpuKawaseBlur(input, mask, output, constants, levels, scratch);
+			const int emptyOff = CountOffPixels(image.output, Black, 0);
+
+			// Colors untouched, alpha times 128 / 255, the last bit is float rounding
+			uint8_t scaled[4] = { Color[0], Color[1], Color[2], (uint8_t)((Color[3] * 128 + 127) / 255) };
+			for (size_t i = 3; i < image.mask.size(); i += 4)
+				image.mask[i] = 128;
+			CpuKawaseBlur(input, mask, output, constants, levels, scratch);
+			int partialOff = CountOffPixels(image.output, scaled, 1);
+			for (size_t i = 0; i < image.output.size(); i += 4)
+				partialOff += memcmp(&image.output[i], Color, 3) != 0;
+
+			char name[32];
+			snprintf(name, sizeof(name), "%dx%d", width, height);
+			printf("%-8s %8d %10d %12d %14d %6s\n", name, levels, flatOff, emptyOff, partialOff,
+				   CheckResult(!flatOff && !emptyOff && !partialOff));
+		}
+	}
+
+	// Just under and over the geometric midpoint of two levels' radii, on an image large
+	// enough not to limit them
+	int boundaryFailures = 0;
+	for (int levels = 1; levels < CpuKawaseMaxLevels; ++levels)
+	{
+		const float midpoint = sqrtf(CpuKawaseEquivalentRadius(levels) * CpuKawaseEquivalentRadius(levels + 1));
+		const int below = CpuKawaseLevelsForRadius(midpoint * 0.99f, 1 << 16, 1 << 16);
+		const int above = CpuKawaseLevelsForRadius(midpoint * 1.01f, 1 << 16, 1 << 16);
+		const int exact = CpuKawaseLevelsForRadius(CpuKawaseEquivalentRadius(levels), 1 << 16, 1 << 16);
+		if (below != levels || above != levels + 1 || exact != levels)
+		{
+			printf("  levels %d: radius %.2f gives %d, %.2f gives %d, %.1f gives %d\n", levels, midpoint * 0.99f, below,
+				   midpoint * 1.01f, above, CpuKawaseEquivalentRadius(levels), exact);
+			++boundaryFailures;
+		}
+	}
+	const bool smallest = CpuKawaseLevelsForRadius(0.0f, 1920, 1080) == 1 && CpuKawaseLevelsForRadius(0.5f, 1920, 1080) == 1;
+	const bool limited = CpuKawaseLevelsForRadius(1000.0f, 7, 1000) == 2 && CpuKawaseLevelsForRadius(1000.0f, 1, 1) == 1;
+	printf("Level choice at the equivalent radius midpoints %s, small radii %s, limited by size %s\n",
+		   CheckResult(!boundaryFailures), CheckResult(smallest), CheckResult(limited));
+}
+
+// Single-threaded box kernel vs the Dual-Kawase chain at frosted-glass radii
+static void BenchKawase(int frames)
+{
+	static const float Radii[] = { 13.0f, 40.0f, 80.0f };
+
+	BenchImage image;
+	MakeBenchImage(image, 1920, 1080);
+
+	CpuImage input = { image.input.data(), image.width * 4 };
+	CpuImage output = { image.output.data(), image.width * 4 };
+	CpuMask mask = { image.mask.data() + 3, image.width * 4, 4 };
+
+	// The CPU times compare the integer box kernel with the float reference of the GPU chain,
+	// which says nothing about GPU cost; the reads per pixel are what the shaders issue
+	printf("Box vs Dual-Kawase at %dx%d (%d frames)\n", image.width, image.height, frames);
+	printf("%-8s %8s %12s %16s %12s %12s\n", "radius", "levels", "cpu box ms", "cpu float ref ms", "box reads", "kawase reads");
+
+	for (float radius : Radii)
+	{
+		BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, radius, 0.0f };
+		int levels = CpuKawaseLevelsForRadius(radius, image.width, image.height);
+
+		CpuBlurScratch boxScratch;
+		double start = NowMs();
+		for (int frame = 0; frame < frames; ++frame)
+			CpuBoxBlur(input, mask, output, constants, boxScratch);
+		double boxMs = (NowMs() - start) / frames;
+
+		CpuKawaseScratch kawaseScratch;
+		start = NowMs();
+		for (int frame = 0; frame < frames; ++frame)
+			CpuKawaseBlur(input, mask, output, constants, levels, kawaseScratch);
+		double kawaseMs = (NowMs() - start) / frames;
+
+		// Reads per output pixel of the GPU kernels
+		double pixels = (double)image.width * image.height;
+		double boxReads = (2.0 * (int)radius + 1) * (2.0 * (int)radius + 1);
+		double kawaseReads = CpuKawaseSampleCount(image.width, image.height, levels) / pixels;
+
+		printf("%-8.0f %8d %12.3f %16.3f %12.0f %12.2f\n", radius, levels, boxMs, kawaseMs, boxReads, kawaseReads);
+	}
+
+	BenchKawaseChecks();
+}
+
+// Unrolled radius-specialized kernels vs the generic runtime-weight loop
+// GenerateBlurKernelHlsl(BlurKernel_Tent, 1) as checked in. Other kernels and radii differ in
+// the first line and the three constants, see GoldenHlslHeaders.
+static const char* const GoldenTentHlsl =
+	"// tent kernel, radius 1, generated by GenerateBlurKernelHlsl\n"
+	"cbuffer BlurConstants : register(b0)\n"
+	"{\n"
+	"\tuint textureWidth;\n"
+	"\tuint textureHeight;\n"
+	"\tfloat blurRadius;\n"
+	"\tfloat padding;\n"
+	"};\n"
+	"\n"
+	"Texture2D<float4> InputTexture : register(t0);\n"
+	"Texture2D<float> MaskTexture : register(t1);\n"
+	"RWTexture2D<float4> OutputTexture : register(u0);\n"
+	"\n"
+	"static const int Radius = 1;\n"
+	"static const float Weights[3] = { 1.0, 2.0, 1.0 };\n"
+	"static const float WeightSum = 16.0;\n"
+	"\n"
+	"#ifdef SPARSE_TILES\n"
+	"StructuredBuffer<uint> TileList : register(t2);\n"
+	"\n"
+	"[numthreads(8, 8, 1)]\n"
+	"void main(uint3 group : SV_GroupID, uint3 groupThread : SV_GroupThreadID)\n"
+	"{\n"
+	"\tuint tile = TileList[group.x];\n"
+	"\tuint2 id = uint2(tile & 0xffff, tile >> 16) * 8 + groupThread.xy;\n"
+	"#else\n"
+	"[numthreads(8, 8, 1)]\n"
+	"void main(uint3 id : SV_DispatchThreadID)\n"
+	"{\n"
+	"#endif\n"
+	"\tif (id.x >= textureWidth || id.y >= textureHeight)\n"
+	"\t\treturn;\n"
+	"\n"
+	"#ifdef FULL_TILES\n"
+	"\tfloat maskValue = 1.0;\n"
+	"#else\n"
+	"\tfloat maskValue = MaskTexture[id.xy];\n"
+	"#endif\n"
+	"\tif (maskValue <= 0.0)\n"
+	"\t{\n"
+	"\t\tOutputTexture[id.xy] = float4(0, 0, 0, 0);\n"
+	"\t\treturn;\n"
+	"\t}\n"
+	"\n"
+	"\tfloat4 color = float4(0, 0, 0, 0);\n"
+	"\n"
+	"\t[unroll]\n"
+	"\tfor (int x = -Radius; x <= Radius; x++)\n"
+	"\t{\n"
+	"\t\t[unroll]\n"
+	"\t\tfor (int y = -Radius; y <= Radius; y++)\n"
+	"\t\t{\n"
+	"\t\t\tint sampleX = clamp((int)id.x + x, 0, (int)textureWidth - 1);\n"
+	"\t\t\tint sampleY = clamp((int)id.y + y, 0, (int)textureHeight - 1);\n"
+	"\t\t\tcolor += InputTexture[uint2(sampleX, sampleY)] * (Weights[x + Radius] * Weights[y + Radius]);\n"
+	"\t\t}\n"
+	"\t}\n"
+	"\n"
+	"\tcolor /= WeightSum;\n"
+	"\tcolor.a *= maskValue;\n"
+	"\tOutputTexture[id.xy] = color;\n"
+	"}\n";
+
+struct GoldenHlslHeader
+{
+	BlurKernelType type;
+	int radius;
+	const char* lines;	// Line 1 and the Radius, Weights and WeightSum lines
+};
+
+static const GoldenHlslHeader GoldenHlslHeaders[] = {
+	{ BlurKernel_Tent, 1,
+	  "// tent kernel, radius 1, generated by GenerateBlurKernelHlsl\n"
+	  "static const int Radius = 1;\n"
+	  "static const float Weights[3] = { 1.0, 2.0, 1.0 };\n"
+	  "static const float WeightSum = 16.0;\n" },
+	{ BlurKernel_Box, 0,
+	  "// box kernel, radius 0, generated by GenerateBlurKernelHlsl\n"
+	  "static const int Radius = 0;\n"
+	  "static const float Weights[1] = { 1.0 };\n"
+	  "static const float WeightSum = 1.0;\n" },
+	{ BlurKernel_Gaussian, 2,
+	  "// gaussian kernel, radius 2, generated by GenerateBlurKernelHlsl\n"
+	  "static const int Radius = 2;\n"
+	  "static const float Weights[5] = { 1.0, 21.0, 64.0, 21.0, 1.0 };\n"
+	  "static const float WeightSum = 11664.0;\n" },
+	{ BlurKernel_Gaussian, 16,
+	  "// gaussian kernel, radius 16, generated by GenerateBlurKernelHlsl\n"
+	  "static const int Radius = 16;\n"
+	  "static const float Weights[33] = { 1.0, 1.0, 2.0, 3.0, 5.0, 8.0, 11.0, 15.0, 21.0, 27.0, 34.0, 41.0, 48.0, 55.0, 60.0, 63.0, "
+	  "64.0, 63.0, 60.0, 55.0, 48.0, 41.0, 34.0, 27.0, 21.0, 15.0, 11.0, 8.0, 5.0, 3.0, 2.0, 1.0, 1.0 };\n"
+	  "static const float WeightSum = 729316.0;\n" },
+};
+
+// The golden shader with the header lines of `header` in place of the tent's
+static std::string GoldenHlsl(const GoldenHlslHeader& header)
+{
+	auto splitLines = [](const std::string& text) {
+		std::vector<std::string> lines;
+		size_t begin = 0;
+		for (size_t end; (end = text.find('\n', begin)) != std::string::npos; begin = end + 1)
+			lines.push_back(text.substr(begin, end + 1 - begin));
+		return lines;
+	};
+
+	std::vector<std::string> lines = splitLines(GoldenTentHlsl);
+	const std::vector<std::string> replacements = splitLines(header.lines);
+	const std::vector<std::string> tent = splitLines(GoldenHlslHeaders[0].lines);
+	std::string result;
+	for (std::string& line : lines)
+	{
+		for (size_t i = 0; i < tent.size(); ++i)
+		{
+			if (line == tent[i])
+				line = replacements[i];
+		}
+		result += line;
+	}
+	return result;
+}
+
+// Golden checks of the generated HLSL, then every specialized CPU kernel against the generic
+// loop and the box kernels against CpuBoxBlurRect, byte for byte, on an odd size with a
+// partial mask, whole image and a rect on an edge
+static void BenchKernelChecks()
+{
+	printf("Generated HLSL against the checked-in shaders:");
+	const char* separator = " ";
+	for (const GoldenHlslHeader& header : GoldenHlslHeaders)
+	{
+		const bool same = GenerateBlurKernelHlsl(header.type, header.radius) == GoldenHlsl(header);
+		printf("%s%s %d %s", separator, BlurKernelName(header.type), header.radius, CheckResult(same));
+		separator = ", ";
+	}
+	printf("\n");
+
+	BenchImage image;
+	MakeBenchImage(image, 83, 47);
+	for (size_t i = 3; i < image.mask.size(); i += 4)
+		image.mask[i] = (uint8_t)(i % 7 == 0 ? 0 : (i % 5 == 0 ? 96 : 255));
+	std::vector<uint8_t> reference(image.output.size());
+	CpuImage input = { image.input.data(), image.width * 4 };
+	CpuImage output = { image.output.data(), image.width * 4 };
+	CpuImage referenceImage = { reference.data(), image.width * 4 };
+	CpuMask mask = { image.mask.data() + 3, image.width * 4, 4 };
+	const BlurRect rects[] = { { 0, 0, image.width, image.height }, { 61, 0, image.width, 20 } };
+	CpuBlurScratch scratch;
+
+	int specializedDiffs = 0, boxDiffs = 0, missing = 0;
+	for (int type = 0; type < BlurKernel_Count; ++type)
+	{
+		for (int radius = 0; radius <= BlurKernelMaxSpecializedRadius; ++radius)
+		{
+			BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, (float)radius, 0.0f };
+			BlurKernelFunction specialized = BlurKernelSpecialized((BlurKernelType)type, radius);
+			if (!specialized)
+			{
+				++missing;
+				continue;
+			}
+
+			for (const BlurRect& rect : rects)
+			{
+				std::fill(reference.begin(), reference.end(), 0xCD);
+				CpuBlurKernelGenericRect((BlurKernelType)type, input, mask, referenceImage, constants, rect, scratch);
+				std::fill(image.output.begin(), image.output.end(), 0xCD);
+				specialized(input, mask, output, constants, rect, scratch);
+				specializedDiffs += CountImageDiffs(image.output, reference);
+
+				if (type != BlurKernel_Box)
+					continue;
+				std::fill(image.output.begin(), image.output.end(), 0xCD);
+				CpuBoxBlurRect(input, mask, output, constants, rect, scratch);
+				boxDiffs += CountImageDiffs(image.output, reference);
+			}
+		}
+	}
+	printf("Specialized kernels, radius 0-%d: %d missing, %d pixels differ from the generic loop %s, box vs CpuBoxBlurRect: %d differ %s\n",
+		   BlurKernelMaxSpecializedRadius, missing, specializedDiffs, CheckResult(!missing && !specializedDiffs), boxDiffs,
+		   CheckResult(!boxDiffs));
+}
+
+static void BenchKernels(int frames)
+{
+	static const int Radii[] = { 1, 4, 8, 13, 16 };
+
+	BenchImage image;
+	MakeBenchImage(image, 1920, 1080);
+
+	CpuImage input = { image.input.data(), image.width * 4 };
+	CpuImage output = { image.output.data(), image.width * 4 };
+	CpuMask mask = { image.mask.data() + 3, image.width * 4, 4 };
+	BlurRect rect = { 0, 0, image.width, image.height };
+
+	printf("Specialized vs generic kernels at %dx%d (%d frames)\n", image.width, image.height, frames);
+	printf("%-10s %8s %14s %12s %8s\n", "kernel", "radius", "specialized ms", "generic ms", "speedup");
+
+	CpuBlurScratch scratch;
+	for (int type = 0; type < BlurKernel_Count; ++type)
+	{
+		for (int radius : Radii)
+		{
+			BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, (float)radius, 0.0f };
+			BlurKernelFunction specialized = BlurKernelSpecialized((BlurKernelType)type, radius);
+
+			double start = NowMs();
+			for (int frame = 0; frame < frames; ++frame)
+				specialized(input, mask, output, constants, rect, scratch);
+			double specializedMs = (NowMs() - start) / frames;
+
+			start = NowMs();
+			for (int frame = 0; frame < frames; ++frame)
+				CpuBlurKernelGenericRect((BlurKernelType)type, input, mask, output, constants, rect, scratch);
+			double genericMs = (NowMs() - start) / frames;
+
+			printf("%-10s %8d %14.3f %12.3f %7.2fx\n", BlurKernelName((BlurKernelType)type), radius, specializedMs, genericMs, genericMs / specializedMs);
+		}
+	}
+
+	BenchKernelChecks();
+}
+
+static uint32_t NextSeed(uint32_t& seed)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return seed >> 8;
+}
+
+// A window that doesn't sit at the desktop's origin, partly off-screen, with move rects:
+// each frame the window's pixels are cut from the desktop again and the incremental blur
+// of what DirtyRegionBuild reports has to match a full blur of them
+static void BenchDirtyRegionWindows(float radius)
+{
+	struct Scenario
+	{
+		const char* name;
+		BlurRect window;  // Desktop coordinates
+		bool moves;
+	};
+	static const Scenario Scenarios[] = {
+		{ "offset", { 200, 120, 712, 504 }, false },
+		{ "off-screen", { -150, 400, 450, 800 }, false },
+		{ "moves", { 200, 120, 712, 504 }, true },
+		{ "off-moves", { 700, -90, 1200, 300 }, true },
+	};
+	const int desktopWidth = 1024;
+	const int desktopHeight = 640;
+	const int frames = 24;
+
+	BenchImage desktop;
+	MakeBenchImage(desktop, desktopWidth, desktopHeight);
+
+	printf("Offset and off-screen windows on a %dx%d desktop (radius %.0f, %d frames)\n", desktopWidth, desktopHeight, radius, frames);
+	printf("%-10s %10s %10s %8s\n", "scenario", "moves", "blurred %", "match");
+
+	CpuBlurScratch scratch;
+	for (const Scenario& scenario : Scenarios)
+	{
+		const int width = scenario.window.right - scenario.window.left;
+		const int height = scenario.window.bottom - scenario.window.top;
+		std::vector<uint8_t> pixels((size_t)width * height * 4);
+		std::vector<uint8_t> coverage((size_t)width * height * 4, 255);
+		std::vector<uint8_t> output(pixels.size());
+		std::vector<uint8_t> reference(pixels.size());
+
+		BlurConstants constants = { (uint32_t)width, (uint32_t)height, radius, 0.0f };
+		CpuImage input = { pixels.data(), width * 4 };
+		CpuImage outputImage = { output.data(), width * 4 };
+		CpuImage referenceImage = { reference.data(), width * 4 };
+		CpuMask mask = { coverage.data() + 3, width * 4, 4 };
+
+		// Off the desktop the window shows transparent black, nothing is ever reported there
+		auto cutWindow = [&]()
+		{
+			for (int y = 0; y < height; ++y)
+			{
+				const int desktopY = scenario.window.top + y;
+				for (int x = 0; x < width; ++x)
+				{
+					const int desktopX = scenario.window.left + x;
+					uint8_t* pixel = &pixels[((size_t)y * width + x) * 4];
+					if (desktopX < 0 || desktopY < 0 || desktopX >= desktopWidth || desktopY >= desktopHeight)
+						memset(pixel, 0, 4);
+					else
+						memcpy(pixel, &desktop.input[((size_t)desktopY * desktopWidth + desktopX) * 4], 4);
+				}
+			}
+		};
+
+		DirtyRegionTracker tracker;
+		DirtyRegionReset(tracker);
+		DirtyRegion region;
+		cutWindow();
+		DirtyRegionBuild(tracker, scenario.window, (int)radius, region);
+		CpuIncrementalBlur(input, mask, outputImage, constants, region, scratch);
+
+		uint32_t seed = 4242;
+		int moveCount = 0;
+		double blurredPixels = 0.0;
+		bool match = true;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			// Dirty rects anywhere on the desktop, many straddle the window's edges
+			std::vector<BlurRect> dirtyRects;
+			for (int i = 0; i < 3; ++i)
+			{
+				const int rectWidth = 1 + (int)(NextSeed(seed) % 96);
+				const int rectHeight = 1 + (int)(NextSeed(seed) % 64);
+				const int x = (int)(NextSeed(seed) % (uint32_t)(desktopWidth - rectWidth + 1));
+				const int y = (int)(NextSeed(seed) % (uint32_t)(desktopHeight - rectHeight + 1));
+				dirtyRects.push_back({ x, y, x + rectWidth, y + rectHeight });
+
+				for (int row = y; row < y + rectHeight; ++row)
+					for (int column = x * 4; column < (x + rectWidth) * 4; ++column)
+						desktop.input[(size_t)row * desktopWidth * 4 + column] ^= (uint8_t)(frame * 37 + 11);
+			}
+
+			// A block scrolled or dragged by up to 48 pixels, the source keeps its pixels
+			std::vector<DirtyMove> moves;
+			if (scenario.moves)
+			{
+				const int rectWidth = 16 + (int)(NextSeed(seed) % 200);
+				const int rectHeight = 16 + (int)(NextSeed(seed) % 120);
+				const int sourceX = 48 + (int)(NextSeed(seed) % (uint32_t)(desktopWidth - rectWidth - 96));
+				const int sourceY = 48 + (int)(NextSeed(seed) % (uint32_t)(desktopHeight - rectHeight - 96));
+				const int x = sourceX + (int)(NextSeed(seed) % 97) - 48;
+				const int y = sourceY + (int)(NextSeed(seed) % 97) - 48;
+				moves.push_back({ sourceX, sourceY, { x, y, x + rectWidth, y + rectHeight } });
+
+				std::vector<uint8_t> block((size_t)rectWidth * rectHeight * 4);
+				for (int row = 0; row < rectHeight; ++row)
+					memcpy(&block[(size_t)row * rectWidth * 4], &desktop.input[((size_t)(sourceY + row) * desktopWidth + sourceX) * 4], (size_t)rectWidth * 4);
+				for (int row = 0; row < rectHeight; ++row)
+					memcpy(&desktop.input[((size_t)(y + row) * desktopWidth + x) * 4], &block[(size_t)row * rectWidth * 4], (size_t)rectWidth * 4);
+				++moveCount;
+			}
+
+			DirtyRegionAddFrame(tracker, dirtyRects.data(), (int)dirtyRects.size(), moves.data(), (int)moves.size());
+			cutWindow();
+			if (DirtyRegionBuild(tracker, scenario.window, (int)radius, region))
+			{
+				CpuIncrementalBlur(input, mask, outputImage, constants, region, scratch);
+				blurredPixels += (double)DirtyRegionArea(region, width, height);
+			}
+
+			CpuBoxBlur(input, mask, referenceImage, constants, scratch);
+			match = match && output == reference;
+		}
+
+		const double blurredPercent = 100.0 * blurredPixels / ((double)width * height * frames);
+		printf("%-10s %10d %10.2f %8s\n", scenario.name, moveCount, blurredPercent, CheckResult(match, "yes", "NO"));
+	}
+}
+
+// Synthetic frames with duplication-style dirty rects: the incremental blur has to
+// produce exactly the full re-blur while touching only the dirty pixels
+static void BenchDirtyRegions(float radius, int frames)
+{
+	struct Scenario
+	{
+		const char* name;
+		int rectWidth;
+		int rectHeight;
+		int rectCount;
+	};
+	static const Scenario Scenarios[] = {
+		{ "caret", 2, 18, 1 },
+		{ "typing", 120, 18, 1 },
+		{ "widgets", 64, 64, 6 },
+		{ "scroll", 1920, 900, 1 },
+	};
+
+	BenchImage image;
+	MakeBenchImage(image, 1920, 1080);
+	std::vector<uint8_t> reference(image.output.size());
+
+	BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, radius, 0.0f };
+	CpuImage input = { image.input.data(), image.width * 4 };
+	CpuImage output = { image.output.data(), image.width * 4 };
+	CpuImage referenceImage = { reference.data(), image.width * 4 };
+	CpuMask mask = { image.mask.data() + 3, image.width * 4, 4 };
+	BlurRect window = { 0, 0, image.width, image.height };
+
+	printf("Incremental vs full re-blur at %dx%d (radius %.0f, %d frames)\n", image.width, image.height, radius, frames);
+	printf("%-10s %10s %14s %10s %8s %8s\n", "scenario", "full ms", "incremental ms", "blurred %", "speedup", "match");
+
+	CpuBlurScratch scratch;
+	for (const Scenario& scenario : Scenarios)
+	{
+		DirtyRegionTracker tracker;
+		DirtyRegionReset(tracker);
+		DirtyRegion region;
+
+		// First frame is always a full blur
+		DirtyRegionBuild(tracker, window, (int)radius, region);
+		CpuIncrementalBlur(input, mask, output, constants, region, scratch);
+
+		uint32_t seed = 777;
+		double fullMs = 0.0;
+		double incrementalMs = 0.0;
+		double blurredPixels = 0.0;
+		bool match = true;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			std::vector<BlurRect> dirtyRects;
+			for (int i = 0; i < scenario.rectCount; ++i)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				int x = (int)(seed % (uint32_t)(image.width - scenario.rectWidth + 1));
+				seed = seed * 1664525u + 1013904223u;
+				int y = (int)(seed % (uint32_t)(image.height - scenario.rectHeight + 1));
+				dirtyRects.push_back({ x, y, x + scenario.rectWidth, y + scenario.rectHeight });
+
+				for (int row = y; row < y + scenario.rectHeight; ++row)
+					for (int column = x * 4; column < (x + scenario.rectWidth) * 4; ++column)
+						image.input[(size_t)row * image.width * 4 + column] ^= (uint8_t)(frame * 37 + 11);
+			}
+
+			DirtyRegionAddFrame(tracker, dirtyRects.data(), (int)dirtyRects.size(), nullptr, 0);
+
+			double start = NowMs();
+			if (DirtyRegionBuild(tracker, window, (int)radius, region))
+				CpuIncrementalBlur(input, mask, output, constants, region, scratch);
+			incrementalMs += NowMs() - start;
+
+			blurredPixels += (double)DirtyRegionArea(region, image.width, image.height);
+
+			start = NowMs();
+			CpuBoxBlur(input, mask, referenceImage, constants, scratch);
+			fullMs += NowMs() - start;
+
+			match = match && image.output == reference;
+		}
+
+		double blurredPercent = 100.0 * blurredPixels / ((double)image.width * image.height * frames);
+		printf("%-10s %10.3f %14.3f %10.2f %7.2fx %8s\n", scenario.name, fullMs / frames, incrementalMs / frames,
+			   blurredPercent, fullMs / incrementalMs, CheckResult(match, "yes", "NO"));
+	}
+
+	BenchDirtyRegionWindows(radius);
+
+	// The apron build's full-blur threshold is a share of the window: 54% of a 200x100 window
+	// is 43% of its radius 8 apron. A change only in the apron re-blurs the strip it reaches.
+	const BlurRect small = { 1000, 500, 1200, 600 };
+	DirtyRegionTracker tracker;
+	DirtyRegionReset(tracker);
+	DirtyRegion region;
+	DirtyRegionBuildApron(tracker, small, 8, region);
+	const BlurRect inside = { 1040, 515, 1150, 585 };
+	DirtyRegionAddFrame(tracker, &inside, 1, nullptr, 0);
+	const bool insideFull = DirtyRegionBuildApron(tracker, small, 8, region) && region.full;
+	const BlurRect apronOnly = { 1203, 520, 1206, 540 };
+	DirtyRegionAddFrame(tracker, &apronOnly, 1, nullptr, 0);
+	const bool apronPartial = DirtyRegionBuildApron(tracker, small, 8, region) && !region.full && region.blurRects.size() == 1 &&
+							  region.blurRects[0].left == 195 && region.blurRects[0].right == 200 && region.copyRects[0].left == 203;
+	printf("Apron threshold of the window: 54%% blurs all %s, apron-only change partial %s\n", CheckResult(insideFull),
+		   CheckResult(apronPartial));
+}
+
+// The headless pipeline fed by frame sources, an 800x600 window on a 1920x1080 desktop
+static void BenchPipeline(const char* sourceSpec, float radius, int frames)
+{
+	static const char* const DefaultSources[] = { "synthetic:text", "synthetic:noise", "synthetic:static" };
+
+	std::vector<const char*> sources;
+	if (sourceSpec)
+		sources.push_back(sourceSpec);
+	else
+		sources.assign(DefaultSources, DefaultSources + sizeof(DefaultSources) / sizeof(DefaultSources[0]));
+
+	const BlurRect window = { 560, 240, 1360, 840 };
+	printf("Frame source pipeline, %dx%d window (radius %.0f, %d frames)\n", window.right - window.left, window.bottom - window.top, radius, frames);
+	printf("%-20s %8s %10s %10s\n", "source", "frames", "blurred", "ms/frame");
+
+	for (const char* spec : sources)
+	{
+		FrameSource* source = CreateFrameSource(spec, 1920, 1080, frames);
+		if (!source)
+		{
+			printf("%-20s failed to open\n", spec);
+			continue;
+		}
+
+		BlurPipeline pipeline;
+		BlurPipelineStart(pipeline, window, radius);
+
+		int frameCount = 0;
+		int blurredCount = 0;
+		double start = NowMs();
+		for (;;)
+		{
+			bool blurred = false;
+			FrameSourceResult result = BlurPipelineStep(pipeline, *source, 0, &blurred);
+			if (result == FrameSource_End)
+				break;
+			if (result != FrameSource_Ok)
+				continue;
+			++frameCount;
+			blurredCount += blurred ? 1 : 0;
+		}
+		double ms = (NowMs() - start) / std::max(1, frameCount);
+
+		BlurPipelineStop(pipeline);
+		delete source;
+
+		printf("%-20s %8d %10d %10.3f\n", spec, frameCount, blurredCount, ms);
+	}
+}
+
+// Just enough JSON to read TraceWriteChrome's output back
+struct JsonValue
+{
+	enum Type
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object,
+	};
+
+	Type type = Null;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> items;
+	std::vector<std::pair<std::string, JsonValue>> members;
+
+	const JsonValue* Find(const char* key) const
+	{
+		for (const auto& member : members)
+			if (member.first == key)
+				return &member.second;
+		return nullptr;
+	}
+};
+
+static void JsonSkipSpace(const char*& at)
+{
+	while (*at == ' ' || *at == '\t' || *at == '\n' || *at == '\r')
+		++at;
+}
+
+static bool JsonParseString(const char*& at, std::string& string)
+{
+	if (*at++ != '"')
+		return false;
+
+	for (; *at != '"'; ++at)
+	{
+		if ((unsigned char)*at < 0x20)
+			return false;  // Also the end of the text
+
+		if (*at == '\\')
+		{
+			++at;
+			if (*at == 'u')
+			{
+				for (int i = 1; i <= 4; ++i)
+					if (!isxdigit((unsigned char)at[i]))
+						return false;
+				at += 4;
+				string += '?';
+				continue;
+			}
+			if (!*at || !strchr("\"\\/bfnrt", *at))
+				return false;
+		}
+		string += *at;
+	}
+	++at;
+	return true;
+}
+
+static bool JsonParseNumber(const char*& at, double& number)
+{
+	const char* begin = at;
+	if (*at == '-')
+		++at;
+	if (!isdigit((unsigned char)*at))
+		return false;
+	if (*at == '0')
+		++at;
+	else
+		while (isdigit((unsigned char)*at)) ++at;
+	if (*at == '.')
+	{
+		++at;
+		if (!isdigit((unsigned char)*at))
+			return false;
+		while (isdigit((unsigned char)*at)) ++at;
+	}
+	if (*at == 'e' || *at == 'E')
+	{
+		++at;
+		if (*at == '+' || *at == '-')
+			++at;
+		if (!isdigit((unsigned char)*at))
+			return false;
+		while (isdigit((unsigned char)*at)) ++at;
+	}
+	number = strtod(begin, nullptr);
+	return true;
+}
+
+static bool JsonParseValue(const char*& at, JsonValue& value);
+
+// `at` is past the opening brace
+static bool JsonParseMembers(const char*& at, JsonValue& value)
+{
+	JsonSkipSpace(at);
+	if (*at == '}')
+	{
+		++at;
+		return true;
+	}
+
+	for (;;)
+	{
+		std::pair<std::string, JsonValue> member;
+		JsonSkipSpace(at);
+		if (!JsonParseString(at, member.first))
+			return false;
+		JsonSkipSpace(at);
+		if (*at++ != ':' || !JsonParseValue(at, member.second))
+			return false;
+		value.members.push_back(std::move(member));
+
+		JsonSkipSpace(at);
+		if (*at == '}')
+		{
+			++at;
+			return true;
+		}
+		if (*at++ != ',')
+			return false;
+	}
+}
+
+// `at` is past the opening bracket
+static bool JsonParseItems(const char*& at, JsonValue& value)
+{
+	JsonSkipSpace(at);
+	if (*at == ']')
+	{
+		++at;
+		return true;
+	}
+
+	for (;;)
+	{
+		value.items.emplace_back();
+		if (!JsonParseValue(at, value.items.back()))
+			return false;
+
+		JsonSkipSpace(at);
+		if (*at == ']')
+		{
+			++at;
+			return true;
+		}
+		if (*at++ != ',')
+			return false;
+	}
+}
+
+static bool JsonParseValue(const char*& at, JsonValue& value)
+{
+	JsonSkipSpace(at);
+	switch (*at)
+	{
+	  case '{':
+		  value.type = JsonValue::Object;
+		  return JsonParseMembers(++at, value);
+
+	  case '[':
+		  value.type = JsonValue::Array;
+		  return JsonParseItems(++at, value);
+
+	  case '"':
+		  value.type = JsonValue::String;
+		  return JsonParseString(at, value.string);
+
+	  case 't':
+	  case 'f':
+	  case 'n':
+		  for (const char* literal : { "true", "false", "null" })
+		  {
+			  if (!strncmp(at, literal, strlen(literal)))
+			  {
+				  value.type = *at == 'n' ? JsonValue::Null : JsonValue::Bool;
+				  value.number = *at == 't' ? 1.0 : 0.0;
+				  at += strlen(literal);
+				  return true;
+			  }
+		  }
+		  return false;
+
+	  default:
+		  value.type = JsonValue::Number;
+		  return JsonParseNumber(at, value.number);
+	}
+}
+
+// Writes what the trace holds through TraceWriteChrome and parses it back, false when
+// the file isn't valid JSON
+static bool ReadBackTrace(JsonValue& root)
+{
+	static const char* const Path = "BackdropFilterBench-check.json";
+	if (!TraceWriteChrome(Path))
+		return false;
+
+	std::string text;
+	FILE* file = fopen(Path, "rb");
+	if (file)
+	{
+		char chunk[65536];
+		for (size_t size; (size = fread(chunk, 1, sizeof(chunk), file)) > 0;)
+			text.append(chunk, size);
+		fclose(file);
+	}
+	remove(Path);
+
+	const char* at = text.c_str();
+	if (!file || !JsonParseValue(at, root))
+		return false;
+	JsonSkipSpace(at);
+	return *at == 0;
+}
+
+struct TraceCheckEvent
+{
+	std::string name;
+	std::string phase;
+	int threadId;
+	double start;	  // Microseconds
+	double duration;
+	double arg;		  // Zones' frame, counters' value
+};
+
+// The trace_event entries, false when one misses a field its phase needs
+static bool TraceCheckEvents(const JsonValue& root, std::vector<TraceCheckEvent>& events)
+{
+	const JsonValue* list = root.Find("traceEvents");
+	if (!list || list->type != JsonValue::Array)
+		return false;
+
+	for (const JsonValue& entry : list->items)
+	{
+		const JsonValue* name = entry.Find("name");
+		const JsonValue* phase = entry.Find("ph");
+		const JsonValue* thread = entry.Find("tid");
+		if (!name || !phase || !thread || name->type != JsonValue::String || phase->type != JsonValue::String)
+			return false;
+
+		TraceCheckEvent event = { name->string, phase->string, (int)thread->number, 0.0, 0.0, 0.0 };
+		if (event.phase != "M")
+		{
+			const JsonValue* start = entry.Find("ts");
+			if (!start || start->type != JsonValue::Number)
+				return false;
+			event.start = start->number;
+		}
+		if (event.phase == "X" || event.phase == "C")
+		{
+			const JsonValue* duration = entry.Find("dur");
+			const JsonValue* args = entry.Find("args");
+			const JsonValue* arg = args ? args->Find(event.phase == "X" ? "frame" : "value") : nullptr;
+			if ((event.phase == "X" && (!duration || duration->number < 0.0)) || !arg || arg->type != JsonValue::Number)
+				return false;
+			event.duration = duration ? duration->number : 0.0;
+			event.arg = arg->number;
+		}
+		events.push_back(std::move(event));
+	}
+	return true;
+}
+
+// The trace core on its own: what is written parses, zones nest and carry the frame they
+// closed in, every thread shows up, the ring keeps the newest events and off records nothing
+static void BenchTraceChecks()
+{
+	static const int Frames = 50;
+	static const int RingExtra = 1000;
+	static const char* const WorkerNames[] = { "Worker 1", "Worker 2", "Worker 3", "Worker 4" };
+	static const int WorkerZones = 500;
+
+	// Frames with a zone nested in another, and a counter
+	TraceEnable(true);
+	for (int frame = 0; frame < Frames; ++frame)
+	{
+		TraceBeginFrame();
+		TraceZone outer("Outer");
+		{
+			TraceZone inner("Inner");
+			TraceCounter("Frame counter", frame);
+		}
+	}
+
+	JsonValue root;
+	std::vector<TraceCheckEvent> events;
+	const bool parsed = ReadBackTrace(root) && TraceCheckEvents(root, events);
+
+	int frameMarkers = 0;
+	int outerZones = 0;
+	bool framesMatch = parsed;
+	bool zonesNest = parsed;
+	const TraceCheckEvent* lastInner = nullptr;
+	for (const TraceCheckEvent& event : events)
+	{
+		// A zone is written when it closes, so it follows its frame's marker and its inner zones
+		char marker[32];
+		snprintf(marker, sizeof(marker), "Frame %d", frameMarkers + 1);
+		if (event.phase == "i" && event.name == marker)
+			++frameMarkers;
+		else if (event.phase == "X" && event.name == "Inner")
+		{
+			framesMatch = framesMatch && event.arg == frameMarkers;
+			lastInner = &event;
+		}
+		else if (event.phase == "X" && event.name == "Outer")
+		{
+			// ts and dur are rounded to nanoseconds separately
+			++outerZones;
+			framesMatch = framesMatch && event.arg == frameMarkers;
+			zonesNest = zonesNest && lastInner && lastInner->arg == event.arg && lastInner->start >= event.start - 0.001 &&
+				lastInner->start + lastInner->duration <= event.start + event.duration + 0.002;
+			lastInner = nullptr;
+		}
+		else if (event.phase == "C")
+			framesMatch = framesMatch && event.name == "Frame counter" && event.arg == frameMarkers - 1;
+	}
+	framesMatch = framesMatch && frameMarkers == Frames;
+	zonesNest = zonesNest && outerZones == Frames;
+
+	// Zones from several threads at once
+	TraceEnable(true);
+	std::vector<std::thread> workers;
+	for (const char* name : WorkerNames)
+	{
+		workers.emplace_back([name]() {
+			for (int i = 0; i < WorkerZones; ++i)
+			{
+				TraceZone zone(name);
+			}
+		});
+	}
+	for (std::thread& worker : workers)
+		worker.join();
+
+	root = JsonValue();
+	events.clear();
+	bool threadsMatch = ReadBackTrace(root) && TraceCheckEvents(root, events);
+	for (const char* name : WorkerNames)
+	{
+		int count = 0;
+		int threadId = -1;
+		for (const TraceCheckEvent& event : events)
+		{
+			if (event.phase != "X" || event.name != name)
+				continue;
+			threadsMatch = threadsMatch && (threadId < 0 || threadId == event.threadId);
+			threadId = event.threadId;
+			++count;
+		}
+		threadsMatch = threadsMatch && count == WorkerZones;
+	}
+
+	// Past TraceBufferEvents the oldest events go
+	TraceEnable(true);
+	std::thread([]() {
+		for (int i = 0; i < TraceBufferEvents + RingExtra; ++i)
+			TraceCounter("Ring", i);
+	}).join();
+
+	root = JsonValue();
+	events.clear();
+	bool ringMatch = ReadBackTrace(root) && TraceCheckEvents(root, events);
+	int ringEvents = 0;
+	for (const TraceCheckEvent& event : events)
+	{
+		if (event.phase != "C" || event.name != "Ring")
+			continue;
+		ringMatch = ringMatch && event.arg == RingExtra + ringEvents;
+		++ringEvents;
+	}
+	ringMatch = ringMatch && ringEvents == TraceBufferEvents && TraceEventCount() == TraceBufferEvents;
+
+	// Off, including a zone that opened while it was on
+	TraceEnable(true);
+	{
+		TraceZone straddling("Straddling");
+		TraceEnable(false);
+	}
+	TraceBeginFrame();
+	{
+		TraceZone zone("Off");
+		TraceCounter("Off", 1);
+	}
+	const bool offEmpty = TraceEventCount() == 0;
+
+	printf("Trace checks: JSON %s, frame ids %s, zones nest %s, %d threads %s, ring keeps the newest %d %s, off records nothing %s\n",
+		   CheckResult(parsed), CheckResult(framesMatch), CheckResult(zonesNest), (int)workers.size(), CheckResult(threadsMatch),
+		   TraceBufferEvents, CheckResult(ringMatch), CheckResult(offEmpty));
+}
+
+static double Median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	const size_t middle = values.size() / 2;
+	return values.size() % 2 ? values[middle] : 0.5 * (values[middle - 1] + values[middle]);
+}
+
+// Cost of the trace zones in the headless pipeline: the same frames with tracing off and on,
+// alternating which goes first so clock drift hits both. The slowdown is the median over many
+// short rounds, long ones only collect more of the machine's drift.
+static void BenchTrace(const char* tracePath, float radius, int frames)
+{
+	static const int Rounds = 200;
+	const BlurRect window = { 0, 0, 1920, 1080 };
+
+	printf("Trace overhead, synthetic:noise %dx%d (radius %.0f, %d frames x %d rounds)\n",
+		   window.right, window.bottom, radius, frames, Rounds);
+#if !defined(BACKDROP_TRACE)
+	printf("Built without BACKDROP_TRACE, the zones are compiled out\n");
+#endif
+
+	BlurPipeline pipeline;
+	BlurPipelineStart(pipeline, window, radius);
+
+	std::vector<double> roundMs[2];
+	int tracedFrames = 1;
+	for (int round = 0; round < Rounds; ++round)
+	{
+		for (int order = 0; order < 2; ++order)
+		{
+			const int traced = (round + order) & 1;
+			TraceEnable(traced != 0);
+
+			FrameSource* source = CreateSyntheticFrameSource(SyntheticFrame_Noise, window.right, window.bottom, frames);
+			DirtyRegionInvalidate(pipeline.tracker);
+
+			int runFrames = 0;
+			double start = NowMs();
+			while (BlurPipelineStep(pipeline, *source, 0) != FrameSource_End)
+			{
+				TRACE_FRAME();
+				++runFrames;
+			}
+			roundMs[traced].push_back((NowMs() - start) / std::max(1, runFrames));
+
+			TraceEnable(false);
+			if (traced)
+				tracedFrames = std::max(1, runFrames);
+			delete source;
+		}
+	}
+
+	// Off doesn't clear, so this is the last traced run
+	int events = TraceEventCount();
+	BlurPipelineStop(pipeline);
+
+	// Frame-to-frame noise easily hides the zones, so also time them on their own
+	static const int ZoneIterations = 1000000;
+	TraceEnable(true);
+	double start = NowMs();
+	for (int i = 0; i < ZoneIterations; ++i)
+	{
+		TRACE_ZONE("Overhead");
+	}
+	double zoneNs = (NowMs() - start) * 1.0e6 / ZoneIterations;
+	TraceEnable(false);
+
+	// Either way the zones have to stay under 1% of a frame
+	std::vector<double> slowdowns;
+	for (int round = 0; round < Rounds; ++round)
+		slowdowns.push_back(100.0 * (roundMs[1][round] - roundMs[0][round]) / roundMs[0][round]);
+	const double offMs = Median(roundMs[0]);
+	const double onMs = Median(roundMs[1]);
+	const double measured = Median(slowdowns);
+	const double eventsPerFrame = (double)events / tracedFrames;
+	const double estimated = 100.0 * eventsPerFrame * zoneNs / (offMs * 1.0e6);
+	printf("%12s %12s %10s %12s %10s %10s\n", "off ms", "on ms", "measured", "events/frame", "ns/zone", "estimated");
+	printf("%12.3f %12.3f %9.2f%% %12.1f %10.1f %9.4f%%\n", offMs, onMs, measured, eventsPerFrame, zoneNs, estimated);
+	printf("Under 1%%: measured %s, estimated %s\n", CheckResult(measured < 1.0), CheckResult(estimated < 1.0));
+
+	if (tracePath)
+	{
+		if (TraceWriteChrome(tracePath))
+			printf("Wrote %s\n", tracePath);
+		else
+			printf("Could not write %s\n", tracePath);
+	}
+
+	BenchTraceChecks();
+}
+
+static MaskShape MakeMaskShape(MaskShapeType type, float left, float top, float right, float bottom)
+{
+	MaskShape shape = {};
+	shape.type = type;
+	shape.left = left;
+	shape.top = top;
+	shape.right = right;
+	shape.bottom = bottom;
+	return shape;
+}
+
+static double MaskArea(const MaskLayer& layer)
+{
+	double area = 0.0;
+	for (uint8_t coverage : layer.coverage)
+		area += coverage / 255.0;
+	return area;
+}
+
+// Rasterizer checks against analytic areas, then the cost of a full raster vs moving one shape
+static void BenchMask(int frames)
+{
+	struct AreaCase
+	{
+		const char* name;
+		MaskShape shape;
+		double expected;
+		double tolerance;
+	};
+
+	MaskShape roundedRect = MakeMaskShape(MaskShape_RoundedRect, 100, 100, 500, 400);
+	roundedRect.cornerRadius = 24;
+	MaskShape triangle = MakeMaskShape(MaskShape_Polygon, 0, 0, 0, 0);
+	triangle.points = { { 400, 150 }, { 600, 450 }, { 200, 450 } };
+
+	const AreaCase cases[] = {
+		{ "rect", MakeMaskShape(MaskShape_Rect, 100, 100, 500, 400), 400.0 * 300.0, 0.0 },
+		{ "half-pixel rect", MakeMaskShape(MaskShape_Rect, 100.5f, 100.5f, 500.5f, 400.5f), 400.0 * 300.0, 8.0 },
+		{ "rounded rect", roundedRect, 400.0 * 300.0 - (4.0 - 3.14159265) * 24.0 * 24.0, 2.0 },
+		{ "ellipse", MakeMaskShape(MaskShape_Ellipse, 100, 100, 500, 400), 3.14159265 * 200.0 * 150.0, 5.0 },
+		{ "triangle", triangle, 0.5 * 400.0 * 300.0, 2.0 },
+	};
+
+	printf("Mask rasterizer at 800x600\n");
+	printf("%-16s %12s %12s %8s\n", "shape", "area", "expected", "ok");
+
+	MaskLayer layer;
+	for (const AreaCase& test : cases)
+	{
+		MaskLayerReset(layer, 800, 600);
+		MaskLayerAdd(layer, test.shape);
+		MaskLayerRasterize(layer);
+		double area = MaskArea(layer);
+		printf("%-16s %12.1f %12.1f %8s\n", test.name, area, test.expected, CheckResult(fabs(area - test.expected) <= test.tolerance, "yes", "NO"));
+	}
+
+	// Move an ellipse around a rounded window; the incremental result has to match a fresh raster
+	MaskLayerReset(layer, 800, 600);
+	MaskLayerAdd(layer, roundedRect);
+	MaskShape ellipse = MakeMaskShape(MaskShape_Ellipse, 20, 20, 140, 100);
+	ellipse.feather = 6;
+	MaskShapeId ellipseId = MaskLayerAdd(layer, ellipse);
+
+	double start = NowMs();
+	MaskLayerRasterize(layer);
+	double fullMs = NowMs() - start;
+
+	bool match = true;
+	double updateMs = 0.0;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		ellipse.left += 7.25f;
+		ellipse.right += 7.25f;
+		ellipse.top += 3.5f;
+		ellipse.bottom += 3.5f;
+		MaskLayerUpdate(layer, ellipseId, ellipse);
+
+		start = NowMs();
+		MaskLayerRasterize(layer);
+		updateMs += NowMs() - start;
+
+		MaskLayer fresh;
+		MaskLayerReset(fresh, layer.width, layer.height);
+		for (const MaskLayerEntry& entry : layer.shapes)
+			MaskLayerAdd(fresh, entry.shape);
+		MaskLayerRasterize(fresh);
+		match = match && fresh.coverage == layer.coverage;
+	}
+
+	std::vector<uint8_t> row(layer.width);
+	bool rleMatch = true;
+	for (int y = 0; y < layer.height; ++y)
+	{
+		MaskRleDecodeRow(layer.rle, y, row.data());
+		rleMatch = rleMatch && memcmp(row.data(), &layer.coverage[(size_t)y * layer.width], layer.width) == 0;
+	}
+
+	printf("full raster %.3f ms, moving one shape %.3f ms, incremental matches %s, runs decode %s\n",
+		   fullMs, updateMs / frames, CheckResult(match, "yes", "NO"), CheckResult(rleMatch, "yes", "NO"));
+	printf("bytes: BGRA %zu, R8 %zu, runs %zu\n", layer.coverage.size() * 4, layer.coverage.size(),
+		   layer.rle.runs.size() * sizeof(MaskRun) + layer.rle.rowStarts.size() * sizeof(uint32_t));
+}
+
+static void SetMaskTriangle(MaskShape& shape, int width, int height, float offsetX)
+{
+	shape = {};
+	shape.type = MaskShape_Polygon;
+	shape.points = {
+		{ width * 0.5f + offsetX, height * 0.25f },
+		{ width * 0.75f + offsetX, height * 0.75f },
+		{ width * 0.25f + offsetX, height * 0.75f },
+	};
+}
+
+// Dense vs mask-aware sparse dispatch with the app's triangle mask. The sparse output starts
+// as garbage and has to match the dense one after the first frame and after the mask moved.
+static void BenchSparseTiles(int threads, int tileSize, float radius, int frames)
+{
+	printf("Sparse tile dispatch (radius %.0f, triangle mask, %d frames)\n", radius, frames);
+	printf("%-12s %7s %7s %7s %10s %10s %10s %8s %6s\n", "resolution", "empty", "partial", "full",
+		   "classify", "dense ms", "sparse ms", "speedup", "match");
+
+	CpuTiledBlur blur;
+	CpuTiledBlurStart(blur, threads, tileSize, tileSize);
+
+	for (const int* resolution : Resolutions)
+	{
+		BenchImage image;
+		MakeBenchImage(image, resolution[0], resolution[1]);
+		std::vector<uint8_t> sparseOutput(image.output.size(), 0xcd);
+
+		MaskLayer layer;
+		MaskLayerReset(layer, image.width, image.height);
+		MaskShape triangle;
+		SetMaskTriangle(triangle, image.width, image.height, 0.0f);
+		MaskShapeId id = MaskLayerAdd(layer, triangle);
+		MaskLayerRasterize(layer);
+
+		MaskTileMap map, denseMap;
+		MaskTileMapReset(map, image.width, image.height);
+		MaskTileMapReset(denseMap, image.width, image.height);
+
+		BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, radius, 0.0f };
+		CpuImage input = { image.input.data(), image.width * 4 };
+		CpuImage denseImage = { image.output.data(), image.width * 4 };
+		CpuImage sparseImage = { sparseOutput.data(), image.width * 4 };
+		CpuMask mask = MaskLayerCpuMask(layer);
+
+		bool match = true;
+		double classifyMs = 0.0, denseMs = 0.0, sparseMs = 0.0;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			// Move the triangle halfway through so tiles change class
+			if (frame == frames / 2)
+			{
+				SetMaskTriangle(triangle, image.width, image.height, image.width * 0.125f);
+				MaskLayerUpdate(layer, id, triangle);
+				MaskLayerRasterize(layer);
+			}
+
+			double start = NowMs();
+			MaskTileClassifyRle(map, layer.rle);
+			classifyMs += NowMs() - start;
+
+			MaskTileClassify(denseMap, mask);
+			match = match && denseMap.classes == map.classes;
+
+			start = NowMs();
+			CpuTiledBlurRun(blur, input, mask, denseImage, constants);
+			denseMs += NowMs() - start;
+
+			start = NowMs();
+			CpuSparseBlurRun(blur, map, input, mask, sparseImage, constants);
+			sparseMs += NowMs() - start;
+
+			match = match && sparseOutput == image.output;
+		}
+
+		char name[32];
+		snprintf(name, sizeof(name), "%dx%d", image.width, image.height);
+		size_t tileCount = map.classes.size();
+		size_t emptyTiles = tileCount - map.fullTiles.size() - map.partialTiles.size();
+		printf("%-12s %6.1f%% %6.1f%% %6.1f%% %10.3f %10.3f %10.3f %7.2fx %6s\n", name,
+			   100.0 * emptyTiles / tileCount, 100.0 * map.partialTiles.size() / tileCount, 100.0 * map.fullTiles.size() / tileCount,
+			   classifyMs / frames, denseMs / frames, sparseMs / frames, denseMs / sparseMs, CheckResult(match, "yes", "NO"));
+	}
+
+	CpuTiledBlurStop(blur);
+}
+
+// Hard-edged blocks over a gradient with a little noise, the worst case for the boundary
+// handling and the tail of the recursive filter
+static void MakeEdgeImage(BenchImage& image, int width, int height)
+{
+	MakeBenchImage(image, width, height);
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			uint8_t* pixel = &image.input[((size_t)y * width + x) * 4];
+			bool block = ((x / 24) + (y / 24)) % 3 == 0;
+			pixel[0] = block ? 255 : (uint8_t)(x * 255 / width);
+			pixel[1] = block ? 0 : (uint8_t)(y * 255 / height);
+			pixel[2] = (uint8_t)(pixel[2] / 8 + (block ? 200 : 0));
+			pixel[3] = x < width / 2 ? 255 : 128;
+		}
+	}
+}
+
+// Recursive Gaussian against the direct convolution, sigma 1 to 100, then its cost per sigma
+static void BenchIirGaussian(int threads, int frames)
+{
+	static const float Sigmas[] = { 1.0f, 1.5f, 2.0f, 3.0f, 5.0f, 8.0f, 13.0f, 20.0f, 35.0f, 50.0f, 75.0f, 100.0f };
+	static const int MaxError = 3;	// 8-bit levels, the third-order fit is off by ~1% of a step
+
+	BenchImage image;
+	MakeEdgeImage(image, 320, 240);
+	std::vector<uint8_t> reference(image.output.size());
+
+	MaskLayer layer;
+	MaskLayerReset(layer, image.width, image.height);
+	MaskShape ellipse = MakeMaskShape(MaskShape_Ellipse, 40, 30, 300, 220);
+	ellipse.feather = 16;
+	MaskLayerAdd(layer, ellipse);
+	MaskLayerRasterize(layer);
+
+	CpuImage input = { image.input.data(), image.width * 4 };
+	CpuImage output = { image.output.data(), image.width * 4 };
+	CpuImage referenceImage = { reference.data(), image.width * 4 };
+	CpuMask mask = MaskLayerCpuMask(layer);
+	BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, 0.0f, 0.0f };
+
+	printf("Recursive Gaussian vs direct convolution at %dx%d, feathered ellipse mask\n", image.width, image.height);
+	printf("%8s %10s %10s %6s\n", "sigma", "max error", "mean error", "ok");
+
+	CpuIirScratch scratch;
+	for (float sigma : Sigmas)
+	{
+		CpuGaussianReference(input, mask, referenceImage, constants, sigma);
+		CpuIirGaussianBlur(input, mask, output, constants, sigma, scratch);
+
+		int maxError = 0;
+		uint64_t totalError = 0;
+		for (size_t i = 0; i < reference.size(); ++i)
+		{
+			int error = abs((int)image.output[i] - (int)reference[i]);
+			maxError = std::max(maxError, error);
+			totalError += error;
+		}
+		printf("%8.1f %10d %10.4f %6s\n", sigma, maxError, (double)totalError / reference.size(), CheckResult(maxError <= MaxError, "yes", "NO"));
+	}
+
+	// Cost per sigma at 1080p, the weighted kernel only where its radius stays reasonable
+	BenchImage large;
+	MakeBenchImage(large, 1920, 1080);
+	CpuImage largeInput = { large.input.data(), large.width * 4 };
+	CpuImage largeOutput = { large.output.data(), large.width * 4 };
+	CpuMask largeMask = { large.mask.data() + 3, large.width * 4, 4 };
+
+	CpuTiledBlur blur;
+	CpuTiledBlurStart(blur, threads);
+
+	printf("Recursive Gaussian cost at %dx%d (%d threads, %d frames)\n", large.width, large.height, ThreadPoolWorkerCount(blur.pool), frames);
+	printf("%8s %10s %14s\n", "sigma", "iir ms", "gaussian ms");
+	for (float sigma : { 1.0f, 4.0f, 16.0f, 64.0f, 100.0f })
+	{
+		BlurConstants largeConstants = { (uint32_t)large.width, (uint32_t)large.height, sigma * 3.0f, 0.0f };
+
+		double start = NowMs();
+		for (int frame = 0; frame < frames; ++frame)
+			CpuIirGaussianBlur(largeInput, largeMask, largeOutput, largeConstants, sigma, scratch, &blur.pool);
+		double iirMs = (NowMs() - start) / frames;
+
+		if (sigma > 16.0f)
+		{
+			printf("%8.1f %10.3f %14s\n", sigma, iirMs, "-");
+			continue;
+		}
+
+		start = NowMs();
+		for (int frame = 0; frame < frames; ++frame)
+			CpuTiledBlurRun(blur, largeInput, largeMask, largeOutput, largeConstants, BlurKernel_Gaussian);
+		printf("%8.1f %10.3f %14.3f\n", sigma, iirMs, (NowMs() - start) / frames);
+	}
+
+	CpuTiledBlurStop(blur);
+}
+
+// "800x600,1920x1080" or "1,4,13": comma separated, one or two numbers per entry
+// Content hash sensitivity and the cache on a toggling input, then the hash against the blur at 4K
+static void BenchBlurCache(int threads, float radius, int frames)
+{
+	printf("Content hash and blur cache\n");
+
+	BenchImage image;
+	MakeBenchImage(image, 1920, 1080);
+	const int rowPitch = image.width * 4;
+	std::vector<uint64_t> tiles, changedTiles;
+	const uint64_t original = FrameHashImage(image.input.data(), rowPitch, image.width, image.height, tiles);
+
+	// A tiny change, two tiles trading places and a scroll by one row all have to show up
+	std::vector<uint8_t> changed = image.input;
+	changed[((size_t)500 * image.width + 700) * 4 + 1] ^= 1;
+	const uint64_t onePixel = FrameHashImage(changed.data(), rowPitch, image.width, image.height, changedTiles);
+	int tilesDiffering = 0;
+	for (size_t i = 0; i < tiles.size(); ++i)
+		tilesDiffering += tiles[i] != changedTiles[i];
+
+	changed = image.input;
+	for (int y = 0; y < FrameHashTileSize; ++y)
+	{
+		uint8_t* row = changed.data() + (size_t)y * rowPitch;
+		std::swap_ranges(row, row + FrameHashTileSize * 4, row + FrameHashTileSize * 4);
+	}
+	const uint64_t swapped = FrameHashImage(changed.data(), rowPitch, image.width, image.height, changedTiles);
+	const uint64_t scrolled = FrameHashImage(image.input.data() + rowPitch, rowPitch, image.width, image.height - 1, changedTiles);
+	const uint64_t again = FrameHashImage(image.input.data(), rowPitch, image.width, image.height, changedTiles);
+
+	printf("  hash %016llx\n", (unsigned long long)original);
+	printf("  same input %s, one pixel %s (%d tile), tiles swapped %s, scrolled %s\n",
+		   CheckResult(again == original, "same", "DIFFERENT"), CheckResult(onePixel != original, "differs", "SAME"), tilesDiffering,
+		   CheckResult(swapped != original, "differs", "SAME"), CheckResult(scrolled != original, "differs", "SAME"));
+
+	// A caret blinking: two inputs taking turns
+	for (int capacity = 1; capacity <= 2; ++capacity)
+	{
+		BlurCache cache;
+		BlurCacheReset(cache, capacity);
+		BlurCacheKey keys[2] = {};
+		keys[0].content = original;
+		keys[1].content = onePixel;
+		for (int frame = 0; frame < 8; ++frame)
+		{
+			const BlurCacheKey& key = keys[frame % 2];
+			if (BlurCacheLookup(cache, key) < 0)
+				BlurCacheInsert(cache, key);
+		}
+		printf("  toggling input, %d entries: %llu hits, %llu misses\n", capacity,
+			   (unsigned long long)cache.hits, (unsigned long long)cache.misses);
+	}
+
+	BenchImage large;
+	MakeBenchImage(large, 3840, 2160);
+	CpuTiledBlur blur;
+	CpuTiledBlurStart(blur, threads);
+
+	BlurConstants constants = { (uint32_t)large.width, (uint32_t)large.height, radius, 0.0f };
+	CpuImage input = { large.input.data(), large.width * 4 };
+	CpuImage output = { large.output.data(), large.width * 4 };
+	CpuMask mask = { large.mask.data() + 3, large.width * 4, 4 };
+	double start = NowMs();
+	for (int frame = 0; frame < frames; ++frame)
+		CpuTiledBlurRun(blur, input, mask, output, constants);
+	const double blurMs = (NowMs() - start) / frames;
+
+	const int threadCounts[2] = { 1, threads };
+	for (int i = 0; i < (threads > 1 ? 2 : 1); ++i)
+	{
+		const int threadCount = threadCounts[i];
+		start = NowMs();
+		for (int frame = 0; frame < frames; ++frame)
+			FrameHashImage(large.input.data(), large.width * 4, large.width, large.height, tiles, threadCount > 1 ? &blur.pool : nullptr);
+		const double hashMs = (NowMs() - start) / frames;
+
+		printf("  3840x2160, hash on %2d threads %7.3f ms (%5.1f GB/s), %.1f%% of the %.3f ms radius %.0f blur on %d\n",
+			   threadCount, hashMs, large.input.size() / hashMs / 1e6, 100.0 * hashMs / blurMs, blurMs, radius, threads);
+	}
+
+	CpuTiledBlurStop(blur);
+}
+
+// Serial BlurPipelineStep plus a present copy against the three-thread pipeline. The serial
+// loop takes the sum of the stages per frame, the pipeline about the slowest one.
+// A random desktop, then every frame two small rects redrawn somewhere new, so a frame whose
+// rects got lost leaves stale pixels. With lockStep set a frame waits until the pipeline
+// showed the one before, nothing is dropped; otherwise frames come in bursts of BurstFrames,
+// intervalUs apart.
+struct ScriptedFrameSource : FrameSource
+{
+	static const int BurstFrames = 4;
+
+	int width;
+	int height;
+	int frameCount;
+	int frameIndex;
+	uint32_t seed;
+	std::vector<uint8_t> pixels;
+	const FramePipeline* lockStep;
+	int64_t intervalUs;
+
+	ScriptedFrameSource(int sourceWidth, int sourceHeight, int count)
+		: width(sourceWidth), height(sourceHeight), frameCount(count), frameIndex(0), seed(99),
+		  pixels((size_t)sourceWidth * sourceHeight * 4), lockStep(nullptr), intervalUs(0)
+	{
+	}
+
+	FrameSourceResult AcquireFrame(int timeoutMs, Frame& frame) override
+	{
+		if (frameIndex >= frameCount)
+			return FrameSource_End;
+
+		while (lockStep && (lockStep->stages[PipelineStage_Blur].frames.load() < (uint64_t)frameIndex ||
+							lockStep->stages[PipelineStage_Present].frames.load() < lockStep->processed.published.load()))
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		if (intervalUs > 0 && frameIndex % BurstFrames == 0)
+			std::this_thread::sleep_for(std::chrono::microseconds(intervalUs));
+
+		frame.dirtyRects.clear();
+		frame.moves.clear();
+		frame.pointerOnly = false;
+		if (frameIndex == 0)
+		{
+			for (uint8_t& value : pixels)
+				value = (uint8_t)NextSeed(seed);
+			frame.dirtyRects.push_back({ 0, 0, width, height });
+		}
+		else
+		{
+			for (int i = 0; i < 2; ++i)
+			{
+				const int rectWidth = 8 + (int)(NextSeed(seed) % 72);
+				const int rectHeight = 8 + (int)(NextSeed(seed) % 52);
+				const int x = (int)(NextSeed(seed) % (uint32_t)(width - rectWidth + 1));
+				const int y = (int)(NextSeed(seed) % (uint32_t)(height - rectHeight + 1));
+				for (int row = y; row < y + rectHeight; ++row)
+					for (int column = x * 4; column < (x + rectWidth) * 4; ++column)
+						pixels[(size_t)row * width * 4 + column] ^= (uint8_t)(frameIndex * 37 + 11) | 1;
+				frame.dirtyRects.push_back({ x, y, x + rectWidth, y + rectHeight });
+			}
+		}
+
+		frame.width = width;
+		frame.height = height;
+		frame.pixels = pixels.data();
+		frame.rowPitch = width * 4;
+		frame.timestamp = frameIndex * 16667;
+		++frameIndex;
+		return FrameSource_Ok;
+	}
+
+	void ReleaseFrame() override {}
+};
+
+struct PipelinedCheck
+{
+	int presented;
+	int mismatched;		  // Presented frames that differ from the serial output for the same source frame
+	uint64_t lastSequence;
+	uint64_t dropped[2];  // Capture -> blur, blur -> present
+};
+
+// Lock-stepped when frameIntervalUs is 0
+static PipelinedCheck RunPipelinedCheck(const std::vector<std::vector<uint8_t>>& serialOutputs, int width, int height,
+										float radius, BlurKernelType kernel, int64_t frameIntervalUs, int64_t presentIntervalUs)
+{
+	PipelinedCheck check = {};
+	ScriptedFrameSource source(width, height, (int)serialOutputs.size());
+	FramePipeline pipeline;
+	source.lockStep = frameIntervalUs > 0 ? nullptr : &pipeline;
+	source.intervalUs = frameIntervalUs;
+
+	// Runs on the present thread, the join in FramePipelineWait publishes the counts
+	pipeline.presentHook = [&](const PipelineFrame& frame) {
+		++check.presented;
+		check.lastSequence = frame.sequence;
+		if (frame.sequence < 1 || frame.sequence > serialOutputs.size() || frame.pixels != serialOutputs[frame.sequence - 1])
+			++check.mismatched;
+	};
+
+	FramePipelineStart(pipeline, source, { 0, 0, width, height }, radius, kernel, 1, presentIntervalUs);
+	FramePipelineWait(pipeline);
+	FramePipelineStop(pipeline);
+	check.dropped[0] = pipeline.captured.dropped.load();
+	check.dropped[1] = pipeline.processed.dropped.load();
+	return check;
+}
+
+// Every frame the pipeline shows has to be exactly what BlurPipelineStep made of the same
+// source frame, also when frames were dropped and their rects carried over to the next. The
+// window is the whole desktop: BlurPipeline reads past a smaller window, FramePipeline doesn't.
+static void BenchPipelinedChecks()
+{
+	static const int Width = 640;
+	static const int Height = 360;
+	static const int Frames = 60;
+	// Within a burst capture outpaces the blur, so frames are dropped whose rects don't
+	// cover each other. Present waits for an 8 ms vertical blank.
+	static const float Radius = 16.0f;
+	static const BlurKernelType Kernel = BlurKernel_Gaussian;
+	static const int64_t FrameIntervalUs = 6000;
+	static const int64_t PresentIntervalUs = 8000;
+
+	std::vector<std::vector<uint8_t>> serialOutputs;
+	{
+		ScriptedFrameSource source(Width, Height, Frames);
+		BlurPipeline serial;
+		BlurPipelineStart(serial, { 0, 0, Width, Height }, Radius, Kernel, 1);
+		while (BlurPipelineStep(serial, source, 0) != FrameSource_End)
+			serialOutputs.push_back(serial.output);
+		BlurPipelineStop(serial);
+	}
+
+	const PipelinedCheck inStep = RunPipelinedCheck(serialOutputs, Width, Height, Radius, Kernel, 0, 0);
+	const PipelinedCheck dropping = RunPipelinedCheck(serialOutputs, Width, Height, Radius, Kernel, FrameIntervalUs, PresentIntervalUs);
+
+	printf("Pipelined against serial, %dx%d %s radius %.0f, %d frames\n", Width, Height, BlurKernelName(Kernel), Radius, Frames);
+	printf("    in step    %4d presented, dropped %llu + %llu, %d differ %s\n", inStep.presented,
+		   (unsigned long long)inStep.dropped[0], (unsigned long long)inStep.dropped[1], inStep.mismatched,
+		   CheckResult(inStep.mismatched == 0 && inStep.presented == Frames && inStep.dropped[0] + inStep.dropped[1] == 0));
+	printf("    dropping   %4d presented, dropped %llu + %llu, %d differ %s, last frame shown %s\n", dropping.presented,
+		   (unsigned long long)dropping.dropped[0], (unsigned long long)dropping.dropped[1], dropping.mismatched,
+		   CheckResult(dropping.mismatched == 0 && dropping.dropped[0] > 0),
+		   CheckResult(dropping.lastSequence == (uint64_t)Frames));
+}
+
+static void BenchPipelined(const char* sourceSpec, int threads, float radius, int frames)
+{
+	static const char* const DefaultSources[] = { "synthetic:noise", "synthetic:text" };
+	static const char* const StageNames[PipelineStage_Count] = { "capture", "blur", "present" };
+
+	std::vector<const char*> sources;
+	if (sourceSpec)
+		sources.push_back(sourceSpec);
+	else
+		sources.assign(DefaultSources, DefaultSources + sizeof(DefaultSources) / sizeof(DefaultSources[0]));
+
+	const BlurRect window = { 560, 240, 1360, 840 };
+	printf("Pipelined capture / blur / present, %dx%d window (radius %.0f, %d source frames, %d blur threads)\n",
+		   window.right - window.left, window.bottom - window.top, radius, frames, threads);
+
+	for (const char* spec : sources)
+	{
+		// Serial: every stage in turn on one thread
+		FrameSource* source = CreateFrameSource(spec, 1920, 1080, frames);
+		if (!source)
+		{
+			printf("  %s failed to open\n", spec);
+			continue;
+		}
+
+		BlurPipeline serial;
+		BlurPipelineStart(serial, window, radius, BlurKernel_Box, threads);
+		std::vector<uint8_t> screen(serial.output.size());
+		int serialPresented = 0;
+		double start = NowMs();
+		for (;;)
+		{
+			bool blurred = false;
+			FrameSourceResult result = BlurPipelineStep(serial, *source, 0, &blurred);
+			if (result == FrameSource_End)
+				break;
+			if (blurred)
+			{
+				memcpy(screen.data(), serial.output.data(), screen.size());
+				++serialPresented;
+			}
+		}
+		const double serialMs = NowMs() - start;
+		BlurPipelineStop(serial);
+		delete source;
+
+		source = CreateFrameSource(spec, 1920, 1080, frames);
+		FramePipeline pipeline;
+		FramePipelineStart(pipeline, *source, window, radius, BlurKernel_Box, threads);
+		FramePipelineWait(pipeline);
+		FramePipelineStop(pipeline);
+		delete source;
+
+		const double pipelinedMs = (pipeline.stopUs - pipeline.startUs) / 1e3;
+		const uint64_t presented = pipeline.stages[PipelineStage_Present].frames.load();
+		printf("  %s\n", spec);
+		printf("    serial     %8.1f ms, %4d presented, %7.1f fps\n", serialMs, serialPresented, serialPresented * 1e3 / serialMs);
+		printf("    pipelined  %8.1f ms, %4llu presented, %7.1f fps, dropped %llu + %llu, latency %.2f ms mean %.2f max\n",
+			   pipelinedMs, (unsigned long long)presented, presented * 1e3 / pipelinedMs,
+			   (unsigned long long)pipeline.captured.dropped.load(), (unsigned long long)pipeline.processed.dropped.load(),
+			   presented ? pipeline.latencySumUs.load() / 1e3 / presented : 0.0, pipeline.latencyMaxUs.load() / 1e3);
+		double slowestMs = 0.0;
+		for (int stage = 0; stage < PipelineStage_Count; ++stage)
+		{
+			const uint64_t stageFrames = pipeline.stages[stage].frames.load();
+			const double stageMs = stageFrames ? pipeline.stages[stage].busyUs.load() / 1e3 / stageFrames : 0.0;
+			slowestMs = std::max(slowestMs, stageMs);
+			printf("    %-8s %5llu frames, %7.3f ms each, %5.1f%% busy\n", StageNames[stage], (unsigned long long)stageFrames,
+				   stageMs, 100.0 * FramePipelineOccupancy(pipeline, (PipelineStage)stage));
+		}
+		printf("    slowest stage allows %.1f fps, stages share %u hardware threads\n",
+			   slowestMs > 0.0 ? 1e3 / slowestMs : 0.0, std::thread::hardware_concurrency());
+	}
+
+	BenchPipelinedChecks();
+}
+
+struct SchedulerScenario
+{
+	const char* name;
+	int maxFps;
+	int64_t frameIntervalUs;  // Desktop frames, 0 for none
+	bool framesBehindWindow;  // Whether they change what is behind the window
+	int64_t moveIntervalUs;	  // Window moves during the first two seconds, 0 for none
+	int64_t occludedFromUs;	  // Minimized in between these, 0 for never
+	int64_t occludedUntilUs;
+};
+
+// The scheduler against a simulated clock: ten seconds of each scenario, with the wakes,
+// the frames, the presents and the worst time a desktop frame or a move waited to be shown.
+// Every wake has to have had a reason, a static desktop only wakes at the latency target's
+// rate, frames show within the latency target plus one capped frame and an occluded window
+// only wakes to check whether it shows again.
+static void BenchScheduler()
+{
+	static const SchedulerScenario Scenarios[] = {
+		{ "static desktop", 60, 0, false, 0, 0, 0 },
+		{ "caret blink", 60, 500000, true, 0, 0, 0 },
+		{ "video behind, 60 fps", 60, 16667, true, 0, 0, 0 },
+		{ "video behind, 30 fps cap", 30, 16667, true, 0, 0, 0 },
+		{ "video elsewhere", 60, 16667, false, 0, 0, 0 },
+		{ "window drag", 60, 0, false, 2000, 0, 0 },
+		{ "video behind, minimized", 60, 16667, true, 0, 2000000, 7900000 },
+	};
+	const int64_t DurationUs = 10000000;
+	const FrameSchedulerConfig config = FrameSchedulerDefaults;
+
+	printf("Frame scheduler, simulated %.0f s, latency target %.0f ms, occluded checks every %.0f ms\n", DurationUs / 1e6,
+		   config.latencyTargetUs / 1e3, config.occludedCheckUs / 1e3);
+	printf("%-26s %8s %8s %8s %8s %8s %9s %10s %8s %6s\n", "scenario", "wakes/s", "polls/s", "frames/s", "presents", "skipped",
+		   "coalesced", "latency ms", "move ms", "check");
+
+	for (const SchedulerScenario& scenario : Scenarios)
+	{
+		FrameSchedulerConfig scenarioConfig = config;
+		scenarioConfig.maxFps = scenario.maxFps;
+
+		int64_t now = 0;
+		FrameScheduler scheduler;
+		FrameSchedulerReset(scheduler, scenarioConfig, now);
+		FrameSchedulerPost(scheduler, FrameEvent_WindowChanged | FrameEvent_Parameters);
+
+		int64_t nextSourceFrame = scenario.frameIntervalUs ? scenario.frameIntervalUs : INT64_MAX;
+		int64_t nextMove = scenario.moveIntervalUs ? 0 : INT64_MAX;
+		int64_t minimizeAt = scenario.occludedUntilUs ? scenario.occludedFromUs : INT64_MAX;
+		int64_t changeAt = scenario.occludedUntilUs ? (scenario.occludedFromUs + scenario.occludedUntilUs) / 2 : INT64_MAX;
+		bool sourceFrame = false;	 // The source holds a frame nobody polled yet
+		int64_t oldestUnshown = -1;	 // When the oldest desktop frame not on screen yet arrived
+		int64_t oldestPolled = -1;
+		int64_t worstLatency = 0;
+		int64_t oldestMove = -1;	 // When the oldest move not on screen yet was posted
+		int64_t worstMoveLatency = 0;
+		uint64_t messages = 0;
+		uint64_t occludedWakes = 0;
+		uint64_t occludedFrames = 0;
+		int64_t shownAgainUs = -1;	 // From the end of the occlusion to the first frame
+
+		// A busy loop doesn't move the clock, give up on it
+		while (now < DurationUs && scheduler.wakes < (uint64_t)DurationUs / 100)
+		{
+			// Messages wake the loop right away, source frames only show up when polled
+			now = std::min({ now + FrameSchedulerTimeout(scheduler, now), nextMove, minimizeAt, changeAt });
+			if (now >= nextMove)
+			{
+				FrameSchedulerPost(scheduler, FrameEvent_WindowChanged);
+				nextMove = now + scenario.moveIntervalUs < 2000000 ? now + scenario.moveIntervalUs : INT64_MAX;
+				if (oldestMove < 0)
+					oldestMove = now;
+				++messages;
+			}
+			if (now >= minimizeAt)
+			{
+				FrameSchedulerSetOccluded(scheduler, true, now);
+				minimizeAt = INT64_MAX;
+				++messages;
+			}
+			if (now >= changeAt)
+			{
+				// Changed while hidden, it waits for the window to show
+				FrameSchedulerPost(scheduler, FrameEvent_Parameters);
+				changeAt = INT64_MAX;
+				++messages;
+			}
+
+			while (now >= nextSourceFrame)
+			{
+				if (oldestUnshown < 0 && scenario.framesBehindWindow)
+					oldestUnshown = nextSourceFrame;
+				sourceFrame = true;
+				nextSourceFrame += scenario.frameIntervalUs;
+			}
+
+			const bool hidden = now >= scenario.occludedFromUs && now < scenario.occludedUntilUs;
+			const uint32_t work = FrameSchedulerWake(scheduler, now);
+			occludedWakes += hidden ? 1 : 0;
+
+			// The test present finds it showing again, frames that came meanwhile wait from now on
+			if ((work & FrameWork_CheckOccluded) && now >= scenario.occludedUntilUs)
+			{
+				FrameSchedulerSetOccluded(scheduler, false, now);
+				if (oldestUnshown >= 0)
+					oldestUnshown = now;
+			}
+
+			if ((work & FrameWork_Poll) && sourceFrame)
+			{
+				if (oldestPolled < 0)
+					oldestPolled = oldestUnshown;
+				oldestUnshown = -1;
+				sourceFrame = false;
+				FrameSchedulerPost(scheduler, FrameEvent_NewFrame);
+			}
+
+			if (uint32_t events = FrameSchedulerBeginFrame(scheduler, now))
+			{
+				if (oldestPolled >= 0)
+				{
+					worstLatency = std::max(worstLatency, now - oldestPolled);
+					oldestPolled = -1;
+				}
+				if (oldestMove >= 0)
+				{
+					worstMoveLatency = std::max(worstMoveLatency, now - oldestMove);
+					oldestMove = -1;
+				}
+				occludedFrames += hidden ? 1 : 0;
+				if (scenario.occludedUntilUs && now >= scenario.occludedUntilUs && shownAgainUs < 0)
+					shownAgainUs = now - scenario.occludedUntilUs;
+				FrameSchedulerEndFrame(scheduler, events != FrameEvent_NewFrame || scenario.framesBehindWindow);
+			}
+		}
+
+		const double seconds = DurationUs / 1e6;
+		const int64_t frameIntervalUs = scenario.maxFps > 0 ? 1000000 / scenario.maxFps : 0;
+		const double targetWakesPerSecond = 1e6 / config.latencyTargetUs;
+		bool ok = scheduler.wakes <= scheduler.polls + scheduler.occludedChecks + messages;
+		if (!scenario.frameIntervalUs && !scenario.moveIntervalUs)
+			ok = ok && fabs(scheduler.wakes / seconds - targetWakesPerSecond) <= 0.1 * targetWakesPerSecond;
+		ok = ok && worstLatency <= config.latencyTargetUs + frameIntervalUs && worstMoveLatency <= frameIntervalUs;
+
+		// Frames outside the window get polled but change nothing, the presents are skipped
+		printf("%-26s %8.1f %8.1f %8.1f %8llu %8llu %9llu %10.2f %8.2f %6s\n", scenario.name,
+			   scheduler.wakes / seconds, scheduler.polls / seconds, scheduler.frames / seconds,
+			   (unsigned long long)scheduler.presents, (unsigned long long)scheduler.skippedPresents,
+			   (unsigned long long)scheduler.coalescedEvents, worstLatency / 1e3, worstMoveLatency / 1e3, CheckResult(ok));
+
+		if (scenario.occludedUntilUs)
+		{
+			const double occludedSeconds = (scenario.occludedUntilUs - scenario.occludedFromUs) / 1e6;
+			const double occludedWakesPerSecond = occludedWakes / occludedSeconds;
+			const bool throttled = occludedFrames == 0 && occludedWakesPerSecond <= 1.1e6 / config.occludedCheckUs &&
+				shownAgainUs >= 0 && shownAgainUs <= config.occludedCheckUs + frameIntervalUs;
+			printf("  while minimized %.1f wakes/s, %llu frames, first frame %.2f ms after it showed again %s\n", occludedWakesPerSecond,
+				   (unsigned long long)occludedFrames, shownAgainUs / 1e3, CheckResult(throttled));
+		}
+	}
+}
+
+// Desktop pixel at (x, y), the same whichever output it is read from
+static uint32_t DesktopPixel(int x, int y)
+{
+	uint32_t value = (uint32_t)x * 0x9E3779B1u ^ (uint32_t)y * 0x85EBCA77u;
+	return (value ^ (value >> 15)) | 0xFF000000u;
+}
+
+struct LayoutScenario
+{
+	const char* name;
+	int outputCount;
+	BlurRect outputs[3];  // Desktop coordinates
+	BlurRect window;
+};
+
+static void BenchDesktopLayout(float radius, int frames)
+{
+	static const LayoutScenario Scenarios[] = {
+		{ "single output", 1, { { 0, 0, 1920, 1080 } }, { 400, 300, 1200, 900 } },
+		{ "side by side", 2, { { 0, 0, 1920, 1080 }, { 1920, 0, 3840, 1080 } }, { 1500, 200, 2300, 800 } },
+		{ "left of primary", 2, { { 0, 0, 2560, 1440 }, { -1920, 360, 0, 1440 } }, { -600, 100, 400, 700 } },
+		{ "mixed, three", 3, { { 0, 0, 2560, 1440 }, { -1920, 360, 0, 1440 }, { 2560, -400, 3640, 1520 } },
+		  { -300, -200, 2900, 1500 } },
+		{ "above, stacked", 2, { { 0, 0, 1920, 1080 }, { -320, -1440, 2240, 0 } }, { -400, -300, 500, 300 } },
+		{ "mirrored", 2, { { 0, 0, 1920, 1080 }, { 0, 0, 1920, 1080 } }, { 100, 100, 900, 700 } },
+		{ "off every output", 1, { { 0, 0, 1920, 1080 } }, { 2000, 1200, 2400, 1500 } },
+	};
+	const int apron = (int)ceilf(radius);
+
+	printf("Multi-output capture, window grown by a %d px apron, %d frames\n", apron, frames);
+	printf("%-18s %7s %7s %10s %10s %10s %8s\n", "layout", "copies", "holes", "copied px", "region px", "assemble", "result");
+
+	for (const LayoutScenario& scenario : Scenarios)
+	{
+		// Every output's frame holds its slice of the one desktop
+		std::vector<DesktopOutput> outputs(scenario.outputCount);
+		std::vector<std::vector<uint32_t>> framePixels(scenario.outputCount);
+		std::vector<CpuImage> frameImages(scenario.outputCount);
+		for (int i = 0; i < scenario.outputCount; ++i)
+		{
+			const BlurRect& bounds = scenario.outputs[i];
+			const int width = bounds.right - bounds.left, height = bounds.bottom - bounds.top;
+			outputs[i].bounds = bounds;
+			framePixels[i].resize((size_t)width * height);
+			for (int y = 0; y < height; ++y)
+				for (int x = 0; x < width; ++x)
+					framePixels[i][(size_t)y * width + x] = DesktopPixel(bounds.left + x, bounds.top + y);
+			frameImages[i] = { (uint8_t*)framePixels[i].data(), width * 4 };
+		}
+
+		const BlurRect& window = scenario.window;
+		const BlurRect region = { window.left - apron, window.top - apron, window.right + apron, window.bottom + apron };
+		const int width = region.right - region.left, height = region.bottom - region.top;
+		std::vector<uint32_t> assembled((size_t)width * height, 0x12345678u);
+		CpuImage regionImage = { (uint8_t*)assembled.data(), width * 4 };
+
+		std::vector<DesktopCopy> copies;
+		std::vector<BlurRect> uncovered;
+		double start = NowMs();
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			DesktopLayoutPlan(outputs, region, copies, uncovered);
+			DesktopLayoutAssemble(copies, uncovered, frameImages.data(), regionImage);
+		}
+		double assembleMs = (NowMs() - start) / frames;
+
+		// Every region pixel written exactly once, by a copy or as a hole
+		std::vector<uint8_t> writes((size_t)width * height, 0);
+		uint64_t copiedPixels = 0;
+		for (const DesktopCopy& copy : copies)
+		{
+			for (int y = copy.destY; y < copy.destY + copy.source.bottom - copy.source.top; ++y)
+				for (int x = copy.destX; x < copy.destX + copy.source.right - copy.source.left; ++x)
+					++writes[(size_t)y * width + x];
+			copiedPixels += (uint64_t)(copy.source.right - copy.source.left) * (copy.source.bottom - copy.source.top);
+		}
+		for (const BlurRect& rect : uncovered)
+			for (int y = rect.top; y < rect.bottom; ++y)
+				for (int x = rect.left; x < rect.right; ++x)
+					++writes[(size_t)y * width + x];
+
+		// Desktop pixels where some output covers them, black where none does
+		int mismatches = 0;
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				const int desktopX = region.left + x, desktopY = region.top + y;
+				bool covered = false;
+				for (const DesktopOutput& output : outputs)
+					covered |= desktopX >= output.bounds.left && desktopX < output.bounds.right &&
+							   desktopY >= output.bounds.top && desktopY < output.bounds.bottom;
+				const uint32_t expected = covered ? DesktopPixel(desktopX, desktopY) : 0;
+				mismatches += writes[(size_t)y * width + x] != 1 || assembled[(size_t)y * width + x] != expected;
+			}
+		}
+
+		printf("%-18s %7zu %7zu %10llu %10llu %8.3fms %8s\n", scenario.name, copies.size(), uncovered.size(),
+			   (unsigned long long)copiedPixels, (unsigned long long)width * height, assembleMs, CheckResult(!mismatches));
+	}
+
+	// Dirty rects arrive per output, the tracker wants them on the desktop
+	DesktopOutput left = { { -1920, 360, 0, 1440 } };
+	Frame frame = {};
+	frame.dirtyRects.push_back({ 10, 20, 110, 70 });
+	frame.moves.push_back({ 0, 0, { 0, 100, 200, 200 } });
+	DesktopLayoutFrameToDesktop(left, frame);
+	const BlurRect& dirty = frame.dirtyRects[0];
+	const DirtyMove& move = frame.moves[0];
+	const bool mapped = dirty.left == -1910 && dirty.top == 380 && dirty.right == -1810 && dirty.bottom == 430 &&
+						move.sourceX == -1920 && move.sourceY == 360 && move.destination.left == -1920 && move.destination.top == 460;
+	printf("Output rects to desktop coordinates: %s\n", CheckResult(mapped));
+}
+
+// Grid of panels over two side-by-side outputs, aprons of neighbours overlap
+static void AddBenchRegions(BlurRegionManager& manager, int count, float radius)
+{
+	const int columns = count >= 16 ? 4 : (count >= 4 ? 2 : 1);
+	for (int i = 0; i < count; ++i)
+	{
+		const int left = 1200 + (i % columns) * 492, top = 100 + (i / columns) * 232;
+		BlurRegionDesc desc = { { left, top, left + 480, top + 220 }, i % 3 == 2 ? radius * 0.5f : radius,
+								i % 2 ? BlurKernel_Gaussian : BlurKernel_Box };
+		BlurRegionId id = BlurRegionAdd(manager, desc);
+		if (i % 2)
+		{
+			MaskShape shape = MakeMaskShape(MaskShape_RoundedRect, 0, 0, 480, 220);
+			shape.cornerRadius = 24;
+			MaskLayerAdd(*BlurRegionMask(manager, id), shape);
+		}
+	}
+}
+
+// One capture and one batched dispatch for every panel, against a capture and a dispatch per panel
+static void BenchBlurRegions(int threads, float radius, int frames)
+{
+	BenchImage desktop;
+	MakeBenchImage(desktop, 3840, 1080);
+	const int pitch = desktop.width * 4;
+	const std::vector<DesktopOutput> outputs = { { { 0, 0, 1920, 1080 } }, { { 1920, 0, 3840, 1080 } } };
+	const CpuImage frames2[2] = { { desktop.input.data(), pitch }, { desktop.input.data() + 1920 * 4, pitch } };
+
+	CpuTiledBlur blur;
+	CpuTiledBlurStart(blur, threads);
+
+	printf("Blur regions over one 2x1920x1080 capture, radius %.0f, %d threads, %d frames\n", radius, threads, frames);
+	printf("%8s %8s %12s %12s %12s %12s %8s %8s\n", "regions", "islands", "captured MB", "aprons MB", "separate", "batched", "speedup", "result");
+
+	static const int Counts[] = { 1, 4, 16 };
+	for (int count : Counts)
+	{
+		BlurRegionManager batched;
+		BlurRegionsReset(batched);
+		AddBenchRegions(batched, count, radius);
+
+		// The old way: every panel captures and dispatches on its own
+		std::vector<BlurRegionManager> separate(count);
+		for (int i = 0; i < count; ++i)
+		{
+			BlurRegionsReset(separate[i]);
+			const BlurRegion& region = batched.regions[i];
+			BlurRegionId id = BlurRegionAdd(separate[i], region.desc);
+			for (const MaskLayerEntry& entry : batched.regions[i].mask.shapes)
+				MaskLayerAdd(*BlurRegionMask(separate[i], id), entry.shape);
+		}
+
+		double start = NowMs();
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			for (BlurRegionManager& manager : separate)
+			{
+				BlurRegionsCapture(manager, outputs, frames2);
+				BlurRegionsRun(manager, blur);
+			}
+		}
+		double separateMs = (NowMs() - start) / frames;
+
+		start = NowMs();
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			BlurRegionsCapture(batched, outputs, frames2);
+			BlurRegionsRun(batched, blur);
+		}
+		double batchedMs = (NowMs() - start) / frames;
+
+		// Each panel against its crop of the whole desktop blurred with its kernel and mask
+		int mismatches = 0;
+		CpuBlurScratch scratch;
+		std::vector<uint8_t> reference(desktop.input.size());
+		std::vector<uint8_t> coverage((size_t)desktop.width * desktop.height);
+		for (const BlurRegion& region : batched.regions)
+		{
+			const BlurRect& rect = region.desc.rect;
+			const bool masked = !region.mask.shapes.empty();
+			for (int y = rect.top; y < rect.bottom && masked; ++y)
+				memcpy(&coverage[(size_t)y * desktop.width + rect.left], &region.mask.coverage[(size_t)(y - rect.top) * region.mask.width], rect.right - rect.left);
+
+			const CpuImage input = { desktop.input.data(), pitch }, output = { reference.data(), pitch };
+			const CpuMask mask = masked ? CpuMask{ coverage.data(), desktop.width, 1 } : CpuMask{};
+			const BlurConstants constants = { (uint32_t)desktop.width, (uint32_t)desktop.height, region.desc.radius, 0.0f };
+			CpuBlurKernelRect(region.desc.kernel, input, mask, output, constants, rect, scratch);
+
+			CpuImage blurred;
+			BlurRect placed;
+			if (!BlurRegionOutput(batched, region.id, blurred, placed))
+			{
+				++mismatches;
+				continue;
+			}
+			for (int y = placed.top; y < placed.bottom; ++y)
+				mismatches += memcmp(blurred.pixels + (size_t)(y - placed.top) * blurred.rowPitch,
+									 &reference[(size_t)y * pitch + (size_t)placed.left * 4], (size_t)(placed.right - placed.left) * 4) != 0;
+		}
+
+		printf("%8d %8zu %12.2f %12.2f %10.2fms %10.2fms %7.2fx %8s\n", count, batched.islands.size(),
+			   batched.capturedBytes / 1e6, batched.apronBytes / 1e6, separateMs, batchedMs, separateMs / batchedMs, CheckResult(!mismatches));
+	}
+
+	CpuTiledBlurStop(blur);
+}
+
+// Stands in for the D3D11 device, hands out numbered handles and counts them
+struct MockAllocator : ResourceAllocator
+{
+	uintptr_t next = 1;
+	uint64_t allocations = 0;
+	uint64_t frees = 0;
+
+	void* Allocate(const PoolResourceDesc& desc) override
+	{
+		++allocations;
+		return (void*)next++;
+	}
+
+	void Free(void* resource) override { ++frees; }
+};
+
+// One window-sized resource of the app, `scale` halves its size that many times
+struct PoolBenchResource
+{
+	const char* name;
+	PoolResourceType type;
+	uint32_t format;
+	int bytesPerPixel;	// Buffers only
+	int scale;
+	PoolLease lease;
+	int width;
+	int height;
+};
+
+static void PoolBenchSize(const PoolBenchResource& resource, int width, int height, int& outWidth, int& outHeight)
+{
+	outWidth = CpuKawaseLevelSize(width, resource.scale);
+	outHeight = CpuKawaseLevelSize(height, resource.scale);
+	if (resource.type == PoolResource_Buffer)
+	{
+		outWidth *= outHeight * resource.bytesPerPixel;
+		outHeight = 1;
+	}
+}
+
+static void BenchResourcePool()
+{
+	// Formats are opaque to the pool, these only keep kinds apart
+	const uint32_t Bgra = 87, R8 = 61;
+	std::vector<PoolBenchResource> resources = {
+		{ "desktop", PoolResource_Texture, Bgra, 0, 0 },
+		{ "mask", PoolResource_Texture, R8, 0, 0 },
+		{ "blur", PoolResource_Texture, Bgra, 0, 0 },
+		{ "staging", PoolResource_Texture, Bgra + 1000, 0, 0 },
+		{ "cache 0", PoolResource_Texture, Bgra + 2000, 0, 0 },
+		{ "cache 1", PoolResource_Texture, Bgra + 2000, 0, 0 },
+		{ "iir rows", PoolResource_Buffer, 16, 16, 0 },
+	};
+	for (int level = 1; level <= 4; ++level)
+		resources.push_back({ "kawase", PoolResource_Texture, Bgra + 3000, 0, level });
+
+	// A resize drag out to 1920x1200 and back, one WM_SIZE every few pixels, frames 16 ms apart
+	std::vector<std::pair<int, int>> sizes;
+	for (int step = 0; step <= 280; ++step)
+		sizes.push_back({ 800 + step * 4, 600 + step * 2 });
+	for (int step = 280; step >= 0; step -= 2)
+		sizes.push_back({ 800 + step * 4, 600 + step * 2 });
+
+	MockAllocator allocator;
+	ResourcePool pool;
+	ResourcePoolReset(pool, &allocator);
+
+	int64_t now = 0;
+	uint64_t naiveAllocations = 0;
+	uint64_t naivePeak = 0;
+	int undersized = 0;
+	for (size_t index = 0; index < sizes.size(); ++index)
+	{
+		uint64_t naiveLive = 0;
+		for (PoolBenchResource& resource : resources)
+		{
+			int width, height;
+			PoolBenchSize(resource, sizes[index].first, sizes[index].second, width, height);
+
+			if (index == 0)
+			{
+				PoolResourceDesc desc = { resource.type, resource.format, 0, 0, 0, 0, width, height };
+				ResourcePoolAcquire(pool, desc, now, resource.lease);
+			}
+			else
+				ResourcePoolResize(pool, resource.lease, width, height, now);
+
+			// Recreating at the exact size allocates whenever the size changes at all
+			if (index == 0 || width != resource.width || height != resource.height)
+				++naiveAllocations;
+			naiveLive += (uint64_t)width * height;
+			resource.width = width;
+			resource.height = height;
+
+			const PoolLease& lease = resource.lease;
+			undersized += !lease.resource || lease.allocatedWidth < width || lease.allocatedHeight < height;
+		}
+		naivePeak = std::max(naivePeak, naiveLive);
+
+		ResourcePoolTrim(pool, now);
+		now += 16667;
+	}
+
+	printf("Resource pool, resize drag of %zu steps, 800x600 to 1920x1200 and back, %zu resources\n", sizes.size(), resources.size());
+	printf("%-28s %12s %12s\n", "", "recreate", "pool");
+	printf("%-28s %12llu %12llu\n", "allocations", (unsigned long long)naiveAllocations, (unsigned long long)allocator.allocations);
+	printf("%-28s %12.1f %12.1f\n", "peak M pixels + buffer bytes", naivePeak / 1e6, pool.peakElements / 1e6);
+	printf("reuses %llu, resizes kept %llu, frees during drag %llu, undersized leases %d %s\n", (unsigned long long)pool.reuses,
+		   (unsigned long long)pool.keptOnResize, (unsigned long long)allocator.frees, undersized, CheckResult(!undersized));
+
+	// Once the drag settles, what it left idle is trimmed and nothing leased is
+	const uint64_t leasedBefore = pool.liveElements;
+	now += pool.idleTimeoutUs;
+	const int trimmed = ResourcePoolTrim(pool, now);
+	uint64_t leased = 0;
+	for (const PoolBenchResource& resource : resources)
+		leased += (uint64_t)resource.lease.allocatedWidth * resource.lease.allocatedHeight;
+	printf("idle trim after %.1f s: %d freed, %.1f -> %.1f M live, leased %.1f M %s\n", pool.idleTimeoutUs / 1e6, trimmed,
+		   leasedBefore / 1e6, pool.liveElements / 1e6, leased / 1e6, CheckResult(pool.liveElements == leased));
+
+	for (PoolBenchResource& resource : resources)
+		ResourcePoolRelease(pool, resource.lease, now);
+	ResourcePoolDestroy(pool);
+	printf("destroy: %llu allocated, %llu freed %s\n", (unsigned long long)allocator.allocations, (unsigned long long)allocator.frees,
+		   CheckResult(allocator.allocations == allocator.frees));
+}
+
+// The shader's math on the CPU: BGRA8 to float, float sums divided by the sample count,
+// UNORM rounding on the way out. Separable sliding windows, so only the arithmetic differs.
+static void FloatBoxBlur(const CpuImage& input, const CpuMask& mask, const CpuImage& output, int width, int height, int radius,
+						 std::vector<float>& rows, std::vector<float>& columns)
+{
+	const size_t stride = (size_t)width * 4;
+	rows.resize(stride * height);
+	columns.resize(stride);
+
+	for (int y = 0; y < height; ++y)
+	{
+		const uint8_t* row = input.pixels + (size_t)y * input.rowPitch;
+		float* sums = rows.data() + y * stride;
+		float acc[4] = {};
+		for (int k = -radius; k <= radius; ++k)
+			for (int c = 0; c < 4; ++c) acc[c] += row[4 * CpuBlurClamp(k, 0, width - 1) + c] / 255.0f;
+		for (int x = 0; x < width; ++x)
+		{
+			const uint8_t* add = row + 4 * CpuBlurClamp(x + radius + 1, 0, width - 1);
+			const uint8_t* sub = row + 4 * CpuBlurClamp(x - radius, 0, width - 1);
+			for (int c = 0; c < 4; ++c)
+			{
+				sums[x * 4 + c] = acc[c];
+				acc[c] += add[c] / 255.0f - sub[c] / 255.0f;
+			}
+		}
+	}
+
+	float* acc = columns.data();
+	std::fill(columns.begin(), columns.end(), 0.0f);
+	for (int k = -radius; k <= radius; ++k)
+	{
+		const float* src = rows.data() + CpuBlurClamp(k, 0, height - 1) * stride;
+		for (size_t i = 0; i < stride; ++i) acc[i] += src[i];
+	}
+
+	const float inverseSamples = 1.0f / (float)((2 * radius + 1) * (2 * radius + 1));
+	for (int y = 0; y < height; ++y)
+	{
+		uint8_t* dst = output.pixels + (size_t)y * output.rowPitch;
+		for (int x = 0; x < width; ++x)
+		{
+			const float coverage = CpuMaskCoverage(mask, x, y) / 255.0f;
+			for (int c = 0; c < 4; ++c)
+			{
+				float value = std::min(acc[x * 4 + c] * inverseSamples, 1.0f);
+				if (c == 3) value *= coverage;
+				dst[x * 4 + c] = coverage > 0.0f ? (uint8_t)(value * 255.0f + 0.5f) : 0;
+			}
+		}
+
+		const float* add = rows.data() + CpuBlurClamp(y + radius + 1, 0, height - 1) * stride;
+		const float* sub = rows.data() + CpuBlurClamp(y - radius, 0, height - 1) * stride;
+		for (size_t i = 0; i < stride; ++i) acc[i] += add[i] - sub[i];
+	}
+}
+
+// Fixed-point u16/u32 kernels against the float math and the u32 integer path
+static void BenchFixedPoint(int frames)
+{
+	static const int Radii[] = { 1, 4, 13, 32, 64, 128 };
+
+	BenchImage image;
+	MakeBenchImage(image, 1920, 1080);
+
+	// Timed with full coverage like a window's interior. Checked again with coverage ramping
+	// across the image, every pixel then goes through the partial-coverage fixup.
+	std::vector<uint8_t> ramp((size_t)image.width * image.height);
+	for (int y = 0; y < image.height; ++y)
+		for (int x = 0; x < image.width; ++x)
+			ramp[(size_t)y * image.width + x] = (uint8_t)(x * 255 / (image.width - 1));
+
+	const int pitch = image.width * 4;
+	CpuImage input = { image.input.data(), pitch };
+	CpuMask mask = { image.mask.data() + 3, pitch, 4 };
+	CpuMask rampMask = { ramp.data(), image.width, 1 };
+	BlurRect rect = { 0, 0, image.width, image.height };
+
+	std::vector<uint8_t> floatPixels(image.input.size()), integerPixels(image.input.size());
+	CpuImage floatOutput = { floatPixels.data(), pitch };
+	CpuImage integerOutput = { integerPixels.data(), pitch };
+	CpuImage output = { image.output.data(), pitch };
+
+	struct Variant
+	{
+		const char* name;
+		BlurKernelFunction function;
+	};
+#if defined(__AVX2__)
+	const BlurKernelFunction integerBlur = CpuBoxBlurRectAvx2;
+#else
+	const BlurKernelFunction integerBlur = CpuBoxBlurRectScalar;
+#endif
+	std::vector<Variant> variants = { { "u32", integerBlur }, { "fixed", CpuBoxBlurRectFixedScalar } };
+#if defined(CPU_BLUR_FIXED_SSE2)
+	variants.push_back({ "sse2", CpuBoxBlurRectFixedSse2 });
+#endif
+#if defined(__AVX2__)
+	variants.push_back({ "avx2", CpuBoxBlurRectFixedAvx2 });
+#endif
+
+	printf("Fixed-point box blur at %dx%d (%d frames), ms per frame\n", image.width, image.height, frames);
+	printf("%-8s %10s", "radius", "float");
+	for (const Variant& variant : variants)
+		printf(" %10s", variant.name);
+	printf(" %9s %10s %12s %6s\n", "vs float", "vs u32", "max err LSB", "exact");
+
+	CpuBlurScratch scratch;
+	std::vector<float> rows, columns;
+	for (int radius : Radii)
+	{
+		BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, (float)radius, 0.0f };
+
+		double start = NowMs();
+		for (int frame = 0; frame < frames; ++frame)
+			FloatBoxBlur(input, mask, floatOutput, image.width, image.height, radius, rows, columns);
+		const double floatMs = (NowMs() - start) / frames;
+
+		printf("%-8d %10.3f", radius, floatMs);
+		double u32Ms = 0.0, bestMs = 0.0;
+		for (const Variant& variant : variants)
+		{
+			variant.function(input, mask, output, constants, rect, scratch);  // Warm up scratch buffers
+			start = NowMs();
+			for (int frame = 0; frame < frames; ++frame)
+				variant.function(input, mask, output, constants, rect, scratch);
+			const double ms = (NowMs() - start) / frames;
+			printf(" %10.3f", ms);
+
+			if (variant.function == integerBlur)
+				u32Ms = ms;
+			else
+				bestMs = ms;
+		}
+
+		// Bit-identical to the u32 path, within 1 LSB of the float math, under both masks
+		bool exact = true;
+		int maxError = 0;
+		for (const CpuMask& checkMask : { mask, rampMask })
+		{
+			FloatBoxBlur(input, checkMask, floatOutput, image.width, image.height, radius, rows, columns);
+			integerBlur(input, checkMask, integerOutput, constants, rect, scratch);
+			for (const Variant& variant : variants)
+			{
+				variant.function(input, checkMask, output, constants, rect, scratch);
+				exact = exact && image.output == integerPixels;
+				for (size_t i = 0; i < floatPixels.size(); ++i)
+					maxError = std::max(maxError, std::abs((int)image.output[i] - (int)floatPixels[i]));
+			}
+		}
+		printf(" %8.2fx %9.2fx %12d %6s\n", floatMs / bestMs, u32Ms / bestMs, maxError, CheckResult(exact && maxError <= 1));
+	}
+}
+
+// Bytecode derived from the request, so a wrong lookup shows up as different bytes. Compiling
+// costs a few hundred microseconds of hashing, a small fraction of what D3DCompile takes.
+struct MockShaderCompiler : ShaderCompiler
+{
+	uint64_t version = 1;
+	int compiles = 0;
+
+	uint64_t Version() override { return version; }
+
+	bool Compile(const ShaderCompileRequest& request, std::vector<uint8_t>& bytecode, std::string& errors) override
+	{
+		++compiles;
+		if (strstr(request.source, "#error"))
+		{
+			errors = "mock(1,1): error X1504: #error in source";
+			return false;
+		}
+
+		uint64_t hash = ShaderCacheKey(request, version);
+		for (int i = 0; i < 20000; ++i)
+			hash = FrameHashBytes((const uint8_t*)&hash, sizeof(hash), hash);
+		bytecode.resize(512 + strlen(request.source) % 1024);
+		for (size_t i = 0; i < bytecode.size(); ++i)
+			bytecode[i] = (uint8_t)(hash >> (i % 8 * 8)) ^ (uint8_t)i;
+		errors.clear();
+		return true;
+	}
+};
+
+struct ShaderBenchRequest
+{
+	std::string source;
+	const char* target;
+	const ShaderDefine* defines;
+	std::vector<uint8_t> expected;
+};
+
+// Requests whose bytecode differs from what the compiler makes for them
+static int CheckShaderCache(ShaderCache& cache, std::vector<ShaderBenchRequest>& requests, MockShaderCompiler& compiler)
+{
+	int wrong = 0;
+	for (ShaderBenchRequest& request : requests)
+	{
+		ShaderCompileRequest compile = { request.source.c_str(), "main", request.target, request.defines };
+		if (request.expected.empty())
+		{
+			std::string errors;
+			MockShaderCompiler reference;
+			reference.version = compiler.version;
+			reference.Compile(compile, request.expected, errors);
+		}
+
+		const uint8_t* bytecode;
+		size_t size;
+		wrong += !ShaderCacheGet(cache, compile, bytecode, size) || size != request.expected.size() ||
+				 memcmp(bytecode, request.expected.data(), size) != 0;
+	}
+	return wrong;
+}
+
+static std::vector<uint8_t> ReadBenchFile(const char* path)
+{
+	std::vector<uint8_t> data;
+	if (FILE* file = fopen(path, "rb"))
+	{
+		uint8_t buffer[4096];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			data.insert(data.end(), buffer, buffer + read);
+		fclose(file);
+	}
+	return data;
+}
+
+static void WriteBenchFile(const char* path, const std::vector<uint8_t>& data, size_t size)
+{
+	if (FILE* file = fopen(path, "wb"))
+	{
+		fwrite(data.data(), 1, size, file);
+		fclose(file);
+	}
+}
+
+static void BenchShaderCache()
+{
+	static const ShaderDefine partialDefines[] = { { "SPARSE_TILES", "1" }, { nullptr, nullptr } };
+	static const ShaderDefine fullDefines[] = { { "SPARSE_TILES", "1" }, { "FULL_TILES", "1" }, { nullptr, nullptr } };
+	static const ShaderDefine editedDefines[] = { { "SPARSE_TILES", "2" }, { nullptr, nullptr } };
+	const ShaderDefine* defineSets[] = { nullptr, partialDefines, fullDefines };
+
+	// The generated blur kernels stand in for the app's shaders, each in its three tile variants
+	std::vector<ShaderBenchRequest> requests;
+	for (int kernel = 0; kernel < BlurKernel_Count; ++kernel)
+		for (int radius : { 2, 4, 8, 13 })
+			for (const ShaderDefine* defines : defineSets)
+				requests.push_back({ GenerateBlurKernelHlsl((BlurKernelType)kernel, radius), "cs_5_0", defines, {} });
+	const int count = (int)requests.size();
+
+	const char* path = "BackdropFilterBench.shadercache";
+	remove(path);
+	MockShaderCompiler compiler;
+	ShaderCache cache;
+
+	printf("Shader cache, %d shaders, mock compiler\n", count);
+	printf("%-34s %9s %9s %9s %9s\n", "", "compiles", "hits", "ms", "");
+
+	auto run = [&](const char* name, bool expectRejected, int expectCompiles, int expectCorrupt) {
+		compiler.compiles = 0;
+		const auto start = std::chrono::steady_clock::now();
+		ShaderCacheOpen(cache, path, &compiler);
+		const int wrong = CheckShaderCache(cache, requests, compiler);
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		const bool ok = !wrong && cache.fileRejected == expectRejected && compiler.compiles == expectCompiles &&
+						(int)cache.corrupt == expectCorrupt;
+		printf("%-34s %9d %9u %9.2f %9s\n", name, compiler.compiles, cache.hits, ms, CheckResult(ok));
+	};
+
+	run("cold, no file", false, count, 0);
+	const bool saved = ShaderCacheSave(cache, path);
+	ShaderCacheClose(cache);
+	run("warm", false, 0, 0);
+	ShaderCacheClose(cache);
+
+	// Editing one request misses that one, the save keeps the old entries next to it
+	requests[1].defines = editedDefines;
+	requests[1].expected.clear();
+	run("one define edited", false, 1, 0);
+	ShaderCacheSave(cache, path);
+	ShaderCacheClose(cache);
+	requests[1].defines = partialDefines;
+	requests[1].expected.clear();
+	run("edit reverted, merged file", false, 0, 0);
+	ShaderCacheClose(cache);
+
+	// A new compiler build invalidates everything
+	compiler.version = 2;
+	for (ShaderBenchRequest& request : requests)
+		request.expected.clear();
+	run("compiler version changed", true, count, 0);
+	ShaderCacheClose(cache);
+	compiler.version = 1;
+	for (ShaderBenchRequest& request : requests)
+		request.expected.clear();
+
+	const std::vector<uint8_t> good = ReadBenchFile(path);
+	ShaderCacheFileHeader header;
+	memcpy(&header, good.data(), sizeof(header));
+
+	std::vector<uint8_t> damaged = good;
+	damaged[damaged.size() - 1] ^= 0x40;  // The last blob
+	WriteBenchFile(path, damaged, damaged.size());
+	run("one blob corrupted", false, 1, 1);
+	ShaderCacheSave(cache, path);
+	ShaderCacheClose(cache);
+	run("after resave", false, 0, 0);
+	ShaderCacheClose(cache);
+
+	WriteBenchFile(path, good, good.size() / 2);
+	const size_t tableEnd = sizeof(header) + header.entryCount * sizeof(ShaderCacheFileEntry);
+	int pastEnd = 0;  // Requested blobs the truncation cut into
+	for (const ShaderBenchRequest& request : requests)
+	{
+		ShaderCompileRequest compile = { request.source.c_str(), "main", request.target, request.defines };
+		const uint64_t key = ShaderCacheKey(compile, compiler.version);
+		for (uint32_t i = 0; i < header.entryCount; ++i)
+		{
+			ShaderCacheFileEntry entry;
+			memcpy(&entry, good.data() + sizeof(header) + i * sizeof(entry), sizeof(entry));
+			pastEnd += entry.key == key && entry.offset + entry.size > good.size() / 2;
+		}
+	}
+	run("truncated to half", false, pastEnd, pastEnd);
+	ShaderCacheClose(cache);
+	WriteBenchFile(path, good, tableEnd - 8);
+	run("truncated in entry table", true, count, 0);
+	ShaderCacheClose(cache);
+	WriteBenchFile(path, good, 3);
+	run("truncated in header", true, count, 0);
+	ShaderCacheClose(cache);
+
+	damaged = good;
+	damaged[0] ^= 1;
+	WriteBenchFile(path, damaged, damaged.size());
+	run("bad magic", true, count, 0);
+	ShaderCacheClose(cache);
+	damaged = good;
+	damaged[4] += 1;
+	WriteBenchFile(path, damaged, damaged.size());
+	run("format version bumped", true, count, 0);
+	ShaderCacheClose(cache);
+	damaged = good;
+	damaged[sizeof(header) + 1] ^= 1;  // A key in the entry table
+	WriteBenchFile(path, damaged, damaged.size());
+	run("entry table corrupted", true, count, 0);
+	ShaderCacheClose(cache);
+
+	// A source that doesn't compile reports the compiler's errors and is not kept
+	WriteBenchFile(path, good, good.size());
+	ShaderCacheOpen(cache, path, &compiler);
+	ShaderCompileRequest broken = { "#error broken\n", "main", "cs_5_0", nullptr };
+	const uint8_t* bytecode;
+	size_t size;
+	std::string errors;
+	const bool compiled = ShaderCacheGet(cache, broken, bytecode, size, &errors);
+	printf("compile error: %s, %zu kept %s\n", errors.c_str(), cache.compiled.size(),
+		   CheckResult(!compiled && !errors.empty() && cache.compiled.empty()));
+	ShaderCacheClose(cache);
+
+	printf("file: %zu bytes, %u entries, saved %s\n", good.size(), header.entryCount, CheckResult(saved));
+	remove(path);
+}
+
+// Fused acrylic chain against one pass per stage: bit-exact for every kernel, stage subset and
+// tiling, then timed where the image does and doesn't fit in the caches
+static void BenchEffectChain(int maxThreads, int frames)
+{
+	static const float Tint[3] = { 0.96f, 0.96f, 0.98f };
+
+	// Chains the compiler must refuse
+	const std::vector<EffectStage> acrylic = AcrylicEffectStages(BlurKernel_Box, Tint);
+	std::vector<std::vector<EffectStage>> invalid = {
+		{},
+		{ EffectTintStage(1, 1, 1, 0.5f), EffectMaskStage() },
+		{ EffectBlurStage(BlurKernel_Box), EffectTintStage(1, 1, 1, 0.5f) },
+		{ EffectBlurStage(BlurKernel_Box), EffectNoiseStage(2, 1), EffectTintStage(1, 1, 1, 0.5f), EffectMaskStage() },
+		{ EffectBlurStage(BlurKernel_Box), EffectTintStage(1, 1, 1, 0.5f), EffectTintStage(0, 0, 0, 0.5f), EffectMaskStage() },
+		{ EffectBlurStage(BlurKernel_Box), EffectTintStage(1, 2, 1, 0.5f), EffectMaskStage() },
+		{ EffectBlurStage(BlurKernel_Box), EffectSaturationStage(NAN), EffectMaskStage() },
+	};
+	int accepted = 0;
+	for (const std::vector<EffectStage>& stages : invalid)
+	{
+		EffectProgram program;
+		accepted += EffectChainCompile(stages, program);
+	}
+	EffectProgram program;
+	std::string error;
+	const bool compiled = EffectChainCompile(acrylic, program, &error);
+	printf("Effect chain: acrylic compiles %s, %zu invalid chains rejected %s\n", CheckResult(compiled, "ok", error.c_str()), invalid.size(),
+		   CheckResult(!accepted));
+
+	// Every subset of the middle stages, coverage ramping to zero so the mask stage has work
+	BenchImage image;
+	MakeBenchImage(image, 301, 187);
+	for (int y = 0; y < image.height; ++y)
+		for (int x = 0; x < image.width; ++x)
+			image.mask[((size_t)y * image.width + x) * 4 + 3] = (uint8_t)std::max(0, 255 - x * 2);
+
+	const int pitch = image.width * 4;
+	CpuImage input = { image.input.data(), pitch };
+	CpuMask mask = { image.mask.data() + 3, pitch, 4 };
+	std::vector<uint8_t> fusedPixels(image.input.size()), unfusedPixels(image.input.size());
+	CpuImage fused = { fusedPixels.data(), pitch };
+	CpuImage unfused = { unfusedPixels.data(), pitch };
+
+	CpuTiledBlur unfusedBlur, fusedBlur;
+	CpuTiledBlurStart(unfusedBlur, 1);
+	CpuTiledBlurStart(fusedBlur, maxThreads, 40, 24);
+
+	int runs = 0, mismatches = 0;
+	for (int kernel = 0; kernel < BlurKernel_Count; ++kernel)
+	{
+		for (int radius : { 0, 1, 5, 13, 40 })
+		{
+			for (int subset = 0; subset < 8; ++subset)
+			{
+				std::vector<EffectStage> stages = { EffectBlurStage((BlurKernelType)kernel) };
+				if (subset & 1) stages.push_back(EffectSaturationStage(0.6f + 0.2f * (radius % 5)));
+				if (subset & 2) stages.push_back(EffectTintStage(Tint[0], Tint[1] * 0.5f, Tint[2], 0.15f + 0.1f * kernel));
+				if (subset & 4) stages.push_back(EffectNoiseStage(2.0f + radius % 7, 0x1234567u * (subset + 1)));
+				stages.push_back(EffectMaskStage());
+
+				EffectProgram variant;
+				if (!EffectChainCompile(stages, variant))
+				{
+					++mismatches;
+					continue;
+				}
+
+				BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, (float)radius, 0.0f };
+				CpuTiledEffectRunUnfused(unfusedBlur, variant, input, mask, unfused, constants);
+				CpuTiledEffectRun(fusedBlur, variant, input, mask, fused, constants);
+				mismatches += fusedPixels != unfusedPixels;
+				++runs;
+			}
+		}
+	}
+	CpuTiledBlurStop(unfusedBlur);
+	CpuTiledBlurStop(fusedBlur);
+	printf("fused vs unfused, %d chains over kernels, radii 0-40 and stage subsets: %d differ %s\n", runs, mismatches,
+		   CheckResult(!mismatches));
+
+	const std::string hlsl = GenerateEffectChainHlsl(program, 13);
+	printf("fused HLSL for radius 13: %zu bytes\n", hlsl.size());
+
+	printf("%-12s %8s %12s %12s %8s %12s %12s %12s %12s\n", "resolution", "threads", "unfused ms", "fused ms", "speedup",
+		   "unfused MB", "fused MB", "unfused GB/s", "fused GB/s");
+	std::vector<int> threadCounts = { 1 };
+	if (maxThreads > 1) threadCounts.push_back(maxThreads);
+	for (const int* resolution : Resolutions)
+	{
+		MakeBenchImage(image, resolution[0], resolution[1]);
+		const int width = image.width;
+		BlurConstants constants = { (uint32_t)width, (uint32_t)image.height, 13.0f, 0.0f };
+		CpuImage frameInput = { image.input.data(), width * 4 };
+		CpuImage frameOutput = { image.output.data(), width * 4 };
+		CpuMask frameMask = { image.mask.data() + 3, width * 4, 4 };
+
+		const uint64_t pixels = (uint64_t)width * image.height;
+		const uint64_t unfusedBytes = EffectChainUnfusedBytes(program, pixels);
+		const uint64_t fusedBytes = EffectChainFusedBytes(program, pixels);
+
+		for (int threads : threadCounts)
+		{
+			CpuTiledBlur blur;
+			CpuTiledBlurStart(blur, threads);
+
+			CpuTiledEffectRunUnfused(blur, program, frameInput, frameMask, frameOutput, constants);
+			double start = NowMs();
+			for (int frame = 0; frame < frames; ++frame)
+				CpuTiledEffectRunUnfused(blur, program, frameInput, frameMask, frameOutput, constants);
+			const double unfusedMs = (NowMs() - start) / frames;
+
+			CpuTiledEffectRun(blur, program, frameInput, frameMask, frameOutput, constants);
+			start = NowMs();
+			for (int frame = 0; frame < frames; ++frame)
+				CpuTiledEffectRun(blur, program, frameInput, frameMask, frameOutput, constants);
+			const double fusedMs = (NowMs() - start) / frames;
+
+			CpuTiledBlurStop(blur);
+
+			char name[32];
+			snprintf(name, sizeof(name), "%dx%d", width, image.height);
+			printf("%-12s %8d %12.3f %12.3f %7.2fx %12.1f %12.1f %12.1f %12.1f\n", name, threads, unfusedMs, fusedMs, unfusedMs / fusedMs,
+				   unfusedBytes / 1e6, fusedBytes / 1e6, unfusedBytes / 1e6 / unfusedMs, fusedBytes / 1e6 / fusedMs);
+		}
+	}
+}
+
+// Visible pixels of a window-sized output that differ from `expected` cropped at `visible`
+// (frame coordinates), plus pixels off the frame that don't hold `offFrame`
+static int CountWindowDiffs(const std::vector<uint8_t>& output, const BlurRect& window, const BlurRect& visible,
+							const uint8_t* expected, int expectedPitch, uint8_t offFrame)
+{
+	const int width = window.right - window.left;
+	int diffs = 0;
+	for (int y = window.top; y < window.bottom; ++y)
+	{
+		for (int x = window.left; x < window.right; ++x)
+		{
+			const uint8_t* pixel = &output[((size_t)(y - window.top) * width + (x - window.left)) * 4];
+			const bool onFrame = x >= visible.left && x < visible.right && y >= visible.top && y < visible.bottom;
+			if (onFrame)
+				diffs += memcmp(pixel, expected + (size_t)y * expectedPitch + (size_t)x * 4, 4) != 0;
+			else
+				diffs += pixel[0] != offFrame || pixel[1] != offFrame || pixel[2] != offFrame || pixel[3] != offFrame;
+		}
+	}
+	return diffs;
+}
+
+// Windows blurred straight out of the frame: the clipping, the zero-copy blur against copying
+// the window's apron out first and against a crop of the whole frame blurred, for windows
+// inside, across and off every edge. Then the headless pipeline against the whole frame with
+// incremental frames, and the copy it no longer makes, timed.
+static void BenchImageViews(int maxThreads, int frames)
+{
+	BenchImage image;
+	MakeBenchImage(image, 640, 360);
+	const ImageView frame = { image.input.data(), image.width, image.height, image.width * 4, ImageFormat_BGRA8 };
+
+	struct ClipCase
+	{
+		BlurRect rect;
+		bool visible;
+		BlurRect clipped;
+	};
+	static const ClipCase Clips[] = {
+		{ { 10, 20, 110, 70 }, true, { 10, 20, 110, 70 } },
+		{ { -50, -30, 100, 40 }, true, { 0, 0, 100, 40 } },
+		{ { 600, 300, 700, 400 }, true, { 600, 300, 640, 360 } },
+		{ { -10, -10, 700, 400 }, true, { 0, 0, 640, 360 } },
+		{ { 640, 0, 700, 50 }, false, {} },
+		{ { -100, -100, 0, 0 }, false, {} },
+		{ { 20, 20, 20, 40 }, false, {} },
+	};
+	int clipFailures = 0;
+	for (const ClipCase& clip : Clips)
+	{
+		BlurRect rect = clip.rect;
+		const bool visible = ImageViewClip(frame, rect);
+		const ImageView sub = ImageViewSubRect(frame, clip.rect);
+		if (visible != clip.visible)
+			++clipFailures;
+		else if (visible)
+			clipFailures += memcmp(&rect, &clip.clipped, sizeof(rect)) != 0 || sub.pixels != ImageViewPixel(frame, rect.left, rect.top) ||
+				sub.width != rect.right - rect.left || sub.height != rect.bottom - rect.top || sub.rowPitch != frame.rowPitch;
+		else
+			clipFailures += sub.width != 0 || sub.height != 0;
+	}
+	printf("Image views: %zu clip cases %s\n", sizeof(Clips) / sizeof(Clips[0]), CheckResult(!clipFailures));
+
+	static const BlurRect Windows[] = {
+		{ 100, 80, 500, 280 },	   // Inside
+		{ 0, 0, 640, 360 },		   // The whole frame
+		{ -150, -90, 250, 110 },   // Across the top-left corner
+		{ 420, 250, 820, 450 },	   // Across the bottom-right corner
+		{ -40, 100, 200, 420 },	   // Across the left and bottom edges
+		{ -60, -60, 700, 420 },	   // Larger than the frame
+		{ 700, 100, 900, 200 },	   // Right of the frame
+		{ -300, -200, -20, -10 },  // Above and left of the frame
+	};
+	static const uint8_t Untouched = 0x5a;
+
+	CpuTiledBlur blur;
+	CpuTiledBlurStart(blur, maxThreads, 40, 24);
+	std::vector<uint8_t> frameMask(image.mask.size()), reference(image.input.size()), apron;
+	std::vector<uint8_t> windowMask, zeroCopy, copied;
+
+	int runs = 0, zeroDiffs = 0, copyDiffs = 0;
+	for (const BlurRect& window : Windows)
+	{
+		// Coverage ramps across the window, the reference sees the same ramp frame-wide
+		const int width = window.right - window.left;
+		const int height = window.bottom - window.top;
+		windowMask.resize((size_t)width * height);
+		for (int y = 0; y < height; ++y)
+			for (int x = 0; x < width; ++x)
+				windowMask[(size_t)y * width + x] = (uint8_t)std::max(0, 255 - (x + y) / 3);
+		for (int y = 0; y < image.height; ++y)
+		{
+			for (int x = 0; x < image.width; ++x)
+			{
+				const int localX = x - window.left, localY = y - window.top;
+				const bool inside = localX >= 0 && localX < width && localY >= 0 && localY < height;
+				frameMask[((size_t)y * image.width + x) * 4 + 3] = inside ? windowMask[(size_t)localY * width + localX] : 255;
+			}
+		}
+		const CpuMask mask = { windowMask.data(), width, 1 };
+
+		for (int kernel = 0; kernel < BlurKernel_Count; ++kernel)
+		{
+			for (int radius : { 0, 5, 13 })
+			{
+				BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, (float)radius, 0.0f };
+				CpuTiledBlurRun(blur, { image.input.data(), image.width * 4 }, { frameMask.data() + 3, image.width * 4, 4 },
+								{ reference.data(), image.width * 4 }, constants, (BlurKernelType)kernel);
+
+				ImageViewBlur plan;
+				const bool onFrame = ImageViewPlanBlur(frame, window, (float)radius, plan);
+				zeroCopy.assign((size_t)width * height * 4, Untouched);
+				copied.assign(zeroCopy.size(), Untouched);
+				if (onFrame)
+				{
+					// In place
+					const CpuImage zeroCopyOutput = CpuImageAt({ zeroCopy.data(), width * 4 }, plan.windowX, plan.windowY);
+					CpuTiledBlurRunRect(blur, ImageViewCpuImage(plan.source), CpuMaskAt(mask, plan.windowX, plan.windowY), zeroCopyOutput,
+										plan.constants, plan.rect, (BlurKernelType)kernel);
+
+					// The apron copied out first
+					apron.resize((size_t)plan.source.width * plan.source.height * 4);
+					const ImageView apronView = { apron.data(), plan.source.width, plan.source.height, plan.source.width * 4, ImageFormat_BGRA8 };
+					ImageViewCopy(plan.source, apronView);
+					const CpuImage copiedOutput = CpuImageAt({ copied.data(), width * 4 }, plan.windowX, plan.windowY);
+					CpuTiledBlurRunRect(blur, ImageViewCpuImage(apronView), CpuMaskAt(mask, plan.windowX, plan.windowY), copiedOutput,
+										plan.constants, plan.rect, (BlurKernelType)kernel);
+				}
+
+				const BlurRect visible = onFrame ? plan.visible : BlurRect{};
+				zeroDiffs += CountWindowDiffs(zeroCopy, window, visible, reference.data(), image.width * 4, Untouched);
+				copyDiffs += CountWindowDiffs(copied, window, visible, reference.data(), image.width * 4, Untouched);
+				++runs;
+			}
+		}
+	}
+	printf("%d windows x kernels x radii 0/5/13 against the whole frame blurred: zero-copy %d px differ %s, copied apron %d px differ %s\n",
+		   runs, zeroDiffs, CheckResult(!zeroDiffs), copyDiffs, CheckResult(!copyDiffs));
+	CpuTiledBlurStop(blur);
+
+	// The pipeline on a window hanging off the left and bottom, against the same frames from a
+	// second source blurred whole. Incremental frames read the apron in place too.
+	{
+		const BlurRect window = { -120, 700, 680, 1200 };
+		const float radius = 13.0f;
+		const int steps = std::max(frames, 8);
+		FrameSource* source = CreateFrameSource("synthetic:text", 1920, 1080, steps);
+		FrameSource* twin = CreateFrameSource("synthetic:text", 1920, 1080, steps);
+
+		BlurPipeline pipeline;
+		BlurPipelineStart(pipeline, window, radius, BlurKernel_Box, maxThreads);
+		CpuTiledBlur whole;
+		CpuTiledBlurStart(whole, maxThreads);
+		std::vector<uint8_t> wholeOutput((size_t)1920 * 1080 * 4);
+
+		int compared = 0, incremental = 0, diffs = 0;
+		for (;;)
+		{
+			bool blurred = false;
+			const FrameSourceResult result = BlurPipelineStep(pipeline, *source, 0, &blurred);
+			Frame twinFrame;
+			if (result == FrameSource_End || twin->AcquireFrame(0, twinFrame) != FrameSource_Ok)
+				break;
+
+			if (blurred)
+			{
+				incremental += !pipeline.region.full;
+				BlurConstants constants = { (uint32_t)twinFrame.width, (uint32_t)twinFrame.height, radius, 0.0f };
+				CpuTiledBlurRun(whole, { (uint8_t*)twinFrame.pixels, twinFrame.rowPitch }, {}, { wholeOutput.data(), twinFrame.width * 4 }, constants);
+				const BlurRect visible = { 0, 700, 680, 1080 };
+				diffs += CountWindowDiffs(pipeline.output, window, visible, wholeOutput.data(), twinFrame.width * 4, 0);
+				++compared;
+			}
+			twin->ReleaseFrame();
+		}
+		CpuTiledBlurStop(whole);
+		BlurPipelineStop(pipeline);
+		delete source;
+		delete twin;
+		printf("pipeline, window off the left and bottom: %d frames (%d incremental), %d px differ %s\n", compared, incremental, diffs,
+			   CheckResult(!diffs && compared));
+	}
+
+	// A 1080p window on a 4K frame, copied out and blurred against blurred in place
+	{
+		MakeBenchImage(image, 3840, 2160);
+		const ImageView bigFrame = { image.input.data(), image.width, image.height, image.width * 4, ImageFormat_BGRA8 };
+		const BlurRect window = { 960, 540, 2880, 1620 };
+		ImageViewBlur plan;
+		ImageViewPlanBlur(bigFrame, window, 13.0f, plan);
+		const int width = window.right - window.left;
+		std::vector<uint8_t> windowOutput((size_t)width * (window.bottom - window.top) * 4);
+		apron.resize((size_t)plan.source.width * plan.source.height * 4);
+		const ImageView apronView = { apron.data(), plan.source.width, plan.source.height, plan.source.width * 4, ImageFormat_BGRA8 };
+		const CpuImage output = CpuImageAt({ windowOutput.data(), width * 4 }, plan.windowX, plan.windowY);
+
+		printf("%-8s %12s %12s %14s\n", "threads", "copy ms", "in place ms", "copied MB");
+		std::vector<int> threadCounts = { 1 };
+		if (maxThreads > 1) threadCounts.push_back(maxThreads);
+		for (int threads : threadCounts)
+		{
+			CpuTiledBlurStart(blur, threads);
+			double start = NowMs();
+			for (int i = 0; i < frames; ++i)
+			{
+				ImageViewCopy(plan.source, apronView);
+				CpuTiledBlurRunRect(blur, ImageViewCpuImage(apronView), {}, output, plan.constants, plan.rect);
+			}
+			const double copyMs = (NowMs() - start) / frames;
+
+			start = NowMs();
+			for (int i = 0; i < frames; ++i)
+				CpuTiledBlurRunRect(blur, ImageViewCpuImage(plan.source), {}, output, plan.constants, plan.rect);
+			const double inPlaceMs = (NowMs() - start) / frames;
+			CpuTiledBlurStop(blur);
+
+			printf("%-8d %12.3f %12.3f %14.1f\n", threads, copyMs, inPlaceMs, apron.size() / 1e6);
+		}
+	}
+}
+
+// Hash of a frame's pixels with the rects and window that came with it. Without the rects for
+// the recording thread, a frame after dropped ones carries their rects as well.
+static uint64_t HashRecordedFrame(const Frame& frame, const BlurRect& window, bool rects = true)
+{
+	uint64_t hash = FrameHashBytes((const uint8_t*)&window, sizeof(window));
+	for (int y = 0; y < frame.height; ++y)
+		hash = FrameHashBytes(frame.pixels + (size_t)y * frame.rowPitch, (size_t)frame.width * 4, hash);
+	hash = FrameHashBytes((const uint8_t*)&frame.timestamp, sizeof(frame.timestamp), hash);
+	hash = FrameHashBytes((const uint8_t*)&frame.pointerOnly, sizeof(frame.pointerOnly), hash);
+	if (!rects)
+		return hash;
+	hash = FrameHashBytes((const uint8_t*)frame.dirtyRects.data(), frame.dirtyRects.size() * sizeof(BlurRect), hash);
+	return FrameHashBytes((const uint8_t*)frame.moves.data(), frame.moves.size() * sizeof(DirtyMove), hash);
+}
+
+// Records `frames` frames of `spec` with a window drifting across them, the hash of every frame
+// as it went in. Returns the writer's milliseconds per frame, negative when a write failed.
+static double RecordBenchSource(const char* path, const char* spec, int width, int height, int frames, int keyframeInterval,
+								std::vector<uint64_t>& hashes, RecordingWriter& writer, double* slowestMs = nullptr)
+{
+	hashes.clear();
+	FrameSource* source = CreateFrameSource(spec, width, height, frames);
+	if (!source || !RecordingWriterOpen(writer, path, width, height, keyframeInterval))
+	{
+		delete source;
+		return -1.0;
+	}
+
+	Frame frame;
+	double writeMs = 0.0;
+	bool ok = true;
+	while (source->AcquireFrame(0, frame) == FrameSource_Ok)
+	{
+		const int index = (int)hashes.size();
+		const BlurRect window = { index * 7 - 100, index * 3 - 50, index * 7 + 300, index * 3 + 250 };
+		hashes.push_back(HashRecordedFrame(frame, window));
+
+		const double start = NowMs();
+		ok &= RecordingWriterAdd(writer, frame, window);
+		const double frameMs = NowMs() - start;
+		writeMs += frameMs;
+		if (slowestMs)
+			*slowestMs = std::max(*slowestMs, frameMs);
+		source->ReleaseFrame();
+	}
+	const double start = NowMs();
+	ok &= RecordingWriterClose(writer);
+	writeMs += NowMs() - start;
+	delete source;
+	return ok ? writeMs / std::max(1, (int)hashes.size()) : -1.0;
+}
+
+// Frames of `source` from `first` on that don't hash as recorded
+static int CountReplayDiffs(RecordingFrameSource& source, const std::vector<uint64_t>& hashes, int first, int count, bool rects = true)
+{
+	int diffs = 0;
+	Frame frame;
+	for (int index = first; index < first + count; ++index)
+	{
+		if (source.AcquireFrame(0, frame) != FrameSource_Ok || index >= (int)hashes.size())
+			return diffs + first + count - index;
+		diffs += HashRecordedFrame(frame, source.window, rects) != hashes[index];
+		source.ReleaseFrame();
+	}
+	return diffs;
+}
+
+// Through the recording thread, hashing only the frames it took. Frames in [stallFrom, stallTo)
+// find every packet taken, as if the thread were behind. A frame interval paces the frames like
+// a render loop, the thread writes between them. Returns the mean time a frame took to hand
+// off, -1 when the recording failed. The first frame is copied whole into fresh memory and
+// timed on its own, slowestMs is of the frames after it.
+static double RecordBenchThreaded(const char* path, const char* spec, int width, int height, int frames, int keyframeInterval,
+								  int stallFrom, int stallTo, double frameIntervalMs, std::vector<uint64_t>& hashes,
+								  RecordingThread& recording, double* firstMs = nullptr, double* slowestMs = nullptr)
+{
+	hashes.clear();
+	FrameSource* source = CreateFrameSource(spec, width, height, frames);
+	if (!source || !RecordingThreadStart(recording, path, width, height, RecordingDefaultQueueLength, keyframeInterval))
+	{
+		delete source;
+		return -1.0;
+	}
+
+	Frame frame;
+	std::vector<int> stalled;
+	double addMs = 0.0;
+	const double startMs = NowMs();
+	int index = 0;
+	for (; source->AcquireFrame(0, frame) == FrameSource_Ok; ++index)
+	{
+		const double dueMs = startMs + index * frameIntervalMs - NowMs();
+		if (dueMs > 0.0)
+			std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(dueMs));
+
+		{
+			std::lock_guard<std::mutex> lock(recording.mutex);
+			std::vector<int>& from = index >= stallFrom && index < stallTo ? recording.idle : stalled;
+			std::vector<int>& to = &from == &stalled ? recording.idle : stalled;
+			to.insert(to.end(), from.begin(), from.end());
+			from.clear();
+		}
+
+		const BlurRect window = { index * 7 - 100, index * 3 - 50, index * 7 + 300, index * 3 + 250 };
+		const double start = NowMs();
+		const bool added = RecordingThreadAdd(recording, frame, window);
+		const double frameMs = NowMs() - start;
+		addMs += frameMs;
+		if (firstMs && index == 0)
+			*firstMs = frameMs;
+		if (slowestMs && index > 0)
+			*slowestMs = std::max(*slowestMs, frameMs);
+		if (added)
+			hashes.push_back(HashRecordedFrame(frame, window, false));
+		source->ReleaseFrame();
+	}
+	{
+		std::lock_guard<std::mutex> lock(recording.mutex);
+		recording.idle.insert(recording.idle.end(), stalled.begin(), stalled.end());
+	}
+	const bool ok = RecordingThreadStop(recording);
+	delete source;
+	return ok ? addMs / std::max(1, index) : -1.0;
+}
+
+// Recordings: every frame played back as recorded for each synthetic source, seeks, files cut
+// short or damaged, the recording thread falling behind, then the hand-off and reader at 4K against
+// the 60 Hz frame budget
+static void BenchRecording(int frames)
+{
+	static const char* const Sources[] = { "synthetic:text", "synthetic:noise", "synthetic:static" };
+	const char* path = "BackdropFilterBench.recording";
+	RecordingWriter writer;
+	std::vector<uint64_t> hashes;
+
+	printf("Capture recording, 640x360, 240 frames, keyframe every 50\n");
+	printf("%-18s %8s %10s %12s %10s %8s %8s\n", "source", "frames", "keyframes", "bytes", "of raw", "differ", "seeks");
+	for (const char* spec : Sources)
+	{
+		const bool recorded = RecordBenchSource(path, spec, 640, 360, 240, 50, hashes, writer) >= 0.0;
+		RecordingFrameSource* source = recorded ? CreateRecordingFrameSource(path) : nullptr;
+		if (!source)
+		{
+			printf("%-18s failed to record %s\n", spec, CheckResult(false));
+			continue;
+		}
+
+		int diffs = CountReplayDiffs(*source, hashes, 0, (int)hashes.size());
+		Frame frame;
+		diffs += source->AcquireFrame(0, frame) != FrameSource_End;
+
+		// Into the middle of a keyframe interval, onto a keyframe, backwards, then play on
+		int seekDiffs = 0;
+		for (int index : { 137, 100, 3, 0, 49, 50, 239, 120 })
+			seekDiffs += !RecordingFrameSourceSeek(*source, index) || CountReplayDiffs(*source, hashes, index, std::min(5, 240 - index)) != 0;
+		delete source;
+
+		const double raw = 240.0 * 640 * 360 * 4;
+		printf("%-18s %8zu %10u %12llu %9.1f%% %8d %8s\n", spec, hashes.size(), writer.keyframes, (unsigned long long)writer.bytesWritten,
+			   100.0 * writer.bytesWritten / raw, diffs, CheckResult(!seekDiffs));
+	}
+
+	// A looping source starts over through Lost, a recording cut short keeps its whole records
+	RecordBenchSource(path, "synthetic:text", 640, 360, 240, 50, hashes, writer);
+	const std::vector<uint8_t> good = ReadBenchFile(path);
+	RecordingFrameSource* looping = CreateRecordingFrameSource(path, true);
+	bool loopOk = looping && CountReplayDiffs(*looping, hashes, 0, 240) == 0;
+	Frame frame;
+	loopOk = loopOk && looping->AcquireFrame(0, frame) == FrameSource_Lost && CountReplayDiffs(*looping, hashes, 0, 60) == 0;
+	delete looping;
+
+	WriteBenchFile(path, good, good.size() - 1000);
+	RecordingFrameSource* cut = CreateRecordingFrameSource(path);
+	const int cutFrames = cut ? (int)cut->records.size() : 0;
+	const bool cutOk = cut && cutFrames > 200 && cutFrames < 240 && CountReplayDiffs(*cut, hashes, 0, cutFrames) == 0;
+	delete cut;
+
+	// An unclosed writer leaves frameCount 0, which the reader doesn't need
+	std::vector<uint8_t> unclosed = good;
+	memset(&unclosed[offsetof(RecordingFileHeader, frameCount)], 0, sizeof(uint32_t));
+	WriteBenchFile(path, unclosed, unclosed.size());
+	RecordingFrameSource* open = CreateRecordingFrameSource(path);
+	const bool unclosedOk = open && open->records.size() == 240;
+	delete open;
+
+	// A record whose rect leaves the frame ends the recording there, a bad header rejects it
+	std::vector<uint8_t> damaged = good;
+	const size_t second = sizeof(RecordingFileHeader) + ((const RecordingFrameHeader*)&good[sizeof(RecordingFileHeader)])->size;
+	const RecordingFrameHeader* secondHeader = (const RecordingFrameHeader*)&good[second];
+	const BlurRect wide = { 0, 0, 100000, 10 };
+	memcpy(&damaged[second + sizeof(RecordingFrameHeader) + secondHeader->moveCount * sizeof(DirtyMove)], &wide, sizeof(wide));
+	WriteBenchFile(path, damaged, damaged.size());
+	RecordingFrameSource* stopped = CreateRecordingFrameSource(path);
+	const bool damagedOk = stopped && stopped->records.size() == 1;
+	delete stopped;
+
+	damaged = good;
+	damaged[0] ^= 0xff;
+	WriteBenchFile(path, damaged, damaged.size());
+	RecordingFrameSource* rejected = CreateRecordingFrameSource(path);
+	const bool rejectedOk = !rejected;
+	delete rejected;
+
+	printf("loop %s, cut short %s (%d frames), unclosed %s, bad record %s, bad header %s\n", CheckResult(loopOk), CheckResult(cutOk),
+		   cutFrames, CheckResult(unclosedOk), CheckResult(damagedOk), CheckResult(rejectedOk));
+
+	// The recording thread falling behind for 4 frames, and for 140 which leaves too many rects
+	// to track so the next frame goes out whole: the frames it took play back as they were
+	static const int Stalls[][2] = { { 30, 34 }, { 100, 240 } };
+	RecordingThread recording;
+	printf("Recording thread, 640x360, 300 frames, stalled for 4 frames from 30 or 140 from 100\n");
+	printf("%-18s %-8s %8s %8s %10s %8s %8s\n", "source", "stall", "queued", "dropped", "keyframes", "differ", "");
+	for (const char* spec : Sources)
+	{
+		for (const int* stall : Stalls)
+		{
+			const bool recorded = RecordBenchThreaded(path, spec, 640, 360, 300, 50, stall[0], stall[1], 1.0, hashes, recording) >= 0.0;
+			RecordingFrameSource* source = recorded ? CreateRecordingFrameSource(path) : nullptr;
+			const int diffs =
+				source ? CountReplayDiffs(*source, hashes, 0, (int)hashes.size(), false) + (int)(source->records.size() != hashes.size()) : -1;
+			delete source;
+
+			// The queue can also run full by itself, the thread shares the machine
+			const bool ok = !diffs && recording.droppedFrames >= (uint64_t)(stall[1] - stall[0]) &&
+							recording.queuedFrames + recording.droppedFrames == 300 && recording.queuedFrames == hashes.size();
+			char range[16];
+			snprintf(range, sizeof(range), "%d-%d", stall[0], stall[1] - 1);
+			printf("%-18s %-8s %8llu %8llu %10u %8d %8s\n", spec, range, (unsigned long long)recording.queuedFrames,
+				   (unsigned long long)recording.droppedFrames, recording.writer.keyframes, diffs, CheckResult(ok));
+		}
+	}
+
+	// A frame has 16.7 ms at 60 Hz and the render thread only pays for the hand-off, its slowest
+	// frame has to fit. The first one starts the recording with a whole frame. Writing on the same
+	// thread is timed to show what the recording thread saves.
+	const int timedFrames = std::max(frames, 60);
+	printf("3840x2160, %d frames at 60 Hz, keyframe every %d\n", timedFrames, RecordingDefaultKeyframeInterval);
+	printf("%-18s %10s %10s %10s %10s %10s %8s %10s %10s %8s\n", "source", "write ms", "slowest", "first ms", "hand-off", "slowest",
+		   "dropped", "read ms", "MB/frame", "60 Hz");
+	for (const char* spec : { "synthetic:text", "synthetic:noise" })
+	{
+		double firstHandOffMs = 0.0;
+		double slowestHandOffMs = 0.0;
+		const double handOffMs = RecordBenchThreaded(path, spec, 3840, 2160, timedFrames, RecordingDefaultKeyframeInterval, -1, -1,
+													 1000.0 / 60, hashes, recording, &firstHandOffMs, &slowestHandOffMs);
+
+		double slowestMs = 0.0;
+		const double writeMs =
+			RecordBenchSource(path, spec, 3840, 2160, timedFrames, RecordingDefaultKeyframeInterval, hashes, writer, &slowestMs);
+		RecordingFrameSource* source = CreateRecordingFrameSource(path);
+		double readMs = 0.0;
+		if (source)
+		{
+			const double start = NowMs();
+			while (source->AcquireFrame(0, frame) == FrameSource_Ok)
+				source->ReleaseFrame();
+			readMs = (NowMs() - start) / timedFrames;
+		}
+		delete source;
+		printf("%-18s %10.3f %10.3f %10.3f %10.3f %10.3f %8llu %10.3f %10.2f %8s\n", spec, writeMs, slowestMs, firstHandOffMs, handOffMs,
+			   slowestHandOffMs, (unsigned long long)recording.droppedFrames, readMs, writer.bytesWritten / 1e6 / timedFrames,
+			   CheckResult(writeMs >= 0.0 && handOffMs >= 0.0 && slowestHandOffMs < 1000.0 / 60));
+	}
+	remove(path);
+}
+
+// Whole-window blur cost at 1920x1080 in ms on each level of a ladder, the simulated machines
+struct TunerMachine
+{
+	const char* name;
+	const BlurTunerLevel* levels;
+	float levelMs[BlurTunerLevelCount];
+};
+
+struct TunerScenario
+{
+	const char* name;
+	int machine;
+	float noise;	  // Frame to frame, +- this share
+	int spikeEvery;	  // Single frames at 5x, 0 for none
+	int loadFrom;	  // Frames at loadScale
+	int loadTo;
+	float loadScale;
+	int resizeAt;  // The window grows to 3840x2160, -1 never
+};
+
+static const int TunerBenchFrames = 3000;
+
+static double TunerScenarioMs(const TunerScenario& scenario, const TunerMachine& machine, int level, int frame)
+{
+	double ms = machine.levelMs[level];
+	if (frame >= scenario.loadFrom && frame < scenario.loadTo)
+		ms *= scenario.loadScale;
+	if (scenario.resizeAt >= 0 && frame >= scenario.resizeAt)
+		ms *= 4.0;
+	return ms;
+}
+
+// Settled on a level that fits, with no better one that would fit easily
+static bool TunerSettledWell(const BlurTunerConfig& config, const TunerScenario& scenario, const TunerMachine& machine, int level)
+{
+	const int last = TunerBenchFrames - 1;
+	if (TunerScenarioMs(scenario, machine, level, last) * 1000.0 > config.budgetUs * config.highWater && level != BlurTunerLevelCount - 1)
+		return false;
+	for (int i = 0; i < level; ++i)
+	{
+		if (TunerScenarioMs(scenario, machine, i, last) * 1000.0 < config.budgetUs * config.lowWater)
+			return false;
+	}
+	return true;
+}
+
+// The tuner against simulated cost models, then closing the loop over the CPU kernels
+static void BenchTuner(int threads, float blurRadius, int frames)
+{
+	static const TunerMachine Machines[] = {
+		{ "fast gpu", BlurTunerGpuLevels, { 1.2f, 0.7f, 1.0f, 0.75f, 0.2f, 0.16f, 0.45f } },
+		{ "slow gpu", BlurTunerGpuLevels, { 9.0f, 4.6f, 7.2f, 5.4f, 1.4f, 1.1f, 3.1f } },
+		{ "cpu", BlurTunerCpuLevels, { 40.0f, 3.4f, 30.0f, 2.2f, 80.0f, 75.0f, 1.9f } },
+		{ "cpu, gpu guesses", BlurTunerGpuLevels, { 40.0f, 3.4f, 30.0f, 2.2f, 80.0f, 75.0f, 1.9f } },
+		{ "near the budget", BlurTunerGpuLevels, { 3.3f, 2.0f, 2.8f, 2.1f, 0.6f, 0.5f, 1.2f } },
+	};
+	static const TunerScenario Scenarios[] = {
+		{ "fast gpu", 0, 0.05f, 0, 0, 0, 1.0f, -1 },
+		{ "slow gpu", 1, 0.05f, 0, 0, 0, 1.0f, -1 },
+		{ "cpu", 2, 0.05f, 0, 0, 0, 1.0f, -1 },
+		{ "cpu, gpu guesses", 3, 0.05f, 0, 0, 0, 1.0f, -1 },
+		{ "near budget, noisy", 4, 0.1f, 0, 0, 0, 1.0f, -1 },
+		{ "1-frame spikes", 1, 0.05f, 7, 0, 0, 1.0f, -1 },
+		{ "3x load, recovers", 0, 0.05f, 0, 600, 1200, 3.0f, -1 },
+		{ "5x load, recovers", 0, 0.05f, 0, 600, 1200, 5.0f, -1 },
+		{ "grows to 4K", 0, 0.05f, 0, 0, 0, 1.0f, 600 },
+	};
+	// Dirty rects make most frames partial, the small ones don't count
+	static const float Coverages[] = { 1.0f, 1.0f, 0.5f, 0.1f };
+	const BlurTunerConfig config = BlurTunerDefaults;
+
+	printf("Blur tuner, %d simulated frames, budget %.1f ms\n", TunerBenchFrames, config.budgetUs / 1e3);
+	printf("%-20s %-12s %6s %6s %8s %10s %11s %6s\n", "scenario", "final", "down", "up", "late", "over", "over after", "ok");
+	for (const TunerScenario& scenario : Scenarios)
+	{
+		const TunerMachine& machine = Machines[scenario.machine];
+		BlurTuner tuner;
+		BlurTunerStart(tuner, config, machine.levels, BlurTunerLevelCount);
+
+		uint32_t seed = 12345;
+		int overFrames = 0;
+		int overAfter = 0;	// Once the load or resize has been there for a second
+		uint64_t lateMoves = 0;
+		for (int frame = 0; frame < TunerBenchFrames; ++frame)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			const double noise = 1.0 + scenario.noise * ((double)(seed >> 8) / (1 << 24) * 2.0 - 1.0);
+			double ms = TunerScenarioMs(scenario, machine, tuner.current, frame) * noise;
+			if (scenario.spikeEvery && frame % scenario.spikeEvery == 0)
+				ms *= 5.0;
+
+			const uint64_t windowPixels = scenario.resizeAt >= 0 && frame >= scenario.resizeAt ? 3840ull * 2160 : 1920ull * 1080;
+			const float coverage = Coverages[frame % 4];
+			const uint64_t pixels = (uint64_t)(windowPixels * coverage);
+
+			if (ms * 1000.0 > config.budgetUs)
+			{
+				++overFrames;
+				const int since = std::max(scenario.loadFrom > 0 ? scenario.loadFrom : 0, scenario.resizeAt);
+				if (frame >= since + 60 && (!scenario.spikeEvery || frame % scenario.spikeEvery))
+					++overAfter;
+			}
+
+			const uint64_t moves = tuner.movesDown + tuner.movesUp;
+			BlurTunerAddSample(tuner, tuner.current, ms * 1000.0 * coverage + 20.0, pixels, windowPixels);
+			if (frame >= TunerBenchFrames * 2 / 3)
+				lateMoves += tuner.movesDown + tuner.movesUp - moves;
+		}
+
+		const bool ok = TunerSettledWell(config, scenario, machine, tuner.current) && lateMoves == 0;
+		printf("%-20s %-12s %6llu %6llu %8llu %10d %11d %6s\n", scenario.name, BlurTunerCurrent(tuner).name,
+			   (unsigned long long)tuner.movesDown, (unsigned long long)tuner.movesUp, (unsigned long long)lateMoves,
+			   overFrames, overAfter, CheckResult(ok));
+	}
+
+	// The real kernels, each budget should end on the best level that fits on this machine
+	BenchImage image;
+	MakeBenchImage(image, 1920, 1080);
+	CpuImage input = { image.input.data(), image.width * 4 };
+	CpuImage output = { image.output.data(), image.width * 4 };
+	CpuMask mask = { image.mask.data() + 3, image.width * 4, 4 };
+	const uint64_t windowPixels = (uint64_t)image.width * image.height;
+
+	CpuTiledBlur blur;
+	CpuTiledBlurStart(blur, threads);
+	CpuIirScratch iirScratch;
+	CpuKawaseScratch kawaseScratch;
+
+	const int loopFrames = std::max(frames, 40);
+	printf("Blur tuner on the CPU kernels at %dx%d, radius %.0f, %d threads, %d frames\n", image.width, image.height,
+		   blurRadius, ThreadPoolWorkerCount(blur.pool), loopFrames);
+	printf("%10s %-12s %10s %6s %6s %s\n", "budget ms", "final", "final ms", "down", "up", "measured ms");
+	for (double budgetMs : { 2.0, 8.0, 30.0, 1000.0 })
+	{
+		BlurTunerConfig loopConfig = config;
+		loopConfig.budgetUs = budgetMs * 1000.0;
+		loopConfig.upFrames = 8;
+		loopConfig.exploreFrames = 16;
+		BlurTuner tuner;
+		BlurTunerStart(tuner, loopConfig, BlurTunerCpuLevels, BlurTunerLevelCount);
+
+		double lastMs[BlurTunerLevelCount] = {};
+		for (int frame = 0; frame < loopFrames; ++frame)
+		{
+			const BlurTunerLevel& level = BlurTunerCurrent(tuner);
+			const float radius = blurRadius * level.radiusScale;
+			BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, radius, 0.0f };
+
+			const double start = NowMs();
+			if (level.method == BlurTunerMethod_Iir)
+				CpuIirGaussianBlur(input, mask, output, constants, IirGaussianSigmaForRadius(radius), iirScratch, &blur.pool);
+			else if (level.method == BlurTunerMethod_Kawase)
+				CpuKawaseBlur(input, mask, output, constants, CpuKawaseLevelsForRadius(radius, image.width, image.height), kawaseScratch);
+			else
+				CpuTiledBlurRun(blur, input, mask, output, constants, level.kernel);
+			const double ms = NowMs() - start;
+
+			lastMs[tuner.current] = ms;
+			BlurTunerAddSample(tuner, tuner.current, ms * 1000.0, windowPixels, windowPixels);
+		}
+
+		// Settled well when the final level fits, or nothing ran that was cheaper
+		bool ok = lastMs[tuner.current] <= budgetMs || tuner.current == BlurTunerLevelCount - 1;
+		std::string measured;
+		for (int i = 0; i < BlurTunerLevelCount; ++i)
+		{
+			char entry[48];
+			if (lastMs[i] > 0.0)
+			{
+				snprintf(entry, sizeof(entry), " %s %.1f", BlurTunerCpuLevels[i].name, lastMs[i]);
+				measured += entry;
+				if (i < tuner.current && lastMs[i] < budgetMs * loopConfig.lowWater)
+					ok = false;
+			}
+		}
+		printf("%10.1f %-12s %10.2f %6llu %6llu%s %s\n", budgetMs, BlurTunerCurrent(tuner).name, lastMs[tuner.current],
+			   (unsigned long long)tuner.movesDown, (unsigned long long)tuner.movesUp, measured.c_str(), CheckResult(ok));
+	}
+
+	CpuTiledBlurStop(blur);
+}
+
+enum RadiusMapShape
+{
+	RadiusMap_Zero,
+	RadiusMap_Full,
+	RadiusMap_Ramp,	   // Sharp on the left to the full radius on the right, a progressive panel edge
+	RadiusMap_Noise,
+	RadiusMap_Radial,
+};
+
+static const char* const RadiusMapNames[] = { "zero", "full", "ramp", "noise", "radial" };
+
+// Coverage in R and the radius in G, the mask texture with a second channel
+static void MakeRadiusMask(std::vector<uint8_t>& rg, int width, int height, RadiusMapShape shape, bool feathered)
+{
+	rg.resize((size_t)width * height * 2);
+	uint32_t seed = 777;
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			uint8_t* pixel = &rg[((size_t)y * width + x) * 2];
+			seed = seed * 1664525u + 1013904223u;
+			pixel[0] = 255;
+			if (feathered)
+				pixel[0] = x < width / 8 ? 0 : (y < height / 4 ? (uint8_t)(y * 255 / (height / 4)) : 255);
+
+			switch (shape)
+			{
+			case RadiusMap_Zero: pixel[1] = 0; break;
+			case RadiusMap_Full: pixel[1] = 255; break;
+			case RadiusMap_Ramp: pixel[1] = (uint8_t)(x * 255 / std::max(width - 1, 1)); break;
+			case RadiusMap_Noise: pixel[1] = (uint8_t)(seed >> 24); break;
+			case RadiusMap_Radial:
+			{
+				const double dx = x - width * 0.5, dy = y - height * 0.5;
+				pixel[1] = (uint8_t)std::min(255.0, 255.0 * sqrt(dx * dx + dy * dy) / (0.5 * std::max(width, height)));
+				break;
+			}
+			}
+		}
+	}
+}
+
+// One pixel of a clamp-to-edge box, summed tap by tap
+static void BruteBoxPixel(const BenchImage& image, int x, int y, int radius, uint8_t* out)
+{
+	uint32_t sum[4] = {};
+	for (int dy = -radius; dy <= radius; ++dy)
+	{
+		const uint8_t* row = &image.input[(size_t)CpuBlurClamp(y + dy, 0, image.height - 1) * image.width * 4];
+		for (int dx = -radius; dx <= radius; ++dx)
+		{
+			const uint8_t* pixel = row + (size_t)CpuBlurClamp(x + dx, 0, image.width - 1) * 4;
+			for (int c = 0; c < 4; ++c)
+				sum[c] += pixel[c];
+		}
+	}
+	CpuBlurResolvePixel(sum, (uint64_t)(2 * radius + 1) * (2 * radius + 1), 255, out);
+}
+
+// Summed-area tables against tap-by-tap sums and the box kernels, then progressive blur cost
+static void BenchSummedArea(int threads, int frames)
+{
+	struct Case
+	{
+		int width;
+		int height;
+		float radius;
+	};
+	static const Case Cases[] = { { 257, 193, 1.0f }, { 257, 193, 13.0f }, { 301, 211, 40.0f }, { 96, 72, 100.0f } };
+
+	std::vector<CpuSummedAreaScratch> scratch;
+	std::vector<uint8_t> rg;
+	printf("Summed-area blur vs tap-by-tap sums, radius from the mask's second channel\n");
+	printf("%-10s %8s %-8s %10s %8s %8s\n", "size", "radius", "map", "feathered", "differ", "ok");
+	for (const Case& test : Cases)
+	{
+		BenchImage image;
+		MakeBenchImage(image, test.width, test.height);
+		std::vector<uint8_t> reference(image.output.size());
+		BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, test.radius, 0.0f };
+		CpuImage input = { image.input.data(), image.width * 4 };
+		CpuImage output = { image.output.data(), image.width * 4 };
+		CpuImage referenceImage = { reference.data(), image.width * 4 };
+
+		for (int shape = 0; shape <= RadiusMap_Radial; ++shape)
+		{
+			for (bool feathered : { false, true })
+			{
+				MakeRadiusMask(rg, image.width, image.height, (RadiusMapShape)shape, feathered);
+				CpuMask mask = { rg.data(), image.width * 2, 2 };
+				CpuMask radiusMap = { rg.data() + 1, image.width * 2, 2 };
+
+				CpuVariableBoxBlurReference(input, mask, radiusMap, referenceImage, constants);
+				CpuSummedAreaBlur(input, mask, radiusMap, output, constants, scratch);
+				const int diffs = CountImageDiffs(image.output, reference);
+
+				char size[32];
+				snprintf(size, sizeof(size), "%dx%d", image.width, image.height);
+				printf("%-10s %8.0f %-8s %10s %8d %8s\n", size, test.radius, RadiusMapNames[shape], feathered ? "yes" : "no", diffs,
+					   CheckResult(!diffs));
+			}
+		}
+	}
+
+	// A map that is full everywhere is the plain box blur, bit for bit
+	BenchImage large;
+	MakeBenchImage(large, 1920, 1080);
+	CpuImage largeInput = { large.input.data(), large.width * 4 };
+	CpuImage largeOutput = { large.output.data(), large.width * 4 };
+	CpuMask largeMask = { large.mask.data() + 3, large.width * 4, 4 };
+	std::vector<uint8_t> boxOutput(large.output.size());
+	CpuImage boxImage = { boxOutput.data(), large.width * 4 };
+	const CpuMask fullRadius = { nullptr, 0, 0 };
+
+	CpuTiledBlur blur;
+	CpuTiledBlurStart(blur, threads);
+	for (float radius : { 13.0f, 64.0f })
+	{
+		BlurConstants constants = { (uint32_t)large.width, (uint32_t)large.height, radius, 0.0f };
+		CpuTiledBlurRun(blur, largeInput, largeMask, boxImage, constants);
+		CpuSummedAreaBlur(largeInput, largeMask, fullRadius, largeOutput, constants, scratch, &blur.pool);
+		const int diffs = CountImageDiffs(large.output, boxOutput);
+		printf("%dx%d full map, radius %.0f, against the box kernel: %d differ %s\n", large.width, large.height, radius, diffs,
+			   CheckResult(!diffs));
+	}
+
+	// 8K rows under a radius whose table is past 2^32 for the bright pixels, sampled
+	{
+		BenchImage huge;
+		MakeBenchImage(huge, 7680, 4320);
+		for (uint8_t& value : huge.input)
+			value = (uint8_t)(240 + (value & 15));
+		CpuImage hugeInput = { huge.input.data(), huge.width * 4 };
+		CpuImage hugeOutput = { huge.output.data(), huge.width * 4 };
+		BlurConstants constants = { (uint32_t)huge.width, (uint32_t)huge.height, 1200.0f, 0.0f };
+		const BlurRect rows = { 0, 2000, huge.width, 2064 };
+		CpuSummedAreaScratch hugeScratch;
+		CpuSummedAreaBlurRect(hugeInput, CpuMask{}, fullRadius, hugeOutput, constants, rows, hugeScratch);
+
+		const double tableSum = (double)huge.width * (rows.bottom - rows.top + 2400) * 240;
+		int diffs = 0;
+		for (int i = 0; i < 32; ++i)
+		{
+			const int x = i < 4 ? (i & 1) * (huge.width - 1) : (i * 2417) % huge.width;
+			const int y = rows.top + (i * 37) % (rows.bottom - rows.top);
+			uint8_t expected[4];
+			BruteBoxPixel(huge, x, y, 1200, expected);
+			diffs += memcmp(expected, &huge.output[((size_t)y * huge.width + x) * 4], 4) != 0;
+		}
+		printf("%dx%d, radius 1200, table sums past %.1fx 2^32: %d of 32 sampled pixels differ %s\n", huge.width, huge.height,
+			   tableSum / 4294967296.0, diffs, CheckResult(!diffs));
+	}
+
+	// A ramp needs one box pass per radius it holds without the tables, each as costly as one pass
+	printf("Progressive blur, ramp map (%d threads, %d frames)\n", ThreadPoolWorkerCount(blur.pool), frames);
+	printf("%-12s %8s %12s %12s %16s %8s\n", "resolution", "radius", "summed ms", "box pass ms", "pass per radius", "speedup");
+	for (int r = 1; r < 3; ++r)
+	{
+		BenchImage image;
+		MakeBenchImage(image, Resolutions[r][0], Resolutions[r][1]);
+		CpuImage input = { image.input.data(), image.width * 4 };
+		CpuImage output = { image.output.data(), image.width * 4 };
+		MakeRadiusMask(rg, image.width, image.height, RadiusMap_Ramp, false);
+		CpuMask mask = { rg.data(), image.width * 2, 2 };
+		CpuMask radiusMap = { rg.data() + 1, image.width * 2, 2 };
+
+		for (float radius : { 16.0f, 64.0f })
+		{
+			BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, radius, 0.0f };
+			CpuSummedAreaBlur(input, mask, radiusMap, output, constants, scratch, &blur.pool);
+			double start = NowMs();
+			for (int frame = 0; frame < frames; ++frame)
+				CpuSummedAreaBlur(input, mask, radiusMap, output, constants, scratch, &blur.pool);
+			const double summedMs = (NowMs() - start) / frames;
+
+			start = NowMs();
+			for (int frame = 0; frame < frames; ++frame)
+				CpuTiledBlurRun(blur, input, mask, output, constants);
+			const double boxMs = (NowMs() - start) / frames;
+
+			const double passesMs = boxMs * ((int)radius + 1);
+			char name[32];
+			snprintf(name, sizeof(name), "%dx%d", image.width, image.height);
+			printf("%-12s %8.0f %12.3f %12.3f %16.1f %7.1fx\n", name, radius, summedMs, boxMs, passesMs, passesMs / summedMs);
+		}
+	}
+	CpuTiledBlurStop(blur);
+}
+
+// Planar layout: conversions round-trip, the plane blur matches the interleaved kernels bit for
+// bit, then both layouts timed across radii
+static void BenchPlanar(int threads, int frames)
+{
+	// Deinterleave then interleave, whole images and an odd rect, then only alpha over a
+	// buffer whose colors have to stay as they were
+	for (const int* size : { Resolutions[0], (const int*)nullptr })
+	{
+		const int width = size ? size[0] : 37, height = size ? size[1] : 5;
+		BenchImage image;
+		MakeBenchImage(image, width, height);
+		CpuImage input = { image.input.data(), width * 4 };
+		CpuImage output = { image.output.data(), width * 4 };
+		CpuPlanarImage planes = {};
+		CpuPlanarResize(planes, width, height);
+
+		std::fill(image.output.begin(), image.output.end(), 0);
+		CpuPlanarDeinterleave(input, planes, BlurRect{ 0, 0, width, height });
+		CpuPlanarInterleave(planes, output, BlurRect{ 0, 0, width, height });
+		int diffs = CountImageDiffs(image.output, image.input);
+
+		const BlurRect rect = { 3, 1, width - 2, height - 1 };
+		std::fill(image.output.begin(), image.output.end(), 0x55);
+		CpuPlanarDeinterleave(input, planes, rect, CpuPlanar_A);
+		CpuPlanarInterleave(planes, output, rect, CpuPlanar_A);
+		int alphaDiffs = 0;
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				const size_t i = ((size_t)y * width + x) * 4;
+				const bool inside = x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom;
+				alphaDiffs += image.output[i] != 0x55 || image.output[i + 1] != 0x55 || image.output[i + 2] != 0x55 ||
+							  image.output[i + 3] != (inside ? image.input[i + 3] : 0x55);
+			}
+		}
+		printf("%dx%d round trip: %d differ, alpha only in a rect: %d differ %s\n", width, height, diffs, alphaDiffs,
+			   CheckResult(!diffs && !alphaDiffs));
+	}
+
+	// Feathered mask: empty, partial and full coverage. Radius 128 is the last the u16 column
+	// sums hold; 129 is refused.
+	std::vector<uint8_t> rg;
+	printf("Planar box blur vs CpuBoxBlur\n");
+	printf("%-10s %8s %10s %10s %10s %8s\n", "size", "radius", "image", "rect", "alpha only", "ok");
+	CpuBlurScratch blurScratch;
+	CpuPlanarBlur planar;
+	for (const int* size : { Resolutions[0], (const int*)nullptr })
+	{
+		const int width = size ? size[0] : 301, height = size ? size[1] : 211;
+		BenchImage image;
+		MakeBenchImage(image, width, height);
+		MakeRadiusMask(rg, width, height, RadiusMap_Ramp, true);
+		std::vector<uint8_t> reference(image.output.size());
+		CpuImage input = { image.input.data(), width * 4 };
+		CpuImage output = { image.output.data(), width * 4 };
+		CpuImage referenceImage = { reference.data(), width * 4 };
+		CpuMask mask = { rg.data(), width * 2, 2 };
+
+		for (float radius : { 0.0f, 1.0f, 4.0f, 13.0f, 40.0f, 128.0f })
+		{
+			BlurConstants constants = { (uint32_t)width, (uint32_t)height, radius, 0.0f };
+			CpuBoxBlur(input, mask, referenceImage, constants, blurScratch);
+			CpuPlanarBoxBlur(input, mask, output, constants, planar);
+			const int imageDiffs = CountImageDiffs(image.output, reference);
+
+			// A rect of the planes, then alpha alone: the color planes keep what they had
+			const BlurRect rect = { width / 3, height / 4, width / 3 + 77, height / 4 + 50 };
+			std::fill(planar.output.storage.begin(), planar.output.storage.end(), 0);
+			CpuPlanarBoxBlurRect(planar.input, mask, planar.output, constants, rect, planar.scratch[0]);
+			int rectDiffs = 0;
+			for (int y = 0; y < height; ++y)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					const bool inside = x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom;
+					for (int c = 0; c < 4; ++c)
+						rectDiffs += planar.output.planes[c][(size_t)y * planar.output.rowPitch + x] !=
+									 (inside ? reference[((size_t)y * width + x) * 4 + c] : 0);
+				}
+			}
+
+			std::fill(planar.output.storage.begin(), planar.output.storage.end(), 0x55);
+			CpuPlanarBoxBlurRun(planar.input, mask, planar.output, constants, planar.scratch, nullptr, CpuPlanar_A);
+			int alphaDiffs = 0;
+			for (int y = 0; y < height; ++y)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					const size_t i = (size_t)y * planar.output.rowPitch + x;
+					alphaDiffs += planar.output.planes[0][i] != 0x55 || planar.output.planes[2][i] != 0x55 ||
+								  planar.output.planes[3][i] != reference[((size_t)y * width + x) * 4 + 3];
+				}
+			}
+
+			char name[32];
+			snprintf(name, sizeof(name), "%dx%d", width, height);
+			const bool ok = !imageDiffs && !rectDiffs && !alphaDiffs;
+			printf("%-10s %8.0f %10d %10d %10d %8s\n", name, radius, imageDiffs, rectDiffs, alphaDiffs, CheckResult(ok));
+		}
+
+		BlurConstants constants = { (uint32_t)width, (uint32_t)height, 129.0f, 0.0f };
+		const bool refused = !CpuPlanarBoxBlur(input, mask, output, constants, planar);
+		printf("%-10s %8d refused: %s\n", "", 129, CheckResult(refused));
+	}
+
+	// Interleaved: the tiled box kernels. Planar: deinterleave, blur, interleave. Planes, alpha
+	// and color: the blur alone, on planes already converted.
+	CpuTiledBlur blur;
+	CpuTiledBlurStart(blur, threads);
+	ThreadPool* pool = &blur.pool;
+	printf("Interleaved vs planar box blur, full mask (%d threads, %d frames)\n", ThreadPoolWorkerCount(blur.pool), frames);
+	printf("%-12s %6s %12s %10s %10s %10s %10s %10s %8s\n", "resolution", "radius", "interleaved", "planar", "planes", "alpha",
+		   "color", "convert", "speedup");
+	for (int r = 1; r < 3; ++r)
+	{
+		BenchImage image;
+		MakeBenchImage(image, Resolutions[r][0], Resolutions[r][1]);
+		CpuImage input = { image.input.data(), image.width * 4 };
+		CpuImage output = { image.output.data(), image.width * 4 };
+		CpuMask mask = { image.mask.data() + 3, image.width * 4, 4 };
+		const BlurRect whole = { 0, 0, image.width, image.height };
+
+		for (float radius : { 1.0f, 4.0f, 13.0f, 32.0f, 64.0f, 128.0f })
+		{
+			BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, radius, 0.0f };
+			auto time = [&](const std::function<void()>& run) {
+				run();
+				const double start = NowMs();
+				for (int frame = 0; frame < frames; ++frame)
+					run();
+				return (NowMs() - start) / frames;
+			};
+
+			const double interleavedMs = time([&] { CpuTiledBlurRun(blur, input, mask, output, constants); });
+			const double planarMs = time([&] { CpuPlanarBoxBlur(input, mask, output, constants, planar, pool); });
+			const double planesMs = time([&] {
+				CpuPlanarBoxBlurRun(planar.input, mask, planar.output, constants, planar.scratch, pool);
+			});
+			const double alphaMs = time([&] {
+				CpuPlanarBoxBlurRun(planar.input, mask, planar.output, constants, planar.scratch, pool, CpuPlanar_A);
+			});
+			const double colorMs = time([&] {
+				CpuPlanarBoxBlurRun(planar.input, mask, planar.output, constants, planar.scratch, pool, CpuPlanar_Color);
+			});
+			const double convertMs = time([&] {
+				CpuPlanarDeinterleave(input, planar.input, whole);
+				CpuPlanarInterleave(planar.output, output, whole);
+			});
+
+			char name[32];
+			snprintf(name, sizeof(name), "%dx%d", image.width, image.height);
+			printf("%-12s %6.0f %12.3f %10.3f %10.3f %10.3f %10.3f %10.3f %7.2fx\n", name, radius, interleavedMs, planarMs,
+				   planesMs, alphaMs, colorMs, convertMs, interleavedMs / planarMs);
+		}
+	}
+	CpuTiledBlurStop(blur);
+}
+
+static void ParseList(const char* text, std::vector<int>& first, std::vector<int>* second = nullptr)
+{
+	first.clear();
+	if (second) second->clear();
+
+	while (text && *text)
+	{
+		char* end = nullptr;
+		first.push_back((int)strtol(text, &end, 10));
+		if (second)
+			second->push_back(*end == 'x' ? (int)strtol(end + 1, &end, 10) : first.back());
+		text = *end == ',' ? end + 1 : nullptr;
+	}
+}
+
+// Mask covering `percent` of the pixels, each row covered from the left like the edge of a window shape
+static void MakeCoverageMask(BenchImage& image, int percent)
+{
+	for (int y = 0; y < image.height; ++y)
+	{
+		int covered = (int)(((int64_t)image.width * percent + 50) / 100);
+		for (int x = 0; x < image.width; ++x)
+			image.mask[((size_t)y * image.width + x) * 4 + 3] = x < covered ? 255 : 0;
+	}
+}
+
+static double Percentile(std::vector<double> values, double percentile)
+{
+	std::sort(values.begin(), values.end());
+	size_t index = (size_t)(percentile / 100.0 * (values.size() - 1) + 0.5);
+	return values[std::min(index, values.size() - 1)];
+}
+
+// Bytes one frame moves through memory: every tile reads its input with the radius halo,
+// writes and reads back 16-byte row sums, reads the mask and writes the output,
+// then the composite reads desktop and blurred and writes the back buffer
+static uint64_t BytesTouched(const CpuTiledBlur& blur, const BlurConstants& constants)
+{
+	const int radius = CpuBlurRadius(constants);
+	uint64_t bytes = 0;
+	for (int tile = 0; tile < CpuTiledBlurTileCount(blur, constants); ++tile)
+	{
+		BlurRect rect = CpuTiledBlurTileRect(blur, constants, tile);
+		uint64_t width = rect.right - rect.left;
+		uint64_t height = rect.bottom - rect.top;
+		uint64_t haloWidth = std::min(rect.right + radius, (int)constants.textureWidth) - std::max(rect.left - radius, 0);
+		uint64_t haloHeight = std::min(rect.bottom + radius, (int)constants.textureHeight) - std::max(rect.top - radius, 0);
+
+		bytes += haloWidth * haloHeight * 4;
+		bytes += width * haloHeight * 16 * 2;
+		bytes += width * height * 4 * 2;
+	}
+	return bytes + (uint64_t)constants.textureWidth * constants.textureHeight * 4 * 3;
+}
+
+struct SuiteResult
+{
+	int width;
+	int height;
+	int radius;
+	int coverage;
+	int threads;
+	double megapixelsPerSecond;
+	double p50Ms;
+	double p99Ms;
+	double blurP50Ms;
+	double compositeP50Ms;
+	uint64_t bytesTouched;
+};
+
+static void WriteSuiteJson(const char* path, const std::vector<SuiteResult>& results, int frames, int tileSize)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+	{
+		printf("Could not write %s\n", path);
+		return;
+	}
+
+	// One result per line so two runs diff line by line
+	fprintf(file, "{\n  \"frames\": %d,\n  \"tile\": %d,\n  \"results\": [\n", frames, tileSize);
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const SuiteResult& result = results[i];
+		fprintf(file, "    { \"width\": %d, \"height\": %d, \"radius\": %d, \"coverage\": %d, \"threads\": %d, "
+				"\"mpixels_per_s\": %.1f, \"p50_ms\": %.3f, \"p99_ms\": %.3f, \"blur_p50_ms\": %.3f, "
+				"\"composite_p50_ms\": %.3f, \"bytes_touched\": %llu }%s\n",
+				result.width, result.height, result.radius, result.coverage, result.threads,
+				result.megapixelsPerSecond, result.p50Ms, result.p99Ms, result.blurP50Ms,
+				result.compositeP50Ms, (unsigned long long)result.bytesTouched, i + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+	fclose(file);
+}
+
+// The CPU side of ApplyBlurEffect + RenderBlurQuad per frame: the masked tiled blur, then
+// the color-keyed composite over the desktop, swept over sizes, radii, coverage and threads
+static void BenchSuite(const char* sizes, const char* radii, const char* coverages, const char* threadCounts,
+					   int tileSize, int frames, const char* jsonPath)
+{
+	std::vector<int> widths, heights, radiusList, coverageList, threadList;
+	ParseList(sizes, widths, &heights);
+	ParseList(radii, radiusList);
+	ParseList(coverages, coverageList);
+	ParseList(threadCounts, threadList);
+
+	printf("Blur + composite suite (tile %dx%d, %d frames)\n", tileSize, tileSize, frames);
+	printf("%-12s %6s %8s %8s %10s %10s %10s %10s %12s %10s\n", "resolution", "radius", "coverage", "threads",
+		   "MP/s", "p50 ms", "p99 ms", "blur ms", "composite ms", "MB/frame");
+
+	std::vector<SuiteResult> results;
+	for (int threads : threadList)
+	{
+		CpuTiledBlur blur;
+		CpuTiledBlurStart(blur, threads, tileSize, tileSize);
+
+		for (size_t size = 0; size < widths.size(); ++size)
+		{
+			BenchImage image;
+			MakeBenchImage(image, widths[size], heights[size]);
+			std::vector<uint8_t> backBuffer(image.output.size());
+
+			CpuImage input = { image.input.data(), image.width * 4 };
+			CpuImage output = { image.output.data(), image.width * 4 };
+			CpuImage composite = { backBuffer.data(), image.width * 4 };
+			CpuMask mask = { image.mask.data() + 3, image.width * 4, 4 };
+
+			for (int coverage : coverageList)
+			{
+				MakeCoverageMask(image, coverage);
+
+				for (int radius : radiusList)
+				{
+					BlurConstants constants = { (uint32_t)image.width, (uint32_t)image.height, (float)radius, 0.0f };
+					const int tiles = CpuTiledBlurTileCount(blur, constants);
+
+					std::vector<double> frameMs, blurMs, compositeMs;
+					for (int frame = 0; frame <= frames; ++frame)
+					{
+						double start = NowMs();
+						CpuTiledBlurRun(blur, input, mask, output, constants);
+						double blurred = NowMs();
+						ThreadPoolParallelFor(blur.pool, tiles, [&](int tile, int worker) {
+							CpuCompositeRect(input, output, composite, constants, CpuTiledBlurTileRect(blur, constants, tile));
+						});
+						double end = NowMs();
+
+						// Frame 0 warms up the scratch buffers
+						if (frame == 0) continue;
+						frameMs.push_back(end - start);
+						blurMs.push_back(blurred - start);
+						compositeMs.push_back(end - blurred);
+					}
+
+					SuiteResult result;
+					result.width = image.width;
+					result.height = image.height;
+					result.radius = radius;
+					result.coverage = coverage;
+					result.threads = ThreadPoolWorkerCount(blur.pool);
+					result.p50Ms = Percentile(frameMs, 50.0);
+					result.p99Ms = Percentile(frameMs, 99.0);
+					result.blurP50Ms = Percentile(blurMs, 50.0);
+					result.compositeP50Ms = Percentile(compositeMs, 50.0);
+					result.megapixelsPerSecond = (double)image.width * image.height / 1.0e6 / (result.p50Ms / 1000.0);
+					result.bytesTouched = BytesTouched(blur, constants);
+					results.push_back(result);
+
+					char name[32];
+					snprintf(name, sizeof(name), "%dx%d", image.width, image.height);
+					printf("%-12s %6d %7d%% %8d %10.1f %10.3f %10.3f %10.3f %12.3f %10.1f\n", name, radius, coverage,
+						   result.threads, result.megapixelsPerSecond, result.p50Ms, result.p99Ms, result.blurP50Ms,
+						   result.compositeP50Ms, result.bytesTouched / (1024.0 * 1024.0));
+				}
+			}
+		}
+
+		CpuTiledBlurStop(blur);
+	}
+
+	if (jsonPath)
+		WriteSuiteJson(jsonPath, results, frames, tileSize);
+}
+
+int main(int argc, char** argv)
+{
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	int tileSize = CpuBlurGroupSize * CpuBlurDefaultTileGroups;
+	float radius = 13.0f;
+	int frames = 10;
+	const char* section = "all";
+	const char* sourceSpec = nullptr;
+	const char* sizes = "800x600,1920x1080,3840x2160,7680x4320";
+	const char* radii = "1,4,13,32,64";
+	const char* coverages = "0,50,100";
+	const char* threadCounts = nullptr;
+	const char* jsonPath = nullptr;
+	const char* tracePath = nullptr;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (!strcmp(argv[i], "--threads")) maxThreads = std::max(1, atoi(argv[i + 1]));
+		else if (!strcmp(argv[i], "--tile")) tileSize = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "--radius")) radius = (float)atof(argv[i + 1]);
+		else if (!strcmp(argv[i], "--frames")) frames = std::max(1, atoi(argv[i + 1]));
+		else if (!strcmp(argv[i], "--section")) section = argv[i + 1];
+		else if (!strcmp(argv[i], "--source")) sourceSpec = argv[i + 1];
+		else if (!strcmp(argv[i], "--sizes")) sizes = argv[i + 1];
+		else if (!strcmp(argv[i], "--radii")) radii = argv[i + 1];
+		else if (!strcmp(argv[i], "--coverage")) coverages = argv[i + 1];
+		else if (!strcmp(argv[i], "--thread-counts")) threadCounts = argv[i + 1];
+		else if (!strcmp(argv[i], "--json")) jsonPath = argv[i + 1];
+		else if (!strcmp(argv[i], "--trace")) tracePath = argv[i + 1];
+	}
+
+	// The suite compares one thread with all of them unless told otherwise
+	char defaultThreadCounts[32];
+	snprintf(defaultThreadCounts, sizeof(defaultThreadCounts), "1,%d", maxThreads);
+	if (!threadCounts) threadCounts = maxThreads > 1 ? defaultThreadCounts : "1";
+
+	bool all = !strcmp(section, "all");
+	if (all || !strcmp(section, "reference")) BenchReference();
+	if (all || !strcmp(section, "scaling")) BenchThreadScaling(maxThreads, tileSize, radius, frames);
+	if (all || !strcmp(section, "kawase")) BenchKawase(frames);
+	if (all || !strcmp(section, "kernels")) BenchKernels(frames);
+	if (all || !strcmp(section, "dirty")) BenchDirtyRegions(radius, frames);
+	if (all || !strcmp(section, "pipeline")) BenchPipeline(sourceSpec, radius, frames);
+	if (all || !strcmp(section, "trace")) BenchTrace(tracePath, radius, frames);
+	if (all || !strcmp(section, "mask")) BenchMask(frames);
+	if (all || !strcmp(section, "sparse")) BenchSparseTiles(maxThreads, tileSize, radius, frames);
+	if (all || !strcmp(section, "iir")) BenchIirGaussian(maxThreads, frames);
+	if (all || !strcmp(section, "cache")) BenchBlurCache(maxThreads, radius, frames);
+	if (all || !strcmp(section, "scheduler")) BenchScheduler();
+	if (all || !strcmp(section, "pipelined")) BenchPipelined(sourceSpec, maxThreads, radius, frames);
+	if (all || !strcmp(section, "outputs")) BenchDesktopLayout(radius, frames);
+	if (all || !strcmp(section, "regions")) BenchBlurRegions(maxThreads, radius, frames);
+	if (all || !strcmp(section, "pool")) BenchResourcePool();
+	if (all || !strcmp(section, "fixed")) BenchFixedPoint(frames);
+	if (all || !strcmp(section, "shadercache")) BenchShaderCache();
+	if (all || !strcmp(section, "effects")) BenchEffectChain(maxThreads, frames);
+	if (all || !strcmp(section, "views")) BenchImageViews(maxThreads, frames);
+	if (all || !strcmp(section, "recording")) BenchRecording(frames);
+	if (all || !strcmp(section, "tuner")) BenchTuner(maxThreads, radius, frames);
+	if (all || !strcmp(section, "sat")) BenchSummedArea(maxThreads, frames);
+	if (all || !strcmp(section, "planar")) BenchPlanar(maxThreads, frames);
+	if (!strcmp(section, "suite") || jsonPath) BenchSuite(sizes, radii, coverages, threadCounts, tileSize, frames, jsonPath);
+
+	if (g_BenchFailures)
+		printf("%d checks FAILED\n", g_BenchFailures);
+	return g_BenchFailures ? 1 : 0;
+}
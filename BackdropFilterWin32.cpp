@@ -3,14 +3,65 @@
 #include <d3d11.h>
 #include <dxgi.h>
 #include <dxgi1_2.h>
+#include <stdio.h>
 #include <algorithm>
+#include <vector>
 
 #include <d3dcompiler.h>
 
+#include "CpuBlur.h"
+#include "CpuBlurTiled.h"
+#include "CpuKawase.h"
+#include "CpuIirGaussian.h"
+#include "CpuPlanar.h"
+#include "BlurKernels.h"
+#include "DesktopLayout.h"
+#include "DirtyRegion.h"
+#include "EffectChain.h"
+#include "ImageView.h"
+#include "BlurCache.h"
+#include "BlurTuner.h"
+#include "CaptureRecording.h"
+#include "FrameScheduler.h"
+#include "MaskLayer.h"
+#include "MaskTiles.h"
+#include "FrameSource.h"
+#include "FrameSourceDxgi.h"
+#include "ResourcePoolD3D11.h"
+#include "ShaderCacheD3D.h"
+#include "Trace.h"
+
 #pragma comment(lib, "d3dcompiler.lib")
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
 
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// WM_TIMER that keeps frames coming while a move or resize runs its modal loop
+static const UINT_PTR SchedulerTimerId = 1;
+
+enum BlurMode
+{
+	BlurMode_Box,		  // computeShaderSource
+	BlurMode_DualKawase,  // kawaseDownsampleShaderSource + kawaseUpsampleShaderSource
+	BlurMode_RecursiveGaussian,	 // iirRowShaderSource + iirColumnShaderSource
+};
+
+// A GPU blur timing in flight, it comes back a few frames later for the level it was taken on
+struct TunerQuery
+{
+	ID3D11Query* disjoint;
+	ID3D11Query* begin;
+	ID3D11Query* end;
+	int level;
+	uint64_t pixels;
+	bool pending;
+};
+
+static const int TunerQueryCount = 4;
+
 struct Application
 {
 	HWND hwnd;
@@ -25,6 +76,10 @@ struct Application
 	int windowHeight;
 	bool isRunning;
 
+	// When the loop wakes and what it does then, see FrameScheduler.h
+	FrameScheduler scheduler;
+	HANDLE schedulerTimer;
+
 	// Add these to your Application struct:
 	ID3D11Buffer* vertexBuffer;
 	ID3D11VertexShader* vertexShader;
@@ -39,7 +94,26 @@ struct Application
 	ID3D11SamplerState* samplerState;
 
 	// Add to Application struct:
-	IDXGIOutputDuplication* desktopDuplication;
+	// One duplication per output. Each output's last frame is kept in outputTextures, so a
+	// window moving over an output that shows nothing new still gets its pixels.
+	std::vector<DxgiFrameSource*> desktopSources;
+	std::vector<DesktopOutput> desktopOutputs;
+	std::vector<ID3D11Texture2D*> outputTextures;
+	std::vector<DesktopCopy> desktopCopies;
+	std::vector<BlurRect> desktopUncovered;
+	std::vector<uint8_t> zeroPixels;  // Uploaded where no output covers the window
+	BlurRect assembledRect;			  // Window rect desktopTexture was last assembled for
+	FrameSource* frameSource;		  // Set by --source instead of the duplications
+	ID3D11Device* captureDevice;	  // On WARP: duplicates an output of another adapter for frameSource
+	Frame frame;
+
+	// --record <path>: every captured frame goes into a recording, see CaptureRecording.h.
+	// Duplications are read back through recordStagingTexture, output 0 only. The recording
+	// thread writes them, frames it falls behind on are dropped and counted.
+	char recordPath[MAX_PATH];
+	RecordingThread recording;
+	ID3D11Texture2D* recordStagingTexture;
+	Frame recordFrame;  // Output-local copy of the duplication's rects
 	ID3D11Texture2D* desktopTexture;
 	ID3D11ShaderResourceView* desktopSRV;
 	ID3D11RenderTargetView* desktopRTV;
@@ -52,14 +126,114 @@ struct Application
 	ID3D11RenderTargetView* blurOutputRTV;
 	ID3D11Buffer* blurConstantBuffer;
 
-	// Mask texture resources
+	// Mask texture resources, R8 coverage uploaded from maskLayer when a shape changes
 	ID3D11Texture2D* maskTexture;
 	ID3D11ShaderResourceView* maskSRV;
-	ID3D11RenderTargetView* maskRTV;
+	MaskLayer maskLayer;
+	MaskShapeId maskTriangle;
+
+	// Mask-aware dispatch: one group per 8x8 tile of the lists instead of the whole window.
+	// Full tiles skip the mask, cleared tiles are dispatched once with the masked variant.
+	MaskTileMap maskTiles;
+	ID3D11ComputeShader* partialTileShader;	 // computeShaderSource with SPARSE_TILES
+	ID3D11ComputeShader* fullTileShader;	 // ... and FULL_TILES
+	ID3D11ComputeShader* specializedPartialTileShader;
+	ID3D11ComputeShader* specializedFullTileShader;
+	ID3D11Buffer* fullTileBuffer;
+	ID3D11Buffer* partialTileBuffer;
+	ID3D11Buffer* clearedTileBuffer;
+	ID3D11ShaderResourceView* fullTileSRV;
+	ID3D11ShaderResourceView* partialTileSRV;
+	ID3D11ShaderResourceView* clearedTileSRV;
+
+	// Dual-Kawase blur resources, level 0 is desktopTexture
+	ID3D11ComputeShader* kawaseDownsampleShader;
+	ID3D11ComputeShader* kawaseUpsampleShader;
+	ID3D11Buffer* kawaseConstantBuffer;
+	ID3D11Texture2D* kawaseLevelTextures[CpuKawaseMaxLevels + 1];
+	ID3D11ShaderResourceView* kawaseLevelSRVs[CpuKawaseMaxLevels + 1];
+	ID3D11UnorderedAccessView* kawaseLevelUAVs[CpuKawaseMaxLevels + 1];
+
+	// Recursive Gaussian resources, the rows pass leaves W*H floats for the columns pass
+	ID3D11ComputeShader* iirRowShader;
+	ID3D11ComputeShader* iirColumnShader;
+	ID3D11Buffer* iirConstantBuffer;
+	ID3D11Buffer* iirRowBuffer;
+	ID3D11UnorderedAccessView* iirRowUAV;
+
+	BlurMode blurMode;
+
+	// Unrolled variant of the blur for one radius, see GenerateBlurKernelHlsl
+	BlurKernelType blurKernel;
+	ID3D11ComputeShader* specializedBlurShader;
+	int specializedBlurRadius;
+
+	// --acrylic: saturation, tint and grain fused into the blur, see EffectChain.h
+	bool useEffectChain;
+	EffectProgram effectProgram;
+
+	// --tune <ms>: the blur level whose cost fits the budget, see BlurTuner.h
+	bool useTuner;
+	BlurTuner tuner;
+	TunerQuery tunerQueries[TunerQueryCount];
+	int tunerQueryNext;
+
+	// What changed behind the window since the last blur, from the frame metadata
+	DirtyRegionTracker dirtyTracker;
+	DirtyRegion dirtyRegion;
+
+	// Blurred outputs by content, for repaints that didn't change any pixels. contentHash is
+	// the last grab's when it came from memory, GPU-only frames are hashed by the CPU blur.
+	BlurCache blurCache;
+	ID3D11Texture2D* blurCacheTextures[BlurCacheMaxEntries];
+	std::vector<uint64_t> contentTileHashes;
+	uint64_t contentHash;
+	bool contentHashed;
+
+	// Chrome trace written on F12 and on exit, empty when tracing is off
+	char tracePath[MAX_PATH];
+
+	// CPU blur fallback, used when no hardware device is available
+	bool useCpuBlur;
+	ID3D11Texture2D* desktopStagingTexture;
+	CpuTiledBlur cpuBlur;
+	CpuKawaseScratch cpuKawaseScratch;
+	CpuIirScratch cpuIirScratch;
+	std::vector<uint8_t> cpuBlurOutput;
+
+	// --planar: full-frame box blurs through one plane per channel, see CpuPlanar.h
+	bool usePlanar;
+	CpuPlanarBlur cpuPlanarBlur;
+
+	// Window-sized textures and buffers come from the pool. They can be larger than the
+	// window, only the top-left windowWidth x windowHeight of them is used.
+	ResourcePool resourcePool;
+	D3D11ResourceAllocator poolAllocator;
+
+	// Compiled shaders from earlier launches, next to the executable
+	ShaderCache shaderCache;
+	D3DShaderCompiler shaderCompiler;
+	char shaderCachePath[MAX_PATH];
+	PoolLease desktopLease;
+	PoolLease maskLease;
+	PoolLease blurLease;
+	PoolLease stagingLease;
+	PoolLease blurCacheLeases[BlurCacheMaxEntries];
+	PoolLease kawaseLeases[CpuKawaseMaxLevels + 1];
+	PoolLease iirRowLease;
+	PoolLease fullTileLease;
+	PoolLease partialTileLease;
+	PoolLease clearedTileLease;
+	float quadUvScale[2];  // What quadVertexBuffer's UVs reach to
 };
 
 static Application g_Application = {};
 
+static const float DefaultBlurRadius = 13.0f;
+
+// Light acrylic, the tint --acrylic lays over the blur
+static const float AcrylicTint[3] = { 0.96f, 0.96f, 0.98f };
+
 // Vertex structure
 struct Vertex
 {
@@ -67,15 +241,6 @@ struct Vertex
 	float r, g, b, a; // Color
 };
 
-// Blur parameters constant buffer structure
-struct BlurConstants
-{
-	UINT textureWidth;
-	UINT textureHeight;
-	float blurRadius;  // How many pixels to blur (e.g., 3.0f for 3-pixel radius)
-	float padding;	   // Padding to align to 16 bytes
-};
-
 // Shader source code
 const char* vertexShaderSource = R"(
 struct VS_INPUT {
@@ -158,20 +323,36 @@ const char* computeShaderSource = R"(
 		};
 
 		Texture2D<float4> InputTexture : register(t0);
-		Texture2D<float4> MaskTexture : register(t1);
+		Texture2D<float> MaskTexture : register(t1);
 		RWTexture2D<float4> OutputTexture : register(u0);
 
+#ifdef SPARSE_TILES
+		// One group per tile of the list, x in the low 16 bits and y in the high 16
+		StructuredBuffer<uint> TileList : register(t2);
+
+		[numthreads(8, 8, 1)]
+		void main(uint3 group : SV_GroupID, uint3 groupThread : SV_GroupThreadID)
+		{
+			uint tile = TileList[group.x];
+			uint2 id = uint2(tile & 0xffff, tile >> 16) * 8 + groupThread.xy;
+#else
 		[numthreads(8, 8, 1)]
 		void main(uint3 id : SV_DispatchThreadID)
 		{
+#endif
 			if (id.x >= textureWidth || id.y >= textureHeight)
 				return;
 
+#ifdef FULL_TILES
+			// Every pixel of a full tile is covered, skip the mask
+			float maskValue = 1.0;
+#else
 			// Sample the mask at current pixel
-			float4 maskValue = MaskTexture[id.xy];
+			float maskValue = MaskTexture[id.xy];
+#endif
 
-			// If mask is empty (alpha = 0), output transparent black
-			if (maskValue.a <= 0.0)
+			// If mask is empty (coverage = 0), output transparent black
+			if (maskValue <= 0.0)
 			{
 				OutputTexture[id.xy] = float4(0, 0, 0, 0);
 				return;
@@ -202,14 +383,236 @@ const char* computeShaderSource = R"(
 			// Average the samples
 			color /= samples;
 
-			// Use mask alpha to blend between blurred and transparent
-			color.a *= maskValue.a;
+			// Use mask coverage to blend between blurred and transparent
+			color.a *= maskValue;
+			OutputTexture[id.xy] = color;
+		}
+	)";
+
+// Dual-Kawase chain, CpuKawaseBlur is the CPU reference
+const char* kawaseDownsampleShaderSource = R"(
+		cbuffer KawaseConstants : register(b0)
+		{
+			uint destWidth;
+			uint destHeight;
+			float2 sourceTexelSize;
+			float2 sourceUvScale;
+			float2 sourceUvMax;
+			uint applyMask;
+			float3 padding;
+		};
+
+		Texture2D<float4> InputTexture : register(t0);
+		RWTexture2D<float4> OutputTexture : register(u0);
+		SamplerState LinearClamp : register(s0);
+
+		[numthreads(8, 8, 1)]
+		void main(uint3 id : SV_DispatchThreadID)
+		{
+			if (id.x >= destWidth || id.y >= destHeight)
+				return;
+
+			// 4 bilinear taps on the corners of the 2x2 source block
+			float2 uv = (float2(id.xy) + 0.5) / float2(destWidth, destHeight) * sourceUvScale;
+			float2 o = sourceTexelSize;
+
+			float4 color = InputTexture.SampleLevel(LinearClamp, min(uv + float2(-o.x, -o.y), sourceUvMax), 0);
+			color += InputTexture.SampleLevel(LinearClamp, min(uv + float2( o.x, -o.y), sourceUvMax), 0);
+			color += InputTexture.SampleLevel(LinearClamp, min(uv + float2(-o.x,  o.y), sourceUvMax), 0);
+			color += InputTexture.SampleLevel(LinearClamp, min(uv + float2( o.x,  o.y), sourceUvMax), 0);
+
+			OutputTexture[id.xy] = color * 0.25;
+		}
+	)";
+
+const char* kawaseUpsampleShaderSource = R"(
+		cbuffer KawaseConstants : register(b0)
+		{
+			uint destWidth;
+			uint destHeight;
+			float2 sourceTexelSize;
+			float2 sourceUvScale;
+			float2 sourceUvMax;
+			uint applyMask;
+			float3 padding;
+		};
+
+		Texture2D<float4> InputTexture : register(t0);
+		Texture2D<float> MaskTexture : register(t1);
+		RWTexture2D<float4> OutputTexture : register(u0);
+		SamplerState LinearClamp : register(s0);
+
+		[numthreads(8, 8, 1)]
+		void main(uint3 id : SV_DispatchThreadID)
+		{
+			if (id.x >= destWidth || id.y >= destHeight)
+				return;
+
+			float maskAlpha = 1.0;
+			if (applyMask)
+			{
+				maskAlpha = MaskTexture[id.xy];
+				if (maskAlpha <= 0.0)
+				{
+					OutputTexture[id.xy] = float4(0, 0, 0, 0);
+					return;
+				}
+			}
+
+			// Tent: 4 axis taps one source texel out, 4 diagonal taps half a texel out with double weight
+			float2 uv = (float2(id.xy) + 0.5) / float2(destWidth, destHeight) * sourceUvScale;
+			float2 o = sourceTexelSize;
+
+			float4 color = InputTexture.SampleLevel(LinearClamp, min(uv + float2(-o.x, 0), sourceUvMax), 0);
+			color += InputTexture.SampleLevel(LinearClamp, min(uv + float2( o.x, 0), sourceUvMax), 0);
+			color += InputTexture.SampleLevel(LinearClamp, min(uv + float2(0, -o.y), sourceUvMax), 0);
+			color += InputTexture.SampleLevel(LinearClamp, min(uv + float2(0,  o.y), sourceUvMax), 0);
+			color += InputTexture.SampleLevel(LinearClamp, min(uv + float2(-o.x, -o.y) * 0.5, sourceUvMax), 0) * 2.0;
+			color += InputTexture.SampleLevel(LinearClamp, min(uv + float2( o.x, -o.y) * 0.5, sourceUvMax), 0) * 2.0;
+			color += InputTexture.SampleLevel(LinearClamp, min(uv + float2(-o.x,  o.y) * 0.5, sourceUvMax), 0) * 2.0;
+			color += InputTexture.SampleLevel(LinearClamp, min(uv + float2( o.x,  o.y) * 0.5, sourceUvMax), 0) * 2.0;
+			color /= 12.0;
+
+			color.a *= maskAlpha;
 			OutputTexture[id.xy] = color;
 		}
 	)";
 
+// Recursive Gaussian, CpuIirGaussianBlur is the CPU reference. One thread walks a whole row
+// or column, so the cost per pixel doesn't depend on the radius.
+const char* iirRowShaderSource = R"(
+		cbuffer IirConstants : register(b0)
+		{
+			uint width;
+			uint height;
+			float realGain;
+			float pairGain;
+			float pairDamping;
+			float3 padding;
+			float4 boundary[3];
+		};
+
+		Texture2D<float4> InputTexture : register(t0);
+		RWStructuredBuffer<float4> Rows : register(u0);
+
+		[numthreads(64, 1, 1)]
+		void main(uint3 id : SV_DispatchThreadID)
+		{
+			if (id.x >= height)
+				return;
+
+			uint y = id.x;
+			uint rowStart = y * width;
+
+			// Causal, the row continues to the left with its first pixel
+			float4 a = InputTexture[uint2(0, y)];
+			float4 b = a;
+			float4 v = 0;
+			for (uint x = 0; x < width; ++x)
+			{
+				a += realGain * (InputTexture[uint2(x, y)] - a);
+				v += pairGain * (a - b) - pairDamping * v;
+				b += v;
+				Rows[rowStart + x] = b;
+			}
+
+			// Anticausal, started from the state the row would reach past its last pixel
+			float4 edge = InputTexture[uint2(width - 1, y)];
+			float4 da = a - edge;
+			float4 db = b - edge;
+			float4 dv = v;
+			a = boundary[0].x * da + boundary[0].y * db + boundary[0].z * dv + edge;
+			b = boundary[1].x * da + boundary[1].y * db + boundary[1].z * dv + edge;
+			v = boundary[2].x * da + boundary[2].y * db + boundary[2].z * dv;
+			for (int x2 = (int)width - 1; x2 >= 0; --x2)
+			{
+				a += realGain * (Rows[rowStart + x2] - a);
+				v += pairGain * (a - b) - pairDamping * v;
+				b += v;
+				Rows[rowStart + x2] = b;
+			}
+		}
+	)";
+
+const char* iirColumnShaderSource = R"(
+		cbuffer IirConstants : register(b0)
+		{
+			uint width;
+			uint height;
+			float realGain;
+			float pairGain;
+			float pairDamping;
+			float3 padding;
+			float4 boundary[3];
+		};
+
+		Texture2D<float> MaskTexture : register(t1);
+		RWTexture2D<float4> OutputTexture : register(u0);
+		RWStructuredBuffer<float4> Rows : register(u1);
+
+		// Neighbouring threads read neighbouring floats of a row, the loads coalesce
+		[numthreads(64, 1, 1)]
+		void main(uint3 id : SV_DispatchThreadID)
+		{
+			if (id.x >= width)
+				return;
+
+			uint x = id.x;
+			float4 first = Rows[x];
+			float4 edge = Rows[(height - 1) * width + x];
+
+			float4 a = first;
+			float4 b = a;
+			float4 v = 0;
+			for (uint y = 0; y < height; ++y)
+			{
+				a += realGain * (Rows[y * width + x] - a);
+				v += pairGain * (a - b) - pairDamping * v;
+				b += v;
+				Rows[y * width + x] = b;
+			}
+
+			float4 da = a - edge;
+			float4 db = b - edge;
+			float4 dv = v;
+			a = boundary[0].x * da + boundary[0].y * db + boundary[0].z * dv + edge;
+			b = boundary[1].x * da + boundary[1].y * db + boundary[1].z * dv + edge;
+			v = boundary[2].x * da + boundary[2].y * db + boundary[2].z * dv;
+			for (int y2 = (int)height - 1; y2 >= 0; --y2)
+			{
+				a += realGain * (Rows[y2 * width + x] - a);
+				v += pairGain * (a - b) - pairDamping * v;
+				b += v;
+
+				float maskAlpha = MaskTexture[uint2(x, y2)];
+				if (maskAlpha <= 0.0)
+				{
+					OutputTexture[uint2(x, y2)] = float4(0, 0, 0, 0);
+					continue;
+				}
+
+				float4 color = saturate(b);
+				color.a *= maskAlpha;
+				OutputTexture[uint2(x, y2)] = color;
+			}
+		}
+	)";
+
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
+// Bytecode for the "main" entry point of `source`, from the shader cache or compiled into it
+static HRESULT CompileShader(const char* source, const char* target, const ShaderDefine* defines, const uint8_t*& bytecode, size_t& size)
+{
+	ShaderCompileRequest request = { source, "main", target, defines };
+	std::string errors;
+	if (!ShaderCacheGet(g_Application.shaderCache, request, bytecode, size, &errors))
+	{
+		OutputDebugStringA(errors.c_str());
+		return E_FAIL;
+	}
+	return S_OK;
+}
+
 bool InitializeTriangle()
 {
 	// Triangle vertices (NDC coordinates: -1 to 1)
@@ -232,19 +635,13 @@ bool InitializeTriangle()
 	if (FAILED(hr)) return false;
 
 	// Compile vertex shader
-	ID3DBlob* vsBlob = nullptr;
-	ID3DBlob* errorBlob = nullptr;
-	hr = D3DCompile(vertexShaderSource, strlen(vertexShaderSource), nullptr, nullptr, nullptr, "main", "vs_5_0", 0, 0, &vsBlob, &errorBlob);
-	if (FAILED(hr)) {
-		if (errorBlob) errorBlob->Release();
-		return false;
-	}
+	const uint8_t* vsBytecode;
+	size_t vsSize;
+	hr = CompileShader(vertexShaderSource, "vs_5_0", nullptr, vsBytecode, vsSize);
+	if (FAILED(hr)) return false;
 
-	hr = g_Application.device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &g_Application.vertexShader);
-	if (FAILED(hr)) {
-		vsBlob->Release();
-		return false;
-	}
+	hr = g_Application.device->CreateVertexShader(vsBytecode, vsSize, nullptr, &g_Application.vertexShader);
+	if (FAILED(hr)) return false;
 
 	// Create input layout
 	D3D11_INPUT_ELEMENT_DESC layout[] = {
@@ -252,67 +649,61 @@ bool InitializeTriangle()
 		{"COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0}
 	};
 
-	hr = g_Application.device->CreateInputLayout(layout, 2, vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), &g_Application.inputLayout);
-	vsBlob->Release();
+	hr = g_Application.device->CreateInputLayout(layout, 2, vsBytecode, vsSize, &g_Application.inputLayout);
 	if (FAILED(hr)) return false;
 
 	// Compile pixel shader
-	ID3DBlob* psBlob = nullptr;
-	hr = D3DCompile(pixelShaderSource, strlen(pixelShaderSource), nullptr, nullptr, nullptr, "main", "ps_5_0", 0, 0, &psBlob, &errorBlob);
-	if (FAILED(hr)) {
-		if (errorBlob) errorBlob->Release();
-		return false;
-	}
+	const uint8_t* psBytecode;
+	size_t psSize;
+	hr = CompileShader(pixelShaderSource, "ps_5_0", nullptr, psBytecode, psSize);
+	if (FAILED(hr)) return false;
 
-	hr = g_Application.device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &g_Application.pixelShader);
-	psBlob->Release();
+	hr = g_Application.device->CreatePixelShader(psBytecode, psSize, nullptr, &g_Application.pixelShader);
 	if (FAILED(hr)) return false;
 
 	return true;
 }
 
+static int64_t SchedulerNowUs();
+
+// Window-sized texture from the pool, at least desc.Width x desc.Height
+static ID3D11Texture2D* AcquireWindowTexture(PoolLease& lease, const D3D11_TEXTURE2D_DESC& desc)
+{
+	if (!ResourcePoolAcquire(g_Application.resourcePool, PoolTextureDesc(desc), SchedulerNowUs(), lease))
+		return nullptr;
+	return (ID3D11Texture2D*)lease.resource;
+}
+
+static ID3D11Buffer* AcquireWindowBuffer(PoolLease& lease, const D3D11_BUFFER_DESC& desc)
+{
+	if (!ResourcePoolAcquire(g_Application.resourcePool, PoolBufferDesc(desc), SchedulerNowUs(), lease))
+		return nullptr;
+	return (ID3D11Buffer*)lease.resource;
+}
+
+template <typename T>
+static void ReleaseView(T*& view)
+{
+	if (view)
+	{
+		view->Release();
+		view = nullptr;
+	}
+}
+
 // Function to initialize the compute shader blur system
 HRESULT InitializeBlurComputeShader()
 {
 	HRESULT hr = S_OK;
 
 	// Compile compute shader
-	ID3DBlob* computeShaderBlob = nullptr;
-	ID3DBlob* errorBlob = nullptr;
-
-	hr = D3DCompile(
-					computeShaderSource,
-					strlen(computeShaderSource),
-					nullptr,
-					nullptr,
-					nullptr,
-					"main",
-					"cs_5_0",
-					0,
-					0,
-					&computeShaderBlob,
-					&errorBlob
-	);
-
-	if (FAILED(hr))
-	{
-		if (errorBlob)
-		{
-			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-			errorBlob->Release();
-		}
-		return hr;
-	}
+	const uint8_t* bytecode;
+	size_t size;
+	hr = CompileShader(computeShaderSource, "cs_5_0", nullptr, bytecode, size);
+	if (FAILED(hr)) return hr;
 
 	// Create compute shader
-	hr = g_Application.device->CreateComputeShader(
-												   computeShaderBlob->GetBufferPointer(),
-												   computeShaderBlob->GetBufferSize(),
-												   nullptr,
-												   &g_Application.blurComputeShader
-	);
-	computeShaderBlob->Release();
-
+	hr = g_Application.device->CreateComputeShader(bytecode, size, nullptr, &g_Application.blurComputeShader);
 	if (FAILED(hr)) return hr;
 
 	// Create blur texture (same size as desktop texture)
@@ -326,8 +717,8 @@ HRESULT InitializeBlurComputeShader()
 	textureDesc.Usage = D3D11_USAGE_DEFAULT;
 	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_RENDER_TARGET;
 
-	hr = g_Application.device->CreateTexture2D(&textureDesc, nullptr, &g_Application.blurTexture);
-	if (FAILED(hr)) return hr;
+	g_Application.blurTexture = AcquireWindowTexture(g_Application.blurLease, textureDesc);
+	if (!g_Application.blurTexture) return E_OUTOFMEMORY;
 
 	// Create SRV for input (will use desktopSRV as input)
 	// Create UAV for output
@@ -362,34 +753,275 @@ HRESULT InitializeBlurComputeShader()
 	return S_OK;
 }
 
-bool InitializeDesktopCapture()
+// Staging copy of the desktop texture so the CPU blur can read it, the mask is already on the CPU
+bool InitializeCpuBlur()
 {
-	// @Important -- get the 'IDXGIOutputDuplication' which allows capturing of desktop
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = g_Application.windowWidth;
+	textureDesc.Height = g_Application.windowHeight;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_STAGING;
+	textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 
-	// Get DXGI adapter from our D3D11 device
-	IDXGIDevice* dxgiDevice = nullptr;
-	g_Application.device->QueryInterface(__uuidof(IDXGIDevice), (void**)&dxgiDevice);
+	g_Application.desktopStagingTexture = AcquireWindowTexture(g_Application.stagingLease, textureDesc);
+	if (!g_Application.desktopStagingTexture) return false;
 
-	IDXGIAdapter* dxgiAdapter = nullptr;
-	dxgiDevice->GetAdapter(&dxgiAdapter);
+	g_Application.cpuBlurOutput.resize((size_t)textureDesc.Width * textureDesc.Height * 4);
+	CpuTiledBlurStart(g_Application.cpuBlur);
+	return true;
+}
+
+// One copy of blurTexture per cache slot, 0 entries turns the cache off
+bool InitializeBlurCache(int entries)
+{
+	BlurCacheReset(g_Application.blurCache, entries);
+	if (entries <= 0)
+		return true;
 
-	// Get the primary output (monitor)
-	IDXGIOutput* dxgiOutput = nullptr;
-	dxgiAdapter->EnumOutputs(0, &dxgiOutput);
+	D3D11_TEXTURE2D_DESC textureDesc;
+	g_Application.blurTexture->GetDesc(&textureDesc);
+	textureDesc.Width = g_Application.windowWidth;
+	textureDesc.Height = g_Application.windowHeight;
+	textureDesc.BindFlags = 0;
 
-	IDXGIOutput1* dxgiOutput1 = nullptr;
-	dxgiOutput->QueryInterface(__uuidof(IDXGIOutput1), (void**)&dxgiOutput1);
+	for (int slot = 0; slot < g_Application.blurCache.capacity; ++slot)
+	{
+		g_Application.blurCacheTextures[slot] = AcquireWindowTexture(g_Application.blurCacheLeases[slot], textureDesc);
+		if (!g_Application.blurCacheTextures[slot]) return false;
+	}
+	return true;
+}
 
-	// Create desktop duplication
-	HRESULT hr = dxgiOutput1->DuplicateOutput(g_Application.device, &g_Application.desktopDuplication);
+static HRESULT CompileComputeShader(const char* source, ID3D11ComputeShader** shader, const ShaderDefine* defines = nullptr)
+{
+	const uint8_t* bytecode;
+	size_t size;
+	HRESULT hr = CompileShader(source, "cs_5_0", defines, bytecode, size);
+	if (FAILED(hr)) return hr;
 
-	// Cleanup
-	dxgiOutput1->Release();
-	dxgiOutput->Release();
-	dxgiAdapter->Release();
-	dxgiDevice->Release();
+	return g_Application.device->CreateComputeShader(bytecode, size, nullptr, shader);
+}
+
+// The generated blur for `radius`, with the effect chain in its resolve when there is one
+static std::string SpecializedBlurSource(int radius)
+{
+	if (g_Application.useEffectChain)
+		return GenerateEffectChainHlsl(g_Application.effectProgram, radius);
+	return GenerateBlurKernelHlsl(g_Application.blurKernel, radius);
+}
+
+// Compiles the generated shader for the radius ApplyBlurEffect runs with by default.
+// Radii without a specialization keep using computeShaderSource (box only, no effect chain).
+HRESULT InitializeSpecializedBlurShader()
+{
+	int radius = (int)DefaultBlurRadius;
+	if (!BlurKernelSpecialized(g_Application.blurKernel, radius))
+		return S_FALSE;
+
+	std::string source = SpecializedBlurSource(radius);
+	HRESULT hr = CompileComputeShader(source.c_str(), &g_Application.specializedBlurShader);
+	if (FAILED(hr)) return hr;
+
+	g_Application.specializedBlurRadius = radius;
+	return S_OK;
+}
+
+static const ShaderDefine PartialTileDefines[] = { { "SPARSE_TILES", "1" }, { nullptr, nullptr } };
+static const ShaderDefine FullTileDefines[] = { { "SPARSE_TILES", "1" }, { "FULL_TILES", "1" }, { nullptr, nullptr } };
+
+static HRESULT CreateTileListBuffer(UINT tileCount, PoolLease& lease, ID3D11Buffer** buffer, ID3D11ShaderResourceView** srv)
+{
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = tileCount * sizeof(uint32_t);
+	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	bufferDesc.StructureByteStride = sizeof(uint32_t);
+
+	*buffer = AcquireWindowBuffer(lease, bufferDesc);
+	if (!*buffer) return E_OUTOFMEMORY;
+	return g_Application.device->CreateShaderResourceView(*buffer, nullptr, srv);
+}
+
+// Tile list variants of the blur shaders, ApplyBlurEffect falls back to the dense dispatch without them
+HRESULT InitializeSparseBlurTiles()
+{
+	const MaskLayer& layer = g_Application.maskLayer;
+	MaskTileMapReset(g_Application.maskTiles, layer.width, layer.height);
+	if (g_Application.useCpuBlur)
+		return S_FALSE;
+
+	HRESULT hr = CompileComputeShader(computeShaderSource, &g_Application.partialTileShader, PartialTileDefines);
+	if (FAILED(hr)) return hr;
+	hr = CompileComputeShader(computeShaderSource, &g_Application.fullTileShader, FullTileDefines);
+	if (FAILED(hr)) return hr;
+
+	if (g_Application.specializedBlurShader)
+	{
+		std::string source = SpecializedBlurSource(g_Application.specializedBlurRadius);
+		hr = CompileComputeShader(source.c_str(), &g_Application.specializedPartialTileShader, PartialTileDefines);
+		if (FAILED(hr)) return hr;
+		hr = CompileComputeShader(source.c_str(), &g_Application.specializedFullTileShader, FullTileDefines);
+		if (FAILED(hr)) return hr;
+	}
+
+	UINT tileCount = (UINT)std::max<size_t>(1, g_Application.maskTiles.classes.size());
+	hr = CreateTileListBuffer(tileCount, g_Application.fullTileLease, &g_Application.fullTileBuffer, &g_Application.fullTileSRV);
+	if (FAILED(hr)) return hr;
+	hr = CreateTileListBuffer(tileCount, g_Application.partialTileLease, &g_Application.partialTileBuffer, &g_Application.partialTileSRV);
+	if (FAILED(hr)) return hr;
+	return CreateTileListBuffer(tileCount, g_Application.clearedTileLease, &g_Application.clearedTileBuffer, &g_Application.clearedTileSRV);
+}
+
+// Dual-Kawase shaders and the half-resolution level chain
+HRESULT InitializeKawaseBlur()
+{
+	HRESULT hr = CompileComputeShader(kawaseDownsampleShaderSource, &g_Application.kawaseDownsampleShader);
+	if (FAILED(hr)) return hr;
+
+	hr = CompileComputeShader(kawaseUpsampleShaderSource, &g_Application.kawaseUpsampleShader);
+	if (FAILED(hr)) return hr;
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = sizeof(KawaseConstants);
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	hr = g_Application.device->CreateBuffer(&bufferDesc, nullptr, &g_Application.kawaseConstantBuffer);
+	if (FAILED(hr)) return hr;
+
+	// Half float levels so the chain doesn't band
+	for (int level = 1; level <= CpuKawaseMaxLevels; ++level)
+	{
+		D3D11_TEXTURE2D_DESC textureDesc = {};
+		textureDesc.Width = CpuKawaseLevelSize(g_Application.windowWidth, level);
+		textureDesc.Height = CpuKawaseLevelSize(g_Application.windowHeight, level);
+		textureDesc.MipLevels = 1;
+		textureDesc.ArraySize = 1;
+		textureDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+		textureDesc.SampleDesc.Count = 1;
+		textureDesc.Usage = D3D11_USAGE_DEFAULT;
+		textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+
+		g_Application.kawaseLevelTextures[level] = AcquireWindowTexture(g_Application.kawaseLeases[level], textureDesc);
+		if (!g_Application.kawaseLevelTextures[level]) return E_OUTOFMEMORY;
+
+		hr = g_Application.device->CreateShaderResourceView(g_Application.kawaseLevelTextures[level], nullptr, &g_Application.kawaseLevelSRVs[level]);
+		if (FAILED(hr)) return hr;
+
+		hr = g_Application.device->CreateUnorderedAccessView(g_Application.kawaseLevelTextures[level], nullptr, &g_Application.kawaseLevelUAVs[level]);
+		if (FAILED(hr)) return hr;
+	}
+
+	return S_OK;
+}
+
+// The whole pooled buffer, rows are windowWidth floats apart whatever its size
+static HRESULT CreateIirRowView()
+{
+	D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.Format = DXGI_FORMAT_UNKNOWN;
+	uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	uavDesc.Buffer.NumElements = g_Application.iirRowLease.allocatedWidth / 16;
+
+	return g_Application.device->CreateUnorderedAccessView(g_Application.iirRowBuffer, &uavDesc, &g_Application.iirRowUAV);
+}
+
+// Recursive Gaussian shaders and the float buffer between the two passes
+HRESULT InitializeIirBlur()
+{
+	HRESULT hr = CompileComputeShader(iirRowShaderSource, &g_Application.iirRowShader);
+	if (FAILED(hr)) return hr;
+
+	hr = CompileComputeShader(iirColumnShaderSource, &g_Application.iirColumnShader);
+	if (FAILED(hr)) return hr;
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = sizeof(IirGaussianConstants);
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	hr = g_Application.device->CreateBuffer(&bufferDesc, nullptr, &g_Application.iirConstantBuffer);
+	if (FAILED(hr)) return hr;
 
-	return SUCCEEDED(hr);
+	// Structured rather than a float4 texture, typed UAV loads of float4 need 11.3 hardware
+	D3D11_BUFFER_DESC rowsDesc = {};
+	rowsDesc.ByteWidth = g_Application.windowWidth * g_Application.windowHeight * 16;
+	rowsDesc.Usage = D3D11_USAGE_DEFAULT;
+	rowsDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	rowsDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	rowsDesc.StructureByteStride = 16;
+
+	g_Application.iirRowBuffer = AcquireWindowBuffer(g_Application.iirRowLease, rowsDesc);
+	if (!g_Application.iirRowBuffer) return E_OUTOFMEMORY;
+	return CreateIirRowView();
+}
+
+// The triangle that used to be drawn into the mask every frame, now a retained shape
+void InitializeMask()
+{
+	const float width = (float)g_Application.windowWidth;
+	const float height = (float)g_Application.windowHeight;
+	MaskLayerReset(g_Application.maskLayer, g_Application.windowWidth, g_Application.windowHeight);
+
+	MaskShape triangle = {};
+	triangle.type = MaskShape_Polygon;
+	triangle.points = {
+		{ width * 0.5f, height * 0.25f },	// Top
+		{ width * 0.75f, height * 0.75f },	// Bottom Right
+		{ width * 0.25f, height * 0.75f },	// Bottom Left
+	};
+	g_Application.maskTriangle = MaskLayerAdd(g_Application.maskLayer, triangle);
+}
+
+// spec is a CreateFrameSource spec, nullptr captures the desktop
+bool InitializeDesktopCapture(const char* spec)
+{
+	if (spec)
+	{
+		// Synthetic and replayed frames cover the primary monitor, like the duplication does
+		g_Application.frameSource = CreateFrameSource(spec, GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN));
+		return g_Application.frameSource != nullptr;
+	}
+
+	// Every output of our adapter, outputs on other adapters can't be copied by this device
+	for (int index = 0;; ++index)
+	{
+		DxgiFrameSource* source = new DxgiFrameSource;
+		if (!DxgiFrameSourceStart(*source, g_Application.device, index))
+		{
+			delete source;
+			break;
+		}
+		g_Application.desktopSources.push_back(source);
+		g_Application.desktopOutputs.push_back(source->output);
+		g_Application.outputTextures.push_back(nullptr);
+	}
+	g_Application.assembledRect = {};
+	if (!g_Application.desktopSources.empty())
+		return true;
+
+	// WARP has no outputs. The primary output is duplicated on a device of the adapter that has
+	// it and read back, the CPU blur wants the frames in memory anyway.
+	int outputIndex = 0;
+	g_Application.captureDevice = CreateDxgiCaptureDevice(outputIndex);
+	if (!g_Application.captureDevice)
+		return false;
+
+	DxgiFrameSource* source = new DxgiFrameSource;
+	source->readBack = true;
+	if (!DxgiFrameSourceStart(*source, g_Application.captureDevice, outputIndex))
+	{
+		delete source;
+		return false;
+	}
+	g_Application.frameSource = source;
+	return true;
 }
 
 bool InitializeWindow(int width, int height)
@@ -462,6 +1094,25 @@ bool InitializeDirectX()
 								   &g_Application.deviceContext
 	);
 
+	if (FAILED(hr))
+	{
+		// No usable GPU, fall back to WARP for presentation and blur on the CPU. WARP has no
+		// outputs, InitializeDesktopCapture duplicates through the adapter that has them.
+		hr = D3D11CreateDevice(
+							   nullptr,
+							   D3D_DRIVER_TYPE_WARP,
+							   nullptr,
+							   flags,
+							   featureLevels,
+							   ARRAYSIZE(featureLevels),
+							   D3D11_SDK_VERSION,
+							   &g_Application.device,
+							   nullptr,
+							   &g_Application.deviceContext
+		);
+		g_Application.useCpuBlur = true;
+	}
+
 	if (FAILED(hr))
 		return false;
 
@@ -530,13 +1181,22 @@ bool InitializeDirectX()
 	textureDesc.Usage = D3D11_USAGE_DEFAULT;
 	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
 
-	g_Application.device->CreateTexture2D(&textureDesc, nullptr, &g_Application.desktopTexture);
+	g_Application.poolAllocator.device = g_Application.device;
+	ResourcePoolReset(g_Application.resourcePool, &g_Application.poolAllocator);
+
+	g_Application.desktopTexture = AcquireWindowTexture(g_Application.desktopLease, textureDesc);
+	if (!g_Application.desktopTexture)
+		return false;
 	g_Application.device->CreateShaderResourceView(g_Application.desktopTexture, nullptr, &g_Application.desktopSRV);
 	g_Application.device->CreateRenderTargetView(g_Application.desktopTexture, nullptr, &g_Application.desktopRTV);
 
-	hr = g_Application.device->CreateTexture2D(&textureDesc, nullptr, &g_Application.maskTexture);
+	// The blur only reads coverage, a quarter of the bytes of a BGRA render target
+	textureDesc.Format = DXGI_FORMAT_R8_UNORM;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	g_Application.maskTexture = AcquireWindowTexture(g_Application.maskLease, textureDesc);
+	if (!g_Application.maskTexture)
+		return false;
 	g_Application.device->CreateShaderResourceView(g_Application.maskTexture, nullptr, &g_Application.maskSRV);
-	g_Application.device->CreateRenderTargetView(g_Application.maskTexture, nullptr, &g_Application.maskRTV);
 
 	return true;
 }
@@ -562,17 +1222,17 @@ bool InitializeQuad()
 
 	HRESULT hr = g_Application.device->CreateBuffer(&bufferDesc, &initData, &g_Application.quadVertexBuffer);
 	if (FAILED(hr)) return false;
+	g_Application.quadUvScale[0] = 1.0f;
+	g_Application.quadUvScale[1] = 1.0f;
 
 	// Compile vertex shader
-	ID3DBlob* vsBlob = nullptr;
-	hr = D3DCompile(quadVertexShaderSource, strlen(quadVertexShaderSource), nullptr, nullptr, nullptr, "main", "vs_5_0", 0, 0, &vsBlob, nullptr);
+	const uint8_t* vsBytecode;
+	size_t vsSize;
+	hr = CompileShader(quadVertexShaderSource, "vs_5_0", nullptr, vsBytecode, vsSize);
 	if (FAILED(hr)) return false;
 
-	hr = g_Application.device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &g_Application.quadVertexShader);
-	if (FAILED(hr)) {
-		vsBlob->Release();
-		return false;
-	}
+	hr = g_Application.device->CreateVertexShader(vsBytecode, vsSize, nullptr, &g_Application.quadVertexShader);
+	if (FAILED(hr)) return false;
 
 	// Create input layout
 	D3D11_INPUT_ELEMENT_DESC layout[] = {
@@ -580,17 +1240,16 @@ bool InitializeQuad()
 		{"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0}
 	};
 
-	hr = g_Application.device->CreateInputLayout(layout, 2, vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), &g_Application.quadInputLayout);
-	vsBlob->Release();
+	hr = g_Application.device->CreateInputLayout(layout, 2, vsBytecode, vsSize, &g_Application.quadInputLayout);
 	if (FAILED(hr)) return false;
 
 	// Compile pixel shader
-	ID3DBlob* psBlob = nullptr;
-	hr = D3DCompile(quadPixelShaderSource, strlen(quadPixelShaderSource), nullptr, nullptr, nullptr, "main", "ps_5_0", 0, 0, &psBlob, nullptr);
+	const uint8_t* psBytecode;
+	size_t psSize;
+	hr = CompileShader(quadPixelShaderSource, "ps_5_0", nullptr, psBytecode, psSize);
 	if (FAILED(hr)) return false;
 
-	hr = g_Application.device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &g_Application.quadPixelShader);
-	psBlob->Release();
+	hr = g_Application.device->CreatePixelShader(psBytecode, psSize, nullptr, &g_Application.quadPixelShader);
 	if (FAILED(hr)) return false;
 
 	// Create sampler state
@@ -609,76 +1268,572 @@ bool InitializeQuad()
 	return true;
 }
 
-bool GrabDesktopBehindWindow()
+// Keeps the output's frame until the next one, the duplication wants it back right away
+static bool KeepOutputFrame(int index, const DxgiFrameSource& source)
 {
-	// Get current frame from desktop duplication
-	IDXGIResource* desktopResource = nullptr;
-	DXGI_OUTDUPL_FRAME_INFO frameInfo;
+	D3D11_TEXTURE2D_DESC desc;
+	source.texture->GetDesc(&desc);
 
-	// @Important
-	HRESULT hr = g_Application.desktopDuplication->AcquireNextFrame(0, &frameInfo, &desktopResource);
-	if (hr == DXGI_ERROR_WAIT_TIMEOUT)
+	ID3D11Texture2D*& kept = g_Application.outputTextures[index];
+	if (kept)
 	{
-		hr = g_Application.desktopDuplication->AcquireNextFrame(1, &frameInfo, &desktopResource);
+		D3D11_TEXTURE2D_DESC keptDesc;
+		kept->GetDesc(&keptDesc);
+		if (keptDesc.Width != desc.Width || keptDesc.Height != desc.Height || keptDesc.Format != desc.Format)
+		{
+			kept->Release();
+			kept = nullptr;
+		}
 	}
 
-	if (FAILED(hr))
+	if (!kept)
 	{
-		if (hr == DXGI_ERROR_WAIT_TIMEOUT) return false; // No new frame
-		if (hr == DXGI_ERROR_ACCESS_LOST)
-		{
-			// Desktop duplication lost, need to recreate
-			g_Application.desktopDuplication->Release();
-			g_Application.desktopDuplication = nullptr;
-			InitializeDesktopCapture();
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = 0;
+		desc.CPUAccessFlags = 0;
+		desc.MiscFlags = 0;
+		if (FAILED(g_Application.device->CreateTexture2D(&desc, nullptr, &kept)))
 			return false;
+	}
+
+	g_Application.deviceContext->CopyResource(kept, source.texture);
+	return true;
+}
+
+// Queues a frame with pixels for the recording thread, the recording takes its size from the
+// first one. `window` is in the frame's pixels like its rects.
+static void RecordFrame(const Frame& frame, const BlurRect& window)
+{
+	RecordingThread& recording = g_Application.recording;
+	if (!recording.thread.joinable() && !RecordingThreadStart(recording, g_Application.recordPath, frame.width, frame.height))
+	{
+		g_Application.recordPath[0] = 0;  // Can't be written, stop trying
+		return;
+	}
+
+	TRACE_ZONE("Record");
+	if (!RecordingThreadAdd(recording, frame, window))
+		TRACE_COUNTER("record dropped", 1);
+}
+
+static BlurRect RecordedWindowRect(int offsetX, int offsetY)
+{
+	RECT windowRect;
+	GetWindowRect(g_Application.hwnd, &windowRect);
+	return { windowRect.left - offsetX, windowRect.top - offsetY, windowRect.right - offsetX, windowRect.bottom - offsetY };
+}
+
+// The staging texture mirrors the output: only what changed is copied into it and read back,
+// so keyframes come out of it as well
+static void RecordOutputFrame(const DxgiFrameSource& source, const Frame& frame)
+{
+	D3D11_TEXTURE2D_DESC desc;
+	source.texture->GetDesc(&desc);
+
+	ID3D11Texture2D*& staging = g_Application.recordStagingTexture;
+	if (staging)
+	{
+		D3D11_TEXTURE2D_DESC stagingDesc;
+		staging->GetDesc(&stagingDesc);
+		if (stagingDesc.Width != desc.Width || stagingDesc.Height != desc.Height || stagingDesc.Format != desc.Format)
+		{
+			staging->Release();
+			staging = nullptr;
 		}
+	}
+
+	const bool fresh = !staging;
+	if (fresh)
+	{
+		desc.Usage = D3D11_USAGE_STAGING;
+		desc.BindFlags = 0;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		desc.MiscFlags = 0;
+		if (FAILED(g_Application.device->CreateTexture2D(&desc, nullptr, &staging)))
+			return;
+	}
+
+	// The duplication reports desktop coordinates, the recording the output's pixels
+	Frame& recorded = g_Application.recordFrame;
+	const BlurRect& bounds = source.output.bounds;
+	recorded.dirtyRects.clear();
+	recorded.moves.clear();
+	for (const BlurRect& rect : frame.dirtyRects)
+		recorded.dirtyRects.push_back({ rect.left - bounds.left, rect.top - bounds.top, rect.right - bounds.left, rect.bottom - bounds.top });
+	for (const DirtyMove& move : frame.moves)
+		recorded.moves.push_back({ move.sourceX - bounds.left, move.sourceY - bounds.top,
+								   { move.destination.left - bounds.left, move.destination.top - bounds.top,
+									 move.destination.right - bounds.left, move.destination.bottom - bounds.top } });
+
+	if (fresh)
+		g_Application.deviceContext->CopyResource(staging, source.texture);
+	else
+	{
+		for (const BlurRect& rect : recorded.dirtyRects)
+		{
+			D3D11_BOX box = { (UINT)rect.left, (UINT)rect.top, 0, (UINT)rect.right, (UINT)rect.bottom, 1 };
+			g_Application.deviceContext->CopySubresourceRegion(staging, 0, rect.left, rect.top, 0, source.texture, 0, &box);
+		}
+		for (const DirtyMove& move : recorded.moves)
+		{
+			const BlurRect& rect = move.destination;
+			D3D11_BOX box = { (UINT)rect.left, (UINT)rect.top, 0, (UINT)rect.right, (UINT)rect.bottom, 1 };
+			g_Application.deviceContext->CopySubresourceRegion(staging, 0, rect.left, rect.top, 0, source.texture, 0, &box);
+		}
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(g_Application.deviceContext->Map(staging, 0, D3D11_MAP_READ, 0, &mapped)))
+		return;
+	recorded.width = (int)desc.Width;
+	recorded.height = (int)desc.Height;
+	recorded.pixels = (const uint8_t*)mapped.pData;
+	recorded.rowPitch = (int)mapped.RowPitch;
+	recorded.timestamp = frame.timestamp;
+	recorded.pointerOnly = frame.pointerOnly;
+	RecordFrame(recorded, RecordedWindowRect(bounds.left, bounds.top));
+	g_Application.deviceContext->Unmap(staging, 0);
+}
+
+// Polls every output and assembles the window from the sub-rects of the outputs it covers
+static bool GrabDesktopOutputs()
+{
+	Frame& frame = g_Application.frame;
+	bool newFrame = false;
+	for (int index = 0; index < (int)g_Application.desktopSources.size(); ++index)
+	{
+		DxgiFrameSource& source = *g_Application.desktopSources[index];
+		FrameSourceResult result = source.AcquireFrame(0, frame);
+		if (result == FrameSource_Timeout)
+			TRACE_COUNTER("timeouts", 1);
+
+		if (result != FrameSource_Ok)
+		{
+			// A recreated duplication has no history, and the output may have moved or changed mode
+			if (result == FrameSource_Lost)
+			{
+				DirtyRegionInvalidate(g_Application.dirtyTracker);
+				g_Application.assembledRect = {};
+			}
+			continue;
+		}
+
+		g_Application.desktopOutputs[index] = source.output;
+		DirtyRegionAddFrame(g_Application.dirtyTracker, frame);
+		newFrame |= KeepOutputFrame(index, source);
+		if (index == 0 && g_Application.recordPath[0])
+			RecordOutputFrame(source, frame);
+		source.ReleaseFrame();
+	}
+
+	// Get window position on the desktop, clipped to desktopTexture
+	RECT windowRect;
+	GetWindowRect(g_Application.hwnd, &windowRect);
+	BlurRect region = { windowRect.left, windowRect.top,
+						std::min(windowRect.right, windowRect.left + (LONG)g_Application.windowWidth),
+						std::min(windowRect.bottom, windowRect.top + (LONG)g_Application.windowHeight) };
+
+	const BlurRect& assembled = g_Application.assembledRect;
+	const bool moved = region.left != assembled.left || region.top != assembled.top ||
+					   region.right != assembled.right || region.bottom != assembled.bottom;
+	if (!newFrame && !moved)
 		return false;
+
+	g_Application.assembledRect = region;
+	g_Application.contentHashed = false;
+	DesktopLayoutPlan(g_Application.desktopOutputs, region, g_Application.desktopCopies, g_Application.desktopUncovered);
+
+	uint64_t bytesCopied = 0;
+	for (const DesktopCopy& copy : g_Application.desktopCopies)
+	{
+		// An output that hasn't delivered a frame yet shows up as uncovered until it does
+		ID3D11Texture2D* kept = g_Application.outputTextures[copy.output];
+		if (!kept)
+		{
+			g_Application.desktopUncovered.push_back({ copy.destX, copy.destY, copy.destX + copy.source.right - copy.source.left,
+													   copy.destY + copy.source.bottom - copy.source.top });
+			continue;
+		}
+
+		// @Important
+		D3D11_BOX sourceBox = { (UINT)copy.source.left, (UINT)copy.source.top, 0, (UINT)copy.source.right, (UINT)copy.source.bottom, 1 };
+		g_Application.deviceContext->CopySubresourceRegion(g_Application.desktopTexture, 0, copy.destX, copy.destY, 0, kept, 0, &sourceBox);
+		bytesCopied += (uint64_t)(copy.source.right - copy.source.left) * (copy.source.bottom - copy.source.top) * 4;
 	}
 
-	if (frameInfo.LastPresentTime.HighPart == 0) {
-		// not interested in just mouse updates, which can happen much faster than 60fps if you really shake the mouse
-		//g_Application.desktopDuplication->ReleaseFrame();
-		//return false;
+	// Off every output, e.g. hanging over the gap next to a smaller monitor
+	if (!g_Application.desktopUncovered.empty())
+		g_Application.zeroPixels.resize((size_t)g_Application.windowWidth * g_Application.windowHeight * 4);
+	for (const BlurRect& rect : g_Application.desktopUncovered)
+	{
+		D3D11_BOX destBox = { (UINT)rect.left, (UINT)rect.top, 0, (UINT)rect.right, (UINT)rect.bottom, 1 };
+		g_Application.deviceContext->UpdateSubresource(g_Application.desktopTexture, 0, &destBox, g_Application.zeroPixels.data(),
+													   g_Application.windowWidth * 4, 0);
+	}
+	TRACE_COUNTER("bytes copied", bytesCopied);
+	TRACE_COUNTER("outputs copied", g_Application.desktopCopies.size());
+	g_Application.deviceContext->Flush();
+	return true;
+}
+
+bool GrabDesktopBehindWindow()
+{
+	if (!g_Application.frameSource)
+		return GrabDesktopOutputs();
+
+	// Get current frame from the frame source
+	Frame& frame = g_Application.frame;
+
+	// @Important
+	// Only a poll, the scheduler decides how long to wait between them
+	FrameSourceResult result = g_Application.frameSource->AcquireFrame(0, frame);
+	if (result == FrameSource_Timeout)
+		TRACE_COUNTER("timeouts", 1);
+
+	if (result != FrameSource_Ok)
+	{
+		// A recreated duplication has no history, blur everything on the next frame
+		if (result == FrameSource_Lost)
+			DirtyRegionInvalidate(g_Application.dirtyTracker);
+		return false;
 	}
 
-	// Get the desktop texture
-	ID3D11Texture2D* acquiredDesktopImage = nullptr;
-	desktopResource->QueryInterface(__uuidof(ID3D11Texture2D), (void**)&acquiredDesktopImage);
+	DirtyRegionAddFrame(g_Application.dirtyTracker, frame);
+	if (frame.pixels && g_Application.recordPath[0])
+		RecordFrame(frame, RecordedWindowRect(0, 0));
 
 	// Get window position on screen
 	RECT windowRect;
 	GetWindowRect(g_Application.hwnd, &windowRect);
 
-	// Copy the region behind our window
-	D3D11_BOX sourceBox;
-	sourceBox.left = std::max(windowRect.left, long(0));
-	sourceBox.top = std::max(windowRect.top, long(0));
-	sourceBox.right = windowRect.right - std::min(windowRect.left, long(0));
-	sourceBox.bottom = windowRect.bottom - std::min(windowRect.top, long(0));
-	sourceBox.front = 0;
-	sourceBox.back = 1;
+	// Frames from memory are uploaded, the window clipped to desktopTexture and then to the frame.
+	// What is on the frame lands at its offset inside the window, e.g. right of a window
+	// hanging off the left edge, the rest is transparent black.
+	const BlurRect window = { windowRect.left, windowRect.top,
+							  std::min(windowRect.right, windowRect.left + (LONG)g_Application.windowWidth),
+							  std::min(windowRect.bottom, windowRect.top + (LONG)g_Application.windowHeight) };
+	const ImageView frameView = { (uint8_t*)frame.pixels, frame.width, frame.height, frame.rowPitch, ImageFormat_BGRA8 };
+	BlurRect visible = window;
+	const bool onFrame = ImageViewClip(frameView, visible);
+	const bool whole = onFrame && visible.left == window.left && visible.top == window.top &&
+		visible.right == window.right && visible.bottom == window.bottom;
+	if (!whole)
+	{
+		g_Application.zeroPixels.resize((size_t)g_Application.windowWidth * g_Application.windowHeight * 4);
+		D3D11_BOX windowBox = { 0, 0, 0, (UINT)(window.right - window.left), (UINT)(window.bottom - window.top), 1 };
+		g_Application.deviceContext->UpdateSubresource(g_Application.desktopTexture, 0, &windowBox, g_Application.zeroPixels.data(),
+													   g_Application.windowWidth * 4, 0);
+	}
 
-	// @Important
-	g_Application.deviceContext->CopySubresourceRegion(
-													   g_Application.desktopTexture,
-													   0, 0, 0, 0,
-													   acquiredDesktopImage,
-													   0,
-													   &sourceBox
-	);
+	if (onFrame)
+	{
+		const ImageView source = ImageViewSubRect(frameView, visible);
+		D3D11_BOX destBox = { (UINT)(visible.left - window.left), (UINT)(visible.top - window.top), 0,
+							  (UINT)(visible.right - window.left), (UINT)(visible.bottom - window.top), 1 };
+		{
+			TRACE_ZONE("Hash");
+			g_Application.contentHash = FrameHashImage(source.pixels, source.rowPitch, source.width, source.height, g_Application.contentTileHashes,
+													   g_Application.useCpuBlur ? &g_Application.cpuBlur.pool : nullptr);
+			g_Application.contentHashed = true;
+		}
+		g_Application.deviceContext->UpdateSubresource(g_Application.desktopTexture, 0, &destBox, source.pixels, source.rowPitch, 0);
+		TRACE_COUNTER("bytes copied", (uint64_t)source.width * source.height * 4);
+	}
 	g_Application.deviceContext->Flush();
 
 	// Cleanup
-	acquiredDesktopImage->Release();
-	desktopResource->Release();
-	g_Application.desktopDuplication->ReleaseFrame();
+	g_Application.frameSource->ReleaseFrame();
+
+	return true;
+}
+
+static BlurCacheKey MakeBlurCacheKey(uint64_t content, float blurRadius)
+{
+	RECT windowRect;
+	GetWindowRect(g_Application.hwnd, &windowRect);
+
+	BlurCacheKey key = {};
+	key.content = content;
+	key.maskVersion = g_Application.maskLayer.version;
+	key.windowRect = { windowRect.left, windowRect.top, windowRect.right, windowRect.bottom };
+	key.radius = blurRadius;
+	key.mode = g_Application.blurMode * 16 + g_Application.blurKernel;
+	return key;
+}
+
+// Puts the output cached for `key` back into blurTexture, false on a miss
+bool RestoreCachedBlur(const BlurCacheKey& key)
+{
+	BlurCache& cache = g_Application.blurCache;
+	if (!g_Application.blurCacheTextures[0])
+		return false;
+
+	const int previous = cache.current;
+	const int slot = BlurCacheLookup(cache, key);
+	TRACE_COUNTER(slot >= 0 ? "blur cache hits" : "blur cache misses", 1);
+	if (slot < 0)
+		return false;
 
+	if (slot != previous)
+	{
+		D3D11_BOX box = { 0, 0, 0, (UINT)g_Application.windowWidth, (UINT)g_Application.windowHeight, 1 };
+		g_Application.deviceContext->CopySubresourceRegion(g_Application.blurTexture, 0, 0, 0, 0, g_Application.blurCacheTextures[slot], 0, &box);
+
+		// cpuBlurOutput still holds the frame before, it can't seed an incremental blur
+		if (g_Application.useCpuBlur)
+			DirtyRegionInvalidate(g_Application.dirtyTracker);
+	}
 	return true;
 }
 
-void ApplyBlurEffect(float blurRadius = 13.0f)
+// Keeps the output that was just blurred for `key`
+void StoreCachedBlur(const BlurCacheKey& key)
 {
+	if (!g_Application.blurCacheTextures[0])
+		return;
+
+	const int slot = BlurCacheInsert(g_Application.blurCache, key);
+	D3D11_BOX box = { 0, 0, 0, (UINT)g_Application.windowWidth, (UINT)g_Application.windowHeight, 1 };
+	g_Application.deviceContext->CopySubresourceRegion(g_Application.blurCacheTextures[slot], 0, 0, 0, 0, g_Application.blurTexture, 0, &box);
+}
+
+void ApplyCpuBlurEffect(float blurRadius)
+{
+	if (!g_Application.desktopStagingTexture || !g_Application.blurTexture)
+		return;
+
+	D3D11_BOX windowBox = { 0, 0, 0, (UINT)g_Application.windowWidth, (UINT)g_Application.windowHeight, 1 };
+	g_Application.deviceContext->CopySubresourceRegion(g_Application.desktopStagingTexture, 0, 0, 0, 0, g_Application.desktopTexture, 0, &windowBox);
+
+	// Never read past the staging texture or the mask layer
+	D3D11_TEXTURE2D_DESC stagingDesc;
+	g_Application.desktopStagingTexture->GetDesc(&stagingDesc);
+
+	BlurConstants constants = {};
+	constants.textureWidth = std::min(std::min((UINT)g_Application.windowWidth, stagingDesc.Width), (UINT)g_Application.maskLayer.width);
+	constants.textureHeight = std::min(std::min((UINT)g_Application.windowHeight, stagingDesc.Height), (UINT)g_Application.maskLayer.height);
+	constants.blurRadius = blurRadius;
+
+	D3D11_MAPPED_SUBRESOURCE desktopMapped;
+	HRESULT hr = g_Application.deviceContext->Map(g_Application.desktopStagingTexture, 0, D3D11_MAP_READ, 0, &desktopMapped);
+	if (FAILED(hr)) return;
+
+	CpuImage input = { (uint8_t*)desktopMapped.pData, (int)desktopMapped.RowPitch };
+	CpuMask mask = MaskLayerCpuMask(g_Application.maskLayer);
+	CpuImage output = { g_Application.cpuBlurOutput.data(), (int)stagingDesc.Width * 4 };
+
+	// Frames that only live on the GPU are hashed here, where their pixels are mapped anyway
+	const bool hashHere = !g_Application.contentHashed;
+	BlurCacheKey key = {};
+	if (hashHere && g_Application.blurCacheTextures[0])
+	{
+		uint64_t content;
+		{
+			TRACE_ZONE("Hash");
+			content = FrameHashImage(input.pixels, input.rowPitch, constants.textureWidth, constants.textureHeight,
+									 g_Application.contentTileHashes, &g_Application.cpuBlur.pool);
+		}
+		key = MakeBlurCacheKey(content, blurRadius);
+		if (RestoreCachedBlur(key))
+		{
+			g_Application.deviceContext->Unmap(g_Application.desktopStagingTexture, 0);
+			return;
+		}
+	}
+
+	if (g_Application.blurMode == BlurMode_DualKawase)
+	{
+		int levels = CpuKawaseLevelsForRadius(blurRadius, constants.textureWidth, constants.textureHeight);
+		CpuKawaseBlur(input, mask, output, constants, levels, g_Application.cpuKawaseScratch);
+	}
+	else if (g_Application.blurMode == BlurMode_RecursiveGaussian)
+	{
+		// Every output pixel depends on the whole row and column, no sparse or incremental path
+		CpuIirGaussianBlur(input, mask, output, constants, IirGaussianSigmaForRadius(blurRadius),
+						   g_Application.cpuIirScratch, &g_Application.cpuBlur.pool);
+	}
+	else if (g_Application.useEffectChain)
+	{
+		// Every stage runs on a tile right after its blur, no sparse or incremental variant
+		CpuTiledEffectRun(g_Application.cpuBlur, g_Application.effectProgram, input, mask, output, constants);
+	}
+	else if (g_Application.dirtyRegion.full && g_Application.usePlanar && g_Application.blurKernel == BlurKernel_Box &&
+			 CpuPlanarBoxBlur(input, mask, output, constants, g_Application.cpuPlanarBlur, &g_Application.cpuBlur.pool))
+	{
+		// Every row of every plane, empty mask tiles included, so it pays off for windows the
+		// mask mostly covers. Radii past CpuBlurFixedMaxRadius fall through to the tiles.
+	}
+	else if (g_Application.dirtyRegion.full)
+	{
+		// Only the tiles the mask covers, maskTiles is classified by UpdateMask
+		CpuSparseBlurRun(g_Application.cpuBlur, g_Application.maskTiles, input, mask, output, constants, g_Application.blurKernel);
+	}
+	else
+	{
+		// Only the pixels the dirty rects reach, the rest of cpuBlurOutput is still last frame's
+		CpuIncrementalBlur(input, mask, output, constants, g_Application.dirtyRegion, g_Application.cpuBlur.scratch[0], g_Application.blurKernel);
+	}
+
+	g_Application.deviceContext->Unmap(g_Application.desktopStagingTexture, 0);
+
+	if (g_Application.dirtyRegion.full || g_Application.blurMode != BlurMode_Box || g_Application.useEffectChain)
+	{
+		D3D11_BOX destBox = { 0, 0, 0, constants.textureWidth, constants.textureHeight, 1 };
+		g_Application.deviceContext->UpdateSubresource(g_Application.blurTexture, 0, &destBox, output.pixels, output.rowPitch, 0);
+		if (hashHere) StoreCachedBlur(key);
+		return;
+	}
+
+	for (const BlurRect& rect : g_Application.dirtyRegion.blurRects)
+	{
+		BlurRect clipped = rect;
+		if (!CpuBlurClipRect(constants, clipped))
+			continue;
+
+		D3D11_BOX destBox = { (UINT)clipped.left, (UINT)clipped.top, 0, (UINT)clipped.right, (UINT)clipped.bottom, 1 };
+		const uint8_t* source = output.pixels + (size_t)clipped.top * output.rowPitch + (size_t)clipped.left * 4;
+		g_Application.deviceContext->UpdateSubresource(g_Application.blurTexture, 0, &destBox, source, output.rowPitch, 0);
+	}
+
+	if (hashHere) StoreCachedBlur(key);
+}
+
+// sourceLease is the pooled texture behind `source`, only its top-left sourceWidth x sourceHeight is read
+static void DispatchKawasePass(ID3D11ComputeShader* shader, ID3D11ShaderResourceView* source, const PoolLease& sourceLease, UINT sourceWidth, UINT sourceHeight,
+							   ID3D11UnorderedAccessView* dest, UINT destWidth, UINT destHeight, bool applyMask)
+{
+	static ID3D11UnorderedAccessView* const NullUAV[] = { nullptr };
+	static ID3D11ShaderResourceView* const NullSRV[] = { nullptr, nullptr };
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HRESULT hr = g_Application.deviceContext->Map(g_Application.kawaseConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	if (FAILED(hr)) return;
+
+	KawaseConstants* constants = (KawaseConstants*)mappedResource.pData;
+	constants->destWidth = destWidth;
+	constants->destHeight = destHeight;
+	constants->sourceTexelWidth = 1.0f / (float)sourceLease.allocatedWidth;
+	constants->sourceTexelHeight = 1.0f / (float)sourceLease.allocatedHeight;
+	constants->sourceUvScaleX = (float)sourceWidth / (float)sourceLease.allocatedWidth;
+	constants->sourceUvScaleY = (float)sourceHeight / (float)sourceLease.allocatedHeight;
+	constants->sourceUvMaxX = ((float)sourceWidth - 0.5f) / (float)sourceLease.allocatedWidth;
+	constants->sourceUvMaxY = ((float)sourceHeight - 0.5f) / (float)sourceLease.allocatedHeight;
+	constants->applyMask = applyMask ? 1 : 0;
+	g_Application.deviceContext->Unmap(g_Application.kawaseConstantBuffer, 0);
+
+	// The previous pass wrote `source` through a UAV, unbind before reading it
+	g_Application.deviceContext->CSSetUnorderedAccessViews(0, 1, &NullUAV[0], nullptr);
+	g_Application.deviceContext->CSSetShaderResources(0, 2, &NullSRV[0]);
+
+	ID3D11ShaderResourceView* srvs[2] = { source, g_Application.maskSRV };
+	g_Application.deviceContext->CSSetShader(shader, nullptr, 0);
+	g_Application.deviceContext->CSSetShaderResources(0, applyMask ? 2 : 1, srvs);
+	g_Application.deviceContext->CSSetUnorderedAccessViews(0, 1, &dest, nullptr);
+	g_Application.deviceContext->Dispatch((destWidth + 7) / 8, (destHeight + 7) / 8, 1);
+}
+
+void ApplyKawaseBlurEffect(float blurRadius)
+{
+	if (!g_Application.kawaseDownsampleShader || !g_Application.kawaseUpsampleShader || !g_Application.desktopSRV)
+		return;
+
+	static ID3D11UnorderedAccessView* const NullUAV[] = { nullptr };
+	static ID3D11ShaderResourceView* const NullSRV[] = { nullptr, nullptr, nullptr };
+	g_Application.deviceContext->PSSetShaderResources(0, 3, &NullSRV[0]);
+	g_Application.deviceContext->OMSetRenderTargets(0, nullptr, nullptr);
+
+	const UINT width = g_Application.windowWidth;
+	const UINT height = g_Application.windowHeight;
+	const int levels = CpuKawaseLevelsForRadius(blurRadius, width, height);
+
+	g_Application.deviceContext->CSSetConstantBuffers(0, 1, &g_Application.kawaseConstantBuffer);
+	g_Application.deviceContext->CSSetSamplers(0, 1, &g_Application.samplerState);
+
+	for (int level = 1; level <= levels; ++level)
+	{
+		ID3D11ShaderResourceView* source = level == 1 ? g_Application.desktopSRV : g_Application.kawaseLevelSRVs[level - 1];
+		const PoolLease& sourceLease = level == 1 ? g_Application.desktopLease : g_Application.kawaseLeases[level - 1];
+		DispatchKawasePass(g_Application.kawaseDownsampleShader,
+						   source, sourceLease, CpuKawaseLevelSize(width, level - 1), CpuKawaseLevelSize(height, level - 1),
+						   g_Application.kawaseLevelUAVs[level], CpuKawaseLevelSize(width, level), CpuKawaseLevelSize(height, level),
+						   false);
+	}
+
+	for (int level = levels - 1; level >= 1; --level)
+	{
+		DispatchKawasePass(g_Application.kawaseUpsampleShader,
+						   g_Application.kawaseLevelSRVs[level + 1], g_Application.kawaseLeases[level + 1], CpuKawaseLevelSize(width, level + 1), CpuKawaseLevelSize(height, level + 1),
+						   g_Application.kawaseLevelUAVs[level], CpuKawaseLevelSize(width, level), CpuKawaseLevelSize(height, level),
+						   false);
+	}
+
+	DispatchKawasePass(g_Application.kawaseUpsampleShader,
+					   g_Application.kawaseLevelSRVs[1], g_Application.kawaseLeases[1], CpuKawaseLevelSize(width, 1), CpuKawaseLevelSize(height, 1),
+					   g_Application.blurOutputUAV, width, height,
+					   true);
+
+	g_Application.deviceContext->CSSetUnorderedAccessViews(0, 1, &NullUAV[0], nullptr);
+	g_Application.deviceContext->CSSetShaderResources(0, 3, &NullSRV[0]);
+	g_Application.deviceContext->CSSetShader(nullptr, nullptr, 0);
+}
+
+void ApplyIirBlurEffect(float blurRadius)
+{
+	if (!g_Application.iirRowShader || !g_Application.iirColumnShader || !g_Application.desktopSRV)
+		return;
+
+	static ID3D11UnorderedAccessView* const NullUAV[] = { nullptr, nullptr };
+	static ID3D11ShaderResourceView* const NullSRV[] = { nullptr, nullptr, nullptr };
+	g_Application.deviceContext->PSSetShaderResources(0, 3, &NullSRV[0]);
+	g_Application.deviceContext->OMSetRenderTargets(0, nullptr, nullptr);
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HRESULT hr = g_Application.deviceContext->Map(g_Application.iirConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	if (FAILED(hr)) return;
+
+	IirGaussianCompute(IirGaussianSigmaForRadius(blurRadius), g_Application.windowWidth, g_Application.windowHeight,
+					   *(IirGaussianConstants*)mappedResource.pData);
+	g_Application.deviceContext->Unmap(g_Application.iirConstantBuffer, 0);
+
+	g_Application.deviceContext->CSSetConstantBuffers(0, 1, &g_Application.iirConstantBuffer);
+
+	g_Application.deviceContext->CSSetShader(g_Application.iirRowShader, nullptr, 0);
+	g_Application.deviceContext->CSSetShaderResources(0, 1, &g_Application.desktopSRV);
+	g_Application.deviceContext->CSSetUnorderedAccessViews(0, 1, &g_Application.iirRowUAV, nullptr);
+	g_Application.deviceContext->Dispatch((g_Application.windowHeight + 63) / 64, 1, 1);
+
+	ID3D11ShaderResourceView* columnSRVs[2] = { nullptr, g_Application.maskSRV };
+	ID3D11UnorderedAccessView* columnUAVs[2] = { g_Application.blurOutputUAV, g_Application.iirRowUAV };
+	g_Application.deviceContext->CSSetShader(g_Application.iirColumnShader, nullptr, 0);
+	g_Application.deviceContext->CSSetShaderResources(0, 2, columnSRVs);
+	g_Application.deviceContext->CSSetUnorderedAccessViews(0, 2, columnUAVs, nullptr);
+	g_Application.deviceContext->Dispatch((g_Application.windowWidth + 63) / 64, 1, 1);
+
+	g_Application.deviceContext->CSSetUnorderedAccessViews(0, 2, &NullUAV[0], nullptr);
+	g_Application.deviceContext->CSSetShaderResources(0, 3, &NullSRV[0]);
+	g_Application.deviceContext->CSSetShader(nullptr, nullptr, 0);
+}
+
+void ApplyBlurEffect(float blurRadius = DefaultBlurRadius)
+{
+	if (g_Application.useCpuBlur)
+	{
+		ApplyCpuBlurEffect(blurRadius);
+		return;
+	}
+
+	if (g_Application.blurMode == BlurMode_DualKawase)
+	{
+		ApplyKawaseBlurEffect(blurRadius);
+		return;
+	}
+
+	if (g_Application.blurMode == BlurMode_RecursiveGaussian)
+	{
+		ApplyIirBlurEffect(blurRadius);
+		return;
+	}
+
 	if (!g_Application.blurComputeShader || !g_Application.desktopSRV)
 		return;
 
@@ -711,7 +1866,11 @@ void ApplyBlurEffect(float blurRadius = 13.0f)
 	g_Application.deviceContext->OMSetRenderTargets(0, nullptr, nullptr);
 
 	// Set compute shader and resources
-	g_Application.deviceContext->CSSetShader(g_Application.blurComputeShader, nullptr, 0);
+	ID3D11ComputeShader* blurShader = g_Application.blurComputeShader;
+	if (g_Application.specializedBlurShader && (int)blurRadius == g_Application.specializedBlurRadius)
+		blurShader = g_Application.specializedBlurShader;
+
+	g_Application.deviceContext->CSSetShader(blurShader, nullptr, 0);
 	g_Application.deviceContext->CSSetConstantBuffers(0, 1, &g_Application.blurConstantBuffer);
 
 	ID3D11ShaderResourceView* srvs[2] = { g_Application.desktopSRV, g_Application.maskSRV };
@@ -719,10 +1878,45 @@ void ApplyBlurEffect(float blurRadius = 13.0f)
 
 	g_Application.deviceContext->CSSetUnorderedAccessViews(0, 1, &g_Application.blurOutputUAV, nullptr);
 
-	// Dispatch compute shader
-	UINT dispatchX = (g_Application.windowWidth + 7) / 8;  // 8x8 thread groups
-	UINT dispatchY = (g_Application.windowHeight + 7) / 8;
-	g_Application.deviceContext->Dispatch(dispatchX, dispatchY, 1);
+	bool specialized = blurShader == g_Application.specializedBlurShader;
+	ID3D11ComputeShader* partialShader = specialized ? g_Application.specializedPartialTileShader : g_Application.partialTileShader;
+	ID3D11ComputeShader* fullShader = specialized ? g_Application.specializedFullTileShader : g_Application.fullTileShader;
+	MaskTileMap& tiles = g_Application.maskTiles;
+
+	if (partialShader && fullShader && g_Application.clearedTileSRV)
+	{
+		// One group per listed tile, the tiles the mask doesn't cover keep their zeros
+		if (!tiles.clearedTiles.empty())
+		{
+			D3D11_BOX box = { 0, 0, 0, (UINT)(tiles.clearedTiles.size() * sizeof(uint32_t)), 1, 1 };
+			g_Application.deviceContext->UpdateSubresource(g_Application.clearedTileBuffer, 0, &box, tiles.clearedTiles.data(), 0, 0);
+			g_Application.deviceContext->CSSetShader(partialShader, nullptr, 0);
+			g_Application.deviceContext->CSSetShaderResources(2, 1, &g_Application.clearedTileSRV);
+			g_Application.deviceContext->Dispatch((UINT)tiles.clearedTiles.size(), 1, 1);
+			MaskTileClearsDone(tiles);
+		}
+
+		if (!tiles.partialTiles.empty())
+		{
+			g_Application.deviceContext->CSSetShader(partialShader, nullptr, 0);
+			g_Application.deviceContext->CSSetShaderResources(2, 1, &g_Application.partialTileSRV);
+			g_Application.deviceContext->Dispatch((UINT)tiles.partialTiles.size(), 1, 1);
+		}
+
+		if (!tiles.fullTiles.empty())
+		{
+			g_Application.deviceContext->CSSetShader(fullShader, nullptr, 0);
+			g_Application.deviceContext->CSSetShaderResources(2, 1, &g_Application.fullTileSRV);
+			g_Application.deviceContext->Dispatch((UINT)tiles.fullTiles.size(), 1, 1);
+		}
+	}
+	else
+	{
+		// Dispatch compute shader
+		UINT dispatchX = (g_Application.windowWidth + 7) / 8;  // 8x8 thread groups
+		UINT dispatchY = (g_Application.windowHeight + 7) / 8;
+		g_Application.deviceContext->Dispatch(dispatchX, dispatchY, 1);
+	}
 
 	// Unbind resources
 	ID3D11ShaderResourceView* nullSRV = nullptr;
@@ -732,8 +1926,29 @@ void ApplyBlurEffect(float blurRadius = 13.0f)
 	g_Application.deviceContext->CSSetShader(nullptr, nullptr, 0);
 }
 
+// Stretches the quad over the in-use part of a pooled texture, rewritten only when that changes
+static void SetQuadUvScale(const PoolLease& lease)
+{
+	const float u = lease.allocatedWidth ? (float)lease.width / (float)lease.allocatedWidth : 1.0f;
+	const float v = lease.allocatedHeight ? (float)lease.height / (float)lease.allocatedHeight : 1.0f;
+	if (u == g_Application.quadUvScale[0] && v == g_Application.quadUvScale[1])
+		return;
+
+	QuadVertex vertices[] = {
+		{-1.0f, -1.0f, 0.0f,	 0.0f, v}, // Bottom Left
+		{-1.0f,	1.0f, 0.0f,	 0.0f, 0.0f}, // Top Left
+		{ 1.0f, -1.0f, 0.0f,	 u, v}, // Bottom Right
+		{ 1.0f,	1.0f, 0.0f,	 u, 0.0f}  // Top Right
+	};
+	g_Application.deviceContext->UpdateSubresource(g_Application.quadVertexBuffer, 0, nullptr, vertices, 0, 0);
+	g_Application.quadUvScale[0] = u;
+	g_Application.quadUvScale[1] = v;
+}
+
 void RenderDesktopQuad()
 {
+	SetQuadUvScale(g_Application.desktopLease);
+
 	// Set vertex buffer
 	UINT stride = sizeof(QuadVertex);
 	UINT offset = 0;
@@ -759,6 +1974,8 @@ void RenderDesktopQuad()
 
 void RenderBlurQuad()
 {
+	SetQuadUvScale(g_Application.blurLease);
+
 	// Set vertex buffer
 	UINT stride = sizeof(QuadVertex);
 	UINT offset = 0;
@@ -803,32 +2020,466 @@ void RenderTriangle()
 	g_Application.deviceContext->Draw(3, 0);
 }
 
-void Render()
+// Whether the device can draw `level`: the GPU box shader takes any radius, the other kernels
+// only exist specialized for the kernel and radius they were compiled with
+static bool TunerLevelAvailable(const BlurTunerLevel& level)
+{
+	if (g_Application.useCpuBlur)
+		return true;
+	if (level.method == BlurTunerMethod_Kawase)
+		return g_Application.kawaseDownsampleShader && g_Application.kawaseUpsampleShader;
+	if (level.method == BlurTunerMethod_Iir)
+		return g_Application.iirRowShader && g_Application.iirColumnShader;
+
+	const int radius = (int)(DefaultBlurRadius * level.radiusScale);
+	if (g_Application.specializedBlurShader && radius == g_Application.specializedBlurRadius)
+		return level.kernel == g_Application.blurKernel;
+	return level.kernel == BlurKernel_Box && g_Application.blurComputeShader;
+}
+
+// Switches the blur to the tuner's level, everything behind the window is blurred again
+static void ApplyTunerLevel()
+{
+	const BlurTunerLevel& level = BlurTunerCurrent(g_Application.tuner);
+	switch (level.method)
+	{
+	case BlurTunerMethod_Direct: g_Application.blurMode = BlurMode_Box; break;
+	case BlurTunerMethod_Iir: g_Application.blurMode = BlurMode_RecursiveGaussian; break;
+	case BlurTunerMethod_Kawase: g_Application.blurMode = BlurMode_DualKawase; break;
+	}
+
+	// The GPU's kernel is baked into the specialized shader, TunerLevelAvailable kept the levels matching it
+	if (g_Application.useCpuBlur)
+		g_Application.blurKernel = level.kernel;
+
+	DirtyRegionInvalidate(g_Application.dirtyTracker);
+	FrameSchedulerPost(g_Application.scheduler, FrameEvent_Parameters);
+	TRACE_COUNTER("blur level", (uint64_t)g_Application.tuner.current);
+}
+
+// The radius the blur runs with, the tuner's cheapest levels shrink it
+static float CurrentBlurRadius()
+{
+	if (!g_Application.useTuner)
+		return DefaultBlurRadius;
+	return DefaultBlurRadius * BlurTunerCurrent(g_Application.tuner).radiusScale;
+}
+
+// Every level of the backend's ladder the device can run, starting from the best looking.
+// The acrylic chain only exists fused into the box and specialized kernels, it isn't tuned.
+HRESULT InitializeBlurTuner(double budgetMs)
+{
+	if (g_Application.useEffectChain || budgetMs <= 0.0)
+		return S_FALSE;
+
+	if (!g_Application.useCpuBlur)
+	{
+		if (!g_Application.kawaseDownsampleShader)
+			InitializeKawaseBlur();
+		if (!g_Application.iirRowShader)
+			InitializeIirBlur();
+
+		D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+		D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+		for (TunerQuery& query : g_Application.tunerQueries)
+		{
+			HRESULT hr = g_Application.device->CreateQuery(&disjointDesc, &query.disjoint);
+			if (SUCCEEDED(hr)) hr = g_Application.device->CreateQuery(&timestampDesc, &query.begin);
+			if (SUCCEEDED(hr)) hr = g_Application.device->CreateQuery(&timestampDesc, &query.end);
+			if (FAILED(hr)) return hr;
+		}
+	}
+
+	const BlurTunerLevel* ladder = g_Application.useCpuBlur ? BlurTunerCpuLevels : BlurTunerGpuLevels;
+	std::vector<BlurTunerLevel> levels;
+	for (int i = 0; i < BlurTunerLevelCount; ++i)
+	{
+		if (TunerLevelAvailable(ladder[i]))
+			levels.push_back(ladder[i]);
+	}
+	if (levels.empty())
+		return S_FALSE;
+
+	BlurTunerConfig config = BlurTunerDefaults;
+	config.budgetUs = budgetMs * 1000.0;
+	BlurTunerStart(g_Application.tuner, config, levels.data(), (int)levels.size());
+	g_Application.useTuner = true;
+	ApplyTunerLevel();
+	return S_OK;
+}
+
+// Hands the tuner the GPU timings that are back, without waiting for the others
+static void ReadTunerQueries()
+{
+	ID3D11DeviceContext* context = g_Application.deviceContext;
+	for (TunerQuery& query : g_Application.tunerQueries)
+	{
+		if (!query.pending)
+			continue;
+
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		UINT64 begin, end;
+		if (context->GetData(query.disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			context->GetData(query.begin, &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			context->GetData(query.end, &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			continue;
+
+		// A disjoint range had the GPU clock change under it, the timestamps mean nothing
+		query.pending = false;
+		if (disjoint.Disjoint || !disjoint.Frequency)
+			continue;
+
+		const double costUs = (double)(end - begin) * 1e6 / (double)disjoint.Frequency;
+		if (BlurTunerAddSample(g_Application.tuner, query.level, costUs, query.pixels, query.pixels))
+			ApplyTunerLevel();
+	}
+}
+
+// ApplyBlurEffect timed for the tuner: wall time on the CPU, timestamp queries on the GPU
+void ApplyTunedBlurEffect(float blurRadius)
+{
+	if (!g_Application.useTuner)
+	{
+		ApplyBlurEffect(blurRadius);
+		return;
+	}
+
+	BlurTuner& tuner = g_Application.tuner;
+	const uint64_t windowPixels = (uint64_t)g_Application.windowWidth * g_Application.windowHeight;
+	if (g_Application.useCpuBlur)
+	{
+		const uint64_t hits = g_Application.blurCache.hits;
+		const int64_t start = SchedulerNowUs();
+		ApplyBlurEffect(blurRadius);
+		const int64_t costUs = SchedulerNowUs() - start;
+
+		// A hit of the hash taken in the CPU path blurred nothing. Box levels only blur the
+		// dirty rects, the others the whole window.
+		if (g_Application.blurCache.hits != hits)
+			return;
+		const uint64_t pixels = g_Application.blurMode == BlurMode_Box
+			? DirtyRegionArea(g_Application.dirtyRegion, g_Application.windowWidth, g_Application.windowHeight)
+			: windowPixels;
+		if (BlurTunerAddSample(tuner, tuner.current, (double)costUs, pixels, windowPixels))
+			ApplyTunerLevel();
+		return;
+	}
+
+	ReadTunerQueries();
+
+	// Every query still in flight, this blur goes untimed
+	TunerQuery& query = g_Application.tunerQueries[g_Application.tunerQueryNext];
+	if (query.pending)
+	{
+		ApplyBlurEffect(blurRadius);
+		return;
+	}
+
+	ID3D11DeviceContext* context = g_Application.deviceContext;
+	context->Begin(query.disjoint);
+	context->End(query.begin);
+	ApplyBlurEffect(blurRadius);
+	context->End(query.end);
+	context->End(query.disjoint);
+
+	query.level = tuner.current;
+	query.pixels = windowPixels;
+	query.pending = true;
+	g_Application.tunerQueryNext = (g_Application.tunerQueryNext + 1) % TunerQueryCount;
+}
+
+// Uploads the rows of the mask that changed since the last frame, nothing when no shape did
+void UpdateMask()
+{
+	BlurRect changed;
+	if (!MaskLayerRasterize(g_Application.maskLayer, &changed))
+		return;
+
+	const MaskLayer& layer = g_Application.maskLayer;
+	D3D11_BOX destBox = { (UINT)changed.left, (UINT)changed.top, 0, (UINT)changed.right, (UINT)changed.bottom, 1 };
+	const uint8_t* source = layer.coverage.data() + (size_t)changed.top * layer.width + changed.left;
+	g_Application.deviceContext->UpdateSubresource(g_Application.maskTexture, 0, &destBox, source, layer.width, 0);
+	TRACE_COUNTER("bytes copied", (uint64_t)(changed.right - changed.left) * (changed.bottom - changed.top));
+
+	// Reclassify from the runs and upload the tile lists the blur dispatches over
+	MaskTileMap& tiles = g_Application.maskTiles;
+	MaskTileClassifyRle(tiles, layer.rle);
+	if (g_Application.fullTileBuffer && !tiles.fullTiles.empty())
+	{
+		D3D11_BOX box = { 0, 0, 0, (UINT)(tiles.fullTiles.size() * sizeof(uint32_t)), 1, 1 };
+		g_Application.deviceContext->UpdateSubresource(g_Application.fullTileBuffer, 0, &box, tiles.fullTiles.data(), 0, 0);
+	}
+	if (g_Application.partialTileBuffer && !tiles.partialTiles.empty())
+	{
+		D3D11_BOX box = { 0, 0, 0, (UINT)(tiles.partialTiles.size() * sizeof(uint32_t)), 1, 1 };
+		g_Application.deviceContext->UpdateSubresource(g_Application.partialTileBuffer, 0, &box, tiles.partialTiles.data(), 0, 0);
+	}
+
+	// The blurred pixels under the changed coverage have to be resolved again
+	RECT windowRect;
+	GetWindowRect(g_Application.hwnd, &windowRect);
+	BlurRect dirty = { windowRect.left + changed.left, windowRect.top + changed.top, windowRect.left + changed.right, windowRect.top + changed.bottom };
+	DirtyRegionAddFrame(g_Application.dirtyTracker, &dirty, 1, nullptr, 0);
+}
+
+// Runs one frame for the scheduler's events. Returns false when nothing on screen changed
+// and the present was skipped.
+bool Render(uint32_t events)
+{
+	// Stage timings are CPU side, GPU work shows up where the driver makes us wait for it
+	TRACE_FRAME();
+	TRACE_ZONE("Render");
+
+	{
+		TRACE_ZONE("Mask");
+		UpdateMask();
+	}
+
+	bool blurChanged = false;
+	{
+		TRACE_ZONE("Blur");
+
+		// desktopTexture and blurTexture keep their content between frames, only blur again
+		// when something behind the window changed or the window moved
+		RECT windowRect;
+		GetWindowRect(g_Application.hwnd, &windowRect);
+		BlurRect blurWindow = { windowRect.left, windowRect.top, windowRect.right, windowRect.bottom };
+		const float blurRadius = CurrentBlurRadius();
+		if (DirtyRegionBuild(g_Application.dirtyTracker, blurWindow, (int)blurRadius, g_Application.dirtyRegion))
+		{
+			// Something was reported, the pixels may still be the same as a frame we blurred
+			BlurCacheKey key = MakeBlurCacheKey(g_Application.contentHash, blurRadius);
+			if (!g_Application.contentHashed || !RestoreCachedBlur(key))
+			{
+				ApplyTunedBlurEffect(blurRadius);
+				if (g_Application.contentHashed)
+					StoreCachedBlur(key);
+				TRACE_COUNTER("pixels blurred", DirtyRegionArea(g_Application.dirtyRegion, g_Application.windowWidth, g_Application.windowHeight));
+			}
+			blurChanged = true;
+		}
+	}
+
+	// The last present still shows exactly this
+	if (!blurChanged && !(events & (FrameEvent_WindowChanged | FrameEvent_Parameters)))
+		return false;
+
+	{
+		TRACE_ZONE("Composite");
+		float clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		g_Application.deviceContext->ClearRenderTargetView(g_Application.renderTargetView, clearColor);
+		g_Application.deviceContext->OMSetRenderTargets(1, &g_Application.renderTargetView, nullptr);
+		RenderBlurQuad();
+		// RenderTriangle();
+	}
+
+	{
+		TRACE_ZONE("Present");
+		// Present the frame, nothing more until the window shows again when none of it does
+		if (g_Application.swapChain->Present(1, 0) == DXGI_STATUS_OCCLUDED)
+			FrameSchedulerSetOccluded(g_Application.scheduler, true, SchedulerNowUs());
+	}
+	return true;
+}
+
+static int64_t SchedulerNowUs()
+{
+	static LARGE_INTEGER frequency;
+	if (!frequency.QuadPart)
+		QueryPerformanceFrequency(&frequency);
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return (int64_t)(counter.QuadPart / frequency.QuadPart * 1000000 + counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
+
+// Resizes one pooled resource, true when it was swapped and its views have to be recreated
+static bool ResizeLease(PoolLease& lease, int width, int height)
+{
+	return ResourcePoolResize(g_Application.resourcePool, lease, width, height, SchedulerNowUs());
+}
+
+// Fits every window-sized resource to the new client size. Pooled resources that still fit
+// are kept and only their in-use part changes, the others are swapped for one of the right
+// size class and their views recreated.
+void ResizeWindowResources()
+{
+	const int width = g_Application.windowWidth;
+	const int height = g_Application.windowHeight;
+
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)width;
+	viewport.Height = (float)height;
+	viewport.MaxDepth = 1.0f;
+	g_Application.deviceContext->RSSetViewports(1, &viewport);
+
+	if (ResizeLease(g_Application.desktopLease, width, height))
+	{
+		g_Application.desktopTexture = (ID3D11Texture2D*)g_Application.desktopLease.resource;
+		ReleaseView(g_Application.desktopSRV);
+		ReleaseView(g_Application.desktopRTV);
+		g_Application.device->CreateShaderResourceView(g_Application.desktopTexture, nullptr, &g_Application.desktopSRV);
+		g_Application.device->CreateRenderTargetView(g_Application.desktopTexture, nullptr, &g_Application.desktopRTV);
+	}
+
+	if (ResizeLease(g_Application.maskLease, width, height))
+	{
+		g_Application.maskTexture = (ID3D11Texture2D*)g_Application.maskLease.resource;
+		ReleaseView(g_Application.maskSRV);
+		g_Application.device->CreateShaderResourceView(g_Application.maskTexture, nullptr, &g_Application.maskSRV);
+	}
+
+	if (ResizeLease(g_Application.blurLease, width, height))
+	{
+		g_Application.blurTexture = (ID3D11Texture2D*)g_Application.blurLease.resource;
+		ReleaseView(g_Application.blurOutputUAV);
+		ReleaseView(g_Application.blurOutputRTV);
+		ReleaseView(g_Application.blurOutputSRV);
+		g_Application.device->CreateUnorderedAccessView(g_Application.blurTexture, nullptr, &g_Application.blurOutputUAV);
+		g_Application.device->CreateRenderTargetView(g_Application.blurTexture, nullptr, &g_Application.blurOutputRTV);
+		g_Application.device->CreateShaderResourceView(g_Application.blurTexture, nullptr, &g_Application.blurOutputSRV);
+	}
+
+	if (ResizeLease(g_Application.stagingLease, width, height))
+		g_Application.desktopStagingTexture = (ID3D11Texture2D*)g_Application.stagingLease.resource;
+	if (g_Application.desktopStagingTexture)
+		g_Application.cpuBlurOutput.resize((size_t)g_Application.stagingLease.allocatedWidth * g_Application.stagingLease.allocatedHeight * 4);
+
+	for (int slot = 0; slot < BlurCacheMaxEntries; ++slot)
+		if (ResizeLease(g_Application.blurCacheLeases[slot], width, height))
+			g_Application.blurCacheTextures[slot] = (ID3D11Texture2D*)g_Application.blurCacheLeases[slot].resource;
+
+	for (int level = 1; level <= CpuKawaseMaxLevels; ++level)
+	{
+		PoolLease& lease = g_Application.kawaseLeases[level];
+		if (!ResizeLease(lease, CpuKawaseLevelSize(width, level), CpuKawaseLevelSize(height, level)))
+			continue;
+
+		g_Application.kawaseLevelTextures[level] = (ID3D11Texture2D*)lease.resource;
+		ReleaseView(g_Application.kawaseLevelSRVs[level]);
+		ReleaseView(g_Application.kawaseLevelUAVs[level]);
+		g_Application.device->CreateShaderResourceView(g_Application.kawaseLevelTextures[level], nullptr, &g_Application.kawaseLevelSRVs[level]);
+		g_Application.device->CreateUnorderedAccessView(g_Application.kawaseLevelTextures[level], nullptr, &g_Application.kawaseLevelUAVs[level]);
+	}
+
+	if (ResizeLease(g_Application.iirRowLease, width * height * 16, 1))
+	{
+		g_Application.iirRowBuffer = (ID3D11Buffer*)g_Application.iirRowLease.resource;
+		ReleaseView(g_Application.iirRowUAV);
+		CreateIirRowView();
+	}
+
+	// The triangle is placed relative to the window, its tiles follow the new size
+	InitializeMask();
+	MaskTileMapReset(g_Application.maskTiles, width, height);
+	const int tileBytes = (int)(std::max<size_t>(1, g_Application.maskTiles.classes.size()) * sizeof(uint32_t));
+	PoolLease* tileLeases[] = { &g_Application.fullTileLease, &g_Application.partialTileLease, &g_Application.clearedTileLease };
+	ID3D11Buffer** tileBuffers[] = { &g_Application.fullTileBuffer, &g_Application.partialTileBuffer, &g_Application.clearedTileBuffer };
+	ID3D11ShaderResourceView** tileSRVs[] = { &g_Application.fullTileSRV, &g_Application.partialTileSRV, &g_Application.clearedTileSRV };
+	for (int i = 0; i < 3; ++i)
+	{
+		if (!ResizeLease(*tileLeases[i], tileBytes, 1))
+			continue;
+
+		*tileBuffers[i] = (ID3D11Buffer*)tileLeases[i]->resource;
+		ReleaseView(*tileSRVs[i]);
+		g_Application.device->CreateShaderResourceView(*tileBuffers[i], nullptr, tileSRVs[i]);
+	}
+
+	// Nothing kept from before matches the new size
+	DirtyRegionInvalidate(g_Application.dirtyTracker);
+	BlurCacheInvalidate(g_Application.blurCache);
+	g_Application.assembledRect = {};
+}
+
+// One wake of the loop: polls the source when the scheduler asks, then runs a frame if one is due
+void RunScheduledFrame()
 {
-	float clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-	g_Application.deviceContext->ClearRenderTargetView(g_Application.renderTargetView, clearColor);
-	g_Application.deviceContext->ClearRenderTargetView(g_Application.desktopRTV, clearColor);
-	g_Application.deviceContext->ClearRenderTargetView(g_Application.blurOutputRTV, clearColor);
-	g_Application.deviceContext->ClearRenderTargetView(g_Application.maskRTV, clearColor);
+	FrameScheduler& scheduler = g_Application.scheduler;
+	const int64_t now = SchedulerNowUs();
+
+	const uint32_t work = FrameSchedulerWake(scheduler, now);
+	if (work & FrameWork_CheckOccluded)
+	{
+		// A test present draws nothing, it only reports whether the window would show
+		if (g_Application.swapChain->Present(0, DXGI_PRESENT_TEST) != DXGI_STATUS_OCCLUDED)
+			FrameSchedulerSetOccluded(scheduler, false, now);
+	}
+
+	if (work & FrameWork_Poll)
+	{
+		TRACE_ZONE("Grab");
+		if (GrabDesktopBehindWindow())
+			FrameSchedulerPost(scheduler, FrameEvent_NewFrame);
+	}
 
-	g_Application.deviceContext->OMSetRenderTargets(1, &g_Application.maskRTV, nullptr);
-	RenderTriangle();
+	if (uint32_t events = FrameSchedulerBeginFrame(scheduler, now))
+		FrameSchedulerEndFrame(scheduler, Render(events));
 
-	g_Application.deviceContext->OMSetRenderTargets(1, &g_Application.renderTargetView, nullptr);
-	GrabDesktopBehindWindow();
+	// Whatever a resize drag left behind goes once the drag has settled
+	ResourcePoolTrim(g_Application.resourcePool, now);
+}
 
-	ApplyBlurEffect();
+// Sleeps until a message arrives or the scheduler's timeout runs out
+void WaitForScheduledWork()
+{
+	const int64_t timeoutUs = FrameSchedulerTimeout(g_Application.scheduler, SchedulerNowUs());
+	if (timeoutUs <= 0)
+		return;
 
-	g_Application.deviceContext->OMSetRenderTargets(1, &g_Application.renderTargetView, nullptr);
-	RenderBlurQuad();
-	// RenderTriangle();
+	if (!g_Application.schedulerTimer)
+	{
+		MsgWaitForMultipleObjectsEx(0, nullptr, (DWORD)((timeoutUs + 999) / 1000), QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+		return;
+	}
 
-	// Present the frame
-	g_Application.swapChain->Present(1, 0);
+	// Relative due time in 100 ns units
+	LARGE_INTEGER dueTime;
+	dueTime.QuadPart = -timeoutUs * 10;
+	SetWaitableTimer(g_Application.schedulerTimer, &dueTime, 0, nullptr, nullptr, FALSE);
+	MsgWaitForMultipleObjectsEx(1, &g_Application.schedulerTimer, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
 }
 
 void Cleanup()
 {
+	if (g_Application.useCpuBlur)
+		CpuTiledBlurStop(g_Application.cpuBlur);
+
+	delete g_Application.frameSource;
+	g_Application.frameSource = nullptr;
+	if (g_Application.captureDevice)
+	{
+		g_Application.captureDevice->Release();
+		g_Application.captureDevice = nullptr;
+	}
+	if (g_Application.recording.thread.joinable())
+		RecordingThreadStop(g_Application.recording);
+	if (g_Application.recordStagingTexture)
+	{
+		g_Application.recordStagingTexture->Release();
+		g_Application.recordStagingTexture = nullptr;
+	}
+	for (size_t i = 0; i < g_Application.desktopSources.size(); ++i)
+	{
+		DxgiFrameSourceStop(*g_Application.desktopSources[i]);
+		delete g_Application.desktopSources[i];
+		if (g_Application.outputTextures[i])
+			g_Application.outputTextures[i]->Release();
+	}
+	g_Application.desktopSources.clear();
+	g_Application.desktopOutputs.clear();
+	g_Application.outputTextures.clear();
+
+	for (TunerQuery& query : g_Application.tunerQueries)
+	{
+		ReleaseView(query.disjoint);
+		ReleaseView(query.begin);
+		ReleaseView(query.end);
+	}
+
+	ResourcePoolDestroy(g_Application.resourcePool);
+	ShaderCacheClose(g_Application.shaderCache);
+
 	if (g_Application.renderTargetView)
 	{
 		g_Application.renderTargetView->Release();
@@ -875,8 +2526,16 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 
 	  case WM_SIZE:
 	  {
+		  // A minimized window has no client area to resize to, it only waits to be restored
+		  if (wParam == SIZE_MINIMIZED)
+		  {
+			  FrameSchedulerSetOccluded(g_Application.scheduler, true, SchedulerNowUs());
+			  return 0;
+		  }
+
 		  if (g_Application.swapChain)
 		  {
+			  FrameSchedulerSetOccluded(g_Application.scheduler, false, SchedulerNowUs());
 			  g_Application.windowWidth = LOWORD(lParam);
 			  g_Application.windowHeight = HIWORD(lParam);
 
@@ -895,27 +2554,123 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			  g_Application.swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&backBuffer);
 			  g_Application.device->CreateRenderTargetView(backBuffer, nullptr, &g_Application.renderTargetView);
 			  backBuffer->Release();
+
+			  ResizeWindowResources();
+			  FrameSchedulerPost(g_Application.scheduler, FrameEvent_WindowChanged);
 		  }
 		  return 0;
 	  }
 
+	  case WM_KEYDOWN:
+	  {
+		  if (wParam == VK_F12 && g_Application.tracePath[0])
+			  TraceWriteChrome(g_Application.tracePath);
+		  break;
+	  }
+
 	  case WM_MOVE:
 	  {
+		  // Dragging runs a modal loop, the main loop doesn't get to the frame
 		  if (g_Application.swapChain)
 		  {
-			  Render();
-			  g_Application.swapChain->Present(1, 0);
+			  FrameSchedulerPost(g_Application.scheduler, FrameEvent_WindowChanged);
+			  RunScheduledFrame();
 		  }
 
 		  return 0;
 	  }
+
+	  case WM_ENTERSIZEMOVE:
+	  {
+		  // Keeps polling the desktop and serving capped frames while the modal loop runs
+		  SetTimer(hwnd, SchedulerTimerId, (UINT)(g_Application.scheduler.config.latencyTargetUs / 1000), nullptr);
+		  return 0;
+	  }
+
+	  case WM_EXITSIZEMOVE:
+	  {
+		  KillTimer(hwnd, SchedulerTimerId);
+		  return 0;
+	  }
+
+	  case WM_TIMER:
+	  {
+		  if (wParam == SchedulerTimerId && g_Application.swapChain)
+			  RunScheduledFrame();
+		  return 0;
+	  }
 	}
 
 	return DefWindowProc(hwnd, uMsg, wParam, lParam);
 }
 
+// <executable>.shadercache
+static void ShaderCachePath(char* path, DWORD size)
+{
+	DWORD length = GetModuleFileNameA(nullptr, path, size);
+	if (length == 0 || length >= size)
+	{
+		strcpy_s(path, size, "BackdropFilterWin32.shadercache");
+		return;
+	}
+	char* extension = strrchr(path, '.');
+	char* name = strrchr(path, '\\');
+	if (!extension || (name && extension < name))
+		extension = path + length;
+	*extension = 0;
+	strcat_s(path, size, ".shadercache");
+}
+
+// Every shader a launch can ask for, so the first run after a build finds them all
+static bool PrecompileShaders()
+{
+	const char* vertexSources[] = { vertexShaderSource, quadVertexShaderSource };
+	const char* pixelSources[] = { pixelShaderSource, quadPixelShaderSource };
+	const char* computeSources[] = { computeShaderSource, kawaseDownsampleShaderSource, kawaseUpsampleShaderSource,
+									 iirRowShaderSource, iirColumnShaderSource };
+
+	const uint8_t* bytecode;
+	size_t size;
+	bool ok = true;
+	for (const char* source : vertexSources)
+		ok = SUCCEEDED(CompileShader(source, "vs_5_0", nullptr, bytecode, size)) && ok;
+	for (const char* source : pixelSources)
+		ok = SUCCEEDED(CompileShader(source, "ps_5_0", nullptr, bytecode, size)) && ok;
+	for (const char* source : computeSources)
+		ok = SUCCEEDED(CompileShader(source, "cs_5_0", nullptr, bytecode, size)) && ok;
+	ok = SUCCEEDED(CompileShader(computeShaderSource, "cs_5_0", PartialTileDefines, bytecode, size)) && ok;
+	ok = SUCCEEDED(CompileShader(computeShaderSource, "cs_5_0", FullTileDefines, bytecode, size)) && ok;
+
+	const int radius = (int)DefaultBlurRadius;
+	for (int kernel = 0; kernel < BlurKernel_Count; ++kernel)
+	{
+		if (!BlurKernelSpecialized((BlurKernelType)kernel, radius))
+			continue;
+		EffectProgram acrylic;
+		EffectChainCompile(AcrylicEffectStages((BlurKernelType)kernel, AcrylicTint), acrylic);
+		for (const std::string& source : { GenerateBlurKernelHlsl((BlurKernelType)kernel, radius), GenerateEffectChainHlsl(acrylic, radius) })
+		{
+			ok = SUCCEEDED(CompileShader(source.c_str(), "cs_5_0", nullptr, bytecode, size)) && ok;
+			ok = SUCCEEDED(CompileShader(source.c_str(), "cs_5_0", PartialTileDefines, bytecode, size)) && ok;
+			ok = SUCCEEDED(CompileShader(source.c_str(), "cs_5_0", FullTileDefines, bytecode, size)) && ok;
+		}
+	}
+	return ok;
+}
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
+	ShaderCachePath(g_Application.shaderCachePath, (DWORD)sizeof(g_Application.shaderCachePath));
+	ShaderCacheOpen(g_Application.shaderCache, g_Application.shaderCachePath, &g_Application.shaderCompiler);
+
+	// --build-shader-cache fills the cache and exits, the build runs it after linking
+	if (strstr(lpCmdLine, "--build-shader-cache"))
+	{
+		bool ok = PrecompileShaders() && ShaderCacheSave(g_Application.shaderCache, g_Application.shaderCachePath);
+		ShaderCacheClose(g_Application.shaderCache);
+		return ok ? 0 : -1;
+	}
+
 	// Initialize window
 	if (!InitializeWindow(800, 600))
 	{
@@ -931,20 +2686,92 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 		return -1;
 	}
 
+	// --source synthetic:text|synthetic:noise|synthetic:static|replay:<pattern>|recording:<path> replaces the desktop
+	char sourceSpec[MAX_PATH] = {};
+	if (const char* sourceArgument = strstr(lpCmdLine, "--source "))
+		sscanf_s(sourceArgument + 9, "%259s", sourceSpec, (unsigned)sizeof(sourceSpec));
+
 	InitializeTriangle();
-	InitializeDesktopCapture();
+	InitializeMask();
+	InitializeDesktopCapture(sourceSpec[0] ? sourceSpec : nullptr);
 	InitializeQuad();
+	if (strstr(lpCmdLine, "--kernel tent"))
+		g_Application.blurKernel = BlurKernel_Tent;
+	else if (strstr(lpCmdLine, "--kernel gaussian"))
+		g_Application.blurKernel = BlurKernel_Gaussian;
+	if (strstr(lpCmdLine, "--acrylic"))
+		g_Application.useEffectChain = EffectChainCompile(AcrylicEffectStages(g_Application.blurKernel, AcrylicTint), g_Application.effectProgram);
+
 	InitializeBlurComputeShader();
+	InitializeSpecializedBlurShader();
+	InitializeSparseBlurTiles();
+
+	if (strstr(lpCmdLine, "--kawase"))
+	{
+		g_Application.blurMode = BlurMode_DualKawase;
+		InitializeKawaseBlur();
+	}
+	else if (strstr(lpCmdLine, "--iir"))
+	{
+		g_Application.blurMode = BlurMode_RecursiveGaussian;
+		InitializeIirBlur();
+	}
+
+	if (g_Application.useCpuBlur)
+		InitializeCpuBlur();
+	g_Application.usePlanar = g_Application.useCpuBlur && strstr(lpCmdLine, "--planar") != nullptr;
+
+	// --tune <ms>: the blur level, kernel and radius follow what the machine manages in that time
+	if (const char* tuneArgument = strstr(lpCmdLine, "--tune "))
+		InitializeBlurTuner(atof(tuneArgument + 7));
+
+	// --blur-cache <entries>, 0 turns it off
+	int blurCacheEntries = 2;
+	if (const char* cacheArgument = strstr(lpCmdLine, "--blur-cache "))
+		blurCacheEntries = atoi(cacheArgument + 13);
+	InitializeBlurCache(blurCacheEntries);
+
+	// Shaders compiled above are there for the next launch
+	ShaderCacheSave(g_Application.shaderCache, g_Application.shaderCachePath);
+
+	DirtyRegionReset(g_Application.dirtyTracker);
+
+	// --trace <path> records every frame, F12 writes the trace, exiting writes it again
+	if (const char* traceArgument = strstr(lpCmdLine, "--trace "))
+	{
+		sscanf_s(traceArgument + 8, "%259s", g_Application.tracePath, (unsigned)sizeof(g_Application.tracePath));
+		TraceEnable(true);
+	}
+
+	// --record <path> keeps every captured frame, --source recording:<path> plays it back
+	if (const char* recordArgument = strstr(lpCmdLine, "--record "))
+		sscanf_s(recordArgument + 9, "%259s", g_Application.recordPath, (unsigned)sizeof(g_Application.recordPath));
+
+	// --fps <cap> (0 uncapped) and --latency <ms>, how late a desktop frame may be noticed
+	FrameSchedulerConfig schedulerConfig = FrameSchedulerDefaults;
+	if (const char* fpsArgument = strstr(lpCmdLine, "--fps "))
+		schedulerConfig.maxFps = atoi(fpsArgument + 6);
+	if (const char* latencyArgument = strstr(lpCmdLine, "--latency "))
+		schedulerConfig.latencyTargetUs = (int64_t)atoi(latencyArgument + 10) * 1000;
+	FrameSchedulerReset(g_Application.scheduler, schedulerConfig, SchedulerNowUs());
+	FrameSchedulerPost(g_Application.scheduler, FrameEvent_WindowChanged | FrameEvent_Parameters);
+
+	// Sleeps shorter than the 15.6 ms system tick need a high resolution timer (Windows 10 1803+)
+	g_Application.schedulerTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (!g_Application.schedulerTimer)
+		g_Application.schedulerTimer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
 
 	g_Application.isRunning = true;
 
 	ShowWindow(g_Application.hwnd, SW_SHOW);
 	UpdateWindow(g_Application.hwnd);
 
-	// Main loop
+	// Main loop, asleep until a message, a desktop poll or a capped frame is due
 	MSG msg = {};
 	while (g_Application.isRunning)
 	{
+		WaitForScheduledWork();
+
 		while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
 		{
 			TranslateMessage(&msg);
@@ -956,10 +2783,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 			break;
 		}
 
-		Render();
-
+		RunScheduledFrame();
 	}
 
+	if (g_Application.schedulerTimer)
+		CloseHandle(g_Application.schedulerTimer);
+
+	if (g_Application.tracePath[0])
+		TraceWriteChrome(g_Application.tracePath);
+
 	Cleanup();
 	return 0;
 }
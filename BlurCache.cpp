@@ -0,0 +1,203 @@
+#include "BlurCache.h"
+#include "Trace.h"
+
+#include <string.h>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+static const uint64_t LaneKeys[4] = {
+	0x9e3779b185ebca87ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull, 0x85ebca77c2b2ae63ull,
+};
+
+static const int LaneRotation = 23;
+
+struct FrameHashState
+{
+	uint64_t acc[4];
+	uint64_t length;
+};
+
+static inline uint64_t Mix(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdull;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ull;
+	x ^= x >> 33;
+	return x;
+}
+
+static inline void HashStart(FrameHashState& state)
+{
+	for (int i = 0; i < 4; ++i) state.acc[i] = LaneKeys[3 - i];
+	state.length = 0;
+}
+
+static inline uint64_t HashFinish(const FrameHashState& state, uint64_t seed)
+{
+	uint64_t h = Mix(seed ^ state.length);
+	for (int i = 0; i < 4; ++i)
+		h = Mix(h ^ state.acc[i]);
+	return h;
+}
+
+// Each lane adds the neighbouring word too, so a word that multiplies to 0 still counts
+static inline void StripeScalar(uint64_t* acc, const uint8_t* data)
+{
+	uint64_t words[4];
+	memcpy(words, data, sizeof(words));
+	for (int i = 0; i < 4; ++i)
+	{
+		uint64_t keyed = words[i] ^ LaneKeys[i];
+		uint64_t sum = acc[i] + words[i ^ 1] + (keyed & 0xffffffffu) * (keyed >> 32);
+		acc[i] = (sum << LaneRotation) | (sum >> (64 - LaneRotation));
+	}
+}
+
+// Whole stripes of `data`, then the rest zero padded into one more
+static void HashUpdate(FrameHashState& state, const uint8_t* data, size_t size)
+{
+	const size_t stripes = size / 32;
+#if defined(__AVX2__)
+	const __m256i keys = _mm256_loadu_si256((const __m256i*)LaneKeys);
+	__m256i acc = _mm256_loadu_si256((const __m256i*)state.acc);
+	for (size_t s = 0; s < stripes; ++s)
+	{
+		__m256i words = _mm256_loadu_si256((const __m256i*)(data + s * 32));
+		__m256i keyed = _mm256_xor_si256(words, keys);
+		__m256i product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+		__m256i swapped = _mm256_shuffle_epi32(words, _MM_SHUFFLE(1, 0, 3, 2));
+		__m256i sum = _mm256_add_epi64(acc, _mm256_add_epi64(swapped, product));
+		acc = _mm256_or_si256(_mm256_slli_epi64(sum, LaneRotation), _mm256_srli_epi64(sum, 64 - LaneRotation));
+	}
+	_mm256_storeu_si256((__m256i*)state.acc, acc);
+#else
+	for (size_t s = 0; s < stripes; ++s)
+		StripeScalar(state.acc, data + s * 32);
+#endif
+
+	const size_t tail = size - stripes * 32;
+	if (tail)
+	{
+		uint8_t last[32] = {};
+		memcpy(last, data + stripes * 32, tail);
+		StripeScalar(state.acc, last);
+	}
+	state.length += size;
+}
+
+uint64_t FrameHashBytes(const uint8_t* data, size_t size, uint64_t seed)
+{
+	FrameHashState state;
+	HashStart(state);
+	HashUpdate(state, data, size);
+	return HashFinish(state, seed);
+}
+
+uint64_t FrameHashImage(const uint8_t* pixels, int rowPitch, int width, int height,
+						std::vector<uint64_t>& tileHashes, ThreadPool* pool)
+{
+	const int tilesAcross = (width + FrameHashTileSize - 1) / FrameHashTileSize;
+	const int tilesDown = (height + FrameHashTileSize - 1) / FrameHashTileSize;
+	tileHashes.resize((size_t)tilesAcross * tilesDown);
+
+	// Row by row across a row of tiles, so the reads stay sequential
+	auto hashTileRow = [&](int tileY, int worker) {
+		TRACE_ZONE("Hash tiles");
+		std::vector<FrameHashState> tileStates(tilesAcross);
+		for (int tileX = 0; tileX < tilesAcross; ++tileX)
+			HashStart(tileStates[tileX]);
+
+		const int top = tileY * FrameHashTileSize;
+		const int bottom = std::min(top + FrameHashTileSize, height);
+		for (int y = top; y < bottom; ++y)
+		{
+			const uint8_t* row = pixels + (size_t)y * rowPitch;
+			for (int tileX = 0; tileX < tilesAcross; ++tileX)
+			{
+				const int left = tileX * FrameHashTileSize;
+				const int right = std::min(left + FrameHashTileSize, width);
+				HashUpdate(tileStates[tileX], row + (size_t)left * 4, (size_t)(right - left) * 4);
+			}
+		}
+
+		for (int tileX = 0; tileX < tilesAcross; ++tileX)
+			tileHashes[(size_t)tileY * tilesAcross + tileX] = HashFinish(tileStates[tileX], 0);
+	};
+
+	if (pool)
+		ThreadPoolParallelFor(*pool, tilesDown, hashTileRow);
+	else
+		for (int tileY = 0; tileY < tilesDown; ++tileY) hashTileRow(tileY, 0);
+
+	const uint64_t size = (uint64_t)(uint32_t)width | ((uint64_t)(uint32_t)height << 32);
+	return FrameHashBytes((const uint8_t*)tileHashes.data(), tileHashes.size() * sizeof(uint64_t), size);
+}
+
+static bool KeysEqual(const BlurCacheKey& a, const BlurCacheKey& b)
+{
+	return a.content == b.content && a.maskVersion == b.maskVersion && a.radius == b.radius && a.mode == b.mode &&
+		   a.windowRect.left == b.windowRect.left && a.windowRect.top == b.windowRect.top &&
+		   a.windowRect.right == b.windowRect.right && a.windowRect.bottom == b.windowRect.bottom;
+}
+
+void BlurCacheReset(BlurCache& cache, int capacity)
+{
+	cache.capacity = std::min(std::max(capacity, 1), BlurCacheMaxEntries);
+	cache.clock = 0;
+	cache.hits = 0;
+	cache.misses = 0;
+	BlurCacheInvalidate(cache);
+}
+
+void BlurCacheInvalidate(BlurCache& cache)
+{
+	for (BlurCacheEntry& entry : cache.entries)
+		entry.valid = false;
+	cache.current = -1;
+}
+
+int BlurCacheLookup(BlurCache& cache, const BlurCacheKey& key)
+{
+	for (int slot = 0; slot < cache.capacity; ++slot)
+	{
+		BlurCacheEntry& entry = cache.entries[slot];
+		if (entry.valid && KeysEqual(entry.key, key))
+		{
+			entry.lastUse = ++cache.clock;
+			cache.current = slot;
+			++cache.hits;
+			return slot;
+		}
+	}
+
+	// The caller is about to overwrite its output
+	cache.current = -1;
+	++cache.misses;
+	return -1;
+}
+
+int BlurCacheInsert(BlurCache& cache, const BlurCacheKey& key)
+{
+	int slot = 0;
+	for (int i = 0; i < cache.capacity; ++i)
+	{
+		if (!cache.entries[i].valid)
+		{
+			slot = i;
+			break;
+		}
+		if (cache.entries[i].lastUse < cache.entries[slot].lastUse)
+			slot = i;
+	}
+
+	BlurCacheEntry& entry = cache.entries[slot];
+	entry.valid = true;
+	entry.key = key;
+	entry.lastUse = ++cache.clock;
+	cache.current = slot;
+	return slot;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "CpuBlur.h"
+#include "ThreadPool.h"
+
+// Memoizes blurred outputs by what produced them: a content hash of the captured pixels,
+// the radius, the mask version, the window rect and the mode. Catches what the duplication
+// metadata can't, e.g. repaints with identical pixels, a caret blinking between two states
+// or a window dragged back to where it was.
+//
+// The hash is not cryptographic. Four 64-bit lanes take 32 bytes per step, each adds its
+// word plus the product of the word's two halves, then rotates so the order matters. The
+// scalar and AVX2 paths do the same math and give the same hashes.
+static const int FrameHashTileSize = 64;
+
+uint64_t FrameHashBytes(const uint8_t* data, size_t size, uint64_t seed = 0);
+
+// Hashes every tile of a BGRA image, then the tile hashes in order. tileHashes receives one
+// hash per FrameHashTileSize tile, row-major. Rows of tiles are split across `pool`.
+uint64_t FrameHashImage(const uint8_t* pixels, int rowPitch, int width, int height,
+						std::vector<uint64_t>& tileHashes, ThreadPool* pool = nullptr);
+
+struct BlurCacheKey
+{
+	uint64_t content;	   // FrameHashImage of the blurred input
+	uint64_t maskVersion;  // MaskLayer::version
+	BlurRect windowRect;   // Desktop coordinates
+	float radius;
+	int mode;			   // Whatever else changes the output, e.g. mode and kernel
+};
+
+static const int BlurCacheMaxEntries = 4;
+
+struct BlurCacheEntry
+{
+	bool valid;
+	BlurCacheKey key;
+	uint64_t lastUse;
+};
+
+// Only keys and slot numbers, the caller keeps one output per slot
+struct BlurCache
+{
+	BlurCacheEntry entries[BlurCacheMaxEntries];
+	int capacity;
+	int current;  // Slot the caller's live output matches, -1 when it matches none
+	uint64_t clock;
+	uint64_t hits;
+	uint64_t misses;
+};
+
+// Drops every entry and the counters, capacity is clamped to [1, BlurCacheMaxEntries]
+void BlurCacheReset(BlurCache& cache, int capacity = BlurCacheMaxEntries);
+
+// Drops every entry but keeps the counters, e.g. after the outputs were recreated
+void BlurCacheInvalidate(BlurCache& cache);
+
+// Slot holding the output for `key` or -1, counts a hit or a miss. A hit becomes current,
+// after a miss nothing is.
+int BlurCacheLookup(BlurCache& cache, const BlurCacheKey& key);
+
+// Slot to keep a freshly blurred output for `key` in, the least recently used one. It
+// becomes current.
+int BlurCacheInsert(BlurCache& cache, const BlurCacheKey& key);
@@ -0,0 +1,323 @@
+#include "BlurKernels.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <algorithm>
+#include <utility>
+
+// Rounds like CpuBlurResolvePixel, with 64-bit sums for the generic path
+template <typename Sum>
+static inline void ResolveWeighted(const Sum* sums, uint64_t weightSum, uint8_t coverage, uint8_t* out)
+{
+	if (coverage == 0)
+	{
+		out[0] = out[1] = out[2] = out[3] = 0;
+		return;
+	}
+
+	for (int c = 0; c < 3; ++c)
+		out[c] = (uint8_t)((2 * (uint64_t)sums[c] + weightSum) / (2 * weightSum));
+
+	uint64_t alphaDivisor = weightSum * 255;
+	out[3] = (uint8_t)((2 * (uint64_t)sums[3] * coverage + alphaDivisor) / (2 * alphaDivisor));
+}
+
+// Rows of the horizontal pass the vertical taps of `rect` can reach
+static int PrepareRows(const BlurConstants& constants, const BlurRect& rect, int radius, CpuBlurScratch& scratch,
+					   int& rowBegin, int& rowEnd)
+{
+	rowBegin = std::max(0, rect.top - radius);
+	rowEnd = std::min((int)constants.textureHeight, rect.bottom + radius);
+	int rowStride = (rect.right - rect.left) * 4;
+	scratch.rowSums.resize((size_t)rowStride * (rowEnd - rowBegin));
+	return rowStride;
+}
+
+// Both passes as fold expressions over the taps, weights are compile-time constants
+template <BlurKernelType Type, int Radius>
+struct UnrolledKernel
+{
+	static constexpr BlurKernelWeights<Type, Radius> Weights = {};
+
+	template <bool Clamp, size_t Tap>
+	static inline void HorizontalTap(const uint8_t* row, int x, int width, uint32_t& b, uint32_t& g, uint32_t& r, uint32_t& a)
+	{
+		int sampleX = x + (int)Tap - Radius;
+		if (Clamp) sampleX = CpuBlurClamp(sampleX, 0, width - 1);
+		const uint8_t* p = row + sampleX * 4;
+		b += p[0] * Weights.values[Tap];
+		g += p[1] * Weights.values[Tap];
+		r += p[2] * Weights.values[Tap];
+		a += p[3] * Weights.values[Tap];
+	}
+
+	template <bool Clamp, size_t... Tap>
+	static inline void HorizontalPixel(const uint8_t* row, int x, int width, uint32_t* sums, std::index_sequence<Tap...>)
+	{
+		uint32_t b = 0, g = 0, r = 0, a = 0;
+		(HorizontalTap<Clamp, Tap>(row, x, width, b, g, r, a), ...);
+
+		sums[0] = b;
+		sums[1] = g;
+		sums[2] = r;
+		sums[3] = a;
+	}
+
+	template <size_t... Tap>
+	static inline void VerticalRow(const uint32_t* const* rows, int count, uint32_t* acc, std::index_sequence<Tap...>)
+	{
+		for (int i = 0; i < count; ++i)
+			acc[i] = ((rows[Tap][i] * Weights.values[Tap]) + ...);
+	}
+
+	static void Run(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+					const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+	{
+		BlurRect clipped = rect;
+		if (!CpuBlurClipRect(constants, clipped))
+			return;
+
+		const int width = (int)constants.textureWidth;
+		const int height = (int)constants.textureHeight;
+		constexpr auto Taps = std::make_index_sequence<2 * Radius + 1>();
+
+		int rowBegin, rowEnd;
+		const int rowStride = PrepareRows(constants, clipped, Radius, scratch, rowBegin, rowEnd);
+		scratch.columnSums.resize(rowStride);
+
+		// Only pixels within Radius of the left/right edge need clamped taps
+		const int interiorBegin = std::min(clipped.right, std::max(clipped.left, Radius));
+		const int interiorEnd = std::max(interiorBegin, std::min(clipped.right, width - Radius));
+
+		for (int y = rowBegin; y < rowEnd; ++y)
+		{
+			const uint8_t* row = input.pixels + (size_t)y * input.rowPitch;
+			uint32_t* sums = scratch.rowSums.data() + (size_t)(y - rowBegin) * rowStride - clipped.left * 4;
+
+			int x = clipped.left;
+			for (; x < interiorBegin; ++x)
+				HorizontalPixel<true>(row, x, width, sums + x * 4, Taps);
+			for (; x < interiorEnd; ++x)
+				HorizontalPixel<false>(row, x, width, sums + x * 4, Taps);
+			for (; x < clipped.right; ++x)
+				HorizontalPixel<true>(row, x, width, sums + x * 4, Taps);
+		}
+
+		const uint64_t weightSum = (uint64_t)Weights.sum * Weights.sum;
+		uint32_t* acc = scratch.columnSums.data();
+		for (int y = clipped.top; y < clipped.bottom; ++y)
+		{
+			const uint32_t* rows[2 * Radius + 1];
+			for (int tap = 0; tap < 2 * Radius + 1; ++tap)
+			{
+				int sampleY = CpuBlurClamp(y + tap - Radius, 0, height - 1);
+				rows[tap] = scratch.rowSums.data() + (size_t)(sampleY - rowBegin) * rowStride;
+			}
+			VerticalRow(rows, rowStride, acc, Taps);
+
+			uint8_t* dst = output.pixels + (size_t)y * output.rowPitch + (size_t)clipped.left * 4;
+			for (int x = 0; x < rowStride / 4; ++x)
+				ResolveWeighted(acc + x * 4, weightSum, CpuMaskCoverage(mask, clipped.left + x, y), dst + x * 4);
+		}
+	}
+};
+
+// One unrolled instantiation per radius, looked up by BlurKernelSpecialized
+template <BlurKernelType Type, size_t... Radius>
+static void FillKernelRow(BlurKernelFunction* row, std::index_sequence<Radius...>)
+{
+	((row[Radius] = &UnrolledKernel<Type, (int)Radius>::Run), ...);
+}
+
+struct BlurKernelTable
+{
+	BlurKernelFunction functions[BlurKernel_Count][BlurKernelMaxSpecializedRadius + 1];
+
+	BlurKernelTable()
+	{
+		constexpr auto Radii = std::make_index_sequence<BlurKernelMaxSpecializedRadius + 1>();
+		FillKernelRow<BlurKernel_Box>(functions[BlurKernel_Box], Radii);
+		FillKernelRow<BlurKernel_Tent>(functions[BlurKernel_Tent], Radii);
+		FillKernelRow<BlurKernel_Gaussian>(functions[BlurKernel_Gaussian], Radii);
+	}
+};
+
+static const BlurKernelTable g_BlurKernelTable;
+
+BlurKernelFunction BlurKernelSpecialized(BlurKernelType type, int radius)
+{
+	if (type < 0 || type >= BlurKernel_Count || radius < 0 || radius > BlurKernelMaxSpecializedRadius)
+		return nullptr;
+	return g_BlurKernelTable.functions[type][radius];
+}
+
+void CpuBlurKernelGenericRect(BlurKernelType type, const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+							  const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+	BlurRect clipped = rect;
+	if (!CpuBlurClipRect(constants, clipped))
+		return;
+
+	const int width = (int)constants.textureWidth;
+	const int height = (int)constants.textureHeight;
+	const int radius = CpuBlurRadius(constants);
+
+	std::vector<uint32_t> weights(2 * radius + 1);
+	uint64_t weightSum1D = 0;
+	for (int tap = -radius; tap <= radius; ++tap)
+	{
+		weights[tap + radius] = BlurKernelWeight(type, radius, tap);
+		weightSum1D += weights[tap + radius];
+	}
+
+	int rowBegin, rowEnd;
+	const int rowStride = PrepareRows(constants, clipped, radius, scratch, rowBegin, rowEnd);
+
+	for (int y = rowBegin; y < rowEnd; ++y)
+	{
+		const uint8_t* row = input.pixels + (size_t)y * input.rowPitch;
+		uint32_t* sums = scratch.rowSums.data() + (size_t)(y - rowBegin) * rowStride;
+		for (int x = clipped.left; x < clipped.right; ++x, sums += 4)
+		{
+			uint32_t acc[4] = {};
+			for (int tap = -radius; tap <= radius; ++tap)
+			{
+				const uint8_t* p = row + CpuBlurClamp(x + tap, 0, width - 1) * 4;
+				for (int c = 0; c < 4; ++c) acc[c] += p[c] * weights[tap + radius];
+			}
+			for (int c = 0; c < 4; ++c) sums[c] = acc[c];
+		}
+	}
+
+	std::vector<uint64_t> acc(rowStride);
+	for (int y = clipped.top; y < clipped.bottom; ++y)
+	{
+		std::fill(acc.begin(), acc.end(), 0);
+		for (int tap = -radius; tap <= radius; ++tap)
+		{
+			int sampleY = CpuBlurClamp(y + tap, 0, height - 1);
+			const uint32_t* sums = scratch.rowSums.data() + (size_t)(sampleY - rowBegin) * rowStride;
+			for (int i = 0; i < rowStride; ++i) acc[i] += (uint64_t)sums[i] * weights[tap + radius];
+		}
+
+		uint8_t* dst = output.pixels + (size_t)y * output.rowPitch + (size_t)clipped.left * 4;
+		for (int x = 0; x < rowStride / 4; ++x)
+			ResolveWeighted(acc.data() + x * 4, weightSum1D * weightSum1D, CpuMaskCoverage(mask, clipped.left + x, y), dst + x * 4);
+	}
+}
+
+void CpuBlurKernelRect(BlurKernelType type, const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+					   const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+	BlurKernelFunction specialized = BlurKernelSpecialized(type, CpuBlurRadius(constants));
+	if (specialized)
+		specialized(input, mask, output, constants, rect, scratch);
+	else
+		CpuBlurKernelGenericRect(type, input, mask, output, constants, rect, scratch);
+}
+
+const char* BlurKernelName(BlurKernelType type)
+{
+	switch (type)
+	{
+	  case BlurKernel_Box: return "box";
+	  case BlurKernel_Tent: return "tent";
+	  case BlurKernel_Gaussian: return "gaussian";
+	  default: return "unknown";
+	}
+}
+
+static void AppendFormat(std::string& text, const char* format, ...)
+{
+	char buffer[256];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	if (length > 0) text.append(buffer, std::min(length, (int)sizeof(buffer) - 1));
+}
+
+// Same layout and semantics as computeShaderSource, the output is stable text so it can be diffed
+std::string GenerateBlurKernelHlsl(BlurKernelType type, int radius, const char* resolve)
+{
+	radius = CpuBlurClamp(radius, 0, CpuBlurMaxRadius);
+	const uint32_t weightSum = BlurKernelWeightSum(type, radius);
+
+	std::string text;
+	AppendFormat(text, "// %s kernel, radius %d, generated by GenerateBlurKernelHlsl\n", BlurKernelName(type), radius);
+	text +=
+		"cbuffer BlurConstants : register(b0)\n"
+		"{\n"
+		"\tuint textureWidth;\n"
+		"\tuint textureHeight;\n"
+		"\tfloat blurRadius;\n"
+		"\tfloat padding;\n"
+		"};\n"
+		"\n"
+		"Texture2D<float4> InputTexture : register(t0);\n"
+		"Texture2D<float> MaskTexture : register(t1);\n"
+		"RWTexture2D<float4> OutputTexture : register(u0);\n"
+		"\n";
+
+	AppendFormat(text, "static const int Radius = %d;\n", radius);
+	AppendFormat(text, "static const float Weights[%d] = {", 2 * radius + 1);
+	for (int tap = -radius; tap <= radius; ++tap)
+		AppendFormat(text, "%s%u.0", tap == -radius ? " " : ", ", BlurKernelWeight(type, radius, tap));
+	text += " };\n";
+	AppendFormat(text, "static const float WeightSum = %llu.0;\n", (unsigned long long)weightSum * weightSum);
+
+	text +=
+		"\n"
+		"#ifdef SPARSE_TILES\n"
+		"StructuredBuffer<uint> TileList : register(t2);\n"
+		"\n"
+		"[numthreads(8, 8, 1)]\n"
+		"void main(uint3 group : SV_GroupID, uint3 groupThread : SV_GroupThreadID)\n"
+		"{\n"
+		"\tuint tile = TileList[group.x];\n"
+		"\tuint2 id = uint2(tile & 0xffff, tile >> 16) * 8 + groupThread.xy;\n"
+		"#else\n"
+		"[numthreads(8, 8, 1)]\n"
+		"void main(uint3 id : SV_DispatchThreadID)\n"
+		"{\n"
+		"#endif\n"
+		"\tif (id.x >= textureWidth || id.y >= textureHeight)\n"
+		"\t\treturn;\n"
+		"\n"
+		"#ifdef FULL_TILES\n"
+		"\tfloat maskValue = 1.0;\n"
+		"#else\n"
+		"\tfloat maskValue = MaskTexture[id.xy];\n"
+		"#endif\n"
+		"\tif (maskValue <= 0.0)\n"
+		"\t{\n"
+		"\t\tOutputTexture[id.xy] = float4(0, 0, 0, 0);\n"
+		"\t\treturn;\n"
+		"\t}\n"
+		"\n"
+		"\tfloat4 color = float4(0, 0, 0, 0);\n"
+		"\n"
+		"\t[unroll]\n"
+		"\tfor (int x = -Radius; x <= Radius; x++)\n"
+		"\t{\n"
+		"\t\t[unroll]\n"
+		"\t\tfor (int y = -Radius; y <= Radius; y++)\n"
+		"\t\t{\n"
+		"\t\t\tint sampleX = clamp((int)id.x + x, 0, (int)textureWidth - 1);\n"
+		"\t\t\tint sampleY = clamp((int)id.y + y, 0, (int)textureHeight - 1);\n"
+		"\t\t\tcolor += InputTexture[uint2(sampleX, sampleY)] * (Weights[x + Radius] * Weights[y + Radius]);\n"
+		"\t\t}\n"
+		"\t}\n"
+		"\n";
+
+	if (resolve)
+		text += resolve;
+	else
+		text +=
+			"\tcolor /= WeightSum;\n"
+			"\tcolor.a *= maskValue;\n"
+			"\tOutputTexture[id.xy] = color;\n";
+	text += "}\n";
+
+	return text;
+}
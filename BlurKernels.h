@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+
+#include "CpuBlur.h"
+
+// Radius-specialized blur kernels. Weights are integers computed at compile time, the CPU
+// kernels are unrolled per (type, radius) and GenerateBlurKernelHlsl bakes the same weights
+// into an unrolled variant of computeShaderSource.
+enum BlurKernelType
+{
+	BlurKernel_Box,
+	BlurKernel_Tent,
+	BlurKernel_Gaussian,
+	BlurKernel_Count,
+};
+
+// Radii 0..BlurKernelMaxSpecializedRadius have unrolled variants, larger ones use the generic loop
+static const int BlurKernelMaxSpecializedRadius = 16;
+
+// exp(x) for x <= 0 that can run at compile time: Taylor series of exp(x / 64) squared back up
+constexpr double BlurKernelExp(double x)
+{
+	double y = x / 64.0;
+	double term = 1.0;
+	double sum = 1.0;
+	for (int i = 1; i < 16; ++i)
+	{
+		term *= y / i;
+		sum += term;
+	}
+	for (int i = 0; i < 6; ++i)
+		sum *= sum;
+	return sum;
+}
+
+// 1D tap weight. Gaussian uses sigma = radius / 3 in 1/64 steps, never below 1
+// so the support matches the radius.
+constexpr uint32_t BlurKernelWeight(BlurKernelType type, int radius, int offset)
+{
+	int distance = offset < 0 ? -offset : offset;
+	switch (type)
+	{
+	  case BlurKernel_Tent:
+		  return (uint32_t)(radius + 1 - distance);
+
+	  case BlurKernel_Gaussian:
+	  {
+		  if (radius == 0) return 1;
+		  double sigma = radius / 3.0;
+		  uint32_t weight = (uint32_t)(64.0 * BlurKernelExp(-(distance * distance) / (2.0 * sigma * sigma)) + 0.5);
+		  return weight < 1 ? 1 : weight;
+	  }
+
+	  default:
+		  return 1;
+	}
+}
+
+constexpr uint32_t BlurKernelWeightSum(BlurKernelType type, int radius)
+{
+	uint32_t sum = 0;
+	for (int offset = -radius; offset <= radius; ++offset)
+		sum += BlurKernelWeight(type, radius, offset);
+	return sum;
+}
+
+template <BlurKernelType Type, int Radius>
+struct BlurKernelWeights
+{
+	static constexpr int Taps = 2 * Radius + 1;
+	uint32_t values[Taps];
+	uint32_t sum;
+
+	constexpr BlurKernelWeights() : values(), sum(0)
+	{
+		for (int i = 0; i < Taps; ++i)
+		{
+			values[i] = BlurKernelWeight(Type, Radius, i - Radius);
+			sum += values[i];
+		}
+	}
+};
+
+// Keeps the 2D weight sum times 255 inside the 32-bit accumulators
+static_assert(255ull * BlurKernelWeightSum(BlurKernel_Gaussian, BlurKernelMaxSpecializedRadius) *
+			  BlurKernelWeightSum(BlurKernel_Gaussian, BlurKernelMaxSpecializedRadius) < (1ull << 32),
+			  "Gaussian weights overflow the accumulators");
+
+typedef void (*BlurKernelFunction)(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+								   const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch);
+
+// Unrolled variant for (type, radius), nullptr when there is none
+BlurKernelFunction BlurKernelSpecialized(BlurKernelType type, int radius);
+
+// Runtime weights, any radius the 32-bit accumulators allow
+void CpuBlurKernelGenericRect(BlurKernelType type, const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+							  const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch);
+
+// Separable weighted blur with the shader's clamp and mask semantics, specialized when possible
+void CpuBlurKernelRect(BlurKernelType type, const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+					   const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch);
+
+const char* BlurKernelName(BlurKernelType type);
+
+// Compute shader with the weights baked in and both loops [unroll]ed, drop-in for computeShaderSource
+// including its SPARSE_TILES and FULL_TILES variants. `resolve` replaces the code that turns the
+// weighted sum `color` into OutputTexture[id.xy], it sees WeightSum, maskValue and id.
+std::string GenerateBlurKernelHlsl(BlurKernelType type, int radius, const char* resolve = nullptr);
@@ -0,0 +1,109 @@
+#include "BlurPipeline.h"
+#include "ImageView.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+void BlurPipelineStart(BlurPipeline& pipeline, const BlurRect& window, float radius, BlurKernelType kernel, int threadCount)
+{
+	CpuTiledBlurStart(pipeline.blur, threadCount);
+	DirtyRegionReset(pipeline.tracker);
+	pipeline.kernel = kernel;
+	pipeline.radius = radius;
+	pipeline.window = window;
+	pipeline.mask = {};
+	pipeline.output.assign((size_t)(window.right - window.left) * (window.bottom - window.top) * 4, 0);
+}
+
+void BlurPipelineStop(BlurPipeline& pipeline)
+{
+	CpuTiledBlurStop(pipeline.blur);
+	pipeline.output.clear();
+}
+
+// Blurs the region straight out of the frame, clamped at the frame's edges
+static void BlurFromFrame(BlurPipeline& pipeline)
+{
+	const int windowWidth = pipeline.window.right - pipeline.window.left;
+	const ImageView frame = { (uint8_t*)pipeline.frame.pixels, pipeline.frame.width, pipeline.frame.height, pipeline.frame.rowPitch,
+							  ImageFormat_BGRA8 };
+	const ImageView window = { pipeline.output.data(), windowWidth, pipeline.window.bottom - pipeline.window.top, windowWidth * 4,
+							   ImageFormat_BGRA8 };
+
+	ImageViewBlur plan;
+	const bool onFrame = ImageViewPlanBlur(frame, pipeline.window, pipeline.radius, plan);
+
+	// Off the frame there is nothing behind the window
+	const BlurRect& visible = plan.visible;
+	const bool whole = onFrame && visible.left == pipeline.window.left && visible.top == pipeline.window.top &&
+		visible.right == pipeline.window.right && visible.bottom == pipeline.window.bottom;
+	if (pipeline.region.full && !whole)
+		ImageViewClear(window);
+	if (!onFrame)
+		return;
+
+	const CpuImage source = ImageViewCpuImage(plan.source);
+	const CpuImage output = CpuImageAt(ImageViewCpuImage(window), plan.windowX, plan.windowY);
+	const CpuMask mask = CpuMaskAt(pipeline.mask, plan.windowX, plan.windowY);
+	if (pipeline.region.full)
+	{
+		CpuTiledBlurRunRect(pipeline.blur, source, mask, output, plan.constants, plan.rect, pipeline.kernel);
+		return;
+	}
+
+	pipeline.viewRegion.full = false;
+	pipeline.viewRegion.blurRects.clear();
+	for (const BlurRect& rect : pipeline.region.blurRects)
+	{
+		BlurRect local = { rect.left - plan.windowX, rect.top - plan.windowY, rect.right - plan.windowX, rect.bottom - plan.windowY };
+		local.left = std::max(local.left, plan.rect.left);
+		local.top = std::max(local.top, plan.rect.top);
+		local.right = std::min(local.right, plan.rect.right);
+		local.bottom = std::min(local.bottom, plan.rect.bottom);
+		if (local.left < local.right && local.top < local.bottom)
+			pipeline.viewRegion.blurRects.push_back(local);
+	}
+	CpuIncrementalBlur(source, mask, output, plan.constants, pipeline.viewRegion, pipeline.blur.scratch[0], pipeline.kernel);
+}
+
+FrameSourceResult BlurPipelineStep(BlurPipeline& pipeline, FrameSource& source, int timeoutMs, bool* blurred)
+{
+	if (blurred) *blurred = false;
+
+	FrameSourceResult result;
+	{
+		TRACE_ZONE("Acquire");
+		result = source.AcquireFrame(timeoutMs, pipeline.frame);
+	}
+	if (result == FrameSource_Timeout)
+		TRACE_COUNTER("timeouts", 1);
+	if (result == FrameSource_Lost)
+		DirtyRegionInvalidate(pipeline.tracker);
+	if (result != FrameSource_Ok)
+		return result;
+
+	if (!pipeline.frame.pixels)
+	{
+		source.ReleaseFrame();
+		return result;
+	}
+
+	DirtyRegionAddFrame(pipeline.tracker, pipeline.frame);
+	if (DirtyRegionBuildApron(pipeline.tracker, pipeline.window, (int)pipeline.radius, pipeline.region))
+	{
+		{
+			TRACE_ZONE("Blur");
+			BlurFromFrame(pipeline);
+			TRACE_COUNTER("pixels blurred", DirtyRegionArea(pipeline.region, pipeline.window.right - pipeline.window.left,
+															pipeline.window.bottom - pipeline.window.top));
+		}
+		// The blur read the frame in place, it is only done with it now
+		source.ReleaseFrame();
+
+		if (blurred) *blurred = true;
+		return result;
+	}
+
+	source.ReleaseFrame();
+	return result;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "BlurKernels.h"
+#include "CpuBlurTiled.h"
+#include "DirtyRegion.h"
+#include "FrameSource.h"
+
+// Headless GrabDesktopBehindWindow + ApplyCpuBlurEffect: frames from any FrameSource, the
+// window region re-blurred where they changed, entirely on the CPU. The blur reads the frame
+// in place through an ImageView, nothing is copied out of it first.
+struct BlurPipeline
+{
+	CpuTiledBlur blur;
+	DirtyRegionTracker tracker;
+	DirtyRegion region;
+	Frame frame;
+	BlurKernelType kernel;
+	float radius;
+	BlurRect window;			  // Desktop coordinates, can hang off the frame
+	CpuMask mask;				  // Window-local, fully covered unless set after BlurPipelineStart
+	DirtyRegion viewRegion;		  // region's blurRects, source-local
+	std::vector<uint8_t> output;  // Window-sized BGRA, transparent black where the window is off the frame
+};
+
+void BlurPipelineStart(BlurPipeline& pipeline, const BlurRect& window, float radius,
+					   BlurKernelType kernel = BlurKernel_Box, int threadCount = 0);
+void BlurPipelineStop(BlurPipeline& pipeline);
+
+// Acquires one frame and blurs what changed behind the window. `blurred` is set when
+// the output changed, frames without pixels (GPU-only) are skipped.
+FrameSourceResult BlurPipelineStep(BlurPipeline& pipeline, FrameSource& source, int timeoutMs, bool* blurred = nullptr);
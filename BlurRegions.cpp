@@ -0,0 +1,271 @@
+#include "BlurRegions.h"
+#include "Trace.h"
+
+#include <string.h>
+#include <algorithm>
+
+static int Width(const BlurRect& rect) { return rect.right - rect.left; }
+static int Height(const BlurRect& rect) { return rect.bottom - rect.top; }
+
+static bool Overlaps(const BlurRect& a, const BlurRect& b)
+{
+	return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+}
+
+static BlurRect Clip(const BlurRect& rect, const BlurRect& bounds)
+{
+	return { std::max(rect.left, bounds.left), std::max(rect.top, bounds.top),
+			 std::min(rect.right, bounds.right), std::min(rect.bottom, bounds.bottom) };
+}
+
+static bool IsEmpty(const BlurRect& rect)
+{
+	return rect.left >= rect.right || rect.top >= rect.bottom;
+}
+
+void BlurRegionsReset(BlurRegionManager& manager)
+{
+	manager.regions.clear();
+	manager.nextId = 1;
+	manager.layoutDirty = true;
+	manager.desktop = {};
+	manager.islands.clear();
+	manager.jobs.clear();
+	manager.capturedBytes = 0;
+	manager.apronBytes = 0;
+}
+
+static BlurRegion* FindRegion(BlurRegionManager& manager, BlurRegionId id)
+{
+	for (BlurRegion& region : manager.regions)
+		if (region.id == id)
+			return &region;
+	return nullptr;
+}
+
+BlurRegionId BlurRegionAdd(BlurRegionManager& manager, const BlurRegionDesc& desc)
+{
+	BlurRegion region = {};
+	region.id = manager.nextId++;
+	region.desc = desc;
+	region.island = -1;
+	MaskLayerReset(region.mask, std::max(Width(desc.rect), 0), std::max(Height(desc.rect), 0));
+	manager.regions.push_back(std::move(region));
+	manager.layoutDirty = true;
+	return manager.regions.back().id;
+}
+
+bool BlurRegionUpdate(BlurRegionManager& manager, BlurRegionId id, const BlurRegionDesc& desc)
+{
+	BlurRegion* region = FindRegion(manager, id);
+	if (!region)
+		return false;
+
+	if (Width(desc.rect) != Width(region->desc.rect) || Height(desc.rect) != Height(region->desc.rect))
+		MaskLayerReset(region->mask, std::max(Width(desc.rect), 0), std::max(Height(desc.rect), 0));
+	region->desc = desc;
+	manager.layoutDirty = true;
+	return true;
+}
+
+bool BlurRegionRemove(BlurRegionManager& manager, BlurRegionId id)
+{
+	for (size_t i = 0; i < manager.regions.size(); ++i)
+	{
+		if (manager.regions[i].id == id)
+		{
+			manager.regions.erase(manager.regions.begin() + i);
+			manager.layoutDirty = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+MaskLayer* BlurRegionMask(BlurRegionManager& manager, BlurRegionId id)
+{
+	BlurRegion* region = FindRegion(manager, id);
+	return region ? &region->mask : nullptr;
+}
+
+// Aprons of every region, merged into islands until no two islands overlap
+static void Layout(BlurRegionManager& manager)
+{
+	std::vector<BlurRect> islands;
+	for (BlurRegion& region : manager.regions)
+	{
+		const BlurConstants constants = { 0, 0, region.desc.radius, 0.0f };
+		const int radius = CpuBlurRadius(constants);
+
+		region.island = -1;
+		region.visible = Clip(region.desc.rect, manager.desktop);
+		if (IsEmpty(region.visible))
+			continue;
+
+		const BlurRect& visible = region.visible;
+		region.apron = Clip({ visible.left - radius, visible.top - radius, visible.right + radius, visible.bottom + radius }, manager.desktop);
+		region.output.assign((size_t)Width(region.apron) * Height(region.apron) * 4, 0);
+		region.apronMaskVersion = UINT64_MAX;
+		islands.push_back(region.apron);
+	}
+
+	// Merging grows an island, which can make it overlap one that was checked already
+	for (bool merged = true; merged;)
+	{
+		merged = false;
+		for (size_t i = 0; i < islands.size() && !merged; ++i)
+		{
+			for (size_t j = i + 1; j < islands.size(); ++j)
+			{
+				if (!Overlaps(islands[i], islands[j]))
+					continue;
+
+				const BlurRect& other = islands[j];
+				islands[i] = { std::min(islands[i].left, other.left), std::min(islands[i].top, other.top),
+							   std::max(islands[i].right, other.right), std::max(islands[i].bottom, other.bottom) };
+				islands.erase(islands.begin() + j);
+				merged = true;
+				break;
+			}
+		}
+	}
+
+	manager.islands.resize(islands.size());
+	for (size_t i = 0; i < islands.size(); ++i)
+	{
+		manager.islands[i].rect = islands[i];
+		manager.islands[i].pixels.resize((size_t)Width(islands[i]) * Height(islands[i]) * 4);
+	}
+
+	manager.apronBytes = 0;
+	for (BlurRegion& region : manager.regions)
+	{
+		if (IsEmpty(region.visible))
+			continue;
+
+		for (size_t i = 0; i < islands.size(); ++i)
+		{
+			const BlurRect& island = islands[i];
+			if (region.apron.left >= island.left && region.apron.top >= island.top &&
+				region.apron.right <= island.right && region.apron.bottom <= island.bottom)
+			{
+				region.island = (int)i;
+				break;
+			}
+		}
+		manager.apronBytes += (uint64_t)Width(region.apron) * Height(region.apron) * 4;
+	}
+	manager.layoutDirty = false;
+}
+
+void BlurRegionsCapture(BlurRegionManager& manager, const std::vector<DesktopOutput>& outputs, const CpuImage* frames)
+{
+	BlurRect desktop = {};
+	for (size_t i = 0; i < outputs.size(); ++i)
+	{
+		const BlurRect& bounds = outputs[i].bounds;
+		desktop = i == 0 ? bounds : BlurRect{ std::min(desktop.left, bounds.left), std::min(desktop.top, bounds.top),
+											  std::max(desktop.right, bounds.right), std::max(desktop.bottom, bounds.bottom) };
+	}
+
+	if (manager.layoutDirty || memcmp(&desktop, &manager.desktop, sizeof(desktop)) != 0)
+	{
+		manager.desktop = desktop;
+		Layout(manager);
+	}
+
+	TRACE_ZONE("Capture islands");
+	manager.capturedBytes = 0;
+	for (BlurIsland& island : manager.islands)
+	{
+		DesktopLayoutPlan(outputs, island.rect, manager.copies, manager.uncovered);
+		DesktopLayoutAssemble(manager.copies, manager.uncovered, frames, { island.pixels.data(), Width(island.rect) * 4 });
+		for (const DesktopCopy& copy : manager.copies)
+			manager.capturedBytes += (uint64_t)Width(copy.source) * Height(copy.source) * 4;
+	}
+}
+
+// Apron-local coverage of the region's mask, false when it has no shapes
+static bool UpdateApronMask(BlurRegion& region)
+{
+	MaskLayer& mask = region.mask;
+	if (mask.shapes.empty())
+		return false;
+
+	MaskLayerRasterize(mask);
+	if (region.apronMaskVersion == mask.version)
+		return true;
+
+	const int apronWidth = Width(region.apron);
+	region.apronMask.assign((size_t)apronWidth * Height(region.apron), 0);
+	for (int y = region.visible.top; y < region.visible.bottom; ++y)
+	{
+		const uint8_t* source = mask.coverage.data() + (size_t)(y - region.desc.rect.top) * mask.width + (region.visible.left - region.desc.rect.left);
+		uint8_t* dest = region.apronMask.data() + (size_t)(y - region.apron.top) * apronWidth + (region.visible.left - region.apron.left);
+		memcpy(dest, source, Width(region.visible));
+	}
+	region.apronMaskVersion = mask.version;
+	return true;
+}
+
+void BlurRegionsRun(BlurRegionManager& manager, CpuTiledBlur& blur)
+{
+	// Nothing was captured for a layout that changed since
+	if (manager.layoutDirty)
+		return;
+
+	std::vector<bool> masked(manager.regions.size());
+	manager.jobs.clear();
+	for (size_t index = 0; index < manager.regions.size(); ++index)
+	{
+		BlurRegion& region = manager.regions[index];
+		if (region.island < 0)
+			continue;
+
+		masked[index] = UpdateApronMask(region);
+		const BlurRect local = { region.visible.left - region.apron.left, region.visible.top - region.apron.top,
+								 region.visible.right - region.apron.left, region.visible.bottom - region.apron.top };
+		for (int top = local.top; top < local.bottom; top += blur.tileHeight)
+			for (int left = local.left; left < local.right; left += blur.tileWidth)
+				manager.jobs.push_back({ (int)index, { left, top, std::min(left + blur.tileWidth, local.right), std::min(top + blur.tileHeight, local.bottom) } });
+	}
+
+	ThreadPoolParallelFor(blur.pool, (int)manager.jobs.size(), [&](int index, int worker) {
+		TRACE_ZONE("Blur tile");
+		const BlurRegionJob& job = manager.jobs[index];
+		BlurRegion& region = manager.regions[job.region];
+		const BlurIsland& island = manager.islands[region.island];
+
+		// The apron is the blur's whole texture, it clamps where the desktop ends
+		const int islandPitch = Width(island.rect) * 4;
+		const uint8_t* origin = island.pixels.data() + (size_t)(region.apron.top - island.rect.top) * islandPitch +
+								(size_t)(region.apron.left - island.rect.left) * 4;
+		const CpuImage input = { const_cast<uint8_t*>(origin), islandPitch };
+		const CpuImage output = { region.output.data(), Width(region.apron) * 4 };
+		const CpuMask mask = masked[job.region] ? CpuMask{ region.apronMask.data(), Width(region.apron), 1 } : CpuMask{};
+		const BlurConstants constants = { (uint32_t)Width(region.apron), (uint32_t)Height(region.apron), region.desc.radius, 0.0f };
+
+		if (region.desc.kernel == BlurKernel_Box)
+			CpuBoxBlurRect(input, mask, output, constants, job.rect, blur.scratch[worker]);
+		else
+			CpuBlurKernelRect(region.desc.kernel, input, mask, output, constants, job.rect, blur.scratch[worker]);
+	});
+}
+
+bool BlurRegionOutput(const BlurRegionManager& manager, BlurRegionId id, CpuImage& image, BlurRect& rect)
+{
+	for (const BlurRegion& region : manager.regions)
+	{
+		if (region.id != id)
+			continue;
+		if (region.island < 0)
+			return false;
+
+		const int pitch = Width(region.apron) * 4;
+		image = { const_cast<uint8_t*>(region.output.data()) + (size_t)(region.visible.top - region.apron.top) * pitch +
+				  (size_t)(region.visible.left - region.apron.left) * 4, pitch };
+		rect = region.visible;
+		return true;
+	}
+	return false;
+}
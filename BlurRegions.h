@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "BlurKernels.h"
+#include "CpuBlurTiled.h"
+#include "DesktopLayout.h"
+#include "MaskLayer.h"
+
+// Several blurred panels over one desktop capture. Regions whose aprons (the rect grown by
+// the blur radius) overlap share an island, one copy of the desktop under their union, so
+// pixels two panels both read come out of the capture once. The tiles of every region then
+// go to the thread pool as one batch. Blurs clamp at the desktop edge rather than at the
+// region's, a panel shows the same pixels as that crop of the whole desktop blurred.
+typedef uint32_t BlurRegionId;
+
+struct BlurRegionDesc
+{
+	BlurRect rect;	// Desktop coordinates
+	float radius;
+	BlurKernelType kernel;
+};
+
+struct BlurRegion
+{
+	BlurRegionId id;
+	BlurRegionDesc desc;
+	MaskLayer mask;	 // Region-local, a mask without shapes covers the whole region
+
+	// Placement from the last layout, desktop coordinates clipped to the outputs
+	BlurRect visible;
+	BlurRect apron;
+	int island;
+	std::vector<uint8_t> apronMask;	 // Apron-sized copy of mask's coverage
+	uint64_t apronMaskVersion;
+	std::vector<uint8_t> output;	 // Apron-sized BGRA, only `visible` is written
+};
+
+struct BlurIsland
+{
+	BlurRect rect;	// Desktop coordinates
+	std::vector<uint8_t> pixels;
+};
+
+// One tile of one region, apron-local
+struct BlurRegionJob
+{
+	int region;
+	BlurRect rect;
+};
+
+struct BlurRegionManager
+{
+	std::vector<BlurRegion> regions;
+	BlurRegionId nextId;
+	bool layoutDirty;
+	BlurRect desktop;  // Bounds of the outputs the layout was made for
+
+	std::vector<BlurIsland> islands;
+	std::vector<BlurRegionJob> jobs;
+	std::vector<DesktopCopy> copies;
+	std::vector<BlurRect> uncovered;
+
+	uint64_t capturedBytes;	 // Read from the outputs by the last capture
+	uint64_t apronBytes;	 // What one capture per region would have read
+};
+
+void BlurRegionsReset(BlurRegionManager& manager);
+
+// Ids are never reused, 0 is never returned. Resizing a region clears its mask, moving keeps it.
+BlurRegionId BlurRegionAdd(BlurRegionManager& manager, const BlurRegionDesc& desc);
+bool BlurRegionUpdate(BlurRegionManager& manager, BlurRegionId id, const BlurRegionDesc& desc);
+bool BlurRegionRemove(BlurRegionManager& manager, BlurRegionId id);
+
+// nullptr for unknown ids, shapes are in region-local pixels
+MaskLayer* BlurRegionMask(BlurRegionManager& manager, BlurRegionId id);
+
+// Copies every island out of the outputs' frames, frames[i] belongs to outputs[i]
+void BlurRegionsCapture(BlurRegionManager& manager, const std::vector<DesktopOutput>& outputs, const CpuImage* frames);
+
+// Blurs every region from its island in one ThreadPoolParallelFor over all their tiles
+void BlurRegionsRun(BlurRegionManager& manager, CpuTiledBlur& blur);
+
+// The region's blurred pixels and where they go on the desktop, false when it is off every output
+bool BlurRegionOutput(const BlurRegionManager& manager, BlurRegionId id, CpuImage& image, BlurRect& rect);
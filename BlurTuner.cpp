@@ -0,0 +1,225 @@
+#include "BlurTuner.h"
+
+#include <algorithm>
+
+// Reads per pixel at radius 13, against the Gaussian's
+const BlurTunerLevel BlurTunerGpuLevels[BlurTunerLevelCount] = {
+	{ "gaussian", BlurTunerMethod_Direct, BlurKernel_Gaussian, 1.0f, 1.0f },
+	{ "iir", BlurTunerMethod_Iir, BlurKernel_Gaussian, 1.0f, 0.5f },
+	{ "tent", BlurTunerMethod_Direct, BlurKernel_Tent, 1.0f, 0.8f },
+	{ "box", BlurTunerMethod_Direct, BlurKernel_Box, 1.0f, 0.6f },
+	{ "kawase", BlurTunerMethod_Kawase, BlurKernel_Box, 1.0f, 0.15f },
+	{ "kawase-3/4", BlurTunerMethod_Kawase, BlurKernel_Box, 0.75f, 0.12f },
+	{ "box-1/2", BlurTunerMethod_Direct, BlurKernel_Box, 0.5f, 0.35f },
+};
+
+// BackdropFilterBench's 1080p timings at radius 13: the sliding box doesn't grow with the
+// radius and the float Kawase reference is slower than everything else
+const BlurTunerLevel BlurTunerCpuLevels[BlurTunerLevelCount] = {
+	{ "gaussian", BlurTunerMethod_Direct, BlurKernel_Gaussian, 1.0f, 1.0f },
+	{ "iir", BlurTunerMethod_Iir, BlurKernel_Gaussian, 1.0f, 0.3f },
+	{ "tent", BlurTunerMethod_Direct, BlurKernel_Tent, 1.0f, 0.75f },
+	{ "box", BlurTunerMethod_Direct, BlurKernel_Box, 1.0f, 0.1f },
+	{ "kawase", BlurTunerMethod_Kawase, BlurKernel_Box, 1.0f, 2.0f },
+	{ "kawase-3/4", BlurTunerMethod_Kawase, BlurKernel_Box, 0.75f, 1.9f },
+	{ "box-1/2", BlurTunerMethod_Direct, BlurKernel_Box, 0.5f, 0.09f },
+};
+
+void BlurTunerStart(BlurTuner& tuner, const BlurTunerConfig& config, const BlurTunerLevel* levels, int count, int start)
+{
+	tuner = {};
+	tuner.config = config;
+	tuner.config.learnSamples = std::max(config.learnSamples, 1);
+	tuner.config.downFrames = std::max(config.downFrames, 1);
+	tuner.config.upFrames = std::max(config.upFrames, 1);
+	tuner.config.maxBackoff = std::min(std::max(config.maxBackoff, 0), 16);
+	tuner.config.exploreFrames = std::max(config.exploreFrames, tuner.config.upFrames);
+	tuner.levels.assign(levels, levels + count);
+	tuner.relativeCost.resize(count);
+	for (int i = 0; i < count; ++i)
+		tuner.relativeCost[i] = std::max(levels[i].relativeCost, 1e-3f);
+	tuner.measured.assign(count, false);
+	tuner.failures.assign(count, 0);
+	tuner.current = std::min(std::max(start, 0), count - 1);
+}
+
+double BlurTunerPredictUs(const BlurTuner& tuner, int level, uint64_t windowPixels)
+{
+	return tuner.speed * tuner.relativeCost[level] * (double)windowPixels;
+}
+
+static void MoveTo(BlurTuner& tuner, int level)
+{
+	const bool up = level < tuner.current;
+
+	// Leaving a level that was just moved up to means the move was wrong, try it less often
+	if (!up && tuner.probation)
+		tuner.failures[tuner.current] = std::min(tuner.failures[tuner.current] + 1, tuner.config.maxBackoff);
+
+	// Left before all its learning samples, what it got is still better than the guess
+	if (tuner.samplesAtLevel > 0)
+		tuner.measured[tuner.current] = true;
+
+	if (up)
+		++tuner.movesUp;
+	else
+		++tuner.movesDown;
+
+	tuner.current = level;
+	tuner.samplesAtLevel = 0;
+	tuner.learnCost = 0.0;
+	tuner.slowFrames = 0;
+	tuner.slowSpeed = 0.0;
+	tuner.fastFrames = 0;
+	tuner.probation = up;
+}
+
+// The best cheaper level predicted to land between the water marks, else the cheapest
+static int PickDown(const BlurTuner& tuner, uint64_t windowPixels, double target)
+{
+	const int count = (int)tuner.levels.size();
+	const double here = tuner.relativeCost[tuner.current];
+
+	int cheapest = -1;
+	for (int i = tuner.current + 1; i < count; ++i)
+	{
+		if (tuner.relativeCost[i] >= here)
+			continue;
+		if (BlurTunerPredictUs(tuner, i, windowPixels) <= target)
+			return i;
+		if (cheapest < 0 || tuner.relativeCost[i] < tuner.relativeCost[cheapest])
+			cheapest = i;
+	}
+	return cheapest;
+}
+
+// A level that ran costs far from what its guess said, the other guesses are likely off too
+static bool GuessesOff(const BlurTuner& tuner)
+{
+	for (size_t i = 0; i < tuner.levels.size(); ++i)
+	{
+		const double ratio = tuner.relativeCost[i] / tuner.levels[i].relativeCost;
+		if (tuner.measured[i] && (ratio > 1.5 || ratio < 1.0 / 1.5))
+			return true;
+	}
+	return false;
+}
+
+// The best level predicted to fit whose backoff has run out, else after exploreFrames the
+// better level that hasn't run with the cheapest guess, -1 for none
+static int PickUp(const BlurTuner& tuner, uint64_t windowPixels, double target)
+{
+	for (int i = 0; i < tuner.current; ++i)
+	{
+		if (tuner.fastFrames < (tuner.config.upFrames << tuner.failures[i]))
+			continue;
+		if (BlurTunerPredictUs(tuner, i, windowPixels) <= target)
+			return i;
+	}
+
+	if (tuner.fastFrames < tuner.config.exploreFrames || !GuessesOff(tuner))
+		return -1;
+
+	int untried = -1;
+	for (int i = 0; i < tuner.current; ++i)
+	{
+		if (!tuner.measured[i] && (untried < 0 || tuner.relativeCost[i] < tuner.relativeCost[untried]))
+			untried = i;
+	}
+	return untried;
+}
+
+bool BlurTunerAddSample(BlurTuner& tuner, int level, double costUs, uint64_t pixels, uint64_t windowPixels)
+{
+	const BlurTunerConfig& config = tuner.config;
+	if (level != tuner.current || pixels == 0 || windowPixels == 0 || costUs < 0.0)
+		return false;
+	if ((double)pixels < config.minCoverage * (double)windowPixels)
+		return false;
+
+	++tuner.samples;
+	++tuner.samplesAtLevel;
+
+	const int current = tuner.current;
+	const double perPixel = costUs / (double)pixels;
+
+	if (tuner.speed <= 0.0)
+	{
+		// The first level measured anchors the scale: its guess stays, the speed is learned
+		tuner.speed = std::max(perPixel / tuner.relativeCost[current], 1e-9);
+		tuner.measured[current] = true;
+	}
+	else if (!tuner.measured[current])
+	{
+		// A new level: the speed just measured on the last one holds for a few samples and they
+		// give this level's cost against the others
+		tuner.learnCost = tuner.samplesAtLevel == 1 ? perPixel : std::min(tuner.learnCost, perPixel);
+		tuner.relativeCost[current] = std::max(tuner.learnCost / tuner.speed, 1e-6);
+		if (tuner.samplesAtLevel >= config.learnSamples)
+			tuner.measured[current] = true;
+	}
+	else
+	{
+		// A single slow frame moves the speed at most by `smoothing`, a lasting load gets there
+		// over a few frames
+		const double speed = std::min(perPixel / tuner.relativeCost[current], tuner.speed * 2.0);
+		tuner.speed += config.smoothing * (speed - tuner.speed);
+	}
+
+	const double projected = perPixel * (double)windowPixels;
+	if (projected > config.budgetUs * config.highWater)
+	{
+		const double speed = perPixel / tuner.relativeCost[current];
+		tuner.slowSpeed = tuner.slowFrames++ ? std::min(tuner.slowSpeed, speed) : speed;
+		tuner.fastFrames = 0;
+	}
+	else if (projected < config.budgetUs * config.lowWater)
+	{
+		tuner.fastFrames = std::min(tuner.fastFrames + 1, std::max(config.upFrames << config.maxBackoff, config.exploreFrames));
+		tuner.slowFrames = 0;
+		tuner.slowSpeed = 0.0;
+	}
+	else
+	{
+		tuner.fastFrames = 0;
+		tuner.slowFrames = 0;
+		tuner.slowSpeed = 0.0;
+	}
+
+	if (tuner.probation && tuner.samplesAtLevel >= config.upFrames)
+	{
+		tuner.probation = false;
+		tuner.failures[current] = 0;
+	}
+
+	const double target = config.budgetUs * (config.highWater + config.lowWater) * 0.5;
+
+	if (tuner.slowFrames >= config.downFrames)
+	{
+		// The slow frames are what the machine does now, the smoothed speed lags behind a new
+		// load and still carries the spikes it was clamped to
+		tuner.speed = tuner.slowSpeed;
+
+		const int down = PickDown(tuner, windowPixels, target);
+		if (down < 0)
+		{
+			// Already the cheapest, nothing to do until it gets faster
+			tuner.slowFrames = 0;
+			tuner.slowSpeed = 0.0;
+			return false;
+		}
+		MoveTo(tuner, down);
+		return true;
+	}
+
+	if (tuner.fastFrames >= config.upFrames)
+	{
+		const int up = PickUp(tuner, windowPixels, target);
+		if (up < 0)
+			return false;
+		MoveTo(tuner, up);
+		return true;
+	}
+
+	return false;
+}
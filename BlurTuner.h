@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "BlurKernels.h"
+
+// Holds the blur under a time budget by trading quality for speed. The settings form a ladder
+// of levels from the best looking to the cheapest, and the tuner moves to the best one whose
+// cost fits. Costs are learned on the machine: each level's cost relative to the others when
+// it is first run, and a speed factor that every sample updates, so a load spike makes every
+// level look slower at once. Moves need several slow or fast frames in a row, and a level the
+// tuner had to leave soon after moving up to it waits twice as long before the next try, so
+// it settles instead of oscillating. A level whose guess is too pessimistic would never run:
+// once a level that did run turned out to cost 1.5 times more or less than its guess,
+// the guesses aren't trusted and after a long stretch of fast frames the tuner tries a level
+// that hasn't run. Costs come in as samples and time as sample counts, so
+// the same controller runs against simulated cost models in BackdropFilterBench.
+enum BlurTunerMethod
+{
+	BlurTunerMethod_Direct,	 // The kernel over every pixel, box is the only one whose cost doesn't grow with the radius
+	BlurTunerMethod_Iir,	 // Recursive Gaussian, an approximation that costs the same at any radius
+	BlurTunerMethod_Kawase,	 // Dual Kawase, blurs at halved resolutions, one down and up pass per halving
+};
+
+struct BlurTunerLevel
+{
+	const char* name;
+	BlurTunerMethod method;
+	BlurKernelType kernel;	// Direct only
+	float radiusScale;		// Of the configured radius: a cheaper Direct kernel, fewer Kawase passes
+	float relativeCost;		// Guess against the other levels until the level has run
+};
+
+// Gaussian, IIR, tent, box, Kawase, Kawase with fewer passes, box at half the radius. The
+// guesses differ by backend: Kawase is the cheapest on a GPU and the slowest on the CPU.
+static const int BlurTunerLevelCount = 7;
+extern const BlurTunerLevel BlurTunerGpuLevels[BlurTunerLevelCount];
+extern const BlurTunerLevel BlurTunerCpuLevels[BlurTunerLevelCount];
+
+struct BlurTunerConfig
+{
+	double budgetUs;	// A blur of the whole window may take this long
+	float highWater;	// Share of the budget past which a frame is too slow
+	float lowWater;		// Share under which a frame leaves room for a better level
+	float smoothing;	// Weight of a new sample in the speed factor
+	int learnSamples;	// Samples after a move that measure the new level's relative cost
+	int downFrames;		// Slow frames in a row before moving down
+	int upFrames;		// Fast frames in a row before moving up, doubled per failed try of the level
+	int maxBackoff;		// Most doublings
+	int exploreFrames;	// Fast frames in a row before trying a better level that hasn't run, whatever its guess
+	float minCoverage;	// Samples that blurred less of the window are mostly overhead, they don't count
+};
+
+static const BlurTunerConfig BlurTunerDefaults = { 4000.0, 0.9f, 0.6f, 0.2f, 4, 3, 60, 5, 480, 0.25f };
+
+struct BlurTuner
+{
+	BlurTunerConfig config;
+	std::vector<BlurTunerLevel> levels;
+	std::vector<double> relativeCost;  // Learned once a level has run, the guess before
+	std::vector<bool> measured;	 // Has run, relativeCost is its own
+	std::vector<int> failures;	// Moves up to the level that ended in a move down
+	double speed;				// Microseconds per pixel and unit of relativeCost, 0 before the first sample
+	int current;
+	int samplesAtLevel;
+	double learnCost;	 // Cheapest cost per pixel of the level's first samples, spikes don't stick
+	int slowFrames;		 // In a row, past highWater
+	double slowSpeed;	 // Lowest speed the slow frames imply
+	int fastFrames;		 // In a row, under lowWater
+	bool probation;		 // Reached by a move up and not held for upFrames yet
+
+	uint64_t samples;
+	uint64_t movesDown;
+	uint64_t movesUp;
+};
+
+void BlurTunerStart(BlurTuner& tuner, const BlurTunerConfig& config, const BlurTunerLevel* levels, int count, int start = 0);
+
+// A blur on `level` took costUs for `pixels` of a window of windowPixels. Samples of another
+// level than the current one, e.g. GPU timings that arrive frames late, are dropped. True
+// when the current level changed.
+bool BlurTunerAddSample(BlurTuner& tuner, int level, double costUs, uint64_t pixels, uint64_t windowPixels);
+
+// What a blur of a whole window of `windowPixels` is expected to take on `level`, 0 before any sample
+double BlurTunerPredictUs(const BlurTuner& tuner, int level, uint64_t windowPixels);
+
+inline const BlurTunerLevel& BlurTunerCurrent(const BlurTuner& tuner)
+{
+	return tuner.levels[tuner.current];
+}
@@ -0,0 +1,615 @@
+#include "CaptureRecording.h"
+
+#include <string.h>
+#include <algorithm>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static_assert(sizeof(RecordingFileHeader) == 32, "RecordingFileHeader is part of the file format");
+static_assert(sizeof(RecordingFrameHeader) == 48, "RecordingFrameHeader is part of the file format");
+static_assert(sizeof(DirtyMove) == 24 && sizeof(BlurRect) == 16, "Rects are part of the file format");
+
+static size_t AlignRecord(size_t size)
+{
+	return (size + RecordingAlignment - 1) & ~(RecordingAlignment - 1);
+}
+
+static size_t RecordPixelsOffset(uint32_t moveCount, uint32_t dirtyCount)
+{
+	return AlignRecord(sizeof(RecordingFrameHeader) + moveCount * sizeof(DirtyMove) + dirtyCount * sizeof(BlurRect));
+}
+
+static uint64_t RectBytes(const BlurRect& rect)
+{
+	return (uint64_t)(rect.right - rect.left) * (rect.bottom - rect.top) * 4;
+}
+
+static bool InsideFrame(const BlurRect& rect, int width, int height)
+{
+	return rect.left >= 0 && rect.top >= 0 && rect.right <= width && rect.bottom <= height && rect.left < rect.right &&
+		rect.top < rect.bottom;
+}
+
+static bool MoveInsideFrame(const DirtyMove& move, int width, int height)
+{
+	const BlurRect source = { move.sourceX, move.sourceY, move.sourceX + move.destination.right - move.destination.left,
+							  move.sourceY + move.destination.bottom - move.destination.top };
+	return InsideFrame(move.destination, width, height) && InsideFrame(source, width, height);
+}
+
+// Moves copy inside the frame as they were made, rows walk away from the overlap
+static void ApplyMove(std::vector<uint8_t>& canvas, int width, const DirtyMove& move)
+{
+	const int rowPitch = width * 4;
+	const int rows = move.destination.bottom - move.destination.top;
+	const size_t rowBytes = (size_t)(move.destination.right - move.destination.left) * 4;
+	const bool upwards = move.destination.top > move.sourceY;
+	for (int i = 0; i < rows; ++i)
+	{
+		const int row = upwards ? rows - 1 - i : i;
+		memmove(&canvas[(size_t)(move.destination.top + row) * rowPitch + (size_t)move.destination.left * 4],
+				&canvas[(size_t)(move.sourceY + row) * rowPitch + (size_t)move.sourceX * 4], rowBytes);
+	}
+}
+
+bool RecordingWriterOpen(RecordingWriter& writer, const char* path, int width, int height, int keyframeInterval)
+{
+	writer.file = nullptr;
+	writer.header = {};
+	writer.sinceKeyframe = 0;
+	writer.bytesWritten = 0;
+	writer.keyframes = 0;
+	if (width <= 0 || height <= 0)
+		return false;
+
+	writer.file = fopen(path, "wb");
+	if (!writer.file)
+		return false;
+	setvbuf(writer.file, nullptr, _IOFBF, 1 << 20);
+
+	writer.header.magic = RecordingMagic;
+	writer.header.formatVersion = RecordingFormatVersion;
+	writer.header.width = width;
+	writer.header.height = height;
+	writer.header.keyframeInterval = (uint32_t)std::max(1, keyframeInterval);
+	writer.bytesWritten = fwrite(&writer.header, 1, sizeof(writer.header), writer.file);
+	return writer.bytesWritten == sizeof(writer.header);
+}
+
+bool RecordingWriterAdd(RecordingWriter& writer, const Frame& frame, const BlurRect& window)
+{
+	const int width = writer.header.width;
+	const int height = writer.header.height;
+	if (!writer.file || !frame.pixels || frame.width != width || frame.height != height)
+		return false;
+
+	// Rects the duplication reported past the edges are clipped, moves can't be and force a keyframe
+	std::vector<BlurRect> dirtyRects;
+	uint64_t dirtyBytes = 0;
+	for (BlurRect rect : frame.dirtyRects)
+	{
+		rect = { std::max(rect.left, 0), std::max(rect.top, 0), std::min(rect.right, width), std::min(rect.bottom, height) };
+		if (rect.left < rect.right && rect.top < rect.bottom)
+		{
+			dirtyRects.push_back(rect);
+			dirtyBytes += RectBytes(rect);
+		}
+	}
+	bool movesValid = true;
+	for (const DirtyMove& move : frame.moves)
+		movesValid &= MoveInsideFrame(move, width, height);
+
+	const uint64_t frameBytes = (uint64_t)width * height * 4;
+	const bool keyframe = writer.header.frameCount == 0 || writer.sinceKeyframe + 1 >= (int)writer.header.keyframeInterval ||
+		dirtyBytes >= frameBytes || !movesValid;
+
+	RecordingFrameHeader header = {};
+	header.magic = RecordingFrameMagic;
+	header.flags = (keyframe ? RecordingFrame_Keyframe : 0) | (frame.pointerOnly ? RecordingFrame_PointerOnly : 0);
+	header.timestamp = frame.timestamp;
+	header.window = window;
+	header.moveCount = movesValid ? (uint32_t)frame.moves.size() : 0;
+	header.dirtyCount = (uint32_t)dirtyRects.size();
+
+	const size_t pixelsOffset = RecordPixelsOffset(header.moveCount, header.dirtyCount);
+	const uint64_t pixelBytes = keyframe ? frameBytes : dirtyBytes;
+	header.size = AlignRecord(pixelsOffset + pixelBytes);
+
+	// Deltas are staged whole, a keyframe's pixels go out straight from the frame
+	writer.record.assign(keyframe ? pixelsOffset : header.size, 0);
+	uint8_t* record = writer.record.data();
+	memcpy(record, &header, sizeof(header));
+	if (header.moveCount)
+		memcpy(record + sizeof(header), frame.moves.data(), header.moveCount * sizeof(DirtyMove));
+	if (header.dirtyCount)
+		memcpy(record + sizeof(header) + header.moveCount * sizeof(DirtyMove), dirtyRects.data(), header.dirtyCount * sizeof(BlurRect));
+
+	bool ok = true;
+	if (keyframe)
+	{
+		ok = fwrite(record, 1, pixelsOffset, writer.file) == pixelsOffset;
+		if (frame.rowPitch == width * 4)
+			ok = ok && fwrite(frame.pixels, 1, (size_t)frameBytes, writer.file) == frameBytes;
+		else
+			for (int y = 0; ok && y < height; ++y)
+				ok = fwrite(frame.pixels + (size_t)y * frame.rowPitch, 1, (size_t)width * 4, writer.file) == (size_t)width * 4;
+
+		static const uint8_t Padding[RecordingAlignment] = {};
+		const size_t padding = (size_t)(header.size - pixelsOffset - pixelBytes);
+		ok = ok && fwrite(Padding, 1, padding, writer.file) == padding;
+	}
+	else
+	{
+		uint8_t* pixels = record + pixelsOffset;
+		for (const BlurRect& rect : dirtyRects)
+		{
+			const size_t rowBytes = (size_t)(rect.right - rect.left) * 4;
+			for (int y = rect.top; y < rect.bottom; ++y, pixels += rowBytes)
+				memcpy(pixels, frame.pixels + (size_t)y * frame.rowPitch + (size_t)rect.left * 4, rowBytes);
+		}
+		ok = fwrite(record, 1, (size_t)header.size, writer.file) == header.size;
+	}
+
+	if (!ok)
+		return false;
+	writer.bytesWritten += header.size;
+	writer.header.frameCount++;
+	writer.sinceKeyframe = keyframe ? 0 : writer.sinceKeyframe + 1;
+	writer.keyframes += keyframe ? 1 : 0;
+	return true;
+}
+
+bool RecordingWriterClose(RecordingWriter& writer)
+{
+	if (!writer.file)
+		return false;
+
+	bool ok = fseek(writer.file, 0, SEEK_SET) == 0 && fwrite(&writer.header, 1, sizeof(writer.header), writer.file) == sizeof(writer.header);
+	ok = fclose(writer.file) == 0 && ok;
+	writer.file = nullptr;
+	writer.record.clear();
+	return ok;
+}
+
+// Past this many rects of dropped frames, or a frame's worth of their pixels, the next frame
+// goes out whole
+static const size_t RecordingUnseenLimit = 256;
+
+static BlurRect ClipToFrame(const BlurRect& rect, int width, int height)
+{
+	return { std::max(rect.left, 0), std::max(rect.top, 0), std::min(rect.right, width), std::min(rect.bottom, height) };
+}
+
+static void AppendClipped(std::vector<BlurRect>& rects, const BlurRect& rect, int width, int height)
+{
+	const BlurRect clipped = ClipToFrame(rect, width, height);
+	if (clipped.left < clipped.right && clipped.top < clipped.bottom)
+		rects.push_back(clipped);
+}
+
+// Below the render thread, so a write only takes a core no frame needs rather than preempting one
+static void LowerThreadPriority(std::thread& thread)
+{
+#if defined(_WIN32)
+	SetThreadPriority((HANDLE)thread.native_handle(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(SCHED_BATCH)
+	sched_param param = {};
+	pthread_setschedparam(thread.native_handle(), SCHED_BATCH, &param);
+#endif
+}
+
+// Dropped frames mostly repeat their rects, a scroll moves the same rect every frame
+static void AddUnseen(std::vector<BlurRect>& unseen, const BlurRect& rect, int width, int height)
+{
+	const BlurRect clipped = ClipToFrame(rect, width, height);
+	if (clipped.left >= clipped.right || clipped.top >= clipped.bottom)
+		return;
+
+	auto inside = [](const BlurRect& inner, const BlurRect& outer) {
+		return inner.left >= outer.left && inner.top >= outer.top && inner.right <= outer.right && inner.bottom <= outer.bottom;
+	};
+	for (const BlurRect& kept : unseen)
+	{
+		if (inside(clipped, kept))
+			return;
+	}
+	unseen.erase(std::remove_if(unseen.begin(), unseen.end(), [&](const BlurRect& kept) { return inside(kept, clipped); }), unseen.end());
+	unseen.push_back(clipped);
+}
+
+static void RecordingThreadRun(RecordingThread& recording)
+{
+	const int width = recording.writer.header.width;
+	const int height = recording.writer.header.height;
+	const size_t rowBytes = (size_t)width * 4;
+	Frame frame = { width, height, recording.canvas.data(), (int)rowBytes };
+
+	std::unique_lock<std::mutex> lock(recording.mutex);
+	for (;;)
+	{
+		recording.wake.wait(lock, [&] { return recording.quitting || !recording.queued.empty(); });
+		if (recording.queued.empty())
+			return;
+		const int index = recording.queued.front();
+		recording.queued.pop_front();
+		lock.unlock();
+
+		// Moves first, then the pixels that changed, like playback
+		RecordingPacket& packet = recording.packets[index];
+		if (packet.whole)
+			memcpy(recording.canvas.data(), packet.pixels.data(), rowBytes * height);
+		else
+		{
+			for (const DirtyMove& move : packet.moves)
+			{
+				if (MoveInsideFrame(move, width, height))
+					ApplyMove(recording.canvas, width, move);
+			}
+			const uint8_t* pixels = packet.pixels.data();
+			for (const BlurRect& rect : packet.copied)
+			{
+				const size_t bytes = (size_t)(rect.right - rect.left) * 4;
+				for (int y = rect.top; y < rect.bottom; ++y, pixels += bytes)
+					memcpy(&recording.canvas[y * rowBytes + (size_t)rect.left * 4], pixels, bytes);
+			}
+		}
+
+		// The packet lends its rects to the frame, the writer reads the pixels from the canvas
+		frame.timestamp = packet.timestamp;
+		frame.pointerOnly = packet.pointerOnly;
+		frame.dirtyRects.swap(packet.dirtyRects);
+		frame.moves.swap(packet.moves);
+		const bool ok = RecordingWriterAdd(recording.writer, frame, packet.window);
+		frame.dirtyRects.swap(packet.dirtyRects);
+		frame.moves.swap(packet.moves);
+
+		lock.lock();
+		recording.failed |= !ok;
+		recording.idle.push_back(index);
+	}
+}
+
+bool RecordingThreadStart(RecordingThread& recording, const char* path, int width, int height, int queueLength, int keyframeInterval)
+{
+	recording.queued.clear();
+	recording.idle.clear();
+	recording.unseen.clear();
+	recording.unseenWhole = true;
+	recording.quitting = false;
+	recording.failed = false;
+	recording.queuedFrames = 0;
+	recording.droppedFrames = 0;
+	if (!RecordingWriterOpen(recording.writer, path, width, height, keyframeInterval))
+	{
+		if (recording.writer.file)
+			RecordingWriterClose(recording.writer);
+		return false;
+	}
+
+	recording.canvas.assign((size_t)width * height * 4, 0);
+	recording.packets.resize(std::max(1, queueLength));
+	for (int i = 0; i < (int)recording.packets.size(); ++i)
+		recording.idle.push_back(i);
+	recording.thread = std::thread(RecordingThreadRun, std::ref(recording));
+	LowerThreadPriority(recording.thread);
+	return true;
+}
+
+bool RecordingThreadAdd(RecordingThread& recording, const Frame& frame, const BlurRect& window)
+{
+	// The size is only written by RecordingThreadStart, the thread doesn't change it
+	const int width = recording.writer.header.width;
+	const int height = recording.writer.header.height;
+	if (!recording.thread.joinable() || !frame.pixels || frame.width != width || frame.height != height)
+		return false;
+
+	int index = -1;
+	{
+		std::lock_guard<std::mutex> lock(recording.mutex);
+		if (recording.failed)
+			return false;
+		if (!recording.idle.empty())
+		{
+			index = recording.idle.back();
+			recording.idle.pop_back();
+		}
+	}
+
+	if (index < 0)
+	{
+		recording.droppedFrames++;
+		if (!recording.unseenWhole)
+		{
+			for (const BlurRect& rect : frame.dirtyRects)
+				AddUnseen(recording.unseen, rect, width, height);
+			for (const DirtyMove& move : frame.moves)
+				AddUnseen(recording.unseen, move.destination, width, height);
+
+			uint64_t unseenBytes = 0;
+			for (const BlurRect& rect : recording.unseen)
+				unseenBytes += RectBytes(rect);
+			if (recording.unseen.size() > RecordingUnseenLimit || unseenBytes >= (uint64_t)width * height * 4)
+			{
+				recording.unseenWhole = true;
+				recording.unseen.clear();
+			}
+		}
+		return false;
+	}
+
+	RecordingPacket& packet = recording.packets[index];
+	packet.timestamp = frame.timestamp;
+	packet.pointerOnly = frame.pointerOnly;
+	packet.whole = recording.unseenWhole;
+	packet.window = window;
+	packet.dirtyRects.clear();
+	packet.moves.clear();
+	packet.copied.clear();
+	if (packet.whole)
+	{
+		// A dirty rect over everything makes it a keyframe
+		const size_t rowBytes = (size_t)width * 4;
+		packet.dirtyRects.push_back({ 0, 0, width, height });
+		packet.pixels.resize(rowBytes * height);
+		for (int y = 0; y < height; ++y)
+			memcpy(&packet.pixels[y * rowBytes], frame.pixels + (size_t)y * frame.rowPitch, rowBytes);
+	}
+	else
+	{
+		// The thread replays moves inside its canvas, only the pixels of moves it can't replay
+		// are copied. After a drop the canvas is behind the frame the moves start from, so
+		// they become dirty rects.
+		const bool caughtUp = recording.unseen.empty();
+		packet.copied = recording.unseen;
+		for (const BlurRect& rect : frame.dirtyRects)
+			AppendClipped(packet.copied, rect, width, height);
+		for (const DirtyMove& move : frame.moves)
+		{
+			if (!caughtUp || !MoveInsideFrame(move, width, height))
+				AppendClipped(packet.copied, move.destination, width, height);
+		}
+
+		if (caughtUp)
+		{
+			packet.dirtyRects = frame.dirtyRects;
+			packet.moves = frame.moves;
+		}
+		else
+			packet.dirtyRects = packet.copied;
+
+		uint64_t bytes = 0;
+		for (const BlurRect& rect : packet.copied)
+			bytes += RectBytes(rect);
+		packet.pixels.resize((size_t)bytes);
+		uint8_t* pixels = packet.pixels.data();
+		for (const BlurRect& rect : packet.copied)
+		{
+			const size_t rowBytes = (size_t)(rect.right - rect.left) * 4;
+			for (int y = rect.top; y < rect.bottom; ++y, pixels += rowBytes)
+				memcpy(pixels, frame.pixels + (size_t)y * frame.rowPitch + (size_t)rect.left * 4, rowBytes);
+		}
+	}
+	recording.unseen.clear();
+	recording.unseenWhole = false;
+
+	{
+		std::lock_guard<std::mutex> lock(recording.mutex);
+		recording.queued.push_back(index);
+		recording.queuedFrames++;
+	}
+	recording.wake.notify_one();
+	return true;
+}
+
+bool RecordingThreadStop(RecordingThread& recording)
+{
+	if (!recording.thread.joinable())
+		return false;
+
+	{
+		std::lock_guard<std::mutex> lock(recording.mutex);
+		recording.quitting = true;
+	}
+	recording.wake.notify_one();
+	recording.thread.join();
+
+	const bool ok = RecordingWriterClose(recording.writer) && !recording.failed;
+	recording.canvas.clear();
+	recording.canvas.shrink_to_fit();
+	recording.packets.clear();
+	recording.idle.clear();
+	return ok;
+}
+
+// The record at `offset` when all of it is inside the mapping and its rects inside the frame
+static bool ValidateRecord(const RecordingFrameSource& source, uint64_t offset, RecordingFrameHeader& header)
+{
+	const MappedFile& file = source.file;
+	if (offset > file.size || file.size - offset < sizeof(header))
+		return false;
+	memcpy(&header, file.data + offset, sizeof(header));
+	if (header.magic != RecordingFrameMagic || header.size > file.size - offset || header.size % RecordingAlignment)
+		return false;
+
+	// Counts bounded by the record first, so the offsets below can't overflow
+	const uint64_t rectBytes = (uint64_t)header.moveCount * sizeof(DirtyMove) + (uint64_t)header.dirtyCount * sizeof(BlurRect);
+	if (rectBytes > header.size)
+		return false;
+	const size_t pixelsOffset = RecordPixelsOffset(header.moveCount, header.dirtyCount);
+
+	const DirtyMove* moves = (const DirtyMove*)(file.data + offset + sizeof(header));
+	const BlurRect* dirtyRects = (const BlurRect*)(moves + header.moveCount);
+	for (uint32_t i = 0; i < header.moveCount; ++i)
+	{
+		DirtyMove move;
+		memcpy(&move, moves + i, sizeof(move));
+		if (!MoveInsideFrame(move, source.width, source.height))
+			return false;
+	}
+
+	uint64_t pixelBytes = 0;
+	for (uint32_t i = 0; i < header.dirtyCount; ++i)
+	{
+		BlurRect rect;
+		memcpy(&rect, dirtyRects + i, sizeof(rect));
+		if (!InsideFrame(rect, source.width, source.height))
+			return false;
+		pixelBytes += RectBytes(rect);
+	}
+	if (header.flags & RecordingFrame_Keyframe)
+		pixelBytes = (uint64_t)source.width * source.height * 4;
+	return header.size == AlignRecord(pixelsOffset + pixelBytes);
+}
+
+// Brings the source's state to frame `index`: a keyframe is only pointed at, a delta is
+// applied to the canvas, which first takes the keyframe's pixels when it doesn't hold them
+static void PlayRecord(RecordingFrameSource& source, int index, RecordingFrameHeader& header)
+{
+	const uint8_t* record = source.file.data + source.records[index];
+	memcpy(&header, record, sizeof(header));
+	const uint8_t* pixels = record + RecordPixelsOffset(header.moveCount, header.dirtyCount);
+	if (header.flags & RecordingFrame_Keyframe)
+	{
+		source.keyframe = pixels;
+		return;
+	}
+
+	if (source.keyframe)
+	{
+		memcpy(source.canvas.data(), source.keyframe, source.canvas.size());
+		source.keyframe = nullptr;
+	}
+
+	const uint8_t* moves = record + sizeof(header);
+	for (uint32_t i = 0; i < header.moveCount; ++i)
+	{
+		DirtyMove move;
+		memcpy(&move, moves + i * sizeof(DirtyMove), sizeof(move));
+		ApplyMove(source.canvas, source.width, move);
+	}
+
+	const uint8_t* dirtyRects = moves + header.moveCount * sizeof(DirtyMove);
+	for (uint32_t i = 0; i < header.dirtyCount; ++i)
+	{
+		BlurRect rect;
+		memcpy(&rect, dirtyRects + i * sizeof(BlurRect), sizeof(rect));
+		const size_t rowBytes = (size_t)(rect.right - rect.left) * 4;
+		for (int y = rect.top; y < rect.bottom; ++y, pixels += rowBytes)
+			memcpy(&source.canvas[((size_t)y * source.width + rect.left) * 4], pixels, rowBytes);
+	}
+}
+
+FrameSourceResult RecordingFrameSource::AcquireFrame(int timeoutMs, Frame& frame)
+{
+	if (next >= (int)records.size())
+	{
+		if (!loop)
+			return FrameSource_End;
+
+		// Starting over jumps back in time, the consumer has to blur everything again
+		RecordingFrameSourceSeek(*this, 0);
+		return FrameSource_Lost;
+	}
+
+	RecordingFrameHeader header;
+	PlayRecord(*this, next, header);
+
+	const uint8_t* moves = file.data + records[next] + sizeof(header);
+	frame.moves.resize(header.moveCount);
+	frame.dirtyRects.resize(header.dirtyCount);
+	if (header.moveCount)
+		memcpy(frame.moves.data(), moves, header.moveCount * sizeof(DirtyMove));
+	if (header.dirtyCount)
+		memcpy(frame.dirtyRects.data(), moves + header.moveCount * sizeof(DirtyMove), header.dirtyCount * sizeof(BlurRect));
+
+	frame.width = width;
+	frame.height = height;
+	frame.pixels = keyframe ? keyframe : canvas.data();
+	frame.rowPitch = width * 4;
+	frame.timestamp = header.timestamp;
+	frame.pointerOnly = (header.flags & RecordingFrame_PointerOnly) != 0;
+	window = header.window;
+	++next;
+	return FrameSource_Ok;
+}
+
+void RecordingFrameSource::ReleaseFrame()
+{
+}
+
+RecordingFrameSource::~RecordingFrameSource()
+{
+	MappedFileClose(file);
+}
+
+RecordingFrameSource* CreateRecordingFrameSource(const char* path, bool loop)
+{
+	MappedFile file;
+	if (!MappedFileOpen(file, path))
+		return nullptr;
+
+	RecordingFileHeader header;
+	if (file.size >= sizeof(header))
+		memcpy(&header, file.data, sizeof(header));
+	if (file.size < sizeof(header) || header.magic != RecordingMagic || header.formatVersion != RecordingFormatVersion ||
+		header.width <= 0 || header.height <= 0 || header.width > 16384 || header.height > 16384)
+	{
+		MappedFileClose(file);
+		return nullptr;
+	}
+
+	RecordingFrameSource* source = new RecordingFrameSource();
+	source->file = file;
+	source->width = header.width;
+	source->height = header.height;
+	source->keyframe = nullptr;
+	source->next = 0;
+	source->loop = loop;
+	source->window = {};
+
+	// Up to the first record that doesn't hold together, e.g. one cut short by a crash
+	uint64_t offset = AlignRecord(sizeof(header));
+	RecordingFrameHeader frame;
+	while (ValidateRecord(*source, offset, frame))
+	{
+		// Deltas need a keyframe before them
+		if (source->records.empty() && !(frame.flags & RecordingFrame_Keyframe))
+			break;
+		source->records.push_back(offset);
+		offset += frame.size;
+	}
+
+	if (source->records.empty())
+	{
+		delete source;
+		return nullptr;
+	}
+	source->canvas.resize((size_t)source->width * source->height * 4);
+	return source;
+}
+
+bool RecordingFrameSourceSeek(RecordingFrameSource& source, int index)
+{
+	if (index < 0 || index >= (int)source.records.size())
+		return false;
+
+	int keyframe = index;
+	RecordingFrameHeader header;
+	for (;; --keyframe)
+	{
+		memcpy(&header, source.file.data + source.records[keyframe], sizeof(header));
+		if (header.flags & RecordingFrame_Keyframe)
+			break;
+	}
+
+	for (int frame = keyframe; frame < index; ++frame)
+		PlayRecord(source, frame, header);
+	source.next = index;
+	return true;
+}
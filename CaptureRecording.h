@@ -0,0 +1,164 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FrameSource.h"
+#include "MappedFile.h"
+
+// Recordings of what the desktop behind the window looked like, to reproduce a performance
+// problem away from the machine it happened on. Every frame keeps its timestamp, the window
+// rect and the dirty and move rects of the duplication. Its pixels are either a keyframe or
+// only the pixels under the dirty rects, moves are replayed by copying inside the frame.
+//
+//   RecordingFileHeader
+//   records, each RecordingAlignment-aligned:
+//     RecordingFrameHeader
+//     DirtyMove[moveCount]
+//     BlurRect[dirtyCount]
+//     pixels, RecordingAlignment-aligned: keyframes width * height packed, deltas each dirty
+//     rect packed in turn
+//
+// Rects are in the frame's pixels. The layout is little-endian and the same on Windows and
+// Linux. Records are found by walking them from the start, so a recording whose writer never
+// closed it still plays up to its last whole record.
+static const uint32_t RecordingMagic = 0x43524642;		 // "BFRC"
+static const uint32_t RecordingFrameMagic = 0x46524642;	 // "BFRF"
+static const uint32_t RecordingFormatVersion = 1;
+static const size_t RecordingAlignment = 16;
+
+// Two seconds at 60 Hz between keyframes
+static const int RecordingDefaultKeyframeInterval = 120;
+
+struct RecordingFileHeader
+{
+	uint32_t magic;
+	uint32_t formatVersion;
+	int32_t width;
+	int32_t height;
+	uint32_t frameCount;  // 0 until the writer closes the file
+	uint32_t keyframeInterval;
+	uint64_t padding;
+};
+
+enum RecordingFrameFlags
+{
+	RecordingFrame_Keyframe = 1,	 // The pixels are the whole frame
+	RecordingFrame_PointerOnly = 2,	 // Frame::pointerOnly
+};
+
+struct RecordingFrameHeader
+{
+	uint32_t magic;
+	uint32_t flags;	 // RecordingFrame_*
+	int64_t timestamp;
+	BlurRect window;
+	uint32_t moveCount;
+	uint32_t dirtyCount;
+	uint64_t size;	// Bytes of the whole record, padding included
+};
+
+struct RecordingWriter
+{
+	FILE* file;
+	RecordingFileHeader header;
+	int sinceKeyframe;
+	uint64_t bytesWritten;
+	uint32_t keyframes;
+	std::vector<uint8_t> record;  // Staged so each record is one write
+};
+
+bool RecordingWriterOpen(RecordingWriter& writer, const char* path, int width, int height,
+						 int keyframeInterval = RecordingDefaultKeyframeInterval);
+
+// Appends a frame with pixels and rects in the frame's pixels, `window` is recorded as is.
+// Frames of another size, or without pixels, fail. A frame becomes a keyframe every
+// keyframeInterval frames, or when its dirty pixels are as many as a keyframe's.
+bool RecordingWriterAdd(RecordingWriter& writer, const Frame& frame, const BlurRect& window);
+
+// Writes the frame count into the header, false when any write failed
+bool RecordingWriterClose(RecordingWriter& writer);
+
+// A 4K keyframe takes longer to write than a 60 Hz frame lasts, so the render thread only
+// copies what changed into a pooled packet and a thread of its own writes it. That thread
+// keeps the whole frame in `canvas`, keyframes come out of it.
+struct RecordingPacket
+{
+	int64_t timestamp;
+	bool pointerOnly;
+	bool whole;						   // pixels is the whole frame, else each of `copied` packed in turn
+	BlurRect window;
+	std::vector<BlurRect> dirtyRects;  // What the writer records
+	std::vector<DirtyMove> moves;
+	std::vector<BlurRect> copied;	   // Dirty rects and move destinations, clipped to the frame
+	std::vector<uint8_t> pixels;
+};
+
+// Four frames behind at most, past that frames are dropped rather than waited for
+static const int RecordingDefaultQueueLength = 4;
+
+struct RecordingThread
+{
+	RecordingWriter writer;	 // Only touched by the thread until RecordingThreadStop returns
+	std::vector<uint8_t> canvas;
+
+	std::vector<RecordingPacket> packets;
+	std::deque<int> queued;	 // Packets waiting for the thread, oldest first
+	std::vector<int> idle;
+
+	// Caller's side only: rects of dropped frames. The next frame that fits copies their pixels
+	// as well and records its moves as dirty rects, the canvas never saw the frames in between.
+	std::vector<BlurRect> unseen;
+	bool unseenWhole;  // Nothing went out yet, or too much was dropped to track
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool quitting;
+	bool failed;  // A write failed, nothing more is queued
+
+	uint64_t queuedFrames;
+	uint64_t droppedFrames;
+};
+
+bool RecordingThreadStart(RecordingThread& recording, const char* path, int width, int height,
+						  int queueLength = RecordingDefaultQueueLength, int keyframeInterval = RecordingDefaultKeyframeInterval);
+
+// Copies the frame's changes and queues them, like RecordingWriterAdd. False when the frame
+// can't be recorded, or was dropped because the queue is full.
+bool RecordingThreadAdd(RecordingThread& recording, const Frame& frame, const BlurRect& window);
+
+// Writes what is still queued and closes the file, false when any write failed
+bool RecordingThreadStop(RecordingThread& recording);
+
+// Plays a recording from its mapping. Keyframes are handed out straight from the mapping;
+// `canvas` is filled from the keyframe only when the first delta after it comes, and each
+// delta then copies its dirty rects and applies its moves in place.
+struct RecordingFrameSource : FrameSource
+{
+	MappedFile file;
+	int width;
+	int height;
+	std::vector<uint64_t> records;	// Offset of each frame's record
+	std::vector<uint8_t> canvas;	// The frame rebuilt from the last keyframe and the deltas since
+	const uint8_t* keyframe;		// The last keyframe's pixels while canvas doesn't hold them yet
+	int next;						// Index of the frame the next AcquireFrame returns
+	bool loop;
+	BlurRect window;  // Of the frame last acquired
+
+	FrameSourceResult AcquireFrame(int timeoutMs, Frame& frame) override;
+	void ReleaseFrame() override;
+	~RecordingFrameSource();
+};
+
+// nullptr when the file is missing or isn't a recording. A looping source returns Lost once
+// at the end and starts over, otherwise End.
+RecordingFrameSource* CreateRecordingFrameSource(const char* path, bool loop = false);
+
+// The next AcquireFrame returns frame `index`, rebuilt from the keyframe before it
+bool RecordingFrameSourceSeek(RecordingFrameSource& source, int index);
@@ -0,0 +1,272 @@
+#include "CpuBlur.h"
+#include "CpuBlurFixed.h"
+
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Rows [rowBegin, rowEnd) are the only ones the vertical pass can reach for a given rect
+struct SeparableRows
+{
+	int radius;
+	int rowBegin;
+	int rowEnd;
+	int rectWidth;
+	size_t rowStride;	 // uint32 sums per row
+};
+
+static SeparableRows PrepareSeparable(const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+	SeparableRows rows;
+	rows.radius = CpuBlurRadius(constants);
+	rows.rowBegin = std::max(0, rect.top - rows.radius);
+	rows.rowEnd = std::min((int)constants.textureHeight, rect.bottom + rows.radius);
+	rows.rectWidth = rect.right - rect.left;
+	rows.rowStride = (size_t)rows.rectWidth * 4;
+
+	scratch.rowSums.resize(rows.rowStride * (rows.rowEnd - rows.rowBegin));
+	scratch.columnSums.resize(rows.rowStride);
+	return rows;
+}
+
+static inline const uint32_t* RowSumsAt(const CpuBlurScratch& scratch, const SeparableRows& rows, int height, int y)
+{
+	y = CpuBlurClamp(y, 0, height - 1);
+	return scratch.rowSums.data() + (size_t)(y - rows.rowBegin) * rows.rowStride;
+}
+
+static void HorizontalPassScalar(const uint8_t* row, int width, int x0, int x1, int radius, uint32_t* sums)
+{
+	uint32_t acc[4] = {};
+	for (int k = -radius; k <= radius; ++k)
+	{
+		const uint8_t* p = row + 4 * CpuBlurClamp(x0 + k, 0, width - 1);
+		for (int c = 0; c < 4; ++c) acc[c] += p[c];
+	}
+
+	for (int x = x0; x < x1; ++x)
+	{
+		for (int c = 0; c < 4; ++c) sums[c] = acc[c];
+		sums += 4;
+
+		const uint8_t* add = row + 4 * CpuBlurClamp(x + radius + 1, 0, width - 1);
+		const uint8_t* sub = row + 4 * CpuBlurClamp(x - radius, 0, width - 1);
+		for (int c = 0; c < 4; ++c) acc[c] += (uint32_t)add[c] - sub[c];
+	}
+}
+
+static void SeedColumnSums(const CpuBlurScratch& scratch, const SeparableRows& rows, int height, int y, uint32_t* acc)
+{
+	for (size_t i = 0; i < rows.rowStride; ++i) acc[i] = 0;
+	for (int k = -rows.radius; k <= rows.radius; ++k)
+	{
+		const uint32_t* src = RowSumsAt(scratch, rows, height, y + k);
+		for (size_t i = 0; i < rows.rowStride; ++i) acc[i] += src[i];
+	}
+}
+
+void CpuBoxBlurRectScalar(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						  const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+	BlurRect clipped = rect;
+	if (!CpuBlurClipRect(constants, clipped))
+		return;
+
+	const int width = (int)constants.textureWidth;
+	const int height = (int)constants.textureHeight;
+	SeparableRows rows = PrepareSeparable(constants, clipped, scratch);
+
+	for (int y = rows.rowBegin; y < rows.rowEnd; ++y)
+	{
+		HorizontalPassScalar(input.pixels + (size_t)y * input.rowPitch, width, clipped.left, clipped.right,
+							 rows.radius, scratch.rowSums.data() + (size_t)(y - rows.rowBegin) * rows.rowStride);
+	}
+
+	uint32_t* acc = scratch.columnSums.data();
+	SeedColumnSums(scratch, rows, height, clipped.top, acc);
+
+	const uint64_t samples = (uint64_t)(2 * rows.radius + 1) * (2 * rows.radius + 1);
+	for (int y = clipped.top; y < clipped.bottom; ++y)
+	{
+		uint8_t* dst = output.pixels + (size_t)y * output.rowPitch + (size_t)clipped.left * 4;
+		for (int x = 0; x < rows.rectWidth; ++x)
+			CpuBlurResolvePixel(acc + x * 4, samples, CpuMaskCoverage(mask, clipped.left + x, y), dst + x * 4);
+
+		if (y + 1 == clipped.bottom)
+			break;
+
+		const uint32_t* add = RowSumsAt(scratch, rows, height, y + rows.radius + 1);
+		const uint32_t* sub = RowSumsAt(scratch, rows, height, y - rows.radius);
+		for (size_t i = 0; i < rows.rowStride; ++i) acc[i] += add[i] - sub[i];
+	}
+}
+
+#if defined(__AVX2__)
+
+// Same sliding window as the scalar pass, one pixel (4 x u32) per SSE register
+static void HorizontalPassAvx2(const uint8_t* row, int width, int x0, int x1, int radius, uint32_t* sums)
+{
+	auto load = [row, width](int x) {
+		int value = *(const int*)(row + 4 * CpuBlurClamp(x, 0, width - 1));
+		return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(value));
+	};
+
+	__m128i acc = _mm_setzero_si128();
+	for (int k = -radius; k <= radius; ++k)
+		acc = _mm_add_epi32(acc, load(x0 + k));
+
+	for (int x = x0; x < x1; ++x)
+	{
+		_mm_storeu_si128((__m128i*)sums, acc);
+		sums += 4;
+		acc = _mm_sub_epi32(_mm_add_epi32(acc, load(x + radius + 1)), load(x - radius));
+	}
+}
+
+// Rounds sum / samples half-up for 8 lanes. The float estimate is off by at most one,
+// the integer remainder check corrects it so the result matches the scalar path exactly.
+static inline __m256i DivideRoundAvx2(__m256i sum, __m256i samples, __m256 inverse)
+{
+	__m256 estimate = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(sum), inverse), _mm256_set1_ps(0.5f));
+	__m256i q = _mm256_cvttps_epi32(estimate);
+	__m256i remainder2 = _mm256_slli_epi32(_mm256_sub_epi32(sum, _mm256_mullo_epi32(q, samples)), 1);
+	__m256i tooLow = _mm256_cmpgt_epi32(remainder2, _mm256_sub_epi32(samples, _mm256_set1_epi32(1)));
+	__m256i tooHigh = _mm256_cmpgt_epi32(_mm256_sub_epi32(_mm256_setzero_si256(), samples), remainder2);
+	return _mm256_add_epi32(_mm256_sub_epi32(q, tooLow), tooHigh);
+}
+
+// Remainders stay in int32 up to this radius (255 * (2r+1)^2 < 2^31)
+static const int Avx2MaxRadius = 1023;
+
+void CpuBoxBlurRectAvx2(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+	if (CpuBlurRadius(constants) > Avx2MaxRadius)
+	{
+		CpuBoxBlurRectScalar(input, mask, output, constants, rect, scratch);
+		return;
+	}
+
+	BlurRect clipped = rect;
+	if (!CpuBlurClipRect(constants, clipped))
+		return;
+
+	const int width = (int)constants.textureWidth;
+	const int height = (int)constants.textureHeight;
+	SeparableRows rows = PrepareSeparable(constants, clipped, scratch);
+
+	for (int y = rows.rowBegin; y < rows.rowEnd; ++y)
+	{
+		HorizontalPassAvx2(input.pixels + (size_t)y * input.rowPitch, width, clipped.left, clipped.right,
+						   rows.radius, scratch.rowSums.data() + (size_t)(y - rows.rowBegin) * rows.rowStride);
+	}
+
+	uint32_t* acc = scratch.columnSums.data();
+	SeedColumnSums(scratch, rows, height, clipped.top, acc);
+
+	const int samples = (2 * rows.radius + 1) * (2 * rows.radius + 1);
+	const __m256i samplesV = _mm256_set1_epi32(samples);
+	const __m256 inverseV = _mm256_set1_ps(1.0f / (float)samples);
+	const __m256i packOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	const size_t vectorEnd = rows.rowStride & ~(size_t)7;
+
+	for (int y = clipped.top; y < clipped.bottom; ++y)
+	{
+		uint8_t* dst = output.pixels + (size_t)y * output.rowPitch + (size_t)clipped.left * 4;
+
+		// Two pixels per iteration
+		size_t i = 0;
+		for (; i < vectorEnd; i += 8)
+		{
+			__m256i q = DivideRoundAvx2(_mm256_loadu_si256((const __m256i*)(acc + i)), samplesV, inverseV);
+			__m256i words = _mm256_packus_epi32(q, q);
+			__m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(words, words), packOrder);
+			_mm_storel_epi64((__m128i*)(dst + i), _mm256_castsi256_si128(bytes));
+		}
+		for (; i < rows.rowStride; i += 4)
+			CpuBlurResolvePixel(acc + i, (uint64_t)samples, 255, dst + i);
+
+		// Mask gating is rare outside edges, fix those pixels up afterwards
+		for (int x = 0; x < rows.rectWidth; ++x)
+		{
+			uint8_t coverage = CpuMaskCoverage(mask, clipped.left + x, y);
+			if (coverage != 255)
+				CpuBlurResolvePixel(acc + x * 4, (uint64_t)samples, coverage, dst + x * 4);
+		}
+
+		if (y + 1 == clipped.bottom)
+			break;
+
+		const uint32_t* add = RowSumsAt(scratch, rows, height, y + rows.radius + 1);
+		const uint32_t* sub = RowSumsAt(scratch, rows, height, y - rows.radius);
+		i = 0;
+		for (; i < vectorEnd; i += 8)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+			a = _mm256_add_epi32(a, _mm256_loadu_si256((const __m256i*)(add + i)));
+			a = _mm256_sub_epi32(a, _mm256_loadu_si256((const __m256i*)(sub + i)));
+			_mm256_storeu_si256((__m256i*)(acc + i), a);
+		}
+		for (; i < rows.rowStride; ++i) acc[i] += add[i] - sub[i];
+	}
+}
+
+#endif
+
+void CpuBoxBlurRect(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+					const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+	if (CpuBlurRadius(constants) <= CpuBlurFixedMaxRadius)
+	{
+		CpuBoxBlurRectFixed(input, mask, output, constants, rect, scratch);
+		return;
+	}
+
+#if defined(__AVX2__)
+	CpuBoxBlurRectAvx2(input, mask, output, constants, rect, scratch);
+#else
+	CpuBoxBlurRectScalar(input, mask, output, constants, rect, scratch);
+#endif
+}
+
+void CpuBoxBlur(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+				const BlurConstants& constants, CpuBlurScratch& scratch)
+{
+	BlurRect rect = { 0, 0, (int)constants.textureWidth, (int)constants.textureHeight };
+	CpuBoxBlurRect(input, mask, output, constants, rect, scratch);
+}
+
+void CpuBoxBlurReference(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						 const BlurConstants& constants)
+{
+	const int width = (int)constants.textureWidth;
+	const int height = (int)constants.textureHeight;
+	const int radius = CpuBlurRadius(constants);
+
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			uint32_t sums[4] = {};
+			uint64_t samples = 0;
+
+			for (int dx = -radius; dx <= radius; dx++)
+			{
+				for (int dy = -radius; dy <= radius; dy++)
+				{
+					int sampleX = CpuBlurClamp(x + dx, 0, width - 1);
+					int sampleY = CpuBlurClamp(y + dy, 0, height - 1);
+
+					const uint8_t* p = input.pixels + (size_t)sampleY * input.rowPitch + (size_t)sampleX * 4;
+					for (int c = 0; c < 4; ++c) sums[c] += p[c];
+					samples += 1;
+				}
+			}
+
+			CpuBlurResolvePixel(sums, samples, CpuMaskCoverage(mask, x, y),
+								output.pixels + (size_t)y * output.rowPitch + (size_t)x * 4);
+		}
+	}
+}
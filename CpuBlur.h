@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Blur parameters constant buffer structure (shared with computeShaderSource)
+struct BlurConstants
+{
+	uint32_t textureWidth;
+	uint32_t textureHeight;
+	float blurRadius;  // How many pixels to blur (e.g., 3.0f for 3-pixel radius)
+	float padding;	   // Padding to align to 16 bytes
+};
+
+// BGRA8 pixels, textureWidth x textureHeight as given by BlurConstants
+struct CpuImage
+{
+	uint8_t* pixels;
+	int rowPitch;
+};
+
+// Mask coverage, `coverage` points at the coverage byte of the first pixel. R8 mask
+// (MaskLayer): pixelStride = 1. BGRA8 alpha: coverage = data + 3, pixelStride = 4.
+// A null mask means fully covered.
+struct CpuMask
+{
+	const uint8_t* coverage;
+	int rowPitch;
+	int pixelStride;
+};
+
+// Half-open pixel rectangle
+struct BlurRect
+{
+	int left;
+	int top;
+	int right;
+	int bottom;
+};
+
+// Per-thread working memory for the separable passes, reused between frames
+struct CpuBlurScratch
+{
+	std::vector<uint32_t> rowSums;
+	std::vector<uint32_t> columnSums;
+	std::vector<uint16_t> fixedRowSums;	 // CpuBlurFixed.h
+};
+
+// Accumulators are 32-bit, larger radii are clamped
+static const int CpuBlurMaxRadius = 2047;
+
+// Box blur with the exact semantics of computeShaderSource: (int)blurRadius, clamp-to-edge,
+// transparent black where the mask is empty and alpha scaled by mask coverage.
+// Averages are rounded half-up from exact integer sums, so every path here is bit-identical.
+//
+// Only pixels inside `rect` are written; reads may go anywhere in the image.
+void CpuBoxBlurRect(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+					const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch);
+
+void CpuBoxBlur(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+				const BlurConstants& constants, CpuBlurScratch& scratch);
+
+// Horizontal then vertical sliding-window passes, O(1) per pixel in the radius
+void CpuBoxBlurRectScalar(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						  const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch);
+
+#if defined(__AVX2__)
+void CpuBoxBlurRectAvx2(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch);
+#endif
+
+// Straight port of the shader's nested loop, O(r^2) per pixel
+void CpuBoxBlurReference(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						 const BlurConstants& constants);
+
+// Helpers shared by the CPU kernels
+inline int CpuBlurClamp(int value, int low, int high)
+{
+	return value < low ? low : (value > high ? high : value);
+}
+
+inline int CpuBlurRadius(const BlurConstants& constants)
+{
+	return CpuBlurClamp((int)constants.blurRadius, 0, CpuBlurMaxRadius);
+}
+
+inline uint8_t CpuMaskCoverage(const CpuMask& mask, int x, int y)
+{
+	if (!mask.coverage) return 255;
+	return mask.coverage[(size_t)y * mask.rowPitch + (size_t)x * mask.pixelStride];
+}
+
+// Clips `rect` to the texture, returns false when nothing is left
+inline bool CpuBlurClipRect(const BlurConstants& constants, BlurRect& rect)
+{
+	if (rect.left < 0) rect.left = 0;
+	if (rect.top < 0) rect.top = 0;
+	if (rect.right > (int)constants.textureWidth) rect.right = (int)constants.textureWidth;
+	if (rect.bottom > (int)constants.textureHeight) rect.bottom = (int)constants.textureHeight;
+	return rect.left < rect.right && rect.top < rect.bottom;
+}
+
+// Writes one output pixel from its four channel sums over `samples` taps
+inline void CpuBlurResolvePixel(const uint32_t* sums, uint64_t samples, uint8_t coverage, uint8_t* out)
+{
+	if (coverage == 0)
+	{
+		out[0] = out[1] = out[2] = out[3] = 0;
+		return;
+	}
+
+	for (int c = 0; c < 3; ++c)
+		out[c] = (uint8_t)((2 * (uint64_t)sums[c] + samples) / (2 * samples));
+
+	// color.a *= maskValue
+	uint64_t alphaDivisor = samples * 255;
+	out[3] = (uint8_t)((2 * (uint64_t)sums[3] * coverage + alphaDivisor) / (2 * alphaDivisor));
+}
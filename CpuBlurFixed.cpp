@@ -0,0 +1,400 @@
+#include "CpuBlurFixed.h"
+
+#include <algorithm>
+
+#if defined(CPU_BLUR_FIXED_SSE2)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Larger radii overflow the u16 row sums, the u32 kernels take them
+static void BoxBlurRectU32(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						   const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+#if defined(__AVX2__)
+	CpuBoxBlurRectAvx2(input, mask, output, constants, rect, scratch);
+#else
+	CpuBoxBlurRectScalar(input, mask, output, constants, rect, scratch);
+#endif
+}
+
+CpuBlurReciprocal CpuBlurFixedReciprocal(uint32_t samples)
+{
+	uint32_t bits = 0;
+	while ((1ull << bits) < samples)
+		++bits;
+
+	CpuBlurReciprocal reciprocal;
+	reciprocal.shift = 8 + 2 * bits;
+	reciprocal.multiplier = (uint32_t)(((1ull << reciprocal.shift) + samples - 1) / samples);
+	reciprocal.bias = (samples - 1) / 2;
+	return reciprocal;
+}
+
+// Rows [rowBegin, rowEnd) the vertical pass can reach, like CpuBlur.cpp's SeparableRows
+// but with u16 row sums
+struct FixedRows
+{
+	int radius;
+	int rowBegin;
+	int rowEnd;
+	int rectWidth;
+	size_t rowStride;  // u16 sums per row
+	uint32_t samples;
+	CpuBlurReciprocal reciprocal;
+};
+
+static FixedRows PrepareFixed(const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+	FixedRows rows;
+	rows.radius = CpuBlurRadius(constants);
+	rows.rowBegin = std::max(0, rect.top - rows.radius);
+	rows.rowEnd = std::min((int)constants.textureHeight, rect.bottom + rows.radius);
+	rows.rectWidth = rect.right - rect.left;
+	rows.rowStride = (size_t)rows.rectWidth * 4;
+	rows.samples = (uint32_t)((2 * rows.radius + 1) * (2 * rows.radius + 1));
+	rows.reciprocal = CpuBlurFixedReciprocal(rows.samples);
+
+	scratch.fixedRowSums.resize(rows.rowStride * (rows.rowEnd - rows.rowBegin));
+	scratch.columnSums.resize(rows.rowStride);
+	return rows;
+}
+
+static inline uint16_t* FixedRowAt(CpuBlurScratch& scratch, const FixedRows& rows, int y)
+{
+	return scratch.fixedRowSums.data() + (size_t)(y - rows.rowBegin) * rows.rowStride;
+}
+
+static inline const uint16_t* FixedRowClamped(CpuBlurScratch& scratch, const FixedRows& rows, int height, int y)
+{
+	return FixedRowAt(scratch, rows, CpuBlurClamp(y, 0, height - 1));
+}
+
+// u16 sums wrap while a pixel is added before the one leaving is subtracted, they are
+// exact again once both are in
+static void HorizontalFixedScalar(const uint8_t* row, int width, int x0, int x1, int radius, uint16_t* sums)
+{
+	uint16_t acc[4] = {};
+	for (int k = -radius; k <= radius; ++k)
+	{
+		const uint8_t* p = row + 4 * CpuBlurClamp(x0 + k, 0, width - 1);
+		for (int c = 0; c < 4; ++c) acc[c] = (uint16_t)(acc[c] + p[c]);
+	}
+
+	for (int x = x0; x < x1; ++x)
+	{
+		for (int c = 0; c < 4; ++c) sums[c] = acc[c];
+		sums += 4;
+
+		const uint8_t* add = row + 4 * CpuBlurClamp(x + radius + 1, 0, width - 1);
+		const uint8_t* sub = row + 4 * CpuBlurClamp(x - radius, 0, width - 1);
+		for (int c = 0; c < 4; ++c) acc[c] = (uint16_t)(acc[c] + add[c] - sub[c]);
+	}
+}
+
+static void SeedFixedColumns(CpuBlurScratch& scratch, const FixedRows& rows, int height, int y, uint32_t* acc)
+{
+	for (size_t i = 0; i < rows.rowStride; ++i) acc[i] = 0;
+	for (int k = -rows.radius; k <= rows.radius; ++k)
+	{
+		const uint16_t* src = FixedRowClamped(scratch, rows, height, y + k);
+		for (size_t i = 0; i < rows.rowStride; ++i) acc[i] += src[i];
+	}
+}
+
+static void AdvanceFixedColumns(CpuBlurScratch& scratch, const FixedRows& rows, int height, int y, uint32_t* acc, size_t begin)
+{
+	const uint16_t* add = FixedRowClamped(scratch, rows, height, y + rows.radius + 1);
+	const uint16_t* sub = FixedRowClamped(scratch, rows, height, y - rows.radius);
+	for (size_t i = begin; i < rows.rowStride; ++i) acc[i] += (uint32_t)add[i] - sub[i];
+}
+
+static void ResolveFixedScalar(const uint32_t* acc, const FixedRows& rows, size_t begin, uint8_t* dst)
+{
+	for (size_t i = begin; i < rows.rowStride; ++i)
+		dst[i] = (uint8_t)CpuBlurFixedDivide(acc[i], rows.reciprocal);
+}
+
+// Pixels with partial coverage need the exact alpha * coverage rounding of CpuBlurResolvePixel
+static void FixupMask(const CpuMask& mask, const FixedRows& rows, const uint32_t* acc, int left, int y, uint8_t* dst)
+{
+	if (!mask.coverage)
+		return;
+
+	for (int x = 0; x < rows.rectWidth; ++x)
+	{
+		uint8_t coverage = CpuMaskCoverage(mask, left + x, y);
+		if (coverage != 255)
+			CpuBlurResolvePixel(acc + x * 4, rows.samples, coverage, dst + x * 4);
+	}
+}
+
+void CpuBoxBlurRectFixedScalar(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+							   const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+	if (CpuBlurRadius(constants) > CpuBlurFixedMaxRadius)
+	{
+		BoxBlurRectU32(input, mask, output, constants, rect, scratch);
+		return;
+	}
+
+	BlurRect clipped = rect;
+	if (!CpuBlurClipRect(constants, clipped))
+		return;
+
+	const int width = (int)constants.textureWidth;
+	const int height = (int)constants.textureHeight;
+	FixedRows rows = PrepareFixed(constants, clipped, scratch);
+
+	for (int y = rows.rowBegin; y < rows.rowEnd; ++y)
+		HorizontalFixedScalar(input.pixels + (size_t)y * input.rowPitch, width, clipped.left, clipped.right, rows.radius, FixedRowAt(scratch, rows, y));
+
+	uint32_t* acc = scratch.columnSums.data();
+	SeedFixedColumns(scratch, rows, height, clipped.top, acc);
+
+	for (int y = clipped.top; y < clipped.bottom; ++y)
+	{
+		uint8_t* dst = output.pixels + (size_t)y * output.rowPitch + (size_t)clipped.left * 4;
+		ResolveFixedScalar(acc, rows, 0, dst);
+		FixupMask(mask, rows, acc, clipped.left, y, dst);
+
+		if (y + 1 < clipped.bottom)
+			AdvanceFixedColumns(scratch, rows, height, y, acc, 0);
+	}
+}
+
+#if defined(CPU_BLUR_FIXED_SSE2)
+
+static inline __m128i LoadPixelSse2(const uint8_t* row, int x)
+{
+	return _mm_cvtsi32_si128(*(const int*)(row + 4 * x));
+}
+
+// Rows y and y + 1 side by side, one pixel of each per register as 2 x 4 u16
+static void HorizontalFixedPairSse2(const uint8_t* row0, const uint8_t* row1, int width, int x0, int x1, int radius,
+									uint16_t* sums0, uint16_t* sums1)
+{
+	const __m128i zero = _mm_setzero_si128();
+	auto load = [=](int x) {
+		x = CpuBlurClamp(x, 0, width - 1);
+		return _mm_unpacklo_epi8(_mm_unpacklo_epi32(LoadPixelSse2(row0, x), LoadPixelSse2(row1, x)), zero);
+	};
+
+	__m128i acc = zero;
+	for (int k = -radius; k <= radius; ++k)
+		acc = _mm_add_epi16(acc, load(x0 + k));
+
+	for (int x = x0; x < x1; ++x)
+	{
+		_mm_storel_epi64((__m128i*)sums0, acc);
+		_mm_storel_epi64((__m128i*)sums1, _mm_unpackhi_epi64(acc, acc));
+		sums0 += 4;
+		sums1 += 4;
+		acc = _mm_sub_epi16(_mm_add_epi16(acc, load(x + radius + 1)), load(x - radius));
+	}
+}
+
+// (sum + bias) * multiplier >> shift for 4 u32 lanes, pmuludq takes the even lanes
+static inline __m128i DivideFixedSse2(__m128i sum, __m128i bias, __m128i multiplier, __m128i shift)
+{
+	sum = _mm_add_epi32(sum, bias);
+	__m128i even = _mm_srl_epi64(_mm_mul_epu32(sum, multiplier), shift);
+	__m128i odd = _mm_srl_epi64(_mm_mul_epu32(_mm_srli_epi64(sum, 32), multiplier), shift);
+	return _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+}
+
+void CpuBoxBlurRectFixedSse2(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+							 const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+	if (CpuBlurRadius(constants) > CpuBlurFixedMaxRadius)
+	{
+		BoxBlurRectU32(input, mask, output, constants, rect, scratch);
+		return;
+	}
+
+	BlurRect clipped = rect;
+	if (!CpuBlurClipRect(constants, clipped))
+		return;
+
+	const int width = (int)constants.textureWidth;
+	const int height = (int)constants.textureHeight;
+	FixedRows rows = PrepareFixed(constants, clipped, scratch);
+
+	int y = rows.rowBegin;
+	for (; y + 1 < rows.rowEnd; y += 2)
+	{
+		const uint8_t* row0 = input.pixels + (size_t)y * input.rowPitch;
+		HorizontalFixedPairSse2(row0, row0 + input.rowPitch, width, clipped.left, clipped.right, rows.radius,
+								FixedRowAt(scratch, rows, y), FixedRowAt(scratch, rows, y + 1));
+	}
+	if (y < rows.rowEnd)
+		HorizontalFixedScalar(input.pixels + (size_t)y * input.rowPitch, width, clipped.left, clipped.right, rows.radius, FixedRowAt(scratch, rows, y));
+
+	uint32_t* acc = scratch.columnSums.data();
+	SeedFixedColumns(scratch, rows, height, clipped.top, acc);
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi32((int)rows.reciprocal.bias);
+	const __m128i multiplier = _mm_set1_epi32((int)rows.reciprocal.multiplier);
+	const __m128i shift = _mm_cvtsi32_si128((int)rows.reciprocal.shift);
+	const size_t vectorEnd = rows.rowStride & ~(size_t)7;
+
+	for (y = clipped.top; y < clipped.bottom; ++y)
+	{
+		uint8_t* dst = output.pixels + (size_t)y * output.rowPitch + (size_t)clipped.left * 4;
+
+		// Two pixels per iteration
+		size_t i = 0;
+		for (; i < vectorEnd; i += 8)
+		{
+			__m128i q0 = DivideFixedSse2(_mm_loadu_si128((const __m128i*)(acc + i)), bias, multiplier, shift);
+			__m128i q1 = DivideFixedSse2(_mm_loadu_si128((const __m128i*)(acc + i + 4)), bias, multiplier, shift);
+			__m128i words = _mm_packs_epi32(q0, q1);
+			_mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(words, words));
+		}
+		ResolveFixedScalar(acc, rows, i, dst);
+		FixupMask(mask, rows, acc, clipped.left, y, dst);
+
+		if (y + 1 == clipped.bottom)
+			break;
+
+		const uint16_t* add = FixedRowClamped(scratch, rows, height, y + rows.radius + 1);
+		const uint16_t* sub = FixedRowClamped(scratch, rows, height, y - rows.radius);
+		for (i = 0; i < vectorEnd; i += 8)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(add + i));
+			__m128i s = _mm_loadu_si128((const __m128i*)(sub + i));
+			__m128i lo = _mm_sub_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc + i)), _mm_unpacklo_epi16(a, zero)), _mm_unpacklo_epi16(s, zero));
+			__m128i hi = _mm_sub_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc + i + 4)), _mm_unpackhi_epi16(a, zero)), _mm_unpackhi_epi16(s, zero));
+			_mm_storeu_si128((__m128i*)(acc + i), lo);
+			_mm_storeu_si128((__m128i*)(acc + i + 4), hi);
+		}
+		AdvanceFixedColumns(scratch, rows, height, y, acc, i);
+	}
+}
+
+#endif
+
+#if defined(__AVX2__)
+
+// Four rows at once, one pixel of each per register as 4 x 4 u16
+static void HorizontalFixedQuadAvx2(const uint8_t* row, int rowPitch, int width, int x0, int x1, int radius, uint16_t* const* sums)
+{
+	auto load = [=](int x) {
+		const uint8_t* p = row + 4 * CpuBlurClamp(x, 0, width - 1);
+		__m128i pixels = _mm_setr_epi32(*(const int*)p, *(const int*)(p + rowPitch), *(const int*)(p + 2 * (size_t)rowPitch),
+										*(const int*)(p + 3 * (size_t)rowPitch));
+		return _mm256_cvtepu8_epi16(pixels);
+	};
+
+	__m256i acc = _mm256_setzero_si256();
+	for (int k = -radius; k <= radius; ++k)
+		acc = _mm256_add_epi16(acc, load(x0 + k));
+
+	for (int x = x0; x < x1; ++x)
+	{
+		const int offset = (x - x0) * 4;
+		__m128i low = _mm256_castsi256_si128(acc);
+		__m128i high = _mm256_extracti128_si256(acc, 1);
+		_mm_storel_epi64((__m128i*)(sums[0] + offset), low);
+		_mm_storel_epi64((__m128i*)(sums[1] + offset), _mm_unpackhi_epi64(low, low));
+		_mm_storel_epi64((__m128i*)(sums[2] + offset), high);
+		_mm_storel_epi64((__m128i*)(sums[3] + offset), _mm_unpackhi_epi64(high, high));
+		acc = _mm256_sub_epi16(_mm256_add_epi16(acc, load(x + radius + 1)), load(x - radius));
+	}
+}
+
+static inline __m256i DivideFixedAvx2(__m256i sum, __m256i bias, __m256i multiplier, __m128i shift)
+{
+	sum = _mm256_add_epi32(sum, bias);
+	__m256i even = _mm256_srl_epi64(_mm256_mul_epu32(sum, multiplier), shift);
+	__m256i odd = _mm256_srl_epi64(_mm256_mul_epu32(_mm256_srli_epi64(sum, 32), multiplier), shift);
+	return _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+}
+
+void CpuBoxBlurRectFixedAvx2(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+							 const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+	if (CpuBlurRadius(constants) > CpuBlurFixedMaxRadius)
+	{
+		BoxBlurRectU32(input, mask, output, constants, rect, scratch);
+		return;
+	}
+
+	BlurRect clipped = rect;
+	if (!CpuBlurClipRect(constants, clipped))
+		return;
+
+	const int width = (int)constants.textureWidth;
+	const int height = (int)constants.textureHeight;
+	FixedRows rows = PrepareFixed(constants, clipped, scratch);
+
+	int y = rows.rowBegin;
+	for (; y + 3 < rows.rowEnd; y += 4)
+	{
+		uint16_t* sums[4] = { FixedRowAt(scratch, rows, y), FixedRowAt(scratch, rows, y + 1), FixedRowAt(scratch, rows, y + 2), FixedRowAt(scratch, rows, y + 3) };
+		HorizontalFixedQuadAvx2(input.pixels + (size_t)y * input.rowPitch, input.rowPitch, width, clipped.left, clipped.right, rows.radius, sums);
+	}
+	for (; y < rows.rowEnd; ++y)
+		HorizontalFixedScalar(input.pixels + (size_t)y * input.rowPitch, width, clipped.left, clipped.right, rows.radius, FixedRowAt(scratch, rows, y));
+
+	uint32_t* acc = scratch.columnSums.data();
+	SeedFixedColumns(scratch, rows, height, clipped.top, acc);
+
+	const __m256i bias = _mm256_set1_epi32((int)rows.reciprocal.bias);
+	const __m256i multiplier = _mm256_set1_epi32((int)rows.reciprocal.multiplier);
+	const __m128i shift = _mm_cvtsi32_si128((int)rows.reciprocal.shift);
+	const __m256i packOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	const size_t vectorEnd = rows.rowStride & ~(size_t)15;
+
+	for (y = clipped.top; y < clipped.bottom; ++y)
+	{
+		uint8_t* dst = output.pixels + (size_t)y * output.rowPitch + (size_t)clipped.left * 4;
+
+		// Four pixels per iteration
+		size_t i = 0;
+		for (; i < vectorEnd; i += 16)
+		{
+			__m256i q0 = DivideFixedAvx2(_mm256_loadu_si256((const __m256i*)(acc + i)), bias, multiplier, shift);
+			__m256i q1 = DivideFixedAvx2(_mm256_loadu_si256((const __m256i*)(acc + i + 8)), bias, multiplier, shift);
+			__m256i words = _mm256_packs_epi32(q0, q1);
+			__m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(words, words), packOrder);
+			_mm_storeu_si128((__m128i*)(dst + i), _mm256_castsi256_si128(bytes));
+		}
+		ResolveFixedScalar(acc, rows, i, dst);
+		FixupMask(mask, rows, acc, clipped.left, y, dst);
+
+		if (y + 1 == clipped.bottom)
+			break;
+
+		const uint16_t* add = FixedRowClamped(scratch, rows, height, y + rows.radius + 1);
+		const uint16_t* sub = FixedRowClamped(scratch, rows, height, y - rows.radius);
+		for (i = 0; i < vectorEnd; i += 16)
+		{
+			for (size_t half = 0; half < 16; half += 8)
+			{
+				__m256i a = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(add + i + half)));
+				__m256i s = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(sub + i + half)));
+				__m256i sum = _mm256_loadu_si256((const __m256i*)(acc + i + half));
+				_mm256_storeu_si256((__m256i*)(acc + i + half), _mm256_sub_epi32(_mm256_add_epi32(sum, a), s));
+			}
+		}
+		AdvanceFixedColumns(scratch, rows, height, y, acc, i);
+	}
+}
+
+#endif
+
+void CpuBoxBlurRectFixed(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						 const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+#if defined(__AVX2__)
+	CpuBoxBlurRectFixedAvx2(input, mask, output, constants, rect, scratch);
+#elif defined(CPU_BLUR_FIXED_SSE2)
+	CpuBoxBlurRectFixedSse2(input, mask, output, constants, rect, scratch);
+#else
+	CpuBoxBlurRectFixedScalar(input, mask, output, constants, rect, scratch);
+#endif
+}
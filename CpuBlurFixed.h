@@ -0,0 +1,56 @@
+#pragma once
+
+#include "CpuBlur.h"
+
+// Fixed-point box blur on packed BGRA8. The horizontal pass keeps its sums in u16, a pixel's
+// four channels in 64 bits, and runs two rows per SSE2 register or four per AVX2 register.
+// The vertical pass accumulates those in u32 and normalizes with a reciprocal multiply and
+// shift instead of a division.
+//
+// Error: the reciprocal is exact for every sum a radius up to CpuBlurFixedMaxRadius can
+// produce (see CpuBlurFixedReciprocal), so the output is bit-identical to the u32 kernels in
+// CpuBlur.h, and CpuBoxBlurRect uses these whenever the radius allows. Against the shader's
+// float math it is off by at most 1 LSB, where float rounding lands on the other side of a
+// .5 that the exact sum rounds up from.
+#if defined(__SSE2__) || defined(_M_X64)
+#define CPU_BLUR_FIXED_SSE2 1
+#endif
+
+// 255 * (2r + 1) still fits a u16 row sum
+static const int CpuBlurFixedMaxRadius = 128;
+
+// (sum + bias) * multiplier >> shift == sum / samples rounded half-up
+struct CpuBlurReciprocal
+{
+	uint32_t multiplier;
+	uint32_t shift;
+	uint32_t bias;
+};
+
+// samples is (2r + 1)^2, odd. With shift = 8 + 2 * ceil(log2 samples) the multiplier's
+// rounding error times any sum below 256 * samples stays under 2^shift, which makes the
+// quotient exact, and the multiplier stays below 2^26 so the product fits 64 bits.
+CpuBlurReciprocal CpuBlurFixedReciprocal(uint32_t samples);
+
+inline uint32_t CpuBlurFixedDivide(uint32_t sum, const CpuBlurReciprocal& reciprocal)
+{
+	return (uint32_t)(((uint64_t)(sum + reciprocal.bias) * reciprocal.multiplier) >> reciprocal.shift);
+}
+
+// Same signature and output as CpuBoxBlurRectScalar, radii above CpuBlurFixedMaxRadius go to the u32 kernels
+void CpuBoxBlurRectFixedScalar(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+							   const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch);
+
+#if defined(CPU_BLUR_FIXED_SSE2)
+void CpuBoxBlurRectFixedSse2(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+							 const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch);
+#endif
+
+#if defined(__AVX2__)
+void CpuBoxBlurRectFixedAvx2(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+							 const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch);
+#endif
+
+// The widest variant the build enables
+void CpuBoxBlurRectFixed(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						 const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch);
@@ -0,0 +1,142 @@
+#include "CpuBlurTiled.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <string.h>
+
+static int RoundUpToGroups(int size)
+{
+	if (size < CpuBlurGroupSize) size = CpuBlurGroupSize;
+	return (size + CpuBlurGroupSize - 1) / CpuBlurGroupSize * CpuBlurGroupSize;
+}
+
+void CpuTiledBlurStart(CpuTiledBlur& blur, int threadCount, int tileWidth, int tileHeight)
+{
+	ThreadPoolStart(blur.pool, threadCount);
+	blur.scratch.resize(ThreadPoolWorkerCount(blur.pool));
+	blur.tileWidth = RoundUpToGroups(tileWidth);
+	blur.tileHeight = RoundUpToGroups(tileHeight);
+}
+
+void CpuTiledBlurStop(CpuTiledBlur& blur)
+{
+	ThreadPoolStop(blur.pool);
+	blur.scratch.clear();
+}
+
+static int TilesAcross(const CpuTiledBlur& blur, const BlurConstants& constants)
+{
+	return ((int)constants.textureWidth + blur.tileWidth - 1) / blur.tileWidth;
+}
+
+int CpuTiledBlurTileCount(const CpuTiledBlur& blur, const BlurConstants& constants)
+{
+	int tilesDown = ((int)constants.textureHeight + blur.tileHeight - 1) / blur.tileHeight;
+	return TilesAcross(blur, constants) * tilesDown;
+}
+
+BlurRect CpuTiledBlurTileRect(const CpuTiledBlur& blur, const BlurConstants& constants, int tile)
+{
+	int tilesAcross = TilesAcross(blur, constants);
+	BlurRect rect;
+	rect.left = (tile % tilesAcross) * blur.tileWidth;
+	rect.top = (tile / tilesAcross) * blur.tileHeight;
+	rect.right = std::min(rect.left + blur.tileWidth, (int)constants.textureWidth);
+	rect.bottom = std::min(rect.top + blur.tileHeight, (int)constants.textureHeight);
+	return rect;
+}
+
+void CpuTiledBlurRun(CpuTiledBlur& blur, const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+					 const BlurConstants& constants, BlurKernelType kernel)
+{
+	const BlurRect everything = { 0, 0, (int)constants.textureWidth, (int)constants.textureHeight };
+	CpuTiledBlurRunRect(blur, input, mask, output, constants, everything, kernel);
+}
+
+void CpuTiledBlurRunRect(CpuTiledBlur& blur, const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						 const BlurConstants& constants, const BlurRect& area, BlurKernelType kernel)
+{
+	if (area.left >= area.right || area.top >= area.bottom)
+		return;
+
+	// Same tile grid as CpuTiledBlurTileRect, started at the rect's corner
+	const BlurConstants areaSize = { (uint32_t)(area.right - area.left), (uint32_t)(area.bottom - area.top), constants.blurRadius, 0.0f };
+	ThreadPoolParallelFor(blur.pool, CpuTiledBlurTileCount(blur, areaSize), [&](int tile, int worker) {
+		TRACE_ZONE("Blur tile");
+		BlurRect rect = CpuTiledBlurTileRect(blur, areaSize, tile);
+		rect = { rect.left + area.left, rect.top + area.top, rect.right + area.left, rect.bottom + area.top };
+		if (kernel == BlurKernel_Box)
+			CpuBoxBlurRect(input, mask, output, constants, rect, blur.scratch[worker]);
+		else
+			CpuBlurKernelRect(kernel, input, mask, output, constants, rect, blur.scratch[worker]);
+	});
+}
+
+// Bounds of the non-empty map tiles inside `rect`, false when there are none
+static bool CoveredBounds(const MaskTileMap& map, const BlurRect& rect, BlurRect& bounds, bool& full)
+{
+	const int tileX0 = rect.left / map.tileWidth;
+	const int tileY0 = rect.top / map.tileHeight;
+	const int tileX1 = std::min((rect.right + map.tileWidth - 1) / map.tileWidth, map.tilesAcross);
+	const int tileY1 = std::min((rect.bottom + map.tileHeight - 1) / map.tileHeight, map.tilesDown);
+
+	bool found = false;
+	for (int tileY = tileY0; tileY < tileY1; ++tileY)
+	{
+		for (int tileX = tileX0; tileX < tileX1; ++tileX)
+		{
+			uint8_t tileClass = map.classes[(size_t)tileY * map.tilesAcross + tileX];
+			if (tileClass == MaskTile_Empty)
+				continue;
+
+			BlurRect tile = MaskTileRect(map, MaskTilePack(tileX, tileY));
+			bounds = found ? BlurRect{ std::min(bounds.left, tile.left), std::min(bounds.top, tile.top),
+									   std::max(bounds.right, tile.right), std::max(bounds.bottom, tile.bottom) } : tile;
+			found = true;
+		}
+	}
+	if (!found)
+		return false;
+
+	// Empty or partial tiles inside the bounds need the mask, it zeroes the empty ones
+	full = true;
+	for (int tileY = bounds.top / map.tileHeight; full && tileY * map.tileHeight < bounds.bottom; ++tileY)
+		for (int tileX = bounds.left / map.tileWidth; full && tileX * map.tileWidth < bounds.right; ++tileX)
+			full = map.classes[(size_t)tileY * map.tilesAcross + tileX] == MaskTile_Full;
+
+	bounds = { std::max(bounds.left, rect.left), std::max(bounds.top, rect.top),
+			   std::min(bounds.right, rect.right), std::min(bounds.bottom, rect.bottom) };
+	return bounds.left < bounds.right && bounds.top < bounds.bottom;
+}
+
+void CpuSparseBlurRun(CpuTiledBlur& blur, MaskTileMap& map, const CpuImage& input, const CpuMask& mask,
+					  const CpuImage& output, const BlurConstants& constants, BlurKernelType kernel)
+{
+	if (constants.textureWidth == 0 || constants.textureHeight == 0)
+		return;
+
+	for (uint32_t tile : map.clearedTiles)
+	{
+		BlurRect rect = MaskTileRect(map, tile);
+		if (!CpuBlurClipRect(constants, rect))
+			continue;
+		for (int y = rect.top; y < rect.bottom; ++y)
+			memset(output.pixels + (size_t)y * output.rowPitch + (size_t)rect.left * 4, 0, (size_t)(rect.right - rect.left) * 4);
+	}
+	MaskTileClearsDone(map);
+
+	const CpuMask noMask = {};
+	ThreadPoolParallelFor(blur.pool, CpuTiledBlurTileCount(blur, constants), [&](int tile, int worker) {
+		BlurRect bounds;
+		bool full;
+		if (!CoveredBounds(map, CpuTiledBlurTileRect(blur, constants, tile), bounds, full))
+			return;
+
+		TRACE_ZONE("Blur tile");
+		const CpuMask& tileMask = full ? noMask : mask;
+		if (kernel == BlurKernel_Box)
+			CpuBoxBlurRect(input, tileMask, output, constants, bounds, blur.scratch[worker]);
+		else
+			CpuBlurKernelRect(kernel, input, tileMask, output, constants, bounds, blur.scratch[worker]);
+	});
+}
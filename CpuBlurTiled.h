@@ -0,0 +1,44 @@
+#pragma once
+
+#include "BlurKernels.h"
+#include "CpuBlur.h"
+#include "MaskTiles.h"
+#include "ThreadPool.h"
+
+// Tiles are whole 8x8 dispatch groups, 16x16 groups keep a tile's row sums in L2
+static const int CpuBlurGroupSize = 8;
+static const int CpuBlurDefaultTileGroups = 16;
+
+// Multithreaded CPU backend: the dispatch grid of ApplyBlurEffect is cut into tiles,
+// each tile reads a halo of blurRadius pixels around itself and writes only its own pixels.
+struct CpuTiledBlur
+{
+	ThreadPool pool;
+	std::vector<CpuBlurScratch> scratch;  // One per worker
+	int tileWidth;
+	int tileHeight;
+};
+
+// threadCount 0 uses every hardware thread, tile sizes are rounded up to whole groups
+void CpuTiledBlurStart(CpuTiledBlur& blur, int threadCount = 0,
+					   int tileWidth = CpuBlurGroupSize * CpuBlurDefaultTileGroups,
+					   int tileHeight = CpuBlurGroupSize * CpuBlurDefaultTileGroups);
+void CpuTiledBlurStop(CpuTiledBlur& blur);
+
+int CpuTiledBlurTileCount(const CpuTiledBlur& blur, const BlurConstants& constants);
+BlurRect CpuTiledBlurTileRect(const CpuTiledBlur& blur, const BlurConstants& constants, int tile);
+
+// Box tiles use the sliding-window CpuBoxBlurRect, other kernels CpuBlurKernelRect
+void CpuTiledBlurRun(CpuTiledBlur& blur, const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+					 const BlurConstants& constants, BlurKernelType kernel = BlurKernel_Box);
+
+// Only the tiles of `rect`, reads still go anywhere inside the constants' size
+void CpuTiledBlurRunRect(CpuTiledBlur& blur, const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						 const BlurConstants& constants, const BlurRect& rect, BlurKernelType kernel = BlurKernel_Box);
+
+// Same output as CpuTiledBlurRun where the mask is non-zero, for a map classified from
+// `mask`. Writes transparent black over map.clearedTiles and consumes them, other empty
+// tiles are skipped and keep the zeros written there before. Each tile is shrunk to the
+// non-empty map tiles it contains and blurred without the mask when they are all full.
+void CpuSparseBlurRun(CpuTiledBlur& blur, MaskTileMap& map, const CpuImage& input, const CpuMask& mask,
+					  const CpuImage& output, const BlurConstants& constants, BlurKernelType kernel = BlurKernel_Box);
@@ -0,0 +1,36 @@
+#include "CpuComposite.h"
+
+void CpuCompositeRect(const CpuImage& desktop, const CpuImage& blurred, const CpuImage& output,
+					  const BlurConstants& constants, const BlurRect& rect)
+{
+	BlurRect clipped = rect;
+	if (!CpuBlurClipRect(constants, clipped))
+		return;
+
+	for (int y = clipped.top; y < clipped.bottom; ++y)
+	{
+		const uint8_t* desktopRow = desktop.pixels + (size_t)y * desktop.rowPitch;
+		const uint8_t* blurredRow = blurred.pixels + (size_t)y * blurred.rowPitch;
+		uint8_t* outputRow = output.pixels + (size_t)y * output.rowPitch;
+
+		for (int x = clipped.left; x < clipped.right; ++x)
+		{
+			const uint8_t* source = blurredRow + (size_t)x * 4;
+			if ((source[0] | source[1] | source[2]) == 0)
+				source = desktopRow + (size_t)x * 4;
+
+			uint8_t* dest = outputRow + (size_t)x * 4;
+			dest[0] = source[0];
+			dest[1] = source[1];
+			dest[2] = source[2];
+			dest[3] = 255;
+		}
+	}
+}
+
+void CpuComposite(const CpuImage& desktop, const CpuImage& blurred, const CpuImage& output,
+				  const BlurConstants& constants)
+{
+	BlurRect rect = { 0, 0, (int)constants.textureWidth, (int)constants.textureHeight };
+	CpuCompositeRect(desktop, blurred, output, constants, rect);
+}
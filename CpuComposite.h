@@ -0,0 +1,12 @@
+#pragma once
+
+#include "CpuBlur.h"
+
+// What ends up on screen: RenderBlurQuad copies blurTexture into the back buffer 1:1 and the
+// layered window's LWA_COLORKEY turns pure black pixels (the mask's transparent black) into
+// holes that show the desktop. Alpha is ignored by the color key, the result is opaque.
+void CpuCompositeRect(const CpuImage& desktop, const CpuImage& blurred, const CpuImage& output,
+					  const BlurConstants& constants, const BlurRect& rect);
+
+void CpuComposite(const CpuImage& desktop, const CpuImage& blurred, const CpuImage& output,
+				  const BlurConstants& constants);
@@ -0,0 +1,458 @@
+#include "CpuIirGaussian.h"
+#include "Trace.h"
+
+#include <math.h>
+#include <algorithm>
+#include <complex>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+typedef std::complex<double> Complex;
+
+// Third-order poles for sigma = 2, L-infinity fit (van Vliet, Young and Verbeek 1998)
+static const Complex BasePoles[3] = { Complex(1.41650, 1.00829), Complex(1.41650, -1.00829), Complex(1.86543, 0.0) };
+
+static const int RowsPerTask = 16;
+static const int ColumnsPerTask = 64;
+
+// Variance of the causal + anticausal cascade with the base poles raised to 1/q
+static double CascadeVariance(double q)
+{
+	double variance = 0.0;
+	for (const Complex& pole : BasePoles)
+	{
+		Complex d = std::pow(pole, 1.0 / q);
+		variance += 2.0 * (d / ((d - 1.0) * (d - 1.0))).real();
+	}
+	return variance;
+}
+
+// Filter state after one sample: the real section's output a, the pair's output b and its step v
+struct IirState
+{
+	double a;
+	double b;
+	double v;
+};
+
+static inline void StepState(IirState& state, double x, double realGain, double pairGain, double pairDamping)
+{
+	state.a += realGain * (x - state.a);
+	state.v += pairGain * (state.a - state.b) - pairDamping * state.v;
+	state.b += state.v;
+}
+
+void IirGaussianCompute(float sigma, uint32_t width, uint32_t height, IirGaussianConstants& constants)
+{
+	sigma = std::max(sigma, IirGaussianMinSigma);
+
+	// The variance grows monotonically with q, bisect for sigma^2
+	double low = 0.01, high = 2.0 * sigma + 2.0;
+	for (int i = 0; i < 64; ++i)
+	{
+		double q = 0.5 * (low + high);
+		(CascadeVariance(q) < (double)sigma * sigma ? low : high) = q;
+	}
+	const double q = 0.5 * (low + high);
+
+	// Poles 1 / d^(1/q), the small distances to 1 computed directly so they keep their precision
+	const double realGain = -expm1(-log(BasePoles[2].real()) / q);
+	const Complex pair = 1.0 / std::pow(BasePoles[0], 1.0 / q);
+	const double pairGain = (1.0 - pair.real()) * (1.0 - pair.real()) + pair.imag() * pair.imag();
+	const double pairDamping = -expm1(-2.0 * log(std::abs(BasePoles[0])) / q);
+
+	// Past the edge the input stays at the edge value, so the causal deviation from it rings
+	// down with the poles and the anticausal pass, started far out, picks it up on the way
+	// back. Run that once per unit deviation of each causal state to get the boundary matrix.
+	const double largestPole = std::max(std::abs(pair), 1.0 - realGain);
+	const int tail = (int)ceil(log(1.0e-12) / log(largestPole)) + 1;
+
+	std::vector<double> causal(tail);
+	double boundary[3][3];
+	for (int column = 0; column < 3; ++column)
+	{
+		IirState state = { column == 0 ? 1.0 : 0.0, column == 1 ? 1.0 : 0.0, column == 2 ? 1.0 : 0.0 };
+		for (int n = 0; n < tail; ++n)
+		{
+			StepState(state, 0.0, realGain, pairGain, pairDamping);
+			causal[n] = state.b;
+		}
+
+		IirState anticausal = { 0.0, 0.0, 0.0 };
+		for (int n = tail - 1; n >= 0; --n)
+			StepState(anticausal, causal[n], realGain, pairGain, pairDamping);
+
+		boundary[0][column] = anticausal.a;
+		boundary[1][column] = anticausal.b;
+		boundary[2][column] = anticausal.v;
+	}
+
+	constants.width = width;
+	constants.height = height;
+	constants.realGain = (float)realGain;
+	constants.pairGain = (float)pairGain;
+	constants.pairDamping = (float)pairDamping;
+	for (int i = 0; i < 3; ++i)
+	{
+		constants.padding[i] = 0.0f;
+		for (int j = 0; j < 3; ++j) constants.boundary[i][j] = (float)boundary[i][j];
+		constants.boundary[i][3] = 0.0f;
+	}
+}
+
+static void ForEachTask(ThreadPool* pool, int count, const ThreadPoolTask& task)
+{
+	if (pool)
+		ThreadPoolParallelFor(*pool, count, task);
+	else
+		for (int i = 0; i < count; ++i) task(i, 0);
+}
+
+static inline uint8_t ToUnorm(float value)
+{
+	value = std::min(std::max(value, 0.0f), 1.0f);
+	return (uint8_t)(value * 255.0f + 0.5f);
+}
+
+static inline void ResolvePixel(const float* color, uint8_t coverage, uint8_t* out)
+{
+	if (coverage == 0)
+	{
+		out[0] = out[1] = out[2] = out[3] = 0;
+		return;
+	}
+
+	for (int c = 0; c < 3; ++c) out[c] = ToUnorm(color[c]);
+	out[3] = ToUnorm(color[3] * (coverage * (1.0f / 255.0f)));
+}
+
+// Anticausal start state from the causal end state and the edge value
+static inline void BoundaryState(const IirGaussianConstants& k, float edge, float& a, float& b, float& v)
+{
+	float da = a - edge, db = b - edge, dv = v;
+	a = k.boundary[0][0] * da + k.boundary[0][1] * db + k.boundary[0][2] * dv + edge;
+	b = k.boundary[1][0] * da + k.boundary[1][1] * db + k.boundary[1][2] * dv + edge;
+	v = k.boundary[2][0] * da + k.boundary[2][1] * db + k.boundary[2][2] * dv;
+}
+
+static inline float Step(const IirGaussianConstants& k, float x, float& a, float& b, float& v)
+{
+	a += k.realGain * (x - a);
+	v += k.pairGain * (a - b) - k.pairDamping * v;
+	b += v;
+	return b;
+}
+
+// Both passes over one row, bytes in, floats out
+static void FilterRowScalar(const IirGaussianConstants& k, const uint8_t* src, float* dst, int width)
+{
+	for (int c = 0; c < 4; ++c)
+	{
+		// Causal, the row continues to the left with its first pixel
+		float a = src[c] * (1.0f / 255.0f), b = a, v = 0.0f;
+		for (int x = 0; x < width; ++x)
+			dst[x * 4 + c] = Step(k, src[x * 4 + c] * (1.0f / 255.0f), a, b, v);
+
+		// Anticausal, and to the right with its last one
+		BoundaryState(k, src[(width - 1) * 4 + c] * (1.0f / 255.0f), a, b, v);
+		for (int x = width - 1; x >= 0; --x)
+			dst[x * 4 + c] = Step(k, dst[x * 4 + c], a, b, v);
+	}
+}
+
+// Both passes down a strip of columns [begin, end) of the floats, resolved into the output
+static void FilterColumnsScalar(const IirGaussianConstants& k, float* pixels, size_t stride, int height, int begin, int end,
+								float* state, size_t stateStride, const CpuMask& mask, const CpuImage& output)
+{
+	float* a = state + begin;
+	float* b = a + stateStride;
+	float* v = b + stateStride;
+	float* edge = v + stateStride;
+	const int count = end - begin;
+
+	for (int s = 0; s < count; ++s)
+	{
+		a[s] = b[s] = pixels[begin + s];
+		v[s] = 0.0f;
+		edge[s] = pixels[(size_t)(height - 1) * stride + begin + s];
+	}
+
+	for (int y = 0; y < height; ++y)
+	{
+		float* row = pixels + (size_t)y * stride + begin;
+		for (int s = 0; s < count; ++s)
+			row[s] = Step(k, row[s], a[s], b[s], v[s]);
+	}
+
+	for (int s = 0; s < count; ++s)
+		BoundaryState(k, edge[s], a[s], b[s], v[s]);
+
+	for (int y = height - 1; y >= 0; --y)
+	{
+		float* row = pixels + (size_t)y * stride + begin;
+		uint8_t* dst = output.pixels + (size_t)y * output.rowPitch + begin;
+		for (int s = 0; s < count; ++s)
+			row[s] = Step(k, row[s], a[s], b[s], v[s]);
+		for (int s = 0; s < count; s += 4)
+			ResolvePixel(row + s, CpuMaskCoverage(mask, (begin + s) / 4, y), dst + s);
+	}
+}
+
+#if defined(__AVX2__)
+
+// -mavx2 alone doesn't enable FMA, keep to plain multiplies and adds
+static inline __m256 MulAdd(__m256 a, __m256 b, __m256 c)
+{
+	return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+}
+
+struct IirStepAvx2
+{
+	__m256 realGain;
+	__m256 pairGain;
+	__m256 pairDamping;
+
+	explicit IirStepAvx2(const IirGaussianConstants& k)
+		: realGain(_mm256_set1_ps(k.realGain)), pairGain(_mm256_set1_ps(k.pairGain)), pairDamping(_mm256_set1_ps(k.pairDamping))
+	{
+	}
+
+	inline __m256 operator()(__m256 x, __m256& a, __m256& b, __m256& v) const
+	{
+		a = MulAdd(realGain, _mm256_sub_ps(x, a), a);
+		v = _mm256_sub_ps(MulAdd(pairGain, _mm256_sub_ps(a, b), v), _mm256_mul_ps(pairDamping, v));
+		b = _mm256_add_ps(b, v);
+		return b;
+	}
+};
+
+static inline void BoundaryStateAvx2(const IirGaussianConstants& k, __m256 edge, __m256& a, __m256& b, __m256& v)
+{
+	auto row = [&](const float* m, __m256 da, __m256 db, __m256 dv) {
+		return MulAdd(_mm256_set1_ps(m[0]), da, MulAdd(_mm256_set1_ps(m[1]), db, _mm256_mul_ps(_mm256_set1_ps(m[2]), dv)));
+	};
+	__m256 da = _mm256_sub_ps(a, edge), db = _mm256_sub_ps(b, edge), dv = v;
+	a = _mm256_add_ps(row(k.boundary[0], da, db, dv), edge);
+	b = _mm256_add_ps(row(k.boundary[1], da, db, dv), edge);
+	v = row(k.boundary[2], da, db, dv);
+}
+
+// Pixel x of two rows in one register, the first row in the low half
+static inline __m256 LoadPixelPair(const uint8_t* rowA, const uint8_t* rowB, int x)
+{
+	__m128i bytes = _mm_setr_epi32(*(const int*)(rowA + x * 4), *(const int*)(rowB + x * 4), 0, 0);
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)), _mm256_set1_ps(1.0f / 255.0f));
+}
+
+static inline __m256 LoadFloatPair(const float* rowA, const float* rowB, int x)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(rowA + x * 4)), _mm_loadu_ps(rowB + x * 4), 1);
+}
+
+static inline void StoreFloatPair(float* rowA, float* rowB, int x, __m256 value)
+{
+	_mm_storeu_ps(rowA + x * 4, _mm256_castps256_ps128(value));
+	_mm_storeu_ps(rowB + x * 4, _mm256_extractf128_ps(value, 1));
+}
+
+// Four rows at once, each register holds one pixel of two rows. The recursion is serial
+// along a row, the two register pairs give the core independent chains to overlap.
+static void FilterRowsAvx2(const IirGaussianConstants& k, const uint8_t* const* src, float* const* dst, int width)
+{
+	const IirStepAvx2 step(k);
+	__m256 a[2], b[2], v[2];
+	for (int p = 0; p < 2; ++p)
+	{
+		a[p] = b[p] = LoadPixelPair(src[2 * p], src[2 * p + 1], 0);
+		v[p] = _mm256_setzero_ps();
+	}
+
+	for (int x = 0; x < width; ++x)
+		for (int p = 0; p < 2; ++p)
+			StoreFloatPair(dst[2 * p], dst[2 * p + 1], x, step(LoadPixelPair(src[2 * p], src[2 * p + 1], x), a[p], b[p], v[p]));
+
+	for (int p = 0; p < 2; ++p)
+		BoundaryStateAvx2(k, LoadPixelPair(src[2 * p], src[2 * p + 1], width - 1), a[p], b[p], v[p]);
+
+	for (int x = width - 1; x >= 0; --x)
+		for (int p = 0; p < 2; ++p)
+			StoreFloatPair(dst[2 * p], dst[2 * p + 1], x, step(LoadFloatPair(dst[2 * p], dst[2 * p + 1], x), a[p], b[p], v[p]));
+}
+
+// Eight floats (two pixels) of the strip per register, the scalar loop takes the rest
+static void FilterColumnsAvx2(const IirGaussianConstants& k, float* pixels, size_t stride, int height, int begin, int end,
+							  float* state, size_t stateStride, const CpuMask& mask, const CpuImage& output)
+{
+	const int vectorEnd = begin + ((end - begin) & ~7);
+	if (vectorEnd < end)
+		FilterColumnsScalar(k, pixels, stride, height, vectorEnd, end, state, stateStride, mask, output);
+	if (vectorEnd == begin)
+		return;
+
+	const IirStepAvx2 step(k);
+	float* a = state + begin;
+	float* b = a + stateStride;
+	float* v = b + stateStride;
+	float* edge = v + stateStride;
+	const int count = vectorEnd - begin;
+
+	auto filterRow = [&](float* row) {
+		for (int s = 0; s < count; s += 8)
+		{
+			__m256 as = _mm256_loadu_ps(a + s), bs = _mm256_loadu_ps(b + s), vs = _mm256_loadu_ps(v + s);
+			_mm256_storeu_ps(row + s, step(_mm256_loadu_ps(row + s), as, bs, vs));
+			_mm256_storeu_ps(a + s, as);
+			_mm256_storeu_ps(b + s, bs);
+			_mm256_storeu_ps(v + s, vs);
+		}
+	};
+
+	for (int s = 0; s < count; s += 8)
+	{
+		__m256 first = _mm256_loadu_ps(pixels + begin + s);
+		_mm256_storeu_ps(a + s, first);
+		_mm256_storeu_ps(b + s, first);
+		_mm256_storeu_ps(v + s, _mm256_setzero_ps());
+		_mm256_storeu_ps(edge + s, _mm256_loadu_ps(pixels + (size_t)(height - 1) * stride + begin + s));
+	}
+
+	for (int y = 0; y < height; ++y)
+		filterRow(pixels + (size_t)y * stride + begin);
+
+	for (int s = 0; s < count; s += 8)
+	{
+		__m256 as = _mm256_loadu_ps(a + s), bs = _mm256_loadu_ps(b + s), vs = _mm256_loadu_ps(v + s);
+		BoundaryStateAvx2(k, _mm256_loadu_ps(edge + s), as, bs, vs);
+		_mm256_storeu_ps(a + s, as);
+		_mm256_storeu_ps(b + s, bs);
+		_mm256_storeu_ps(v + s, vs);
+	}
+
+	const __m256 scale = _mm256_set1_ps(255.0f);
+	for (int y = height - 1; y >= 0; --y)
+	{
+		float* row = pixels + (size_t)y * stride + begin;
+		filterRow(row);
+
+		// Same rounding as ToUnorm, the mask is applied to the few pixels that need it afterwards
+		uint8_t* dst = output.pixels + (size_t)y * output.rowPitch + begin;
+		for (int s = 0; s < count; s += 8)
+		{
+			__m256 clamped = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(row + s), _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+			__m256i q = _mm256_cvttps_epi32(MulAdd(clamped, scale, _mm256_set1_ps(0.5f)));
+			__m128i words = _mm_packus_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+			_mm_storel_epi64((__m128i*)(dst + s), _mm_packus_epi16(words, words));
+		}
+		for (int s = 0; s < count; s += 4)
+		{
+			uint8_t coverage = CpuMaskCoverage(mask, (begin + s) / 4, y);
+			if (coverage != 255)
+				ResolvePixel(row + s, coverage, dst + s);
+		}
+	}
+}
+
+#endif
+
+void CpuIirGaussianBlur(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						const BlurConstants& constants, float sigma, CpuIirScratch& scratch, ThreadPool* pool)
+{
+	const int width = (int)constants.textureWidth;
+	const int height = (int)constants.textureHeight;
+	if (width == 0 || height == 0)
+		return;
+
+	IirGaussianConstants k;
+	IirGaussianCompute(sigma, constants.textureWidth, constants.textureHeight, k);
+
+	const size_t stride = (size_t)width * 4;
+	scratch.pixels.resize(stride * height);
+	scratch.state.resize(stride * 4);
+
+	ForEachTask(pool, (height + RowsPerTask - 1) / RowsPerTask, [&](int task, int worker) {
+		TRACE_ZONE("IIR rows");
+		int y = task * RowsPerTask;
+		const int end = std::min(y + RowsPerTask, height);
+#if defined(__AVX2__)
+		for (; y + 4 <= end; y += 4)
+		{
+			const uint8_t* src[4];
+			float* dst[4];
+			for (int i = 0; i < 4; ++i)
+			{
+				src[i] = input.pixels + (size_t)(y + i) * input.rowPitch;
+				dst[i] = scratch.pixels.data() + (size_t)(y + i) * stride;
+			}
+			FilterRowsAvx2(k, src, dst, width);
+		}
+#endif
+		for (; y < end; ++y)
+			FilterRowScalar(k, input.pixels + (size_t)y * input.rowPitch, scratch.pixels.data() + (size_t)y * stride, width);
+	});
+
+	const int strip = ColumnsPerTask * 4;
+	ForEachTask(pool, (int)((stride + strip - 1) / strip), [&](int task, int worker) {
+		TRACE_ZONE("IIR columns");
+		int begin = task * strip;
+		int end = std::min(begin + strip, (int)stride);
+#if defined(__AVX2__)
+		FilterColumnsAvx2(k, scratch.pixels.data(), stride, height, begin, end, scratch.state.data(), stride, mask, output);
+#else
+		FilterColumnsScalar(k, scratch.pixels.data(), stride, height, begin, end, scratch.state.data(), stride, mask, output);
+#endif
+	});
+}
+
+void CpuGaussianReference(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						  const BlurConstants& constants, float sigma)
+{
+	const int width = (int)constants.textureWidth;
+	const int height = (int)constants.textureHeight;
+	if (width == 0 || height == 0)
+		return;
+
+	sigma = std::max(sigma, IirGaussianMinSigma);
+	const int radius = (int)ceil(4.0 * sigma);
+	std::vector<double> weights(2 * radius + 1);
+	double weightSum = 0.0;
+	for (int tap = -radius; tap <= radius; ++tap)
+	{
+		weights[tap + radius] = exp(-(double)tap * tap / (2.0 * sigma * sigma));
+		weightSum += weights[tap + radius];
+	}
+	for (double& weight : weights) weight /= weightSum;
+
+	std::vector<double> rows((size_t)width * height * 4);
+	for (int y = 0; y < height; ++y)
+	{
+		const uint8_t* src = input.pixels + (size_t)y * input.rowPitch;
+		for (int x = 0; x < width; ++x)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				double sum = 0.0;
+				for (int tap = -radius; tap <= radius; ++tap)
+					sum += weights[tap + radius] * src[CpuBlurClamp(x + tap, 0, width - 1) * 4 + c];
+				rows[((size_t)y * width + x) * 4 + c] = sum / 255.0;
+			}
+		}
+	}
+
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			float color[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				double sum = 0.0;
+				for (int tap = -radius; tap <= radius; ++tap)
+					sum += weights[tap + radius] * rows[((size_t)CpuBlurClamp(y + tap, 0, height - 1) * width + x) * 4 + c];
+				color[c] = (float)sum;
+			}
+			ResolvePixel(color, CpuMaskCoverage(mask, x, y), output.pixels + (size_t)y * output.rowPitch + (size_t)x * 4);
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "CpuBlur.h"
+#include "ThreadPool.h"
+
+// Recursive Gaussian: third-order causal and anticausal passes over the rows, then over
+// the columns. Poles from van Vliet, Young and Verbeek scaled to the requested variance,
+// clamp-to-edge boundaries in the spirit of Triggs and Sdika. The cost per pixel does not
+// depend on sigma. Same clamp and mask semantics as the box blur, reference for
+// iirRowShaderSource and iirColumnShaderSource.
+//
+// The poles crowd towards 1 as sigma grows and the direct form loses everything to float
+// rounding past sigma ~40, so each pass is a real pole followed by the complex pair, both
+// written as small steps towards their input:
+//   a += realGain * (x - a)
+//   v += pairGain * (a - b) - pairDamping * v,  b += v
+// and b is the output.
+static const float IirGaussianMinSigma = 0.5f;
+
+// Constant buffer shared by both IIR shaders, the CPU passes use the same floats
+struct IirGaussianConstants
+{
+	uint32_t width;
+	uint32_t height;
+	float realGain;		   // 1 - real pole
+	float pairGain;		   // |1 - pair pole|^2
+	float pairDamping;	   // 1 - |pair pole|^2
+	float padding[3];
+	float boundary[3][4];  // (a, b, v) - (edge, edge, 0) at the end of the causal pass to the
+						   // anticausal state past the edge, [i][3] unused
+};
+
+void IirGaussianCompute(float sigma, uint32_t width, uint32_t height, IirGaussianConstants& constants);
+
+// Same sigma BlurKernel_Gaussian uses for a radius
+inline float IirGaussianSigmaForRadius(float radius)
+{
+	float sigma = radius / 3.0f;
+	return sigma < IirGaussianMinSigma ? IirGaussianMinSigma : sigma;
+}
+
+struct CpuIirScratch
+{
+	std::vector<float> pixels;	// BGRA in [0, 1], the rows after the first pass
+	std::vector<float> state;	// Column pass, a, b, v and the edge row
+};
+
+// Rows and column strips are split across `pool` when there is one
+void CpuIirGaussianBlur(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						const BlurConstants& constants, float sigma, CpuIirScratch& scratch, ThreadPool* pool = nullptr);
+
+// Separable direct convolution with the sampled Gaussian truncated at 4 sigma, in double
+void CpuGaussianReference(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						  const BlurConstants& constants, float sigma);
@@ -0,0 +1,193 @@
+#include "CpuKawase.h"
+
+#include <math.h>
+#include <algorithm>
+
+// Box blur radius each level count stands in for, measured from the impulse response
+// (box of the same variance, sigma^2 = ((2r+1)^2 - 1) / 12)
+static const float KawaseEquivalentRadius[CpuKawaseMaxLevels + 1] = {
+	0.0f, 2.6f, 6.1f, 12.9f, 26.4f, 53.3f, 107.2f, 215.0f, 430.4f,
+};
+
+float CpuKawaseEquivalentRadius(int levels)
+{
+	return KawaseEquivalentRadius[CpuBlurClamp(levels, 0, CpuKawaseMaxLevels)];
+}
+
+int CpuKawaseLevelsForRadius(float radius, int width, int height)
+{
+	// Nearest in log space, the spread doubles with every level
+	float target = log2f(std::max(radius, 1.0f));
+	int levels = 1;
+	for (int i = 2; i <= CpuKawaseMaxLevels; ++i)
+	{
+		if (fabsf(log2f(KawaseEquivalentRadius[i]) - target) < fabsf(log2f(KawaseEquivalentRadius[levels]) - target))
+			levels = i;
+	}
+
+	while (levels > 1 && (CpuKawaseLevelSize(width, levels) < 2 || CpuKawaseLevelSize(height, levels) < 2))
+		--levels;
+
+	return levels;
+}
+
+// Texture2D.SampleLevel with a linear clamp sampler, u/v in texels of the level
+static inline void SampleBilinear(const CpuKawaseLevel& level, float u, float v, float* out)
+{
+	float x = u - 0.5f;
+	float y = v - 0.5f;
+	float fx = floorf(x);
+	float fy = floorf(y);
+	float wx = x - fx;
+	float wy = y - fy;
+
+	int x0 = CpuBlurClamp((int)fx, 0, level.width - 1);
+	int x1 = CpuBlurClamp((int)fx + 1, 0, level.width - 1);
+	int y0 = CpuBlurClamp((int)fy, 0, level.height - 1);
+	int y1 = CpuBlurClamp((int)fy + 1, 0, level.height - 1);
+
+	const float* p00 = level.pixels.data() + ((size_t)y0 * level.width + x0) * 4;
+	const float* p10 = level.pixels.data() + ((size_t)y0 * level.width + x1) * 4;
+	const float* p01 = level.pixels.data() + ((size_t)y1 * level.width + x0) * 4;
+	const float* p11 = level.pixels.data() + ((size_t)y1 * level.width + x1) * 4;
+
+	for (int c = 0; c < 4; ++c)
+	{
+		float top = p00[c] + (p10[c] - p00[c]) * wx;
+		float bottom = p01[c] + (p11[c] - p01[c]) * wx;
+		out[c] = top + (bottom - top) * wy;
+	}
+}
+
+static void ResizeLevel(CpuKawaseLevel& level, int width, int height)
+{
+	level.width = width;
+	level.height = height;
+	level.pixels.resize((size_t)width * height * 4);
+}
+
+// kawaseDownsampleShaderSource
+static void Downsample(const CpuKawaseLevel& source, CpuKawaseLevel& dest)
+{
+	for (int y = 0; y < dest.height; ++y)
+	{
+		for (int x = 0; x < dest.width; ++x)
+		{
+			float u = (x + 0.5f) / dest.width * source.width;
+			float v = (y + 0.5f) / dest.height * source.height;
+
+			float taps[4][4];
+			SampleBilinear(source, u - 1.0f, v - 1.0f, taps[0]);
+			SampleBilinear(source, u + 1.0f, v - 1.0f, taps[1]);
+			SampleBilinear(source, u - 1.0f, v + 1.0f, taps[2]);
+			SampleBilinear(source, u + 1.0f, v + 1.0f, taps[3]);
+
+			float* out = dest.pixels.data() + ((size_t)y * dest.width + x) * 4;
+			for (int c = 0; c < 4; ++c)
+				out[c] = (taps[0][c] + taps[1][c] + taps[2][c] + taps[3][c]) * 0.25f;
+		}
+	}
+}
+
+// kawaseUpsampleShaderSource without the mask, writes floats for the next level up
+static void UpsampleTexel(const CpuKawaseLevel& source, float u, float v, float* out)
+{
+	static const float Offsets[8][3] = {
+		{ -1.0f,  0.0f, 1.0f }, {  1.0f,  0.0f, 1.0f }, {  0.0f, -1.0f, 1.0f }, {  0.0f,  1.0f, 1.0f },
+		{ -0.5f, -0.5f, 2.0f }, {  0.5f, -0.5f, 2.0f }, { -0.5f,  0.5f, 2.0f }, {  0.5f,  0.5f, 2.0f },
+	};
+
+	for (int c = 0; c < 4; ++c) out[c] = 0.0f;
+	for (const float* offset : Offsets)
+	{
+		float tap[4];
+		SampleBilinear(source, u + offset[0], v + offset[1], tap);
+		for (int c = 0; c < 4; ++c) out[c] += tap[c] * offset[2];
+	}
+	for (int c = 0; c < 4; ++c) out[c] *= 1.0f / 12.0f;
+}
+
+static void Upsample(const CpuKawaseLevel& source, CpuKawaseLevel& dest)
+{
+	for (int y = 0; y < dest.height; ++y)
+	{
+		for (int x = 0; x < dest.width; ++x)
+		{
+			float u = (x + 0.5f) / dest.width * source.width;
+			float v = (y + 0.5f) / dest.height * source.height;
+			UpsampleTexel(source, u, v, dest.pixels.data() + ((size_t)y * dest.width + x) * 4);
+		}
+	}
+}
+
+static inline uint8_t ToUnorm(float value)
+{
+	value = std::min(std::max(value, 0.0f), 1.0f);
+	return (uint8_t)(value * 255.0f + 0.5f);
+}
+
+void CpuKawaseBlur(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+				   const BlurConstants& constants, int levels, CpuKawaseScratch& scratch)
+{
+	const int width = (int)constants.textureWidth;
+	const int height = (int)constants.textureHeight;
+	if (width == 0 || height == 0)
+		return;
+
+	levels = CpuBlurClamp(levels, 1, CpuKawaseMaxLevels);
+
+	// Level 0 is the input in float, the GPU reads it through desktopSRV
+	CpuKawaseLevel& base = scratch.levels[0];
+	ResizeLevel(base, width, height);
+	for (int y = 0; y < height; ++y)
+	{
+		const uint8_t* src = input.pixels + (size_t)y * input.rowPitch;
+		float* dst = base.pixels.data() + (size_t)y * width * 4;
+		for (int i = 0; i < width * 4; ++i) dst[i] = src[i] * (1.0f / 255.0f);
+	}
+
+	for (int level = 1; level <= levels; ++level)
+	{
+		ResizeLevel(scratch.levels[level], CpuKawaseLevelSize(width, level), CpuKawaseLevelSize(height, level));
+		Downsample(scratch.levels[level - 1], scratch.levels[level]);
+	}
+
+	// Upsampling overwrites each level once the one below has been consumed
+	for (int level = levels - 1; level >= 1; --level)
+		Upsample(scratch.levels[level + 1], scratch.levels[level]);
+
+	const CpuKawaseLevel& source = scratch.levels[1];
+	for (int y = 0; y < height; ++y)
+	{
+		uint8_t* dst = output.pixels + (size_t)y * output.rowPitch;
+		for (int x = 0; x < width; ++x, dst += 4)
+		{
+			uint8_t coverage = CpuMaskCoverage(mask, x, y);
+			if (coverage == 0)
+			{
+				dst[0] = dst[1] = dst[2] = dst[3] = 0;
+				continue;
+			}
+
+			float color[4];
+			float u = (x + 0.5f) / width * source.width;
+			float v = (y + 0.5f) / height * source.height;
+			UpsampleTexel(source, u, v, color);
+			color[3] *= coverage * (1.0f / 255.0f);
+
+			for (int c = 0; c < 4; ++c) dst[c] = ToUnorm(color[c]);
+		}
+	}
+}
+
+uint64_t CpuKawaseSampleCount(int width, int height, int levels)
+{
+	uint64_t samples = 0;
+	for (int level = 1; level <= levels; ++level)
+	{
+		uint64_t downPixels = (uint64_t)CpuKawaseLevelSize(width, level) * CpuKawaseLevelSize(height, level);
+		uint64_t upPixels = (uint64_t)CpuKawaseLevelSize(width, level - 1) * CpuKawaseLevelSize(height, level - 1);
+		samples += downPixels * 4 + upPixels * 8;
+	}
+	return samples;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CpuBlur.h"
+
+// Dual-Kawase blur: a chain of half-resolution downsamples (4 bilinear taps on the
+// diagonal corners) followed by matching upsamples (8 bilinear taps, tent shaped).
+// Reference for kawaseDownsampleShaderSource / kawaseUpsampleShaderSource, same
+// sample positions, float math and the mask gating of the box blur on the last pass.
+static const int CpuKawaseMaxLevels = 8;
+
+// Constant buffer shared by both Kawase shaders
+struct KawaseConstants
+{
+	uint32_t destWidth;
+	uint32_t destHeight;
+	float sourceTexelWidth;	  // 1 / source texture width
+	float sourceTexelHeight;  // 1 / source texture height
+	float sourceUvScaleX;	  // Part of a pooled source texture in use, 1 when it fits exactly
+	float sourceUvScaleY;
+	float sourceUvMaxX;		  // Last in-use texel centre, taps clamp there instead of the texture edge
+	float sourceUvMaxY;
+	uint32_t applyMask;		  // Last upsample only
+	float padding[3];
+};
+
+struct CpuKawaseLevel
+{
+	int width;
+	int height;
+	std::vector<float> pixels;	// BGRA, 4 floats per pixel in [0, 1]
+};
+
+struct CpuKawaseScratch
+{
+	CpuKawaseLevel levels[CpuKawaseMaxLevels + 1];
+};
+
+// Number of down/up pairs whose spread best matches a box blur of the given radius,
+// limited so the smallest level stays at least 2 pixels wide
+int CpuKawaseLevelsForRadius(float radius, int width, int height);
+
+// Box blur radius a chain of `levels` pairs stands in for, 0 to CpuKawaseMaxLevels
+float CpuKawaseEquivalentRadius(int levels);
+
+inline int CpuKawaseLevelSize(int size, int level)
+{
+	for (int i = 0; i < level; ++i) size = (size + 1) / 2;
+	return size;
+}
+
+void CpuKawaseBlur(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+				   const BlurConstants& constants, int levels, CpuKawaseScratch& scratch);
+
+// Texture reads issued by the GPU chain, to compare with (2r+1)^2 per pixel of the box kernel
+uint64_t CpuKawaseSampleCount(int width, int height, int levels);
@@ -0,0 +1,432 @@
+#include "CpuPlanar.h"
+
+#include <algorithm>
+
+#include "Trace.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define CPU_PLANAR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static inline int RoundUp(int value, int multiple)
+{
+	return (value + multiple - 1) / multiple * multiple;
+}
+
+void CpuPlanarResize(CpuPlanarImage& image, int width, int height)
+{
+	const int rowPitch = RoundUp(std::max(width, 1), CpuPlanarAlignment);
+	const size_t planeSize = (size_t)rowPitch * std::max(height, 1);
+	if (image.width != width || image.height != height || image.storage.empty())
+	{
+		// One line to align the base, one of slack after the last plane
+		image.storage.assign(planeSize * 4 + 2 * CpuPlanarAlignment, 0);
+	}
+	image.width = width;
+	image.height = height;
+	image.rowPitch = rowPitch;
+
+	uint8_t* base = image.storage.data();
+	base += (CpuPlanarAlignment - (uintptr_t)base % CpuPlanarAlignment) % CpuPlanarAlignment;
+	for (int c = 0; c < 4; ++c)
+		image.planes[c] = base + planeSize * c;
+}
+
+void CpuPlanarDeinterleave(const CpuImage& input, CpuPlanarImage& planes, const BlurRect& rect, uint32_t channels)
+{
+	for (int y = rect.top; y < rect.bottom; ++y)
+	{
+		const uint8_t* src = input.pixels + (size_t)y * input.rowPitch;
+		const size_t row = (size_t)y * planes.rowPitch;
+		int x = rect.left;
+#if defined(CPU_PLANAR_SSE2)
+		// 16 pixels: each channel is a byte of every u32, shifted down, masked and packed
+		// u32 -> u16 -> u8, which saturation can't touch with values under 256
+		const __m128i low = _mm_set1_epi32(0xFF);
+		for (; x + 16 <= rect.right; x += 16)
+		{
+			const __m128i* pixels = (const __m128i*)(src + (size_t)x * 4);
+			const __m128i p0 = _mm_loadu_si128(pixels + 0);
+			const __m128i p1 = _mm_loadu_si128(pixels + 1);
+			const __m128i p2 = _mm_loadu_si128(pixels + 2);
+			const __m128i p3 = _mm_loadu_si128(pixels + 3);
+			for (int c = 0; c < 4; ++c)
+			{
+				if (!(channels & (1u << c)))
+					continue;
+				const __m128i shift = _mm_cvtsi32_si128(c * 8);
+				const __m128i c0 = _mm_and_si128(_mm_srl_epi32(p0, shift), low);
+				const __m128i c1 = _mm_and_si128(_mm_srl_epi32(p1, shift), low);
+				const __m128i c2 = _mm_and_si128(_mm_srl_epi32(p2, shift), low);
+				const __m128i c3 = _mm_and_si128(_mm_srl_epi32(p3, shift), low);
+				const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+				_mm_storeu_si128((__m128i*)(planes.planes[c] + row + x), packed);
+			}
+		}
+#endif
+		for (; x < rect.right; ++x)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				if (channels & (1u << c))
+					planes.planes[c][row + x] = src[(size_t)x * 4 + c];
+			}
+		}
+	}
+}
+
+void CpuPlanarInterleave(const CpuPlanarImage& planes, const CpuImage& output, const BlurRect& rect, uint32_t channels)
+{
+	channels &= CpuPlanar_All;
+	if (!channels)
+		return;
+
+#if defined(CPU_PLANAR_SSE2)
+	// Bytes of the channels left out keep what the output had
+	uint32_t keep = 0;
+	for (int c = 0; c < 4; ++c)
+	{
+		if (!(channels & (1u << c)))
+			keep |= 0xFFu << (c * 8);
+	}
+	const __m128i keepMask = _mm_set1_epi32((int)keep);
+	const __m128i zero = _mm_setzero_si128();
+#endif
+
+	for (int y = rect.top; y < rect.bottom; ++y)
+	{
+		uint8_t* dst = output.pixels + (size_t)y * output.rowPitch;
+		const size_t row = (size_t)y * planes.rowPitch;
+		int x = rect.left;
+#if defined(CPU_PLANAR_SSE2)
+		for (; x + 16 <= rect.right; x += 16)
+		{
+			__m128i channel[4];
+			for (int c = 0; c < 4; ++c)
+				channel[c] = channels & (1u << c) ? _mm_loadu_si128((const __m128i*)(planes.planes[c] + row + x)) : zero;
+
+			// BGBG.. and RARA.., then BGRA words interleaved into pixels
+			const __m128i bg0 = _mm_unpacklo_epi8(channel[0], channel[1]);
+			const __m128i bg1 = _mm_unpackhi_epi8(channel[0], channel[1]);
+			const __m128i ra0 = _mm_unpacklo_epi8(channel[2], channel[3]);
+			const __m128i ra1 = _mm_unpackhi_epi8(channel[2], channel[3]);
+			__m128i pixels[4] = { _mm_unpacklo_epi16(bg0, ra0), _mm_unpackhi_epi16(bg0, ra0), _mm_unpacklo_epi16(bg1, ra1),
+								  _mm_unpackhi_epi16(bg1, ra1) };
+
+			__m128i* out = (__m128i*)(dst + (size_t)x * 4);
+			for (int i = 0; i < 4; ++i)
+			{
+				if (keep)
+					pixels[i] = _mm_or_si128(pixels[i], _mm_and_si128(_mm_loadu_si128(out + i), keepMask));
+				_mm_storeu_si128(out + i, pixels[i]);
+			}
+		}
+#endif
+		for (; x < rect.right; ++x)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				if (channels & (1u << c))
+					dst[(size_t)x * 4 + c] = planes.planes[c][row + x];
+			}
+		}
+	}
+}
+
+// sums[i] += add[i] - sub[i] over `count` columns rounded up to 16, u16 wraps but every
+// column sum of 2r + 1 bytes fits up to CpuBlurFixedMaxRadius
+static void SlideColumns(uint16_t* sums, const uint8_t* add, const uint8_t* sub, int count)
+{
+#if defined(CPU_PLANAR_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (int i = 0; i < count; i += 16)
+	{
+		const __m128i in = _mm_loadu_si128((const __m128i*)(add + i));
+		__m128i low = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(sums + i)), _mm_unpacklo_epi8(in, zero));
+		__m128i high = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(sums + i + 8)), _mm_unpackhi_epi8(in, zero));
+		if (sub)
+		{
+			const __m128i out = _mm_loadu_si128((const __m128i*)(sub + i));
+			low = _mm_sub_epi16(low, _mm_unpacklo_epi8(out, zero));
+			high = _mm_sub_epi16(high, _mm_unpackhi_epi8(out, zero));
+		}
+		_mm_storeu_si128((__m128i*)(sums + i), low);
+		_mm_storeu_si128((__m128i*)(sums + i + 8), high);
+	}
+#else
+	for (int i = 0; i < count; ++i)
+		sums[i] = (uint16_t)(sums[i] + add[i] - (sub ? sub[i] : 0));
+#endif
+}
+
+// prefix[i] = sums[0] + .. + sums[i - 1], u32 can't overflow for a row of u16. SSE2 scans
+// four lanes in two shifted adds and carries the last lane into the next four.
+static void PrefixSums(const uint16_t* sums, uint32_t* prefix, int count)
+{
+	prefix[0] = 0;
+	int i = 0;
+#if defined(CPU_PLANAR_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i carry = zero;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i values = _mm_loadu_si128((const __m128i*)(sums + i));
+		__m128i low = _mm_unpacklo_epi16(values, zero);
+		__m128i high = _mm_unpackhi_epi16(values, zero);
+		low = _mm_add_epi32(low, _mm_slli_si128(low, 4));
+		high = _mm_add_epi32(high, _mm_slli_si128(high, 4));
+		low = _mm_add_epi32(low, _mm_slli_si128(low, 8));
+		high = _mm_add_epi32(high, _mm_slli_si128(high, 8));
+		low = _mm_add_epi32(low, carry);
+		high = _mm_add_epi32(high, _mm_shuffle_epi32(low, 0xFF));
+		carry = _mm_shuffle_epi32(high, 0xFF);
+		_mm_storeu_si128((__m128i*)(prefix + i + 1), low);
+		_mm_storeu_si128((__m128i*)(prefix + i + 5), high);
+	}
+#endif
+	for (; i < count; ++i)
+		prefix[i + 1] = prefix[i] + sums[i];
+}
+
+#if defined(CPU_PLANAR_SSE2)
+// CpuBlurFixedDivide on four lanes: _mm_mul_epu32 multiplies the even ones to 64 bits, the
+// odd ones are shifted down for a second multiply. Quotients are bytes, so the high half of
+// each shifted product is zero and the two can be or'ed together.
+static inline __m128i DivideSse2(__m128i sum, __m128i bias, __m128i multiplier, __m128i shift)
+{
+	sum = _mm_add_epi32(sum, bias);
+	const __m128i even = _mm_srl_epi64(_mm_mul_epu32(sum, multiplier), shift);
+	const __m128i odd = _mm_srl_epi64(_mm_mul_epu32(_mm_srli_epi64(sum, 32), multiplier), shift);
+	return _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+}
+#endif
+
+// 16 pixels of coverage all 255. SSE2 for R8 masks and BGRA alpha; the latter's load runs
+// 3 bytes past the 16th pixel's alpha, which the caller keeps inside the row.
+static inline bool FullyCovered(const uint8_t* coverage, int pixelStride)
+{
+#if defined(CPU_PLANAR_SSE2)
+	if (pixelStride == 1)
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)coverage), _mm_set1_epi8(-1))) == 0xFFFF;
+	if (pixelStride == 4)
+	{
+		const __m128i* pixels = (const __m128i*)coverage;
+		const __m128i all = _mm_and_si128(_mm_and_si128(_mm_loadu_si128(pixels), _mm_loadu_si128(pixels + 1)),
+										  _mm_and_si128(_mm_loadu_si128(pixels + 2), _mm_loadu_si128(pixels + 3)));
+		const __m128i low = _mm_set1_epi32(0xFF);
+		return _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(all, low), low)) == 0xFFFF;
+	}
+#endif
+	uint32_t all = 255;
+	for (int i = 0; i < 16; ++i)
+		all &= coverage[(size_t)i * pixelStride];
+	return all == 255;
+}
+
+// Pixels of row y in [left, right) whose coverage isn't full, 16 at a time skipped with one test
+static void FindPartialCoverage(const CpuMask& mask, int y, int left, int right, std::vector<int>& partial)
+{
+	partial.clear();
+	if (!mask.coverage)
+		return;
+
+	const uint8_t* row = mask.coverage + (size_t)y * mask.rowPitch;
+	auto at = [&](int x) { return row[(size_t)x * mask.pixelStride]; };
+	int x = left;
+	for (; x + 16 < right; x += 16)
+	{
+		if (FullyCovered(row + (size_t)x * mask.pixelStride, mask.pixelStride))
+			continue;
+		for (int i = 0; i < 16; ++i)
+		{
+			if (at(x + i) != 255)
+				partial.push_back(x + i);
+		}
+	}
+	for (; x < right; ++x)
+	{
+		if (at(x) != 255)
+			partial.push_back(x);
+	}
+}
+
+// The planes in `channels` over `rect`, a row at a time. Each plane keeps u16 column sums of
+// the 2r + 1 rows around the current one, indexed from rect.left - r with the taps past the
+// image edges filled in from the edge column, so every box is a difference of two prefix sums
+// with no clamping. The mask only changes pixels that aren't fully covered and is read once
+// per row: colors go to 0 where it is empty, alpha is divided again with coverage.
+static void BlurPlanes(const CpuPlanarImage& input, CpuPlanarImage& output, int radius, const BlurRect& rect,
+					   const CpuMask& mask, uint32_t channels, CpuPlanarScratch& scratch)
+{
+	const int width = input.width;
+	const int height = input.height;
+	const int first = rect.left - radius;  // Image column of columns[0]
+	const int count = rect.right - rect.left + 2 * radius;
+	const int x0 = std::max(first, 0);
+	const int x1 = std::min(rect.right + radius, width);
+	const int stride = RoundUp(count, 16) + 16;	 // Slides write up to 15 columns past x1
+	const int taps = 2 * radius + 1;
+	const uint64_t samples = (uint64_t)taps * taps;
+	const CpuBlurReciprocal reciprocal = CpuBlurFixedReciprocal((uint32_t)samples);
+
+	scratch.columnSums.assign((size_t)stride * 4, 0);
+	scratch.prefixSums.resize(stride + 1);
+	uint32_t* prefix = scratch.prefixSums.data();
+
+	auto rowAt = [&](int c, int y) {
+		return input.planes[c] + (size_t)CpuBlurClamp(y, 0, height - 1) * input.rowPitch + x0;
+	};
+	auto columnsOf = [&](int c) { return scratch.columnSums.data() + (size_t)stride * c; };
+
+	for (int c = 0; c < 4; ++c)
+	{
+		if (!(channels & (1u << c)))
+			continue;
+		for (int k = -radius; k <= radius; ++k)
+			SlideColumns(columnsOf(c) + (x0 - first), rowAt(c, rect.top + k), nullptr, x1 - x0);
+	}
+
+#if defined(CPU_PLANAR_SSE2)
+	const __m128i bias = _mm_set1_epi32((int)reciprocal.bias);
+	const __m128i multiplier = _mm_set1_epi32((int)reciprocal.multiplier);
+	const __m128i shift = _mm_cvtsi32_si128((int)reciprocal.shift);
+#endif
+
+	for (int y = rect.top; y < rect.bottom; ++y)
+	{
+		FindPartialCoverage(mask, y, rect.left, rect.right, scratch.partial);
+
+		for (int c = 0; c < 4; ++c)
+		{
+			if (!(channels & (1u << c)))
+				continue;
+
+			uint16_t* columns = columnsOf(c);
+			std::fill(columns, columns + (x0 - first), columns[x0 - first]);
+			std::fill(columns + (x1 - first), columns + count, columns[x1 - 1 - first]);
+			PrefixSums(columns, prefix, count);
+
+			// Box of pixel rect.left + i: prefix[i + taps] - prefix[i]
+			uint8_t* out = output.planes[c] + (size_t)y * output.rowPitch;
+			int x = rect.left;
+#if defined(CPU_PLANAR_SSE2)
+			for (; x + 16 <= rect.right; x += 16)
+			{
+				const uint32_t* low = prefix + (x - rect.left);
+				__m128i q[4];
+				for (int i = 0; i < 4; ++i)
+				{
+					const __m128i sum = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(low + taps + i * 4)),
+													  _mm_loadu_si128((const __m128i*)(low + i * 4)));
+					q[i] = DivideSse2(sum, bias, multiplier, shift);
+				}
+				_mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(_mm_packs_epi32(q[0], q[1]), _mm_packs_epi32(q[2], q[3])));
+			}
+#endif
+			for (; x < rect.right; ++x)
+				out[x] = (uint8_t)CpuBlurFixedDivide(prefix[x - rect.left + taps] - prefix[x - rect.left], reciprocal);
+
+			for (int px : scratch.partial)
+			{
+				const uint8_t coverage = CpuMaskCoverage(mask, px, y);
+				const uint32_t sum = prefix[px - rect.left + taps] - prefix[px - rect.left];
+				if (coverage == 0)
+					out[px] = 0;
+				else if (c == 3)
+					out[px] = (uint8_t)((2 * (uint64_t)sum * coverage + samples * 255) / (2 * samples * 255));
+			}
+
+			if (y + 1 < rect.bottom)
+				SlideColumns(columns + (x0 - first), rowAt(c, y + radius + 1), rowAt(c, y - radius), x1 - x0);
+		}
+	}
+}
+
+bool CpuPlanarBoxBlurRect(const CpuPlanarImage& input, const CpuMask& mask, CpuPlanarImage& output,
+						  const BlurConstants& constants, const BlurRect& rect, CpuPlanarScratch& scratch, uint32_t channels)
+{
+	const int radius = CpuBlurRadius(constants);
+	if (radius > CpuBlurFixedMaxRadius)
+		return false;
+
+	BlurRect clipped = rect;
+	if (CpuBlurClipRect(constants, clipped) && (channels & CpuPlanar_All))
+		BlurPlanes(input, output, radius, clipped, mask, channels, scratch);
+	return true;
+}
+
+// Full-width bands, one per worker so every band's column sums start over as few times as possible
+struct PlanarBands
+{
+	ThreadPool* pool;
+	int width;
+	int height;
+	int rows;
+	int count;
+};
+
+static PlanarBands SplitBands(const BlurConstants& constants, ThreadPool* pool, std::vector<CpuPlanarScratch>& scratch)
+{
+	PlanarBands bands;
+	const int workers = pool ? std::max(ThreadPoolWorkerCount(*pool), 1) : 1;
+	bands.pool = pool;
+	bands.width = (int)constants.textureWidth;
+	bands.height = (int)constants.textureHeight;
+	bands.rows = std::max(CpuPlanarBandRows, (bands.height + workers - 1) / workers);
+	bands.count = (bands.height + bands.rows - 1) / bands.rows;
+	scratch.resize(workers);
+	return bands;
+}
+
+static BlurRect BandRect(const PlanarBands& bands, int band)
+{
+	return BlurRect{ 0, band * bands.rows, bands.width, std::min((band + 1) * bands.rows, bands.height) };
+}
+
+static void ForEachBand(const PlanarBands& bands, const ThreadPoolTask& task)
+{
+	if (bands.pool)
+		ThreadPoolParallelFor(*bands.pool, bands.count, task);
+	else
+		for (int i = 0; i < bands.count; ++i) task(i, 0);
+}
+
+bool CpuPlanarBoxBlurRun(const CpuPlanarImage& input, const CpuMask& mask, CpuPlanarImage& output, const BlurConstants& constants,
+						 std::vector<CpuPlanarScratch>& scratch, ThreadPool* pool, uint32_t channels)
+{
+	if (CpuBlurRadius(constants) > CpuBlurFixedMaxRadius)
+		return false;
+
+	const PlanarBands bands = SplitBands(constants, pool, scratch);
+	ForEachBand(bands, [&](int band, int worker) {
+		TRACE_ZONE("Planar blur");
+		CpuPlanarBoxBlurRect(input, mask, output, constants, BandRect(bands, band), scratch[worker], channels);
+	});
+	return true;
+}
+
+bool CpuPlanarBoxBlur(const CpuImage& input, const CpuMask& mask, const CpuImage& output, const BlurConstants& constants,
+					  CpuPlanarBlur& blur, ThreadPool* pool)
+{
+	if (CpuBlurRadius(constants) > CpuBlurFixedMaxRadius)
+		return false;
+
+	CpuPlanarResize(blur.input, (int)constants.textureWidth, (int)constants.textureHeight);
+	CpuPlanarResize(blur.output, (int)constants.textureWidth, (int)constants.textureHeight);
+	const PlanarBands bands = SplitBands(constants, pool, blur.scratch);
+
+	// Bands read each other's rows, all of the input is planar before any of them blurs. Each
+	// band interleaves its output while it is still in cache.
+	ForEachBand(bands, [&](int band, int worker) {
+		TRACE_ZONE("Planar deinterleave");
+		CpuPlanarDeinterleave(input, blur.input, BandRect(bands, band));
+	});
+	ForEachBand(bands, [&](int band, int worker) {
+		TRACE_ZONE("Planar blur");
+		const BlurRect rect = BandRect(bands, band);
+		CpuPlanarBoxBlurRect(blur.input, mask, blur.output, constants, rect, blur.scratch[worker]);
+		CpuPlanarInterleave(blur.output, output, rect);
+	});
+	return true;
+}
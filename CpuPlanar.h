@@ -0,0 +1,71 @@
+#pragma once
+
+#include "CpuBlur.h"
+#include "CpuBlurFixed.h"
+#include "ThreadPool.h"
+
+// Planar intermediate layout for the CPU passes: the B, G, R and A of a BGRA8 image as four
+// byte planes. Every row starts 64-byte aligned and is padded to whole cache lines, so the SIMD
+// loops read a channel contiguously, 16 pixels a register, instead of a quarter of each
+// interleaved pixel. Deinterleave and Interleave convert at the edges of the pipeline; in
+// between, work that only needs alpha (the mask) or only colors (tint) touches only those planes.
+static const int CpuPlanarAlignment = 64;
+
+// Fewest rows per band of the threaded passes, each blur band also sums radius rows around it
+static const int CpuPlanarBandRows = 64;
+
+enum CpuPlanarChannels
+{
+	CpuPlanar_B = 1,
+	CpuPlanar_G = 2,
+	CpuPlanar_R = 4,
+	CpuPlanar_A = 8,
+	CpuPlanar_Color = CpuPlanar_B | CpuPlanar_G | CpuPlanar_R,
+	CpuPlanar_All = CpuPlanar_Color | CpuPlanar_A,
+};
+
+struct CpuPlanarImage
+{
+	int width;
+	int height;
+	int rowPitch;		 // Bytes, a multiple of CpuPlanarAlignment
+	uint8_t* planes[4];	 // B, G, R, A in BGRA8's byte order
+	std::vector<uint8_t> storage;  // The planes plus a line of slack, SIMD loads may run past a row's end
+};
+
+void CpuPlanarResize(CpuPlanarImage& image, int width, int height);
+
+// Only pixels inside `rect` and only the planes in `channels`
+void CpuPlanarDeinterleave(const CpuImage& input, CpuPlanarImage& planes, const BlurRect& rect, uint32_t channels = CpuPlanar_All);
+void CpuPlanarInterleave(const CpuPlanarImage& planes, const CpuImage& output, const BlurRect& rect, uint32_t channels = CpuPlanar_All);
+
+struct CpuPlanarScratch
+{
+	std::vector<uint16_t> columnSums;  // Per plane, the 2r + 1 rows around the current one
+	std::vector<uint32_t> prefixSums;  // Of the current row's column sums
+	std::vector<int> partial;		   // Columns of the current row the mask doesn't fully cover
+};
+
+// Box blur of the planes in `channels`, same output as CpuBoxBlurRect for those bytes: colors
+// go transparent black where the mask is empty and alpha is scaled by coverage. Column sums
+// are u16, false for radii past CpuBlurFixedMaxRadius; the interleaved kernels take those.
+bool CpuPlanarBoxBlurRect(const CpuPlanarImage& input, const CpuMask& mask, CpuPlanarImage& output,
+						  const BlurConstants& constants, const BlurRect& rect, CpuPlanarScratch& scratch,
+						  uint32_t channels = CpuPlanar_All);
+
+// The whole image, bands of rows split across `pool` when there is one. scratch is resized
+// to one per worker.
+bool CpuPlanarBoxBlurRun(const CpuPlanarImage& input, const CpuMask& mask, CpuPlanarImage& output, const BlurConstants& constants,
+						 std::vector<CpuPlanarScratch>& scratch, ThreadPool* pool = nullptr, uint32_t channels = CpuPlanar_All);
+
+// The interleaved pipeline's box blur through the planar layout: deinterleave, blur each plane
+// and interleave back, bands split across `pool` when there is one
+struct CpuPlanarBlur
+{
+	CpuPlanarImage input;
+	CpuPlanarImage output;
+	std::vector<CpuPlanarScratch> scratch;	// One per worker
+};
+
+bool CpuPlanarBoxBlur(const CpuImage& input, const CpuMask& mask, const CpuImage& output, const BlurConstants& constants,
+					  CpuPlanarBlur& blur, ThreadPool* pool = nullptr);
@@ -0,0 +1,247 @@
+#include "CpuSummedArea.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define CPU_SUMMED_AREA_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// The table of one rect: sums over [left, left + i) x [top, top + j) of the image at (i, j)
+struct SummedAreaTable
+{
+	uint32_t* sums;
+	size_t stride;	// u32 per row
+	int left;
+	int top;
+};
+
+static inline const uint32_t* TableAt(const SummedAreaTable& table, int x, int y)
+{
+	return table.sums + (size_t)(y - table.top) * table.stride + (size_t)(x - table.left) * 4;
+}
+
+// Sum of the pixels in [x0, x1) x [y0, y1), the rect inside the table
+static inline void RectSum(const SummedAreaTable& table, int x0, int y0, int x1, int y1, uint32_t* sum)
+{
+	const uint32_t* a = TableAt(table, x0, y0);
+	const uint32_t* b = TableAt(table, x1, y0);
+	const uint32_t* c = TableAt(table, x0, y1);
+	const uint32_t* d = TableAt(table, x1, y1);
+#if defined(CPU_SUMMED_AREA_SSE2)
+	__m128i result = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)d), _mm_loadu_si128((const __m128i*)b));
+	result = _mm_add_epi32(_mm_sub_epi32(result, _mm_loadu_si128((const __m128i*)c)), _mm_loadu_si128((const __m128i*)a));
+	_mm_storeu_si128((__m128i*)sum, result);
+#else
+	for (int i = 0; i < 4; ++i)
+		sum[i] = d[i] - b[i] - c[i] + a[i];
+#endif
+}
+
+// Rows of the table, one pixel of 4 sums per SSE2 register: the running sum of the row
+// plus the table row above
+static void BuildTable(const CpuImage& input, const BlurRect& area, CpuSummedAreaScratch& scratch, SummedAreaTable& table)
+{
+	const int width = area.right - area.left;
+	const int height = area.bottom - area.top;
+	table.stride = (size_t)(width + 1) * 4;
+	table.left = area.left;
+	table.top = area.top;
+	scratch.table.resize(table.stride * (height + 1));
+	table.sums = scratch.table.data();
+
+	std::fill(table.sums, table.sums + table.stride, 0u);
+	for (int y = 0; y < height; ++y)
+	{
+		const uint8_t* row = input.pixels + (size_t)(area.top + y) * input.rowPitch + (size_t)area.left * 4;
+		const uint32_t* above = table.sums + (size_t)y * table.stride + 4;
+		uint32_t* sums = table.sums + (size_t)(y + 1) * table.stride;
+		sums[0] = sums[1] = sums[2] = sums[3] = 0;
+		sums += 4;
+
+#if defined(CPU_SUMMED_AREA_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		__m128i acc = zero;
+		for (int x = 0; x < width; ++x)
+		{
+			__m128i pixel = _mm_cvtsi32_si128(*(const int*)(row + x * 4));
+			pixel = _mm_unpacklo_epi16(_mm_unpacklo_epi8(pixel, zero), zero);
+			acc = _mm_add_epi32(acc, pixel);
+			_mm_storeu_si128((__m128i*)(sums + x * 4), _mm_add_epi32(acc, _mm_loadu_si128((const __m128i*)(above + x * 4))));
+		}
+#else
+		uint32_t acc[4] = {};
+		for (int x = 0; x < width; ++x)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				acc[c] += row[x * 4 + c];
+				sums[x * 4 + c] = acc[c] + above[x * 4 + c];
+			}
+		}
+#endif
+	}
+}
+
+// Clamp-to-edge box of `radius` around (x, y): the part inside the image, then the edge
+// rows, columns and corners once per tap that fell outside
+static void ClampedBoxSum(const SummedAreaTable& table, const CpuImage& input, int width, int height, int x, int y, int radius,
+						  uint32_t* sum)
+{
+	const int x0 = x - radius, x1 = x + radius + 1;
+	const int y0 = y - radius, y1 = y + radius + 1;
+	const int left = std::max(x0, 0), right = std::min(x1, width);
+	const int top = std::max(y0, 0), bottom = std::min(y1, height);
+
+	RectSum(table, left, top, right, bottom, sum);
+	if (left == x0 && right == x1 && top == y0 && bottom == y1)
+		return;
+
+	const uint32_t outLeft = (uint32_t)(left - x0), outRight = (uint32_t)(x1 - right);
+	const uint32_t outTop = (uint32_t)(top - y0), outBottom = (uint32_t)(y1 - bottom);
+	uint32_t edge[4];
+	auto addEdge = [&](uint32_t times, int ex0, int ey0, int ex1, int ey1) {
+		if (!times)
+			return;
+		RectSum(table, ex0, ey0, ex1, ey1, edge);
+		for (int c = 0; c < 4; ++c)
+			sum[c] += times * edge[c];
+	};
+	addEdge(outLeft, 0, top, 1, bottom);
+	addEdge(outRight, width - 1, top, width, bottom);
+	addEdge(outTop, left, 0, right, 1);
+	addEdge(outBottom, left, height - 1, right, height);
+
+	auto addCorner = [&](uint32_t times, int cx, int cy) {
+		if (!times)
+			return;
+		const uint8_t* pixel = input.pixels + (size_t)cy * input.rowPitch + (size_t)cx * 4;
+		for (int c = 0; c < 4; ++c)
+			sum[c] += times * pixel[c];
+	};
+	addCorner(outTop * outLeft, 0, 0);
+	addCorner(outTop * outRight, width - 1, 0);
+	addCorner(outBottom * outLeft, 0, height - 1);
+	addCorner(outBottom * outRight, width - 1, height - 1);
+}
+
+int CpuSummedAreaTileSizeFor(const BlurConstants& constants)
+{
+	return std::max(CpuSummedAreaTileSize, 2 * CpuBlurRadius(constants));
+}
+
+void CpuSummedAreaBlurRect(const CpuImage& input, const CpuMask& mask, const CpuMask& radiusMap, const CpuImage& output,
+						   const BlurConstants& constants, const BlurRect& rect, CpuSummedAreaScratch& scratch)
+{
+	BlurRect clipped = rect;
+	if (!CpuBlurClipRect(constants, clipped))
+		return;
+
+	const int width = (int)constants.textureWidth;
+	const int height = (int)constants.textureHeight;
+
+	int radii[256];
+	for (int value = 0; value < 256; ++value)
+		radii[value] = CpuSummedAreaRadius(constants, (uint8_t)value);
+
+	// The apron only has to reach as far as the largest radius in the rect
+	int apron = 0;
+	for (int y = clipped.top; y < clipped.bottom; ++y)
+	{
+		for (int x = clipped.left; x < clipped.right; ++x)
+			apron = std::max(apron, radii[CpuMaskCoverage(radiusMap, x, y)]);
+	}
+
+	const BlurRect area = { std::max(clipped.left - apron, 0), std::max(clipped.top - apron, 0),
+							std::min(clipped.right + apron, width), std::min(clipped.bottom + apron, height) };
+	SummedAreaTable table;
+	BuildTable(input, area, scratch, table);
+
+	const int exactRadius = std::min(apron, CpuBlurFixedMaxRadius);
+	for (int radius = (int)scratch.reciprocals.size(); radius <= exactRadius; ++radius)
+		scratch.reciprocals.push_back(CpuBlurFixedReciprocal((uint32_t)((2 * radius + 1) * (2 * radius + 1))));
+
+	for (int y = clipped.top; y < clipped.bottom; ++y)
+	{
+		uint8_t* dst = output.pixels + (size_t)y * output.rowPitch;
+		for (int x = clipped.left; x < clipped.right; ++x)
+		{
+			const int radius = radii[CpuMaskCoverage(radiusMap, x, y)];
+			const uint8_t coverage = CpuMaskCoverage(mask, x, y);
+			uint8_t* out = dst + (size_t)x * 4;
+			if (coverage == 0)
+			{
+				out[0] = out[1] = out[2] = out[3] = 0;
+				continue;
+			}
+
+			uint32_t sum[4];
+			ClampedBoxSum(table, input, width, height, x, y, radius, sum);
+
+			// Fully covered pixels divide by a reciprocal multiply, the alpha of the others
+			// by samples * 255
+			if (coverage == 255 && radius <= exactRadius)
+			{
+				const CpuBlurReciprocal& reciprocal = scratch.reciprocals[radius];
+				for (int c = 0; c < 4; ++c)
+					out[c] = (uint8_t)CpuBlurFixedDivide(sum[c], reciprocal);
+			}
+			else
+			{
+				CpuBlurResolvePixel(sum, (uint64_t)(2 * radius + 1) * (2 * radius + 1), coverage, out);
+			}
+		}
+	}
+}
+
+void CpuSummedAreaBlur(const CpuImage& input, const CpuMask& mask, const CpuMask& radiusMap, const CpuImage& output,
+					   const BlurConstants& constants, std::vector<CpuSummedAreaScratch>& scratch, ThreadPool* pool)
+{
+	const int tile = CpuSummedAreaTileSizeFor(constants);
+	const int columns = ((int)constants.textureWidth + tile - 1) / tile;
+	const int rows = ((int)constants.textureHeight + tile - 1) / tile;
+	scratch.resize(pool ? std::max(ThreadPoolWorkerCount(*pool), 1) : 1);
+
+	auto blurTile = [&](int index, int worker) {
+		const int x = index % columns * tile;
+		const int y = index / columns * tile;
+		const BlurRect rect = { x, y, x + tile, y + tile };
+		CpuSummedAreaBlurRect(input, mask, radiusMap, output, constants, rect, scratch[worker]);
+	};
+
+	if (pool)
+	{
+		ThreadPoolParallelFor(*pool, columns * rows, blurTile);
+		return;
+	}
+	for (int i = 0; i < columns * rows; ++i)
+		blurTile(i, 0);
+}
+
+void CpuVariableBoxBlurReference(const CpuImage& input, const CpuMask& mask, const CpuMask& radiusMap, const CpuImage& output,
+								 const BlurConstants& constants)
+{
+	const int width = (int)constants.textureWidth;
+	const int height = (int)constants.textureHeight;
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			const int radius = CpuSummedAreaRadius(constants, CpuMaskCoverage(radiusMap, x, y));
+			uint32_t sum[4] = {};
+			for (int dy = -radius; dy <= radius; ++dy)
+			{
+				const uint8_t* row = input.pixels + (size_t)CpuBlurClamp(y + dy, 0, height - 1) * input.rowPitch;
+				for (int dx = -radius; dx <= radius; ++dx)
+				{
+					const uint8_t* pixel = row + (size_t)CpuBlurClamp(x + dx, 0, width - 1) * 4;
+					for (int c = 0; c < 4; ++c)
+						sum[c] += pixel[c];
+				}
+			}
+
+			uint8_t* out = output.pixels + (size_t)y * output.rowPitch + (size_t)x * 4;
+			CpuBlurResolvePixel(sum, (uint64_t)(2 * radius + 1) * (2 * radius + 1), CpuMaskCoverage(mask, x, y), out);
+		}
+	}
+}
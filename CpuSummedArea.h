@@ -0,0 +1,47 @@
+#pragma once
+
+#include "CpuBlur.h"
+#include "CpuBlurFixed.h"
+#include "ThreadPool.h"
+
+// Box blur whose radius changes from pixel to pixel, for progressive blur: a ramp from sharp
+// to frosted across a panel edge. Each tile builds a summed-area table of its pixels plus an
+// apron of its largest radius, after which any box is four reads whatever its radius.
+//
+// The radius comes from a byte channel: 0 leaves the pixel unblurred, 255 is
+// constants.blurRadius, values between scale linearly. Same clamp-to-edge, mask and rounding
+// as CpuBoxBlurRect, so a map that is 255 everywhere gives bit-identical output.
+//
+// Tables hold u32 sums and are clipped to the image. Boxes reaching past an edge add the
+// edge row, column and corner pixel once per tap outside, from the same table. A table up to
+// 4096x4096 can't overflow. Larger ones, from radii past 1024 at 8K, wrap. The four-corner
+// difference is still exact mod 2^32 because a single box's sum fits 32 bits up to
+// CpuBlurMaxRadius.
+static const int CpuSummedAreaTileSize = 128;
+
+struct CpuSummedAreaScratch
+{
+	std::vector<uint32_t> table;  // (width + 1) x (height + 1) pixels of 4 sums, row and column 0 are zero
+	std::vector<CpuBlurReciprocal> reciprocals;	 // By radius, up to CpuBlurFixedMaxRadius
+};
+
+inline int CpuSummedAreaRadius(const BlurConstants& constants, uint8_t value)
+{
+	return (value * CpuBlurRadius(constants) + 127) / 255;
+}
+
+// Tiles are CpuSummedAreaTileSize, or twice the largest radius when that is more so the
+// aprons don't dwarf them: a table is at most (tile + 2 * radius)^2 pixels of 16 bytes
+int CpuSummedAreaTileSizeFor(const BlurConstants& constants);
+
+// Only pixels inside `rect` are written, from one table covering the rect and its apron
+void CpuSummedAreaBlurRect(const CpuImage& input, const CpuMask& mask, const CpuMask& radiusMap, const CpuImage& output,
+						   const BlurConstants& constants, const BlurRect& rect, CpuSummedAreaScratch& scratch);
+
+// The whole image in tiles, split across `pool` when there is one. scratch is resized to one per worker.
+void CpuSummedAreaBlur(const CpuImage& input, const CpuMask& mask, const CpuMask& radiusMap, const CpuImage& output,
+					   const BlurConstants& constants, std::vector<CpuSummedAreaScratch>& scratch, ThreadPool* pool = nullptr);
+
+// Every tap of every pixel's box summed on its own, O(r^2) per pixel
+void CpuVariableBoxBlurReference(const CpuImage& input, const CpuMask& mask, const CpuMask& radiusMap, const CpuImage& output,
+								 const BlurConstants& constants);
@@ -0,0 +1,98 @@
+#include "DesktopLayout.h"
+
+#include <string.h>
+#include <algorithm>
+
+static bool Intersect(const BlurRect& a, const BlurRect& b, BlurRect& result)
+{
+	result = { std::max(a.left, b.left), std::max(a.top, b.top), std::min(a.right, b.right), std::min(a.bottom, b.bottom) };
+	return result.left < result.right && result.top < result.bottom;
+}
+
+// The parts of `rect` outside `hole`, at most four bands
+static void Subtract(const BlurRect& rect, const BlurRect& hole, std::vector<BlurRect>& pieces)
+{
+	BlurRect overlap;
+	if (!Intersect(rect, hole, overlap))
+	{
+		pieces.push_back(rect);
+		return;
+	}
+
+	if (rect.top < overlap.top)
+		pieces.push_back({ rect.left, rect.top, rect.right, overlap.top });
+	if (overlap.bottom < rect.bottom)
+		pieces.push_back({ rect.left, overlap.bottom, rect.right, rect.bottom });
+	if (rect.left < overlap.left)
+		pieces.push_back({ rect.left, overlap.top, overlap.left, overlap.bottom });
+	if (overlap.right < rect.right)
+		pieces.push_back({ overlap.right, overlap.top, rect.right, overlap.bottom });
+}
+
+void DesktopLayoutPlan(const std::vector<DesktopOutput>& outputs, const BlurRect& region,
+					   std::vector<DesktopCopy>& copies, std::vector<BlurRect>& uncovered)
+{
+	copies.clear();
+	uncovered.clear();
+	if (region.left >= region.right || region.top >= region.bottom)
+		return;
+
+	// Desktop rects nobody claimed yet, every output takes its share of them
+	std::vector<BlurRect> remaining(1, region), next;
+	for (int index = 0; index < (int)outputs.size() && !remaining.empty(); ++index)
+	{
+		const BlurRect& bounds = outputs[index].bounds;
+		next.clear();
+		for (const BlurRect& piece : remaining)
+		{
+			BlurRect overlap;
+			if (Intersect(piece, bounds, overlap))
+			{
+				BlurRect source = { overlap.left - bounds.left, overlap.top - bounds.top, overlap.right - bounds.left, overlap.bottom - bounds.top };
+				copies.push_back({ index, source, overlap.left - region.left, overlap.top - region.top });
+			}
+			Subtract(piece, bounds, next);
+		}
+		remaining.swap(next);
+	}
+
+	for (const BlurRect& piece : remaining)
+		uncovered.push_back({ piece.left - region.left, piece.top - region.top, piece.right - region.left, piece.bottom - region.top });
+}
+
+void DesktopLayoutAssemble(const std::vector<DesktopCopy>& copies, const std::vector<BlurRect>& uncovered,
+						   const CpuImage* frames, const CpuImage& region)
+{
+	for (const DesktopCopy& copy : copies)
+	{
+		const CpuImage& frame = frames[copy.output];
+		const size_t bytes = (size_t)(copy.source.right - copy.source.left) * 4;
+		for (int y = copy.source.top; y < copy.source.bottom; ++y)
+		{
+			const uint8_t* source = frame.pixels + (size_t)y * frame.rowPitch + (size_t)copy.source.left * 4;
+			uint8_t* dest = region.pixels + (size_t)(copy.destY + y - copy.source.top) * region.rowPitch + (size_t)copy.destX * 4;
+			memcpy(dest, source, bytes);
+		}
+	}
+
+	for (const BlurRect& rect : uncovered)
+	{
+		for (int y = rect.top; y < rect.bottom; ++y)
+			memset(region.pixels + (size_t)y * region.rowPitch + (size_t)rect.left * 4, 0, (size_t)(rect.right - rect.left) * 4);
+	}
+}
+
+void DesktopLayoutFrameToDesktop(const DesktopOutput& output, Frame& frame)
+{
+	const int x = output.bounds.left;
+	const int y = output.bounds.top;
+	for (BlurRect& rect : frame.dirtyRects)
+		rect = { rect.left + x, rect.top + y, rect.right + x, rect.bottom + y };
+
+	for (DirtyMove& move : frame.moves)
+	{
+		move.sourceX += x;
+		move.sourceY += y;
+		move.destination = { move.destination.left + x, move.destination.top + y, move.destination.right + x, move.destination.bottom + y };
+	}
+}
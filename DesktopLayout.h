@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+#include "CpuBlur.h"
+#include "FrameSource.h"
+
+// Monitors on the virtual desktop. Every output is duplicated on its own and its frames are
+// in its own pixels, while windows live in desktop coordinates: they can straddle outputs,
+// start left of or above the primary one (negative coordinates) or hang over a gap between
+// outputs of different sizes.
+struct DesktopOutput
+{
+	BlurRect bounds;  // Desktop coordinates, DXGI_OUTPUT_DESC::DesktopCoordinates
+};
+
+// One rect to copy from an output's frame into the assembled region
+struct DesktopCopy
+{
+	int output;
+	BlurRect source;  // Output-local pixels
+	int destX;		  // Region-local position
+	int destY;
+};
+
+// Copies that assemble `region` (desktop coordinates, e.g. the window grown by the blur
+// apron) out of the outputs, plus the region-local rects no output covers. Where outputs
+// overlap (mirrored displays) the first one wins, no pixel is copied twice.
+void DesktopLayoutPlan(const std::vector<DesktopOutput>& outputs, const BlurRect& region,
+					   std::vector<DesktopCopy>& copies, std::vector<BlurRect>& uncovered);
+
+// CPU assembly, frames[i] is output i's frame. Uncovered pixels become transparent black.
+void DesktopLayoutAssemble(const std::vector<DesktopCopy>& copies, const std::vector<BlurRect>& uncovered,
+						   const CpuImage* frames, const CpuImage& region);
+
+// Moves an output's dirty and move rects from its pixels to desktop coordinates
+void DesktopLayoutFrameToDesktop(const DesktopOutput& output, Frame& frame);
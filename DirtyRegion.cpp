@@ -0,0 +1,186 @@
+#include "DirtyRegion.h"
+
+#include <algorithm>
+
+static inline bool Touches(const BlurRect& a, const BlurRect& b)
+{
+	return a.left <= b.right && b.left <= a.right && a.top <= b.bottom && b.top <= a.bottom;
+}
+
+static inline BlurRect Union(const BlurRect& a, const BlurRect& b)
+{
+	BlurRect rect;
+	rect.left = std::min(a.left, b.left);
+	rect.top = std::min(a.top, b.top);
+	rect.right = std::max(a.right, b.right);
+	rect.bottom = std::max(a.bottom, b.bottom);
+	return rect;
+}
+
+static inline bool Intersect(const BlurRect& a, const BlurRect& b, BlurRect& result)
+{
+	result.left = std::max(a.left, b.left);
+	result.top = std::max(a.top, b.top);
+	result.right = std::min(a.right, b.right);
+	result.bottom = std::min(a.bottom, b.bottom);
+	return result.left < result.right && result.top < result.bottom;
+}
+
+static inline bool SameRect(const BlurRect& a, const BlurRect& b)
+{
+	return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+void DirtyRegionReset(DirtyRegionTracker& tracker)
+{
+	tracker.pending.clear();
+	tracker.forceFull = false;
+	tracker.hasLast = false;
+	tracker.lastWindowRect = {};
+	tracker.lastRadius = 0;
+}
+
+void DirtyRegionInvalidate(DirtyRegionTracker& tracker)
+{
+	tracker.forceFull = true;
+}
+
+void DirtyRegionAddFrame(DirtyRegionTracker& tracker, const BlurRect* dirtyRects, int dirtyCount,
+						 const DirtyMove* moves, int moveCount)
+{
+	for (int i = 0; i < dirtyCount; ++i)
+		tracker.pending.push_back(dirtyRects[i]);
+
+	for (int i = 0; i < moveCount; ++i)
+		tracker.pending.push_back(moves[i].destination);
+
+	// Frames can pile up between builds, keep the list bounded
+	if (tracker.pending.size() > (size_t)DirtyRegionMaxRects * 4)
+		DirtyRegionMerge(tracker.pending);
+}
+
+void DirtyRegionMerge(std::vector<BlurRect>& rects)
+{
+	bool merged = true;
+	while (merged)
+	{
+		merged = false;
+		for (size_t i = 0; i < rects.size() && !merged; ++i)
+		{
+			for (size_t j = i + 1; j < rects.size(); ++j)
+			{
+				if (Touches(rects[i], rects[j]))
+				{
+					rects[i] = Union(rects[i], rects[j]);
+					rects.erase(rects.begin() + j);
+					merged = true;
+					break;
+				}
+			}
+		}
+	}
+
+	if (rects.size() > (size_t)DirtyRegionMaxRects)
+	{
+		BlurRect bounds = rects[0];
+		for (const BlurRect& rect : rects)
+			bounds = Union(bounds, rect);
+		rects.assign(1, bounds);
+	}
+}
+
+// Changes count inside windowRect grown by `apron`, the rects come out local to windowRect
+// and the share that makes one full blur cheaper is of the window, not of the apron
+static bool BuildRegion(DirtyRegionTracker& tracker, const BlurRect& windowRect, int apron, int radius, DirtyRegion& region)
+{
+	region.full = false;
+	region.copyRects.clear();
+	region.blurRects.clear();
+
+	const int width = windowRect.right - windowRect.left;
+	const int height = windowRect.bottom - windowRect.top;
+	const BlurRect collected = { windowRect.left - apron, windowRect.top - apron, windowRect.right + apron, windowRect.bottom + apron };
+
+	// Moving or resizing the window changes everything behind it
+	bool full = tracker.forceFull || !tracker.hasLast || radius != tracker.lastRadius ||
+		!SameRect(windowRect, tracker.lastWindowRect);
+
+	if (!full)
+	{
+		for (const BlurRect& dirty : tracker.pending)
+		{
+			BlurRect clipped;
+			if (!Intersect(dirty, collected, clipped))
+				continue;
+
+			clipped.left -= windowRect.left;
+			clipped.right -= windowRect.left;
+			clipped.top -= windowRect.top;
+			clipped.bottom -= windowRect.top;
+			region.copyRects.push_back(clipped);
+		}
+
+		if (region.copyRects.empty())
+		{
+			tracker.pending.clear();
+			return false;
+		}
+
+		DirtyRegionMerge(region.copyRects);
+
+		const BlurRect window = { 0, 0, width, height };
+		for (const BlurRect& copy : region.copyRects)
+		{
+			BlurRect grown = { copy.left - radius, copy.top - radius, copy.right + radius, copy.bottom + radius };
+			BlurRect clipped;
+			if (Intersect(grown, window, clipped))
+				region.blurRects.push_back(clipped);
+		}
+		DirtyRegionMerge(region.blurRects);
+
+		uint64_t area = DirtyRegionArea(region, width, height);
+		if (area > (uint64_t)(DirtyRegionFullThreshold * (double)width * height))
+			full = true;
+	}
+
+	if (full)
+	{
+		region.full = true;
+		region.copyRects.clear();
+		region.blurRects.clear();
+	}
+
+	tracker.pending.clear();
+	tracker.forceFull = false;
+	tracker.hasLast = true;
+	tracker.lastWindowRect = windowRect;
+	tracker.lastRadius = radius;
+	return region.full || !region.blurRects.empty();
+}
+
+bool DirtyRegionBuild(DirtyRegionTracker& tracker, const BlurRect& windowRect, int radius, DirtyRegion& region)
+{
+	return BuildRegion(tracker, windowRect, 0, radius, region);
+}
+
+bool DirtyRegionBuildApron(DirtyRegionTracker& tracker, const BlurRect& windowRect, int radius, DirtyRegion& region)
+{
+	return BuildRegion(tracker, windowRect, radius, radius, region);
+}
+
+void CpuIncrementalBlur(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						const BlurConstants& constants, const DirtyRegion& region, CpuBlurScratch& scratch,
+						BlurKernelType kernel)
+{
+	const BlurRect everything = { 0, 0, (int)constants.textureWidth, (int)constants.textureHeight };
+	const BlurRect* rects = region.full ? &everything : region.blurRects.data();
+	const size_t count = region.full ? 1 : region.blurRects.size();
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (kernel == BlurKernel_Box)
+			CpuBoxBlurRect(input, mask, output, constants, rects[i], scratch);
+		else
+			CpuBlurKernelRect(kernel, input, mask, output, constants, rects[i], scratch);
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+#include "BlurKernels.h"
+#include "CpuBlur.h"
+
+// Collects the dirty and move rects IDXGIOutputDuplication reports per frame and turns
+// them into the window-local rects that need to be blurred again. Everything else keeps
+// the previous blurred output.
+static const int DirtyRegionMaxRects = 32;
+
+// Share of the window above which one full blur is cheaper than many small ones
+static const float DirtyRegionFullThreshold = 0.5f;
+
+// DXGI_OUTDUPL_MOVE_RECT in desktop coordinates
+struct DirtyMove
+{
+	int sourceX;
+	int sourceY;
+	BlurRect destination;
+};
+
+struct DirtyRegion
+{
+	bool full;						// Blur everything, the rects are empty
+	std::vector<BlurRect> copyRects;  // Changed input pixels, window-local, merged
+	std::vector<BlurRect> blurRects;  // copyRects grown by the radius, the output pixels they reach
+};
+
+struct DirtyRegionTracker
+{
+	std::vector<BlurRect> pending;	// Desktop coordinates, since the last DirtyRegionBuild
+	bool forceFull;
+	bool hasLast;
+	BlurRect lastWindowRect;
+	int lastRadius;
+};
+
+void DirtyRegionReset(DirtyRegionTracker& tracker);
+
+// The next DirtyRegionBuild blurs everything, e.g. after the mask or the kernel changed
+void DirtyRegionInvalidate(DirtyRegionTracker& tracker);
+
+// One frame of duplication metadata. Only move destinations change content, the sources
+// keep theirs until something else is drawn there, which shows up as a dirty rect.
+void DirtyRegionAddFrame(DirtyRegionTracker& tracker, const BlurRect* dirtyRects, int dirtyCount,
+						 const DirtyMove* moves, int moveCount);
+
+// Clips the pending rects to the window, merges them and grows them by the radius.
+// Returns false when nothing behind the window changed since the last call.
+bool DirtyRegionBuild(DirtyRegionTracker& tracker, const BlurRect& windowRect, int radius, DirtyRegion& region);
+
+// For a blur that reads past the window (ImageViewPlanBlur): changes up to `radius` outside
+// the window count too. copyRects stay window-local and can lie outside the window, blurRects
+// are clipped to it. Use one of the two builds per tracker, not both.
+bool DirtyRegionBuildApron(DirtyRegionTracker& tracker, const BlurRect& windowRect, int radius, DirtyRegion& region);
+
+// Pixels the region re-blurs in a width x height window
+inline uint64_t DirtyRegionArea(const DirtyRegion& region, int width, int height)
+{
+	if (region.full)
+		return (uint64_t)width * height;
+
+	uint64_t area = 0;
+	for (const BlurRect& rect : region.blurRects)
+		area += (uint64_t)(rect.right - rect.left) * (rect.bottom - rect.top);
+	return area;
+}
+
+// Merges overlapping or touching rects in place until none overlap
+void DirtyRegionMerge(std::vector<BlurRect>& rects);
+
+// Re-blurs region.blurRects of `output`, which must hold the previous frame's result
+void CpuIncrementalBlur(const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						const BlurConstants& constants, const DirtyRegion& region, CpuBlurScratch& scratch,
+						BlurKernelType kernel = BlurKernel_Box);
@@ -0,0 +1,361 @@
+#include "EffectChain.h"
+#include "Trace.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+EffectStage EffectBlurStage(BlurKernelType kernel)
+{
+	EffectStage stage = {};
+	stage.type = EffectStage_Blur;
+	stage.kernel = kernel;
+	return stage;
+}
+
+EffectStage EffectColorMatrixStage(const float matrix[3][4])
+{
+	EffectStage stage = {};
+	stage.type = EffectStage_ColorMatrix;
+	memcpy(stage.matrix, matrix, sizeof(stage.matrix));
+	return stage;
+}
+
+EffectStage EffectSaturationStage(float saturation)
+{
+	static const float Luma[3] = { 0.2126f, 0.7152f, 0.0722f };
+
+	float matrix[3][4] = {};
+	for (int row = 0; row < 3; ++row)
+		for (int column = 0; column < 3; ++column)
+			matrix[row][column] = (1.0f - saturation) * Luma[column] + (row == column ? saturation : 0.0f);
+	return EffectColorMatrixStage(matrix);
+}
+
+EffectStage EffectTintStage(float r, float g, float b, float opacity)
+{
+	EffectStage stage = {};
+	stage.type = EffectStage_Tint;
+	stage.tint[0] = r;
+	stage.tint[1] = g;
+	stage.tint[2] = b;
+	stage.tintOpacity = opacity;
+	return stage;
+}
+
+EffectStage EffectNoiseStage(float amplitude, uint32_t seed)
+{
+	EffectStage stage = {};
+	stage.type = EffectStage_Noise;
+	stage.noiseAmplitude = amplitude;
+	stage.noiseSeed = seed;
+	return stage;
+}
+
+EffectStage EffectMaskStage()
+{
+	EffectStage stage = {};
+	stage.type = EffectStage_Mask;
+	return stage;
+}
+
+std::vector<EffectStage> AcrylicEffectStages(BlurKernelType kernel, const float tint[3])
+{
+	return {
+		EffectBlurStage(kernel),
+		EffectSaturationStage(1.4f),
+		EffectTintStage(tint[0], tint[1], tint[2], 0.15f),
+		EffectNoiseStage(2.0f, 0x9e3779b9u),
+		EffectMaskStage(),
+	};
+}
+
+static bool Fail(std::string* error, const char* message)
+{
+	if (error) *error = message;
+	return false;
+}
+
+static bool InRange(float value, float low, float high)
+{
+	return value >= low && value <= high;  // False for NaN
+}
+
+bool EffectChainCompile(const std::vector<EffectStage>& stages, EffectProgram& program, std::string* error)
+{
+	program = {};
+	if (stages.empty() || stages.front().type != EffectStage_Blur)
+		return Fail(error, "the chain must start with a blur");
+	if (stages.back().type != EffectStage_Mask)
+		return Fail(error, "the chain must end with the mask");
+
+	int previous = -1;
+	for (const EffectStage& stage : stages)
+	{
+		if (stage.type < 0 || stage.type >= EffectStage_Count)
+			return Fail(error, "unknown stage");
+		if ((int)stage.type <= previous)
+			return Fail(error, "stages must run blur, color matrix, tint, noise, mask, each at most once");
+		previous = stage.type;
+		program.stages |= 1u << stage.type;
+
+		switch (stage.type)
+		{
+		  case EffectStage_Blur:
+			  if (stage.kernel < 0 || stage.kernel >= BlurKernel_Count)
+				  return Fail(error, "unknown blur kernel");
+			  program.kernel = stage.kernel;
+			  break;
+
+		  case EffectStage_ColorMatrix:
+			  // Keeps matrix * 255 and the offset well inside the int32 accumulators
+			  for (int row = 0; row < 3; ++row)
+			  {
+				  for (int column = 0; column < 3; ++column)
+				  {
+					  if (!InRange(stage.matrix[row][column], -8.0f, 8.0f))
+						  return Fail(error, "color matrix coefficients must be within -8..8");
+					  program.matrix[row][column] = (int32_t)lroundf(stage.matrix[row][column] * (1 << EffectMatrixShift));
+				  }
+				  if (!InRange(stage.matrix[row][3], -2.0f, 2.0f))
+					  return Fail(error, "color matrix offsets must be within -2..2");
+				  program.offset[row] = (int32_t)lroundf(stage.matrix[row][3] * 255.0f * (1 << EffectMatrixShift));
+			  }
+			  break;
+
+		  case EffectStage_Tint:
+			  for (int c = 0; c < 3; ++c)
+			  {
+				  if (!InRange(stage.tint[c], 0.0f, 1.0f))
+					  return Fail(error, "tint color must be within 0..1");
+				  program.tint[c] = (int32_t)lroundf(stage.tint[c] * 255.0f);
+			  }
+			  if (!InRange(stage.tintOpacity, 0.0f, 1.0f))
+				  return Fail(error, "tint opacity must be within 0..1");
+			  program.tintOpacity = (int32_t)lroundf(stage.tintOpacity * 255.0f);
+			  break;
+
+		  case EffectStage_Noise:
+			  if (!InRange(stage.noiseAmplitude, 0.0f, 64.0f))
+				  return Fail(error, "noise amplitude must be within 0..64");
+			  program.noiseAmplitude = (int32_t)lroundf(stage.noiseAmplitude);
+			  program.noiseSeed = stage.noiseSeed;
+			  break;
+
+		  default:
+			  break;
+		}
+	}
+	return true;
+}
+
+static inline int ClampByte(int value)
+{
+	return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+// The stages in `stages` for one row of BGRA pixels, in chain order
+static void ApplyStagesRow(const EffectProgram& program, uint32_t stages, uint8_t* row, int left, int right, int y,
+						   const CpuMask& mask)
+{
+	const int half = 1 << (EffectMatrixShift - 1);
+	const int keep = 255 - program.tintOpacity;
+	const int tintR = program.tint[0] * program.tintOpacity;
+	const int tintG = program.tint[1] * program.tintOpacity;
+	const int tintB = program.tint[2] * program.tintOpacity;
+
+	for (int x = left; x < right; ++x)
+	{
+		uint8_t* p = row + (size_t)x * 4;
+		int b = p[0], g = p[1], r = p[2];
+
+		if (stages & EffectStageBit_ColorMatrix)
+		{
+			const int32_t(*m)[3] = program.matrix;
+			const int r1 = (m[0][0] * r + m[0][1] * g + m[0][2] * b + program.offset[0] + half) >> EffectMatrixShift;
+			const int g1 = (m[1][0] * r + m[1][1] * g + m[1][2] * b + program.offset[1] + half) >> EffectMatrixShift;
+			const int b1 = (m[2][0] * r + m[2][1] * g + m[2][2] * b + program.offset[2] + half) >> EffectMatrixShift;
+			r = ClampByte(r1);
+			g = ClampByte(g1);
+			b = ClampByte(b1);
+		}
+
+		if (stages & EffectStageBit_Tint)
+		{
+			// (c * (255 - opacity) + tint * opacity) / 255, rounded half-up
+			r = (2 * (r * keep + tintR) + 255) / 510;
+			g = (2 * (g * keep + tintG) + 255) / 510;
+			b = (2 * (b * keep + tintB) + 255) / 510;
+		}
+
+		if (stages & EffectStageBit_Noise)
+		{
+			const int grain = EffectNoise((uint32_t)x, (uint32_t)y, program.noiseSeed, program.noiseAmplitude);
+			r = ClampByte(r + grain);
+			g = ClampByte(g + grain);
+			b = ClampByte(b + grain);
+		}
+
+		p[0] = (uint8_t)b;
+		p[1] = (uint8_t)g;
+		p[2] = (uint8_t)r;
+
+		if (stages & EffectStageBit_Mask)
+		{
+			// Transparent black where the mask is empty, alpha scaled by coverage elsewhere
+			const int coverage = CpuMaskCoverage(mask, x, y);
+			if (coverage == 0)
+				p[0] = p[1] = p[2] = p[3] = 0;
+			else
+				p[3] = (uint8_t)((2 * p[3] * coverage + 255) / 510);
+		}
+	}
+}
+
+static void ApplyStagesRect(const EffectProgram& program, uint32_t stages, const CpuMask& mask, const CpuImage& output,
+							const BlurRect& rect)
+{
+	for (int y = rect.top; y < rect.bottom; ++y)
+		ApplyStagesRow(program, stages, output.pixels + (size_t)y * output.rowPitch, rect.left, rect.right, y, mask);
+}
+
+static void BlurRectUnmasked(const EffectProgram& program, const CpuImage& input, const CpuImage& output,
+							 const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+	// The mask is the chain's last stage, the blur itself runs everywhere
+	const CpuMask unmasked = {};
+	if (program.kernel == BlurKernel_Box)
+		CpuBoxBlurRect(input, unmasked, output, constants, rect, scratch);
+	else
+		CpuBlurKernelRect(program.kernel, input, unmasked, output, constants, rect, scratch);
+}
+
+void CpuEffectChainRect(const EffectProgram& program, const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch)
+{
+	BlurRect clipped = rect;
+	if (!CpuBlurClipRect(constants, clipped))
+		return;
+
+	// A tile's blur output is still in cache when the stages go over it
+	BlurRectUnmasked(program, input, output, constants, clipped, scratch);
+	ApplyStagesRect(program, program.stages & ~EffectStageBit_Blur, mask, output, clipped);
+}
+
+void CpuTiledEffectRun(CpuTiledBlur& blur, const EffectProgram& program, const CpuImage& input, const CpuMask& mask,
+					   const CpuImage& output, const BlurConstants& constants)
+{
+	if (constants.textureWidth == 0 || constants.textureHeight == 0)
+		return;
+
+	ThreadPoolParallelFor(blur.pool, CpuTiledBlurTileCount(blur, constants), [&](int tile, int worker) {
+		TRACE_ZONE("Effect tile");
+		BlurRect rect = CpuTiledBlurTileRect(blur, constants, tile);
+		CpuEffectChainRect(program, input, mask, output, constants, rect, blur.scratch[worker]);
+	});
+}
+
+void CpuTiledEffectRunUnfused(CpuTiledBlur& blur, const EffectProgram& program, const CpuImage& input, const CpuMask& mask,
+							  const CpuImage& output, const BlurConstants& constants)
+{
+	if (constants.textureWidth == 0 || constants.textureHeight == 0)
+		return;
+
+	const int tiles = CpuTiledBlurTileCount(blur, constants);
+	ThreadPoolParallelFor(blur.pool, tiles, [&](int tile, int worker) {
+		TRACE_ZONE("Blur tile");
+		BlurRect rect = CpuTiledBlurTileRect(blur, constants, tile);
+		BlurRectUnmasked(program, input, output, constants, rect, blur.scratch[worker]);
+	});
+
+	for (int type = EffectStage_ColorMatrix; type < EffectStage_Count; ++type)
+	{
+		const uint32_t stage = 1u << type;
+		if (!(program.stages & stage))
+			continue;
+
+		ThreadPoolParallelFor(blur.pool, tiles, [&](int tile, int worker) {
+			TRACE_ZONE("Effect pass tile");
+			ApplyStagesRect(program, stage, mask, output, CpuTiledBlurTileRect(blur, constants, tile));
+		});
+	}
+}
+
+uint64_t EffectChainUnfusedBytes(const EffectProgram& program, uint64_t pixels)
+{
+	// Every pass reads and writes BGRA8, the mask pass also reads the R8 mask
+	uint64_t bytes = 0;
+	for (int type = EffectStage_Blur; type < EffectStage_Count; ++type)
+		if (program.stages & (1u << type))
+			bytes += pixels * (4 + 4 + (type == EffectStage_Mask ? 1 : 0));
+	return bytes;
+}
+
+uint64_t EffectChainFusedBytes(const EffectProgram& program, uint64_t pixels)
+{
+	return pixels * (4 + 4 + ((program.stages & EffectStageBit_Mask) ? 1 : 0));
+}
+
+static void AppendFormat(std::string& text, const char* format, ...)
+{
+	char buffer[256];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	if (length > 0) text.append(buffer, std::min(length, (int)sizeof(buffer) - 1));
+}
+
+std::string GenerateEffectChainHlsl(const EffectProgram& program, int radius)
+{
+	// Rounds the float blur to 8 bits like the CPU blur, then the same integer math as ApplyStagesRow
+	std::string resolve =
+		"\t// Effect chain, generated by GenerateEffectChainHlsl\n"
+		"\tcolor /= WeightSum;\n"
+		"\tint3 rgb = (int3)(color.rgb * 255.0 + 0.5);\n"
+		"\tint alpha = (int)(color.a * 255.0 + 0.5);\n";
+
+	if (program.stages & EffectStageBit_ColorMatrix)
+	{
+		resolve += "\n\t// Color matrix\n";
+		AppendFormat(resolve, "\trgb = clamp((int3(dot(int3(%d, %d, %d), rgb), dot(int3(%d, %d, %d), rgb), dot(int3(%d, %d, %d), rgb))",
+					 program.matrix[0][0], program.matrix[0][1], program.matrix[0][2], program.matrix[1][0], program.matrix[1][1],
+					 program.matrix[1][2], program.matrix[2][0], program.matrix[2][1], program.matrix[2][2]);
+		AppendFormat(resolve, " + int3(%d, %d, %d) + %d) >> %d, 0, 255);\n", program.offset[0], program.offset[1], program.offset[2],
+					 1 << (EffectMatrixShift - 1), EffectMatrixShift);
+	}
+
+	if (program.stages & EffectStageBit_Tint)
+	{
+		resolve += "\n\t// Tint\n";
+		AppendFormat(resolve, "\trgb = (2 * (rgb * %d + int3(%d, %d, %d)) + 255) / 510;\n", 255 - program.tintOpacity,
+					 program.tint[0] * program.tintOpacity, program.tint[1] * program.tintOpacity, program.tint[2] * program.tintOpacity);
+	}
+
+	if (program.stages & EffectStageBit_Noise)
+	{
+		resolve += "\n\t// Noise, EffectNoise\n";
+		AppendFormat(resolve, "\tuint h = (id.x * 0x8da6b343u) ^ (id.y * 0xd8163841u) ^ 0x%08xu;\n", program.noiseSeed);
+		resolve +=
+			"\th ^= h >> 16;\n"
+			"\th *= 0x7feb352du;\n"
+			"\th ^= h >> 15;\n"
+			"\th *= 0x846ca68bu;\n"
+			"\th ^= h >> 16;\n";
+		AppendFormat(resolve, "\trgb = clamp(rgb + ((int)(h %% %uu) - %d), 0, 255);\n", (unsigned)(2 * program.noiseAmplitude + 1),
+					 program.noiseAmplitude);
+	}
+
+	if (program.stages & EffectStageBit_Mask)
+	{
+		// maskValue <= 0 already returned transparent black
+		resolve +=
+			"\n\t// Mask\n"
+			"\talpha = (2 * alpha * (int)(maskValue * 255.0 + 0.5) + 255) / 510;\n";
+	}
+
+	resolve += "\n\tOutputTexture[id.xy] = float4(rgb, alpha) / 255.0;\n";
+	return GenerateBlurKernelHlsl(program.kernel, radius, resolve.c_str());
+}
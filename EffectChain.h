@@ -0,0 +1,105 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "BlurKernels.h"
+#include "CpuBlur.h"
+#include "CpuBlurTiled.h"
+
+// Acrylic material: the blurred backdrop gets a color matrix (saturation), a tint and grain
+// before the mask cuts it out. The chain is described as a list of stages in that order and
+// EffectChainCompile bakes it into an EffectProgram, which runs as one fused kernel: the CPU
+// kernel applies every stage to a tile while the tile's blur output is still in L2, the HLSL
+// applies them in the blur shader's resolve. Either way each pixel leaves the kernel once.
+//
+// Every stage works on 8-bit values with integer math, rounded half-up like the blur. The
+// unfused passes (CpuTiledEffectRunUnfused) are the definition, the fused kernel matches them
+// bit for bit. The HLSL does the same integer math after the float blur, which is within 1 LSB.
+enum EffectStageType
+{
+	EffectStage_Blur,
+	EffectStage_ColorMatrix,
+	EffectStage_Tint,
+	EffectStage_Noise,
+	EffectStage_Mask,
+	EffectStage_Count,
+};
+
+struct EffectStage
+{
+	EffectStageType type;
+	BlurKernelType kernel;	// Blur, the radius comes from BlurConstants
+	float matrix[3][4];		// ColorMatrix, rgb' = matrix * (r, g, b, 1) in 0..1 units
+	float tint[3];			// Tint, rgb in 0..1
+	float tintOpacity;
+	float noiseAmplitude;  // Noise, in 8-bit steps
+	uint32_t noiseSeed;
+};
+
+EffectStage EffectBlurStage(BlurKernelType kernel);
+EffectStage EffectColorMatrixStage(const float matrix[3][4]);
+EffectStage EffectSaturationStage(float saturation);  // 0 gray, 1 unchanged, Rec. 709 luma
+EffectStage EffectTintStage(float r, float g, float b, float opacity);
+EffectStage EffectNoiseStage(float amplitude, uint32_t seed);
+EffectStage EffectMaskStage();
+
+// Blur, saturation 1.4, a 15% tint of `tint` and 2 steps of grain
+std::vector<EffectStage> AcrylicEffectStages(BlurKernelType kernel, const float tint[3]);
+
+// Bit per EffectStageType
+static const uint32_t EffectStageBit_Blur = 1u << EffectStage_Blur;
+static const uint32_t EffectStageBit_ColorMatrix = 1u << EffectStage_ColorMatrix;
+static const uint32_t EffectStageBit_Tint = 1u << EffectStage_Tint;
+static const uint32_t EffectStageBit_Noise = 1u << EffectStage_Noise;
+static const uint32_t EffectStageBit_Mask = 1u << EffectStage_Mask;
+
+// Fixed-point form of a chain, matrix and offset are Q12 in 8-bit units, rgb order
+static const int EffectMatrixShift = 12;
+
+struct EffectProgram
+{
+	uint32_t stages;  // EffectStageBit_*
+	BlurKernelType kernel;
+	int32_t matrix[3][3];
+	int32_t offset[3];
+	int32_t tint[3];
+	int32_t tintOpacity;  // 0..255
+	int32_t noiseAmplitude;
+	uint32_t noiseSeed;
+};
+
+// Stages must come in EffectStageType order, each at most once, starting with the blur and
+// ending with the mask. False with the reason in `error` otherwise.
+bool EffectChainCompile(const std::vector<EffectStage>& stages, EffectProgram& program, std::string* error = nullptr);
+
+// Grain of pixel (x, y), in -amplitude..amplitude. Same integer hash as the HLSL.
+inline int EffectNoise(uint32_t x, uint32_t y, uint32_t seed, int amplitude)
+{
+	uint32_t h = (x * 0x8da6b343u) ^ (y * 0xd8163841u) ^ seed;
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return (int)(h % (uint32_t)(2 * amplitude + 1)) - amplitude;
+}
+
+// The whole chain for the pixels inside `rect`, reads may go anywhere in the image
+void CpuEffectChainRect(const EffectProgram& program, const CpuImage& input, const CpuMask& mask, const CpuImage& output,
+						const BlurConstants& constants, const BlurRect& rect, CpuBlurScratch& scratch);
+
+// Fused, one task per tile of CpuTiledBlur
+void CpuTiledEffectRun(CpuTiledBlur& blur, const EffectProgram& program, const CpuImage& input, const CpuMask& mask,
+					   const CpuImage& output, const BlurConstants& constants);
+
+// The blur, then one full-image pass per stage over `output`, as separate shaders would run
+void CpuTiledEffectRunUnfused(CpuTiledBlur& blur, const EffectProgram& program, const CpuImage& input, const CpuMask& mask,
+							  const CpuImage& output, const BlurConstants& constants);
+
+// Bytes an unfused run moves through memory for `pixels` against the fused kernel's one read and write
+uint64_t EffectChainUnfusedBytes(const EffectProgram& program, uint64_t pixels);
+uint64_t EffectChainFusedBytes(const EffectProgram& program, uint64_t pixels);
+
+// GenerateBlurKernelHlsl with the stages baked into its resolve, drop-in for computeShaderSource
+std::string GenerateEffectChainHlsl(const EffectProgram& program, int radius);
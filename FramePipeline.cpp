@@ -0,0 +1,316 @@
+#include "FramePipeline.h"
+#include "Trace.h"
+
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+// Long enough not to spin, short enough to notice a stop
+static const int64_t StageWaitUs = 2000;
+
+int64_t FramePipelineNowUs()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameMailboxReset(FrameMailbox& mailbox, size_t frameBytes)
+{
+	for (PipelineFrame& slot : mailbox.slots)
+	{
+		slot.pixels.assign(frameBytes, 0);
+		slot.dirtyRects.clear();
+		slot.sequence = 0;
+		slot.captureUs = 0;
+	}
+	mailbox.back = 0;
+	mailbox.middle.store(1);
+	mailbox.front = 2;
+	mailbox.published.store(0);
+	mailbox.dropped.store(0);
+}
+
+bool FrameMailboxPublish(FrameMailbox& mailbox)
+{
+	uint32_t previous = mailbox.middle.exchange(mailbox.back | FrameMailboxFresh, std::memory_order_acq_rel);
+	mailbox.back = previous & (FrameMailboxFresh - 1);
+	mailbox.published.fetch_add(1, std::memory_order_relaxed);
+
+	const bool dropped = (previous & FrameMailboxFresh) != 0;
+	if (dropped)
+		mailbox.dropped.fetch_add(1, std::memory_order_relaxed);
+
+	// Empty critical section, a consumer between its check and its wait can't miss this
+	{
+		std::lock_guard<std::mutex> lock(mailbox.mutex);
+	}
+	mailbox.wake.notify_one();
+	return dropped;
+}
+
+static bool HasFresh(const FrameMailbox& mailbox)
+{
+	return (mailbox.middle.load(std::memory_order_acquire) & FrameMailboxFresh) != 0;
+}
+
+PipelineFrame* FrameMailboxTake(FrameMailbox& mailbox, int64_t timeoutUs)
+{
+	if (!HasFresh(mailbox))
+	{
+		if (timeoutUs <= 0)
+			return nullptr;
+
+		std::unique_lock<std::mutex> lock(mailbox.mutex);
+		if (!mailbox.wake.wait_for(lock, std::chrono::microseconds(timeoutUs), [&] { return HasFresh(mailbox); }))
+			return nullptr;
+	}
+
+	// Only the consumer clears the fresh bit, so what it swaps out is still the newest frame
+	uint32_t previous = mailbox.middle.exchange(mailbox.front, std::memory_order_acq_rel);
+	mailbox.front = previous & (FrameMailboxFresh - 1);
+	return &mailbox.slots[mailbox.front];
+}
+
+void FrameMailboxNotify(FrameMailbox& mailbox)
+{
+	{
+		std::lock_guard<std::mutex> lock(mailbox.mutex);
+	}
+	mailbox.wake.notify_all();
+}
+
+static void AddBusy(FramePipeline& pipeline, PipelineStage stage, int64_t startUs)
+{
+	pipeline.stages[stage].busyUs.fetch_add(FramePipelineNowUs() - startUs, std::memory_order_relaxed);
+	pipeline.stages[stage].frames.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Window-sized copy of the frame, the parts of the window off the frame keep what they had
+static void CopyWindow(const FramePipeline& pipeline, const Frame& frame, uint8_t* pixels)
+{
+	const BlurRect& window = pipeline.window;
+	const int windowWidth = window.right - window.left;
+	const int left = std::max(window.left, 0), right = std::min(window.right, frame.width);
+	const int top = std::max(window.top, 0), bottom = std::min(window.bottom, frame.height);
+
+	for (int y = top; y < bottom && left < right; ++y)
+	{
+		const uint8_t* source = frame.pixels + (size_t)y * frame.rowPitch + (size_t)left * 4;
+		memcpy(pixels + ((size_t)(y - window.top) * windowWidth + (left - window.left)) * 4, source, (size_t)(right - left) * 4);
+	}
+}
+
+static void CaptureStage(FramePipeline& pipeline)
+{
+	Frame frame;
+	uint64_t sequence = 0;
+	std::vector<BlurRect> unseen;  // Rects of published frames the blur may not have taken yet
+	std::vector<BlurRect> fresh;   // Rects since the last publish
+	while (!pipeline.stopping.load(std::memory_order_relaxed))
+	{
+		const int64_t startUs = FramePipelineNowUs();
+		FrameSourceResult result;
+		{
+			TRACE_ZONE("Acquire");
+			result = pipeline.source->AcquireFrame(1, frame);
+		}
+		if (result == FrameSource_End)
+			break;
+
+		if (result == FrameSource_Lost)
+			fresh.push_back(pipeline.window);
+		if (result != FrameSource_Ok)
+			continue;
+
+		++sequence;
+		fresh.insert(fresh.end(), frame.dirtyRects.begin(), frame.dirtyRects.end());
+		for (const DirtyMove& move : frame.moves)
+			fresh.push_back(move.destination);
+		if (fresh.size() > (size_t)DirtyRegionMaxRects * 4)
+			DirtyRegionMerge(fresh);
+
+		// Its changes come with the next frame that has pixels
+		if (!frame.pixels)
+		{
+			pipeline.source->ReleaseFrame();
+			continue;
+		}
+
+		PipelineFrame& back = FrameMailboxBack(pipeline.captured);
+		{
+			TRACE_ZONE("Capture");
+			CopyWindow(pipeline, frame, back.pixels.data());
+			unseen.insert(unseen.end(), fresh.begin(), fresh.end());
+			if (unseen.size() > (size_t)DirtyRegionMaxRects * 4)
+				DirtyRegionMerge(unseen);
+			back.dirtyRects = unseen;
+			back.sequence = sequence;
+			back.captureUs = startUs;
+			pipeline.source->ReleaseFrame();
+		}
+
+		// Replacing a frame the blur never took drops it, this one already has its rects and
+		// they stay unseen. Otherwise the blur took the last frame and only this one's are new.
+		if (!FrameMailboxPublish(pipeline.captured))
+			unseen.swap(fresh);
+		fresh.clear();
+		AddBusy(pipeline, PipelineStage_Capture, startUs);
+	}
+
+	pipeline.captureDone.store(true);
+	FrameMailboxNotify(pipeline.captured);
+}
+
+static void BlurStage(FramePipeline& pipeline)
+{
+	const int windowWidth = pipeline.window.right - pipeline.window.left;
+	const int windowHeight = pipeline.window.bottom - pipeline.window.top;
+	const BlurConstants constants = { (uint32_t)windowWidth, (uint32_t)windowHeight, pipeline.radius, 0.0f };
+
+	while (!pipeline.stopping.load(std::memory_order_relaxed))
+	{
+		const bool lastChance = pipeline.captureDone.load();
+		PipelineFrame* frame = FrameMailboxTake(pipeline.captured, lastChance ? 0 : StageWaitUs);
+		if (!frame)
+		{
+			if (lastChance) break;
+			continue;
+		}
+
+		const int64_t startUs = FramePipelineNowUs();
+		DirtyRegionAddFrame(pipeline.tracker, frame->dirtyRects.data(), (int)frame->dirtyRects.size(), nullptr, 0);
+		if (DirtyRegionBuild(pipeline.tracker, pipeline.window, (int)pipeline.radius, pipeline.region))
+		{
+			{
+				TRACE_ZONE("Blur");
+				CpuImage input = { frame->pixels.data(), windowWidth * 4 };
+				CpuImage output = { pipeline.blurred.data(), windowWidth * 4 };
+				if (pipeline.region.full)
+					CpuTiledBlurRun(pipeline.blur, input, pipeline.mask, output, constants, pipeline.kernel);
+				else
+					CpuIncrementalBlur(input, pipeline.mask, output, constants, pipeline.region, pipeline.blur.scratch[0], pipeline.kernel);
+			}
+
+			PipelineFrame& back = FrameMailboxBack(pipeline.processed);
+			memcpy(back.pixels.data(), pipeline.blurred.data(), pipeline.blurred.size());
+			back.sequence = frame->sequence;
+			back.captureUs = frame->captureUs;
+			FrameMailboxPublish(pipeline.processed);
+		}
+		AddBusy(pipeline, PipelineStage_Blur, startUs);
+	}
+
+	pipeline.blurDone.store(true);
+	FrameMailboxNotify(pipeline.processed);
+}
+
+static void PresentStage(FramePipeline& pipeline)
+{
+	while (!pipeline.stopping.load(std::memory_order_relaxed))
+	{
+		const bool lastChance = pipeline.blurDone.load();
+		PipelineFrame* frame = FrameMailboxTake(pipeline.processed, lastChance ? 0 : StageWaitUs);
+		if (!frame)
+		{
+			if (lastChance) break;
+			continue;
+		}
+
+		const int64_t startUs = FramePipelineNowUs();
+		{
+			TRACE_ZONE("Present");
+			memcpy(pipeline.screen.data(), frame->pixels.data(), pipeline.screen.size());
+		}
+
+		// Only this thread writes the latencies
+		const int64_t latencyUs = FramePipelineNowUs() - frame->captureUs;
+		pipeline.latencySumUs.fetch_add(latencyUs, std::memory_order_relaxed);
+		if (latencyUs > pipeline.latencyMaxUs.load(std::memory_order_relaxed))
+			pipeline.latencyMaxUs.store(latencyUs, std::memory_order_relaxed);
+		AddBusy(pipeline, PipelineStage_Present, startUs);
+
+		if (pipeline.presentHook)
+			pipeline.presentHook(*frame);
+
+		// Waiting for the vertical blank, not work
+		if (pipeline.presentIntervalUs > 0)
+		{
+			const int64_t now = FramePipelineNowUs();
+			const int64_t next = (now / pipeline.presentIntervalUs + 1) * pipeline.presentIntervalUs;
+			std::this_thread::sleep_for(std::chrono::microseconds(next - now));
+		}
+	}
+}
+
+void FramePipelineStart(FramePipeline& pipeline, FrameSource& source, const BlurRect& window, float radius,
+						BlurKernelType kernel, int blurThreads, int64_t presentIntervalUs)
+{
+	pipeline.source = &source;
+	pipeline.window = window;
+	pipeline.radius = radius;
+	pipeline.kernel = kernel;
+	pipeline.mask = {};
+	pipeline.presentIntervalUs = presentIntervalUs;
+
+	CpuTiledBlurStart(pipeline.blur, blurThreads);
+	DirtyRegionReset(pipeline.tracker);
+
+	const size_t bytes = (size_t)(window.right - window.left) * (window.bottom - window.top) * 4;
+	pipeline.blurred.assign(bytes, 0);
+	pipeline.screen.assign(bytes, 0);
+	FrameMailboxReset(pipeline.captured, bytes);
+	FrameMailboxReset(pipeline.processed, bytes);
+
+	pipeline.stopping.store(false);
+	pipeline.captureDone.store(false);
+	pipeline.blurDone.store(false);
+	for (PipelineStageStats& stage : pipeline.stages)
+	{
+		stage.frames.store(0);
+		stage.busyUs.store(0);
+	}
+	pipeline.latencySumUs.store(0);
+	pipeline.latencyMaxUs.store(0);
+	pipeline.startUs = FramePipelineNowUs();
+	pipeline.stopUs = 0;
+
+	pipeline.threads[PipelineStage_Capture] = std::thread(CaptureStage, std::ref(pipeline));
+	pipeline.threads[PipelineStage_Blur] = std::thread(BlurStage, std::ref(pipeline));
+	pipeline.threads[PipelineStage_Present] = std::thread(PresentStage, std::ref(pipeline));
+}
+
+static void JoinStages(FramePipeline& pipeline)
+{
+	bool joined = false;
+	for (std::thread& thread : pipeline.threads)
+	{
+		if (thread.joinable())
+		{
+			thread.join();
+			joined = true;
+		}
+	}
+	if (joined)
+		pipeline.stopUs = FramePipelineNowUs();
+}
+
+void FramePipelineWait(FramePipeline& pipeline)
+{
+	JoinStages(pipeline);
+}
+
+void FramePipelineStop(FramePipeline& pipeline)
+{
+	pipeline.stopping.store(true);
+	FrameMailboxNotify(pipeline.captured);
+	FrameMailboxNotify(pipeline.processed);
+	JoinStages(pipeline);
+	CpuTiledBlurStop(pipeline.blur);
+}
+
+double FramePipelineOccupancy(const FramePipeline& pipeline, PipelineStage stage)
+{
+	const int64_t endUs = pipeline.stopUs ? pipeline.stopUs : FramePipelineNowUs();
+	const int64_t wallUs = std::max<int64_t>(1, endUs - pipeline.startUs);
+	return (double)pipeline.stages[stage].busyUs.load() / wallUs;
+}
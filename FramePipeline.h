@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BlurKernels.h"
+#include "CpuBlurTiled.h"
+#include "DirtyRegion.h"
+#include "FrameSource.h"
+
+// BlurPipeline with capture, blur and present each on their own thread, so a frame takes
+// as long as the slowest stage instead of all of them. Neighbouring stages share a
+// FrameMailbox: three pooled buffers rotated by one atomic exchange. Neither side waits for
+// the other and the consumer always gets the newest frame. A frame the producer replaces
+// before the consumer took it is dropped and counted.
+struct PipelineFrame
+{
+	std::vector<uint8_t> pixels;	   // Window-sized BGRA
+	std::vector<BlurRect> dirtyRects;  // Desktop coordinates, everything since the consumer's last take
+	uint64_t sequence;				   // Source frame number
+	int64_t captureUs;				   // When the capture stage acquired it
+};
+
+// The slot index in the low bits of FrameMailbox::middle, this bit when it wasn't taken yet
+static const uint32_t FrameMailboxFresh = 4;
+
+struct FrameMailbox
+{
+	PipelineFrame slots[3];
+	std::atomic<uint32_t> middle;
+	uint32_t back;	 // Producer's slot
+	uint32_t front;	 // Consumer's slot
+
+	std::atomic<uint64_t> published;
+	std::atomic<uint64_t> dropped;
+
+	// Only for sleeping consumers, the frames themselves never go through the lock
+	std::mutex mutex;
+	std::condition_variable wake;
+};
+
+void FrameMailboxReset(FrameMailbox& mailbox, size_t frameBytes);
+
+// Producer side: fill FrameMailboxBack, then publish it. Returns true when it replaced a
+// frame the consumer never took; the back slot is then that frame.
+inline PipelineFrame& FrameMailboxBack(FrameMailbox& mailbox)
+{
+	return mailbox.slots[mailbox.back];
+}
+bool FrameMailboxPublish(FrameMailbox& mailbox);
+
+// Consumer side: the newest published frame, nullptr when nothing new came since the last
+// take. Valid until the next take. Waits up to timeoutUs for one (0 doesn't wait).
+PipelineFrame* FrameMailboxTake(FrameMailbox& mailbox, int64_t timeoutUs = 0);
+
+// Wakes a consumer waiting in FrameMailboxTake, e.g. to stop it
+void FrameMailboxNotify(FrameMailbox& mailbox);
+
+enum PipelineStage
+{
+	PipelineStage_Capture,
+	PipelineStage_Blur,
+	PipelineStage_Present,
+	PipelineStage_Count,
+};
+
+struct PipelineStageStats
+{
+	std::atomic<uint64_t> frames;	// Frames the stage finished
+	std::atomic<int64_t> busyUs;	// Time spent working rather than waiting
+};
+
+struct FramePipeline
+{
+	FrameSource* source;
+	BlurRect window;  // Desktop coordinates
+	float radius;
+	BlurKernelType kernel;
+	CpuMask mask;
+	int64_t presentIntervalUs;	// Present blocks until the next multiple of this, 0 doesn't
+
+	// Called on the present thread with each frame it showed, set before FramePipelineStart
+	std::function<void(const PipelineFrame& frame)> presentHook;
+
+	CpuTiledBlur blur;
+	DirtyRegionTracker tracker;
+	DirtyRegion region;
+	std::vector<uint8_t> blurred;  // The blur stage's own output, incremental blurs need the last one
+	std::vector<uint8_t> screen;   // What the present stage showed last
+
+	FrameMailbox captured;	// Capture -> blur
+	FrameMailbox processed;	// Blur -> present
+
+	std::thread threads[PipelineStage_Count];
+	std::atomic<bool> stopping;
+	std::atomic<bool> captureDone;	// The source ran out
+	std::atomic<bool> blurDone;
+
+	int64_t startUs;
+	int64_t stopUs;
+	PipelineStageStats stages[PipelineStage_Count];
+	std::atomic<int64_t> latencySumUs;	// Capture to present, over the presented frames
+	std::atomic<int64_t> latencyMaxUs;
+};
+
+int64_t FramePipelineNowUs();
+
+// Starts the three threads, the blur splits its work across blurThreads (0 uses every core)
+void FramePipelineStart(FramePipeline& pipeline, FrameSource& source, const BlurRect& window, float radius,
+						BlurKernelType kernel = BlurKernel_Box, int blurThreads = 0, int64_t presentIntervalUs = 0);
+
+// Waits until the source ran out and its last frame was presented
+void FramePipelineWait(FramePipeline& pipeline);
+
+// Stops the threads without waiting for the source, fine after FramePipelineWait
+void FramePipelineStop(FramePipeline& pipeline);
+
+// Busy share of the stage's time between start and stop (or now)
+double FramePipelineOccupancy(const FramePipeline& pipeline, PipelineStage stage);
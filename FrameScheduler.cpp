@@ -0,0 +1,109 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+
+static int64_t FrameIntervalUs(const FrameSchedulerConfig& config)
+{
+	return config.maxFps > 0 ? 1000000 / config.maxFps : 0;
+}
+
+// Earliest time the pending events may be served
+static int64_t FrameDueUs(const FrameScheduler& scheduler, int64_t nowUs)
+{
+	if (!scheduler.framed)
+		return nowUs;
+	return std::max(nowUs, scheduler.lastFrameUs + FrameIntervalUs(scheduler.config));
+}
+
+void FrameSchedulerReset(FrameScheduler& scheduler, const FrameSchedulerConfig& config, int64_t nowUs)
+{
+	scheduler = {};
+	scheduler.config = config;
+	scheduler.config.latencyTargetUs = std::max<int64_t>(config.latencyTargetUs, 1000);
+	scheduler.config.occludedCheckUs = std::max<int64_t>(config.occludedCheckUs, scheduler.config.latencyTargetUs);
+	scheduler.nextPollUs = nowUs;
+	scheduler.deadlineUs = -1;
+}
+
+void FrameSchedulerPost(FrameScheduler& scheduler, uint32_t events)
+{
+	if (scheduler.pending && events)
+		++scheduler.coalescedEvents;
+	scheduler.pending |= events;
+}
+
+void FrameSchedulerSetDeadline(FrameScheduler& scheduler, int64_t atUs)
+{
+	scheduler.deadlineUs = atUs;
+}
+
+void FrameSchedulerSetOccluded(FrameScheduler& scheduler, bool occluded, int64_t nowUs)
+{
+	if (occluded == scheduler.occluded)
+		return;
+
+	// Showing again, the desktop behind it may have changed meanwhile
+	scheduler.occluded = occluded;
+	scheduler.nextPollUs = occluded ? nowUs + scheduler.config.occludedCheckUs : nowUs;
+}
+
+int64_t FrameSchedulerTimeout(const FrameScheduler& scheduler, int64_t nowUs)
+{
+	int64_t wakeUs = scheduler.nextPollUs;
+	if (scheduler.deadlineUs >= 0)
+		wakeUs = std::min(wakeUs, scheduler.deadlineUs);
+	if (scheduler.pending && !scheduler.occluded)
+		wakeUs = std::min(wakeUs, FrameDueUs(scheduler, nowUs));
+	return std::max<int64_t>(0, wakeUs - nowUs);
+}
+
+uint32_t FrameSchedulerWake(FrameScheduler& scheduler, int64_t nowUs)
+{
+	++scheduler.wakes;
+
+	if (scheduler.deadlineUs >= 0 && nowUs >= scheduler.deadlineUs)
+	{
+		FrameSchedulerPost(scheduler, FrameEvent_Deadline);
+		scheduler.deadlineUs = -1;
+	}
+
+	if (scheduler.occluded)
+	{
+		if (nowUs < scheduler.nextPollUs)
+			return 0;
+		++scheduler.occludedChecks;
+		scheduler.nextPollUs = nowUs + scheduler.config.occludedCheckUs;
+		return FrameWork_CheckOccluded;
+	}
+
+	const bool frameDue = scheduler.pending && FrameDueUs(scheduler, nowUs) <= nowUs;
+	if (nowUs < scheduler.nextPollUs && !frameDue)
+		return 0;
+
+	// A frame polled before the next one may start would only wait for it
+	++scheduler.polls;
+	scheduler.nextPollUs = std::max(nowUs + scheduler.config.latencyTargetUs, FrameDueUs(scheduler, nowUs));
+	return FrameWork_Poll;
+}
+
+uint32_t FrameSchedulerBeginFrame(FrameScheduler& scheduler, int64_t nowUs)
+{
+	if (scheduler.occluded || !scheduler.pending || FrameDueUs(scheduler, nowUs) > nowUs)
+		return 0;
+
+	uint32_t events = scheduler.pending;
+	scheduler.pending = 0;
+	scheduler.lastFrameUs = nowUs;
+	scheduler.framed = true;
+	scheduler.nextPollUs = std::max(scheduler.nextPollUs, nowUs + FrameIntervalUs(scheduler.config));
+	++scheduler.frames;
+	return events;
+}
+
+void FrameSchedulerEndFrame(FrameScheduler& scheduler, bool presented)
+{
+	if (presented)
+		++scheduler.presents;
+	else
+		++scheduler.skippedPresents;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+// Decides when the render loop wakes up and whether it has work. The platform side sleeps
+// for FrameSchedulerTimeout or until a message arrives, reports what happened as events and
+// runs a frame when FrameSchedulerBeginFrame hands it some. Events that arrive between two
+// frames are merged into one. Time is passed in as microseconds from any clock, so the same
+// logic runs against a simulated clock in BackdropFilterBench.
+enum FrameEvent
+{
+	FrameEvent_NewFrame = 1 << 0,		// The desktop source delivered a frame
+	FrameEvent_WindowChanged = 1 << 1,	// Moved or resized
+	FrameEvent_Parameters = 1 << 2,		// Mask, radius or mode changed
+	FrameEvent_Deadline = 1 << 3,		// The deadline from FrameSchedulerSetDeadline passed
+};
+
+// What a wake asks the caller to do before FrameSchedulerBeginFrame
+enum FrameWork
+{
+	FrameWork_Poll = 1 << 0,		   // Poll the desktop source, it can't signal new frames by itself
+	FrameWork_CheckOccluded = 1 << 1,  // Check whether the window still is occluded, e.g. with a test Present
+};
+
+struct FrameSchedulerConfig
+{
+	int maxFps;				  // Frames start at least 1/maxFps apart, 0 is uncapped
+	int64_t latencyTargetUs;  // Longest a desktop frame goes unpolled, unless the FPS cap holds it anyway
+	int64_t occludedCheckUs;  // While occluded, how often to check whether the window shows again
+};
+
+static const FrameSchedulerConfig FrameSchedulerDefaults = { 60, 16000, 250000 };
+
+struct FrameScheduler
+{
+	FrameSchedulerConfig config;
+	uint32_t pending;	  // FrameEvent bits not served yet
+	int64_t lastFrameUs;  // Start of the last frame
+	bool framed;		  // lastFrameUs is set
+	int64_t nextPollUs;
+	int64_t deadlineUs;	  // -1 when none
+	bool occluded;		  // Nothing of the window shows, frames wait until it does
+
+	uint64_t wakes;
+	uint64_t polls;
+	uint64_t frames;
+	uint64_t presents;
+	uint64_t skippedPresents;  // Frames that changed nothing on screen
+	uint64_t coalescedEvents;  // Posts merged into a frame that was already pending
+	uint64_t occludedChecks;
+};
+
+void FrameSchedulerReset(FrameScheduler& scheduler, const FrameSchedulerConfig& config, int64_t nowUs);
+
+void FrameSchedulerPost(FrameScheduler& scheduler, uint32_t events);
+
+// Wakes the loop at `atUs` with FrameEvent_Deadline, replaces an earlier deadline
+void FrameSchedulerSetDeadline(FrameScheduler& scheduler, int64_t atUs);
+
+// Minimized, or Present reported DXGI_STATUS_OCCLUDED. Until the window shows again no frame
+// starts and the source isn't polled, the loop only wakes every occludedCheckUs to check.
+// Events keep pending and are served once it shows.
+void FrameSchedulerSetOccluded(FrameScheduler& scheduler, bool occluded, int64_t nowUs);
+
+// Microseconds the caller may sleep before the next wake, 0 when work is due now
+int64_t FrameSchedulerTimeout(const FrameScheduler& scheduler, int64_t nowUs);
+
+// Counts a wake and returns FrameWork bits. The source is polled when the latency target
+// says so and right before a frame, so the frame sees the newest pixels.
+uint32_t FrameSchedulerWake(FrameScheduler& scheduler, int64_t nowUs);
+
+// The pending events if a frame may start now, 0 otherwise. They count as served.
+uint32_t FrameSchedulerBeginFrame(FrameScheduler& scheduler, int64_t nowUs);
+
+// `presented` is false when the frame found nothing on screen to change
+void FrameSchedulerEndFrame(FrameScheduler& scheduler, bool presented);
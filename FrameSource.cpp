@@ -0,0 +1,299 @@
+#include "FrameSource.h"
+#include "CaptureRecording.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+// 60 Hz, like a duplication without missed frames
+static const int64_t FrameIntervalMicroseconds = 16667;
+
+static const int TextLineHeight = 20;
+static const int TextGlyphWidth = 8;
+static const int TextGlyphHeight = 12;
+static const int TextScrollStep = 3;
+
+static uint32_t Hash(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+static inline void WritePixel(uint8_t* pixel, uint8_t b, uint8_t g, uint8_t r)
+{
+	pixel[0] = b;
+	pixel[1] = g;
+	pixel[2] = r;
+	pixel[3] = 255;
+}
+
+// Wallpaper gradient behind everything
+static void FillDesktop(std::vector<uint8_t>& pixels, int width, int height)
+{
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			uint8_t* pixel = &pixels[((size_t)y * width + x) * 4];
+			WritePixel(pixel, (uint8_t)(x * 255 / std::max(1, width - 1)), (uint8_t)(y * 255 / std::max(1, height - 1)), 96);
+		}
+	}
+}
+
+// One row of an endless document: dark pseudo-glyphs on white paper, words of up to
+// five glyphs and ragged line ends
+static void WriteTextRow(uint8_t* row, int documentY, int left, int right)
+{
+	const uint32_t line = (uint32_t)documentY / TextLineHeight;
+	const int glyphRow = documentY % TextLineHeight - (TextLineHeight - TextGlyphHeight) / 2;
+	const int columns = (right - left) / TextGlyphWidth;
+	const int lineLength = columns / 2 + (int)(Hash(line) % (uint32_t)std::max(1, columns / 2));
+
+	for (int x = left; x < right; ++x)
+	{
+		uint8_t value = 250;
+		int column = (x - left) / TextGlyphWidth;
+		if (glyphRow >= 0 && glyphRow < TextGlyphHeight && column < lineLength)
+		{
+			bool space = column % 6 == 5 || (Hash(line * 977u + column / 6) & 7) == 0;
+			uint32_t bits = Hash(line * 131071u + column * 8191u + glyphRow * 8u + (x - left) % TextGlyphWidth);
+			if (!space && (bits & 3) == 0)
+				value = 30;
+		}
+		WritePixel(row + (size_t)x * 4, value, value, value);
+	}
+}
+
+struct SyntheticFrameSource : FrameSource
+{
+	SyntheticFrameKind kind;
+	int width;
+	int height;
+	int frameCount;
+	int frameIndex;
+	int scrollOffset;
+	std::vector<uint8_t> pixels;
+
+	FrameSourceResult AcquireFrame(int timeoutMs, Frame& frame) override;
+	void ReleaseFrame() override {}
+};
+
+static BlurRect DocumentRect(int width, int height)
+{
+	return { width / 8, 0, width - width / 8, height };
+}
+
+static BlurRect VideoRect(int width, int height)
+{
+	return { width / 4, height / 4, width / 4 + width / 2, height / 4 + height / 2 };
+}
+
+FrameSourceResult SyntheticFrameSource::AcquireFrame(int timeoutMs, Frame& frame)
+{
+	if (frameCount > 0 && frameIndex >= frameCount)
+		return FrameSource_End;
+
+	const int rowPitch = width * 4;
+	frame.dirtyRects.clear();
+	frame.moves.clear();
+	frame.pointerOnly = false;
+
+	if (frameIndex == 0)
+	{
+		FillDesktop(pixels, width, height);
+		if (kind == SyntheticFrame_ScrollingText)
+		{
+			BlurRect document = DocumentRect(width, height);
+			for (int y = document.top; y < document.bottom; ++y)
+				WriteTextRow(&pixels[(size_t)y * rowPitch], y, document.left, document.right);
+		}
+		frame.dirtyRects.push_back({ 0, 0, width, height });
+	}
+	else if (kind == SyntheticFrame_ScrollingText)
+	{
+		// The old rows move up like a scrolled window, only the exposed strip is new
+		BlurRect document = DocumentRect(width, height);
+		int step = std::min(TextScrollStep, height);
+		scrollOffset += step;
+
+		size_t bytes = (size_t)(document.right - document.left) * 4;
+		for (int y = 0; y + step < height; ++y)
+			memmove(&pixels[(size_t)y * rowPitch + document.left * 4], &pixels[(size_t)(y + step) * rowPitch + document.left * 4], bytes);
+		for (int y = height - step; y < height; ++y)
+			WriteTextRow(&pixels[(size_t)y * rowPitch], scrollOffset + y, document.left, document.right);
+
+		if (height > step)
+			frame.moves.push_back({ document.left, step, { document.left, 0, document.right, height - step } });
+		frame.dirtyRects.push_back({ document.left, height - step, document.right, height });
+	}
+	else if (kind == SyntheticFrame_Noise)
+	{
+		// 4x4 blocks like a decoded video frame, all of it changes every frame
+		BlurRect video = VideoRect(width, height);
+		for (int y = video.top; y < video.bottom; ++y)
+		{
+			for (int x = video.left; x < video.right; ++x)
+			{
+				uint32_t block = Hash((uint32_t)frameIndex * 2654435761u + (uint32_t)(y / 4) * 40503u + (uint32_t)(x / 4));
+				WritePixel(&pixels[(size_t)y * rowPitch + x * 4], (uint8_t)block, (uint8_t)(block >> 8), (uint8_t)(block >> 16));
+			}
+		}
+		frame.dirtyRects.push_back(video);
+	}
+	else
+	{
+		frame.pointerOnly = true;
+	}
+
+	frame.width = width;
+	frame.height = height;
+	frame.pixels = pixels.data();
+	frame.rowPitch = rowPitch;
+	frame.timestamp = frameIndex * FrameIntervalMicroseconds;
+	++frameIndex;
+	return FrameSource_Ok;
+}
+
+FrameSource* CreateSyntheticFrameSource(SyntheticFrameKind kind, int width, int height, int frameCount)
+{
+	if (width <= 0 || height <= 0)
+		return nullptr;
+
+	SyntheticFrameSource* source = new SyntheticFrameSource();
+	source->kind = kind;
+	source->width = width;
+	source->height = height;
+	source->frameCount = frameCount;
+	source->frameIndex = 0;
+	source->scrollOffset = 0;
+	source->pixels.resize((size_t)width * height * 4);
+	return source;
+}
+
+struct ReplayFrameSource : FrameSource
+{
+	std::string pathPattern;
+	int width;
+	int height;
+	bool loop;
+	int frameIndex;
+	bool hasPrevious;
+	std::vector<uint8_t> pixels;
+	std::vector<uint8_t> previous;
+
+	FrameSourceResult AcquireFrame(int timeoutMs, Frame& frame) override;
+	void ReleaseFrame() override {}
+};
+
+static bool ReadReplayFrame(const std::string& pathPattern, int index, std::vector<uint8_t>& pixels)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), pathPattern.c_str(), index);
+
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	size_t read = fread(pixels.data(), 1, pixels.size(), file);
+	fclose(file);
+	return read == pixels.size();
+}
+
+FrameSourceResult ReplayFrameSource::AcquireFrame(int timeoutMs, Frame& frame)
+{
+	pixels.swap(previous);
+	if (!ReadReplayFrame(pathPattern, frameIndex, pixels))
+	{
+		if (!loop || frameIndex == 0 || !ReadReplayFrame(pathPattern, 0, pixels))
+		{
+			pixels.swap(previous);
+			return FrameSource_End;
+		}
+		frameIndex = 0;
+	}
+
+	frame.dirtyRects.clear();
+	frame.moves.clear();
+
+	const int rowPitch = width * 4;
+	if (!hasPrevious)
+	{
+		frame.dirtyRects.push_back({ 0, 0, width, height });
+	}
+	else
+	{
+		for (int top = 0; top < height; top += FrameSourceReplayTile)
+		{
+			for (int left = 0; left < width; left += FrameSourceReplayTile)
+			{
+				BlurRect tile = { left, top, std::min(left + FrameSourceReplayTile, width), std::min(top + FrameSourceReplayTile, height) };
+				size_t offset = (size_t)tile.left * 4;
+				size_t bytes = (size_t)(tile.right - tile.left) * 4;
+				for (int y = tile.top; y < tile.bottom; ++y)
+				{
+					if (memcmp(&pixels[(size_t)y * rowPitch + offset], &previous[(size_t)y * rowPitch + offset], bytes) != 0)
+					{
+						frame.dirtyRects.push_back(tile);
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	frame.width = width;
+	frame.height = height;
+	frame.pixels = pixels.data();
+	frame.rowPitch = rowPitch;
+	frame.timestamp = frameIndex * FrameIntervalMicroseconds;
+	frame.pointerOnly = frame.dirtyRects.empty();
+	hasPrevious = true;
+	++frameIndex;
+	return FrameSource_Ok;
+}
+
+FrameSource* CreateReplayFrameSource(const char* pathPattern, int width, int height, bool loop)
+{
+	if (!pathPattern || width <= 0 || height <= 0)
+		return nullptr;
+
+	ReplayFrameSource* source = new ReplayFrameSource();
+	source->pathPattern = pathPattern;
+	source->width = width;
+	source->height = height;
+	source->loop = loop;
+	source->frameIndex = 0;
+	source->hasPrevious = false;
+	source->pixels.resize((size_t)width * height * 4);
+	source->previous.resize((size_t)width * height * 4);
+
+	if (!ReadReplayFrame(source->pathPattern, 0, source->pixels))
+	{
+		delete source;
+		return nullptr;
+	}
+	return source;
+}
+
+FrameSource* CreateFrameSource(const char* spec, int width, int height, int frameCount)
+{
+	if (!spec)
+		return nullptr;
+
+	if (!strcmp(spec, "synthetic:text"))
+		return CreateSyntheticFrameSource(SyntheticFrame_ScrollingText, width, height, frameCount);
+	if (!strcmp(spec, "synthetic:noise"))
+		return CreateSyntheticFrameSource(SyntheticFrame_Noise, width, height, frameCount);
+	if (!strcmp(spec, "synthetic:static"))
+		return CreateSyntheticFrameSource(SyntheticFrame_Static, width, height, frameCount);
+	if (!strncmp(spec, "replay:", 7))
+		return CreateReplayFrameSource(spec + 7, width, height, frameCount == 0);
+	if (!strncmp(spec, "recording:", 10))
+		return CreateRecordingFrameSource(spec + 10, frameCount == 0);
+	return nullptr;
+}
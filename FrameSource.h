@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "CpuBlur.h"
+#include "DirtyRegion.h"
+
+// Where desktop frames come from. The DXGI duplication is one implementation (FrameSourceDxgi.h),
+// the synthetic and replay sources below run anywhere so the blur pipeline can be profiled
+// and regression tested without a live Windows desktop.
+enum FrameSourceResult
+{
+	FrameSource_Ok,
+	FrameSource_Timeout,  // No new frame within the timeout
+	FrameSource_Lost,	  // The source was recreated, the next frame is a full one
+	FrameSource_End,	  // Replay ran out of frames
+};
+
+// One acquired frame, rects in desktop coordinates like DXGI reports them
+struct Frame
+{
+	int width;
+	int height;
+	const uint8_t* pixels;	// BGRA, nullptr when the frame only lives on the GPU
+	int rowPitch;
+	int64_t timestamp;	  // Microseconds
+	bool pointerOnly;	  // Only the mouse moved, the pixels did not change
+	std::vector<BlurRect> dirtyRects;
+	std::vector<DirtyMove> moves;
+};
+
+struct FrameSource
+{
+	virtual ~FrameSource() {}
+
+	// The frame stays valid until ReleaseFrame, every Ok result needs one
+	virtual FrameSourceResult AcquireFrame(int timeoutMs, Frame& frame) = 0;
+	virtual void ReleaseFrame() = 0;
+};
+
+enum SyntheticFrameKind
+{
+	SyntheticFrame_ScrollingText,  // A document scrolling up: one move rect and a new strip per frame
+	SyntheticFrame_Noise,		   // A video-sized rect of fresh noise per frame
+	SyntheticFrame_Static,		   // Nothing but the pointer moves after the first frame
+};
+
+// frameCount 0 runs forever
+FrameSource* CreateSyntheticFrameSource(SyntheticFrameKind kind, int width, int height, int frameCount = 0);
+
+// Tightly packed width * height BGRA files named by a printf pattern, e.g. "capture/%05d.bgra",
+// numbered from 0. Dirty rects come from diffing consecutive frames in FrameSourceReplayTile tiles.
+static const int FrameSourceReplayTile = 64;
+FrameSource* CreateReplayFrameSource(const char* pathPattern, int width, int height, bool loop = false);
+
+// "synthetic:text", "synthetic:noise", "synthetic:static", "replay:<pattern>" or "recording:<path>"
+// (CaptureRecording.h, which brings its own size), nullptr for anything else or when the replay
+// has no first frame. Replays and recordings loop when frameCount is 0, else play once.
+FrameSource* CreateFrameSource(const char* spec, int width, int height, int frameCount = 0);
+
+inline void DirtyRegionAddFrame(DirtyRegionTracker& tracker, const Frame& frame)
+{
+	DirtyRegionAddFrame(tracker, frame.dirtyRects.data(), (int)frame.dirtyRects.size(),
+						frame.moves.data(), (int)frame.moves.size());
+}
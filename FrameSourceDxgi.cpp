@@ -0,0 +1,273 @@
+#include "FrameSourceDxgi.h"
+
+static bool DuplicateOutput(DxgiFrameSource& source)
+{
+	// @Important -- get the 'IDXGIOutputDuplication' which allows capturing of desktop
+
+	// Get DXGI adapter from our D3D11 device
+	IDXGIDevice* dxgiDevice = nullptr;
+	source.device->QueryInterface(__uuidof(IDXGIDevice), (void**)&dxgiDevice);
+
+	IDXGIAdapter* dxgiAdapter = nullptr;
+	dxgiDevice->GetAdapter(&dxgiAdapter);
+
+	// Get the output (monitor), a WARP device has none
+	IDXGIOutput* dxgiOutput = nullptr;
+	if (FAILED(dxgiAdapter->EnumOutputs(source.outputIndex, &dxgiOutput)))
+	{
+		dxgiAdapter->Release();
+		dxgiDevice->Release();
+		return false;
+	}
+
+	// Where it sits on the desktop, left of or above the primary output is negative
+	DXGI_OUTPUT_DESC outputDesc;
+	dxgiOutput->GetDesc(&outputDesc);
+	const RECT& bounds = outputDesc.DesktopCoordinates;
+	source.output.bounds = { bounds.left, bounds.top, bounds.right, bounds.bottom };
+
+	IDXGIOutput1* dxgiOutput1 = nullptr;
+	dxgiOutput->QueryInterface(__uuidof(IDXGIOutput1), (void**)&dxgiOutput1);
+
+	// Create desktop duplication, a new one starts without history
+	HRESULT hr = dxgiOutput1->DuplicateOutput(source.device, &source.duplication);
+	source.stagingValid = false;
+
+	// Cleanup
+	dxgiOutput1->Release();
+	dxgiOutput->Release();
+	dxgiAdapter->Release();
+	dxgiDevice->Release();
+
+	return SUCCEEDED(hr);
+}
+
+bool DxgiFrameSourceStart(DxgiFrameSource& source, ID3D11Device* device, int outputIndex)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+
+	source.device = device;
+	source.ticksPerSecond = frequency.QuadPart;
+	source.outputIndex = outputIndex;
+	return DuplicateOutput(source);
+}
+
+void DxgiFrameSourceStop(DxgiFrameSource& source)
+{
+	source.ReleaseFrame();
+	if (source.duplication)
+	{
+		source.duplication->Release();
+		source.duplication = nullptr;
+	}
+	if (source.staging)
+	{
+		source.staging->Release();
+		source.staging = nullptr;
+	}
+}
+
+DxgiFrameSource::~DxgiFrameSource()
+{
+	DxgiFrameSourceStop(*this);
+}
+
+ID3D11Device* CreateDxgiCaptureDevice(int& outputIndex)
+{
+	IDXGIFactory1* factory = nullptr;
+	if (FAILED(CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void**)&factory)))
+		return nullptr;
+
+	ID3D11Device* device = nullptr;
+	IDXGIAdapter1* adapter = nullptr;
+	for (UINT index = 0; !device && factory->EnumAdapters1(index, &adapter) != DXGI_ERROR_NOT_FOUND; ++index)
+	{
+		int found = -1;
+		IDXGIOutput* output = nullptr;
+		for (UINT i = 0; adapter->EnumOutputs(i, &output) != DXGI_ERROR_NOT_FOUND; ++i)
+		{
+			DXGI_OUTPUT_DESC desc;
+			output->GetDesc(&desc);
+			output->Release();
+			if (found < 0 || (desc.DesktopCoordinates.left == 0 && desc.DesktopCoordinates.top == 0))
+				found = (int)i;
+		}
+
+		// A device on a given adapter has to be created with the unknown driver type
+		if (found >= 0 && SUCCEEDED(D3D11CreateDevice(adapter, D3D_DRIVER_TYPE_UNKNOWN, nullptr, 0, nullptr, 0, D3D11_SDK_VERSION,
+													  &device, nullptr, nullptr)))
+			outputIndex = found;
+		adapter->Release();
+	}
+
+	factory->Release();
+	return device;
+}
+
+// Move and dirty rects of the acquired frame, the whole frame when they can't be read
+static void ReadFrameMetadata(DxgiFrameSource& source, const DXGI_OUTDUPL_FRAME_INFO& frameInfo, Frame& frame)
+{
+	frame.dirtyRects.clear();
+	frame.moves.clear();
+	if (frameInfo.TotalMetadataBufferSize == 0)
+		return;
+
+	source.metadata.resize(frameInfo.TotalMetadataBufferSize);
+	uint8_t* metadata = source.metadata.data();
+
+	UINT moveBytes = 0;
+	UINT dirtyBytes = 0;
+	HRESULT hr = source.duplication->GetFrameMoveRects(frameInfo.TotalMetadataBufferSize, (DXGI_OUTDUPL_MOVE_RECT*)metadata, &moveBytes);
+	if (SUCCEEDED(hr))
+		hr = source.duplication->GetFrameDirtyRects(frameInfo.TotalMetadataBufferSize - moveBytes, (RECT*)(metadata + moveBytes), &dirtyBytes);
+
+	if (FAILED(hr))
+	{
+		frame.dirtyRects.push_back({ 0, 0, frame.width, frame.height });
+		return;
+	}
+
+	const DXGI_OUTDUPL_MOVE_RECT* moves = (const DXGI_OUTDUPL_MOVE_RECT*)metadata;
+	frame.moves.resize(moveBytes / sizeof(DXGI_OUTDUPL_MOVE_RECT));
+	for (size_t i = 0; i < frame.moves.size(); ++i)
+	{
+		const RECT& dest = moves[i].DestinationRect;
+		frame.moves[i] = { moves[i].SourcePoint.x, moves[i].SourcePoint.y, { dest.left, dest.top, dest.right, dest.bottom } };
+	}
+
+	const RECT* dirtyRects = (const RECT*)(metadata + moveBytes);
+	frame.dirtyRects.resize(dirtyBytes / sizeof(RECT));
+	for (size_t i = 0; i < frame.dirtyRects.size(); ++i)
+		frame.dirtyRects[i] = { dirtyRects[i].left, dirtyRects[i].top, dirtyRects[i].right, dirtyRects[i].bottom };
+}
+
+// Copies the acquired image's changes into staging and maps it, the rects are still in the
+// output's pixels here
+static bool ReadBackFrame(DxgiFrameSource& source, Frame& frame)
+{
+	D3D11_TEXTURE2D_DESC desc;
+	source.texture->GetDesc(&desc);
+	if (source.staging)
+	{
+		D3D11_TEXTURE2D_DESC stagingDesc;
+		source.staging->GetDesc(&stagingDesc);
+		if (stagingDesc.Width != desc.Width || stagingDesc.Height != desc.Height || stagingDesc.Format != desc.Format)
+		{
+			source.staging->Release();
+			source.staging = nullptr;
+		}
+	}
+	if (!source.staging)
+	{
+		desc.Usage = D3D11_USAGE_STAGING;
+		desc.BindFlags = 0;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		desc.MiscFlags = 0;
+		if (FAILED(source.device->CreateTexture2D(&desc, nullptr, &source.staging)))
+			return false;
+		source.stagingValid = false;
+	}
+
+	ID3D11DeviceContext* context = nullptr;
+	source.device->GetImmediateContext(&context);
+	if (!source.stagingValid)
+		context->CopyResource(source.staging, source.texture);
+	else
+	{
+		auto copy = [&](const BlurRect& rect)
+		{
+			D3D11_BOX box = { (UINT)rect.left, (UINT)rect.top, 0, (UINT)rect.right, (UINT)rect.bottom, 1 };
+			context->CopySubresourceRegion(source.staging, 0, rect.left, rect.top, 0, source.texture, 0, &box);
+		};
+		for (const BlurRect& rect : frame.dirtyRects)
+			copy(rect);
+		for (const DirtyMove& move : frame.moves)
+			copy(move.destination);
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	const HRESULT hr = context->Map(source.staging, 0, D3D11_MAP_READ, 0, &mapped);
+	context->Release();
+	if (FAILED(hr))
+	{
+		source.stagingValid = false;
+		return false;
+	}
+	source.stagingValid = true;
+	source.mapped = true;
+	frame.pixels = (const uint8_t*)mapped.pData;
+	frame.rowPitch = (int)mapped.RowPitch;
+	return true;
+}
+
+FrameSourceResult DxgiFrameSource::AcquireFrame(int timeoutMs, Frame& frame)
+{
+	// Lost earlier and the output could not be duplicated again yet
+	if (!duplication && !DuplicateOutput(*this))
+		return FrameSource_Lost;
+
+	DXGI_OUTDUPL_FRAME_INFO frameInfo;
+	HRESULT hr = duplication->AcquireNextFrame(timeoutMs, &frameInfo, &resource);
+	if (FAILED(hr))
+	{
+		resource = nullptr;
+		if (hr == DXGI_ERROR_WAIT_TIMEOUT) return FrameSource_Timeout; // No new frame
+		if (hr == DXGI_ERROR_ACCESS_LOST)
+		{
+			// Desktop duplication lost, need to recreate
+			duplication->Release();
+			duplication = nullptr;
+			DuplicateOutput(*this);
+		}
+		return FrameSource_Lost;
+	}
+
+	resource->QueryInterface(__uuidof(ID3D11Texture2D), (void**)&texture);
+
+	D3D11_TEXTURE2D_DESC desc;
+	texture->GetDesc(&desc);
+	frame.width = (int)desc.Width;
+	frame.height = (int)desc.Height;
+	frame.pixels = nullptr;
+	frame.rowPitch = 0;
+
+	// not interested in just mouse updates, which can happen much faster than 60fps if you really shake the mouse
+	frame.pointerOnly = frameInfo.LastPresentTime.QuadPart == 0;
+	LONGLONG ticks = frame.pointerOnly ? frameInfo.LastMouseUpdateTime.QuadPart : frameInfo.LastPresentTime.QuadPart;
+	frame.timestamp = (int64_t)(ticks / ticksPerSecond * 1000000 + ticks % ticksPerSecond * 1000000 / ticksPerSecond);
+
+	ReadFrameMetadata(*this, frameInfo, frame);
+	if (readBack && !ReadBackFrame(*this, frame))
+	{
+		ReleaseFrame();
+		return FrameSource_Lost;
+	}
+	DesktopLayoutFrameToDesktop(output, frame);
+	return FrameSource_Ok;
+}
+
+void DxgiFrameSource::ReleaseFrame()
+{
+	if (mapped)
+	{
+		ID3D11DeviceContext* context = nullptr;
+		device->GetImmediateContext(&context);
+		context->Unmap(staging, 0);
+		context->Release();
+		mapped = false;
+	}
+
+	if (texture)
+	{
+		texture->Release();
+		texture = nullptr;
+	}
+
+	if (resource)
+	{
+		resource->Release();
+		resource = nullptr;
+		duplication->ReleaseFrame();
+	}
+}
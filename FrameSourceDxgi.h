@@ -0,0 +1,43 @@
+#pragma once
+
+#include <d3d11.h>
+#include <dxgi1_2.h>
+
+#include "DesktopLayout.h"
+#include "FrameSource.h"
+
+// IDXGIOutputDuplication of one output. Frames stay on the GPU: Frame::pixels is nullptr
+// and `texture` holds the acquired output image until ReleaseFrame. The image is in the
+// output's pixels, its rects are moved to desktop coordinates.
+//
+// With readBack the image is also copied into `staging` and mapped into Frame::pixels, for a
+// consumer on another device. Only what changed is copied, staging mirrors the output.
+struct DxgiFrameSource : FrameSource
+{
+	ID3D11Device* device = nullptr;
+	int outputIndex = 0;
+	DesktopOutput output = {};	// Refreshed whenever the output is duplicated again
+	IDXGIOutputDuplication* duplication = nullptr;
+	IDXGIResource* resource = nullptr;
+	ID3D11Texture2D* texture = nullptr;
+	std::vector<uint8_t> metadata;
+	int64_t ticksPerSecond = 1;
+
+	bool readBack = false;
+	ID3D11Texture2D* staging = nullptr;
+	bool stagingValid = false;	// Holds the last frame, only changes need copying
+	bool mapped = false;
+
+	FrameSourceResult AcquireFrame(int timeoutMs, Frame& frame) override;
+	void ReleaseFrame() override;
+	~DxgiFrameSource();
+};
+
+// Fails when the adapter has no such output, e.g. on WARP
+bool DxgiFrameSourceStart(DxgiFrameSource& source, ID3D11Device* device, int outputIndex = 0);
+void DxgiFrameSourceStop(DxgiFrameSource& source);
+
+// A WARP device has no outputs and can't duplicate another adapter's. This creates a device
+// on the first adapter that has outputs, e.g. the Basic Display Adapter, and picks its output
+// at the desktop's origin (else its first). nullptr when no adapter has an output.
+ID3D11Device* CreateDxgiCaptureDevice(int& outputIndex);
@@ -0,0 +1,60 @@
+#include "ImageView.h"
+
+#include <string.h>
+#include <algorithm>
+
+bool ImageViewClip(const ImageView& view, BlurRect& rect)
+{
+	rect.left = std::max(rect.left, 0);
+	rect.top = std::max(rect.top, 0);
+	rect.right = std::min(rect.right, view.width);
+	rect.bottom = std::min(rect.bottom, view.height);
+	return rect.left < rect.right && rect.top < rect.bottom;
+}
+
+ImageView ImageViewSubRect(const ImageView& view, const BlurRect& rect)
+{
+	BlurRect clipped = rect;
+	if (!ImageViewClip(view, clipped))
+		return { view.pixels, 0, 0, view.rowPitch, view.format };
+
+	return { ImageViewPixel(view, clipped.left, clipped.top), clipped.right - clipped.left, clipped.bottom - clipped.top,
+			 view.rowPitch, view.format };
+}
+
+void ImageViewCopy(const ImageView& source, const ImageView& destination)
+{
+	const size_t rowBytes = (size_t)source.width * ImageFormatBytes(source.format);
+	for (int y = 0; y < source.height; ++y)
+		memcpy(ImageViewPixel(destination, 0, y), ImageViewPixel(source, 0, y), rowBytes);
+}
+
+void ImageViewClear(const ImageView& view)
+{
+	const size_t rowBytes = (size_t)view.width * ImageFormatBytes(view.format);
+	for (int y = 0; y < view.height; ++y)
+		memset(ImageViewPixel(view, 0, y), 0, rowBytes);
+}
+
+bool ImageViewPlanBlur(const ImageView& frame, const BlurRect& window, float radius, ImageViewBlur& plan)
+{
+	plan = {};
+	plan.visible = window;
+	if (!ImageViewClip(frame, plan.visible))
+		return false;
+
+	// Same radius the kernels take from the constants
+	const BlurConstants probe = { 0, 0, radius, 0.0f };
+	const int apron = CpuBlurRadius(probe);
+
+	BlurRect source = { plan.visible.left - apron, plan.visible.top - apron, plan.visible.right + apron, plan.visible.bottom + apron };
+	ImageViewClip(frame, source);
+
+	plan.source = ImageViewSubRect(frame, source);
+	plan.constants = { (uint32_t)plan.source.width, (uint32_t)plan.source.height, radius, 0.0f };
+	plan.rect = { plan.visible.left - source.left, plan.visible.top - source.top, plan.visible.right - source.left,
+				  plan.visible.bottom - source.top };
+	plan.windowX = source.left - window.left;
+	plan.windowY = source.top - window.top;
+	return true;
+}
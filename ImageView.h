@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CpuBlur.h"
+
+// Non-owning strided view of pixels, usually a sub-rect of a larger image such as the whole
+// captured frame. Views never copy: ImageViewSubRect narrows one to a rect clipped to the
+// pixels that exist, and the blur reads the window's part of a frame through one instead of
+// copying it out first.
+enum ImageFormat
+{
+	ImageFormat_BGRA8,
+	ImageFormat_R8,
+};
+
+struct ImageView
+{
+	uint8_t* pixels;  // Pixel (0, 0) of the view
+	int width;
+	int height;
+	int rowPitch;  // Bytes, at least width times the pixel size
+	ImageFormat format;
+};
+
+inline int ImageFormatBytes(ImageFormat format)
+{
+	return format == ImageFormat_R8 ? 1 : 4;
+}
+
+inline uint8_t* ImageViewPixel(const ImageView& view, int x, int y)
+{
+	return view.pixels + (ptrdiff_t)y * view.rowPitch + (ptrdiff_t)x * ImageFormatBytes(view.format);
+}
+
+// Rects are half-open in the view's pixels and may hang off any of its edges.
+// Clips `rect` to the view, false when nothing of it is on the view.
+bool ImageViewClip(const ImageView& view, BlurRect& rect);
+
+// The part of `rect` on the view, width and height 0 when there is none
+ImageView ImageViewSubRect(const ImageView& view, const BlurRect& rect);
+
+// Row by row, both views must have the same size and format
+void ImageViewCopy(const ImageView& source, const ImageView& destination);
+void ImageViewClear(const ImageView& view);
+
+inline CpuImage ImageViewCpuImage(const ImageView& view)
+{
+	return { view.pixels, view.rowPitch };
+}
+
+// R8 coverage, or the alpha of BGRA8
+inline CpuMask ImageViewCpuMask(const ImageView& view)
+{
+	return view.format == ImageFormat_R8 ? CpuMask{ view.pixels, view.rowPitch, 1 } : CpuMask{ view.pixels + 3, view.rowPitch, 4 };
+}
+
+// The same memory addressed so that the result's (0, 0) is (x, y) of `image`. x and y may be
+// negative, the pointer then lies before the image and only pixels inside it may be touched.
+inline CpuImage CpuImageAt(const CpuImage& image, int x, int y)
+{
+	return { image.pixels + (ptrdiff_t)y * image.rowPitch + (ptrdiff_t)x * 4, image.rowPitch };
+}
+
+inline CpuMask CpuMaskAt(const CpuMask& mask, int x, int y)
+{
+	if (!mask.coverage)
+		return mask;
+	return { mask.coverage + (ptrdiff_t)y * mask.rowPitch + (ptrdiff_t)x * mask.pixelStride, mask.rowPitch, mask.pixelStride };
+}
+
+// Blurring a window straight out of a frame. The blur reads up to the radius past the window
+// and clamps at the frame's edges rather than the window's, so every pixel of the window on
+// the frame matches that crop of the whole frame blurred. The kernels run in source-local
+// coordinates: pass them `source`, `constants` and `rect`, with the window-local output and
+// mask moved by CpuImageAt / CpuMaskAt(windowX, windowY).
+struct ImageViewBlur
+{
+	BlurRect visible;		   // The window's pixels on the frame, frame coordinates
+	ImageView source;		   // visible grown by the radius, clipped to the frame
+	BlurConstants constants;   // source's size
+	BlurRect rect;			   // visible, source-local
+	int windowX;			   // source's top-left, window-local, negative left of or above the window
+	int windowY;
+};
+
+// `window` in frame coordinates, false when it is entirely off the frame
+bool ImageViewPlanBlur(const ImageView& frame, const BlurRect& window, float radius, ImageViewBlur& plan);
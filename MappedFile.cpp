@@ -0,0 +1,66 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFileOpen(MappedFile& mapped, const char* path)
+{
+	mapped = {};
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+	mapped.file = file;
+	mapped.mapping = mapping;
+	mapped.data = (const uint8_t*)view;
+	mapped.size = view ? (size_t)size.QuadPart : 0;
+#else
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat status;
+	void* view = MAP_FAILED;
+	if (fstat(file, &status) == 0 && status.st_size > 0)
+		view = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);  // The mapping keeps the file
+
+	mapped.data = view != MAP_FAILED ? (const uint8_t*)view : nullptr;
+	mapped.size = view != MAP_FAILED ? (size_t)status.st_size : 0;
+#endif
+	if (!mapped.data)
+	{
+		MappedFileClose(mapped);
+		return false;
+	}
+	return true;
+}
+
+void MappedFileClose(MappedFile& mapped)
+{
+#if defined(_WIN32)
+	if (mapped.data)
+		UnmapViewOfFile(mapped.data);
+	if (mapped.mapping)
+		CloseHandle(mapped.mapping);
+	if (mapped.file)
+		CloseHandle(mapped.file);
+#else
+	if (mapped.data)
+		munmap((void*)mapped.data, mapped.size);
+#endif
+	mapped = {};
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Read-only memory mapping of a whole file, for formats that are read in place
+struct MappedFile
+{
+	const uint8_t* data;  // Null when nothing is mapped
+	size_t size;
+	void* mapping;	// Platform handles of the mapping
+	void* file;
+};
+
+// False when the file is missing or empty, `mapped` is then empty
+bool MappedFileOpen(MappedFile& mapped, const char* path);
+void MappedFileClose(MappedFile& mapped);
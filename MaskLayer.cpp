@@ -0,0 +1,267 @@
+#include "MaskLayer.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+static BlurRect UnionRect(const BlurRect& a, const BlurRect& b)
+{
+	return { std::min(a.left, b.left), std::min(a.top, b.top), std::max(a.right, b.right), std::max(a.bottom, b.bottom) };
+}
+
+static bool IntersectRect(const BlurRect& a, const BlurRect& b, BlurRect& result)
+{
+	result = { std::max(a.left, b.left), std::max(a.top, b.top), std::min(a.right, b.right), std::min(a.bottom, b.bottom) };
+	return result.left < result.right && result.top < result.bottom;
+}
+
+static void MarkDirty(MaskLayer& layer, const BlurRect& rect)
+{
+	layer.dirtyRect = layer.dirty ? UnionRect(layer.dirtyRect, rect) : rect;
+	layer.dirty = true;
+}
+
+static float EdgeWidth(const MaskShape& shape)
+{
+	return std::max(1.0f, shape.feather);
+}
+
+void MaskLayerReset(MaskLayer& layer, int width, int height)
+{
+	layer.width = std::min(std::max(0, width), 0xffff);
+	layer.height = std::max(0, height);
+	layer.shapes.clear();
+	layer.nextId = 1;
+	layer.coverage.assign((size_t)layer.width * layer.height, 0);
+	MaskRleBuild(layer.rle, layer.coverage.data(), layer.width, layer.height, layer.width);
+	layer.version = 0;
+
+	// The first rasterize reports the whole layer so uploads start from a known state
+	layer.dirty = true;
+	layer.dirtyRect = { 0, 0, layer.width, layer.height };
+}
+
+MaskShapeId MaskLayerAdd(MaskLayer& layer, const MaskShape& shape)
+{
+	MaskLayerEntry entry = { layer.nextId++, shape };
+	layer.shapes.push_back(entry);
+	MarkDirty(layer, MaskShapeBounds(shape));
+	return entry.id;
+}
+
+bool MaskLayerUpdate(MaskLayer& layer, MaskShapeId id, const MaskShape& shape)
+{
+	for (MaskLayerEntry& entry : layer.shapes)
+	{
+		if (entry.id == id)
+		{
+			MarkDirty(layer, MaskShapeBounds(entry.shape));
+			MarkDirty(layer, MaskShapeBounds(shape));
+			entry.shape = shape;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool MaskLayerRemove(MaskLayer& layer, MaskShapeId id)
+{
+	for (size_t i = 0; i < layer.shapes.size(); ++i)
+	{
+		if (layer.shapes[i].id == id)
+		{
+			MarkDirty(layer, MaskShapeBounds(layer.shapes[i].shape));
+			layer.shapes.erase(layer.shapes.begin() + i);
+			return true;
+		}
+	}
+	return false;
+}
+
+BlurRect MaskShapeBounds(const MaskShape& shape)
+{
+	float left = shape.left, top = shape.top, right = shape.right, bottom = shape.bottom;
+	if (shape.type == MaskShape_Polygon)
+	{
+		if (shape.points.empty())
+			return { 0, 0, 0, 0 };
+
+		left = right = shape.points[0].x;
+		top = bottom = shape.points[0].y;
+		for (const MaskPoint& point : shape.points)
+		{
+			left = std::min(left, point.x);
+			right = std::max(right, point.x);
+			top = std::min(top, point.y);
+			bottom = std::max(bottom, point.y);
+		}
+	}
+
+	// Half the edge ramp lies outside the shape
+	float margin = EdgeWidth(shape) * 0.5f;
+	return { (int)floorf(left - margin), (int)floorf(top - margin), (int)ceilf(right + margin), (int)ceilf(bottom + margin) };
+}
+
+static float RoundedBoxDistance(float x, float y, float centerX, float centerY, float halfWidth, float halfHeight, float radius)
+{
+	float qx = fabsf(x - centerX) - halfWidth + radius;
+	float qy = fabsf(y - centerY) - halfHeight + radius;
+	float outsideX = std::max(qx, 0.0f);
+	float outsideY = std::max(qy, 0.0f);
+	return sqrtf(outsideX * outsideX + outsideY * outsideY) + std::min(std::max(qx, qy), 0.0f) - radius;
+}
+
+// Approximation that is exact on the axes and close enough for a 1 pixel ramp elsewhere
+static float EllipseDistance(float x, float y, float centerX, float centerY, float radiusX, float radiusY)
+{
+	if (radiusX <= 0.0f || radiusY <= 0.0f)
+		return 1.0e30f;
+
+	float px = (x - centerX) / radiusX;
+	float py = (y - centerY) / radiusY;
+	float k0 = sqrtf(px * px + py * py);
+	float k1 = sqrtf(px * px / (radiusX * radiusX) + py * py / (radiusY * radiusY));
+	if (k1 == 0.0f)
+		return -std::min(radiusX, radiusY);
+	return k0 * (k0 - 1.0f) / k1;
+}
+
+static float PolygonDistance(const std::vector<MaskPoint>& points, float x, float y)
+{
+	const size_t count = points.size();
+	if (count < 3)
+		return 1.0e30f;
+
+	float nearest = 1.0e30f;
+	bool inside = false;
+	for (size_t i = 0, j = count - 1; i < count; j = i++)
+	{
+		const MaskPoint& a = points[i];
+		const MaskPoint& b = points[j];
+
+		float edgeX = b.x - a.x, edgeY = b.y - a.y;
+		float toX = x - a.x, toY = y - a.y;
+		float lengthSquared = edgeX * edgeX + edgeY * edgeY;
+		float t = lengthSquared > 0.0f ? std::min(std::max((toX * edgeX + toY * edgeY) / lengthSquared, 0.0f), 1.0f) : 0.0f;
+		float dx = toX - edgeX * t, dy = toY - edgeY * t;
+		nearest = std::min(nearest, dx * dx + dy * dy);
+
+		// Even-odd crossing test
+		if ((a.y > y) != (b.y > y) && x < a.x + (y - a.y) * edgeX / edgeY)
+			inside = !inside;
+	}
+	float distance = sqrtf(nearest);
+	return inside ? -distance : distance;
+}
+
+float MaskShapeDistance(const MaskShape& shape, float x, float y)
+{
+	float centerX = (shape.left + shape.right) * 0.5f;
+	float centerY = (shape.top + shape.bottom) * 0.5f;
+	float halfWidth = (shape.right - shape.left) * 0.5f;
+	float halfHeight = (shape.bottom - shape.top) * 0.5f;
+
+	switch (shape.type)
+	{
+	  case MaskShape_Rect:
+		  return RoundedBoxDistance(x, y, centerX, centerY, halfWidth, halfHeight, 0.0f);
+
+	  case MaskShape_RoundedRect:
+	  {
+		  float radius = std::min(std::max(shape.cornerRadius, 0.0f), std::min(halfWidth, halfHeight));
+		  return RoundedBoxDistance(x, y, centerX, centerY, halfWidth, halfHeight, radius);
+	  }
+
+	  case MaskShape_Ellipse:
+		  return EllipseDistance(x, y, centerX, centerY, halfWidth, halfHeight);
+
+	  case MaskShape_Polygon:
+		  return PolygonDistance(shape.points, x, y);
+	}
+	return 1.0e30f;
+}
+
+// Draws one shape over the coverage inside `clip`, sampled at pixel centers
+static void RasterizeShape(MaskLayer& layer, const MaskShape& shape, const BlurRect& clip)
+{
+	BlurRect rect;
+	if (!IntersectRect(MaskShapeBounds(shape), clip, rect))
+		return;
+
+	const float inverseWidth = 1.0f / EdgeWidth(shape);
+	for (int y = rect.top; y < rect.bottom; ++y)
+	{
+		uint8_t* row = &layer.coverage[(size_t)y * layer.width];
+		for (int x = rect.left; x < rect.right; ++x)
+		{
+			float distance = MaskShapeDistance(shape, x + 0.5f, y + 0.5f);
+			float alpha = std::min(std::max(0.5f - distance * inverseWidth, 0.0f), 1.0f);
+			if (alpha <= 0.0f)
+				continue;
+
+			// Source-over so overlapping anti-aliased edges don't leave seams
+			uint32_t source = (uint32_t)(alpha * 255.0f + 0.5f);
+			uint32_t dest = row[x];
+			row[x] = (uint8_t)(source + (dest * (255 - source) + 127) / 255);
+		}
+	}
+}
+
+bool MaskLayerRasterize(MaskLayer& layer, BlurRect* changed)
+{
+	if (!layer.dirty)
+		return false;
+
+	layer.dirty = false;
+	BlurRect rect;
+	if (!IntersectRect(layer.dirtyRect, { 0, 0, layer.width, layer.height }, rect))
+		return false;
+
+	for (int y = rect.top; y < rect.bottom; ++y)
+		memset(&layer.coverage[(size_t)y * layer.width + rect.left], 0, (size_t)(rect.right - rect.left));
+
+	for (const MaskLayerEntry& entry : layer.shapes)
+		RasterizeShape(layer, entry.shape, rect);
+
+	MaskRleBuild(layer.rle, layer.coverage.data(), layer.width, layer.height, layer.width);
+	++layer.version;
+
+	if (changed)
+		*changed = rect;
+	return true;
+}
+
+void MaskRleBuild(MaskRle& rle, const uint8_t* coverage, int width, int height, int rowPitch)
+{
+	rle.width = width;
+	rle.height = height;
+	rle.rowStarts.resize((size_t)height + 1);
+	rle.runs.clear();
+
+	for (int y = 0; y < height; ++y)
+	{
+		rle.rowStarts[y] = (uint32_t)rle.runs.size();
+		const uint8_t* row = coverage + (size_t)y * rowPitch;
+
+		int x = 0;
+		while (x < width)
+		{
+			uint8_t value = row[x];
+			int end = x + 1;
+			while (end < width && row[end] == value && end - x < 0xffff)
+				++end;
+
+			if (value != 0)
+				rle.runs.push_back({ (uint16_t)x, (uint16_t)(end - x), value });
+			x = end;
+		}
+	}
+	rle.rowStarts[height] = (uint32_t)rle.runs.size();
+}
+
+void MaskRleDecodeRow(const MaskRle& rle, int y, uint8_t* row)
+{
+	memset(row, 0, (size_t)rle.width);
+	for (uint32_t i = rle.rowStarts[y]; i < rle.rowStarts[y + 1]; ++i)
+		memset(row + rle.runs[i].left, rle.runs[i].coverage, rle.runs[i].length);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "CpuBlur.h"
+
+// Retained mask: shapes are kept between frames and rasterized into an R8 coverage buffer
+// only when one of them changes. Edges are anti-aliased analytically from each shape's
+// signed distance, `feather` widens the ramp into a soft edge.
+enum MaskShapeType
+{
+	MaskShape_Rect,
+	MaskShape_RoundedRect,
+	MaskShape_Ellipse,
+	MaskShape_Polygon,
+};
+
+struct MaskPoint
+{
+	float x;
+	float y;
+};
+
+// Pixel coordinates, (0, 0) is the top-left corner of the first pixel
+struct MaskShape
+{
+	MaskShapeType type;
+	float left;			  // Bounds of rects and ellipses, ignored for polygons
+	float top;
+	float right;
+	float bottom;
+	float cornerRadius;	  // MaskShape_RoundedRect
+	float feather;		  // Width of the edge ramp in pixels, below 1 is a 1 pixel anti-aliased edge
+	std::vector<MaskPoint> points;	// MaskShape_Polygon, even-odd filled
+};
+
+typedef uint32_t MaskShapeId;
+
+// Run of equal non-zero coverage, empty pixels between runs are implicit
+struct MaskRun
+{
+	uint16_t left;
+	uint16_t length;
+	uint8_t coverage;
+};
+
+// Row y owns runs[rowStarts[y], rowStarts[y + 1])
+struct MaskRle
+{
+	int width;
+	int height;
+	std::vector<uint32_t> rowStarts;
+	std::vector<MaskRun> runs;
+};
+
+struct MaskLayerEntry
+{
+	MaskShapeId id;
+	MaskShape shape;
+};
+
+struct MaskLayer
+{
+	int width;
+	int height;
+	std::vector<MaskLayerEntry> shapes;	 // Drawn in order, later shapes over earlier ones
+	MaskShapeId nextId;
+
+	bool dirty;
+	BlurRect dirtyRect;	 // Pixels that need rasterizing, old and new bounds of changed shapes
+
+	std::vector<uint8_t> coverage;	// width x height, tightly packed
+	MaskRle rle;
+	uint64_t version;  // Bumped by every MaskLayerRasterize that changed something
+};
+
+// Clears the layer, every shape is dropped. Runs store 16-bit positions, width is capped at 65535.
+void MaskLayerReset(MaskLayer& layer, int width, int height);
+
+// Ids are never reused, 0 is never returned
+MaskShapeId MaskLayerAdd(MaskLayer& layer, const MaskShape& shape);
+bool MaskLayerUpdate(MaskLayer& layer, MaskShapeId id, const MaskShape& shape);
+bool MaskLayerRemove(MaskLayer& layer, MaskShapeId id);
+
+// Rasterizes dirtyRect if anything changed since the last call. Returns false when nothing
+// did, otherwise `changed` (optional) receives the rect of coverage that was rewritten.
+bool MaskLayerRasterize(MaskLayer& layer, BlurRect* changed = nullptr);
+
+inline CpuMask MaskLayerCpuMask(const MaskLayer& layer)
+{
+	return { layer.coverage.data(), layer.width, 1 };
+}
+
+// Pixels the shape can touch, before clipping to the layer
+BlurRect MaskShapeBounds(const MaskShape& shape);
+
+// Signed distance from (x, y) to the shape's edge, negative inside
+float MaskShapeDistance(const MaskShape& shape, float x, float y);
+
+// Coverage buffer to runs and back, rowPitch is in bytes
+void MaskRleBuild(MaskRle& rle, const uint8_t* coverage, int width, int height, int rowPitch);
+void MaskRleDecodeRow(const MaskRle& rle, int y, uint8_t* row);
@@ -0,0 +1,132 @@
+#include "MaskTiles.h"
+
+#include <algorithm>
+
+// Not classified yet, whatever the output holds there is unknown
+static const uint8_t MaskTileUnknown = 0xff;
+
+void MaskTileMapReset(MaskTileMap& map, int width, int height, int tileWidth, int tileHeight)
+{
+	map.width = std::min(std::max(0, width), 0xffff);
+	map.height = std::min(std::max(0, height), 0xffff);
+	map.tileWidth = std::max(1, tileWidth);
+	map.tileHeight = std::max(1, tileHeight);
+	map.tilesAcross = (map.width + map.tileWidth - 1) / map.tileWidth;
+	map.tilesDown = (map.height + map.tileHeight - 1) / map.tileHeight;
+
+	const size_t tileCount = (size_t)map.tilesAcross * map.tilesDown;
+	map.classes.assign(tileCount, MaskTileUnknown);
+	map.clearPending.assign(tileCount, 0);
+	map.fullTiles.clear();
+	map.partialTiles.clear();
+	map.clearedTiles.clear();
+	map.coveredPixels.assign(map.tilesAcross, 0);
+	map.fullPixels.assign(map.tilesAcross, 0);
+}
+
+// Classifies one row of tiles from the per-tile pixel counts and rebuilds the lists
+static void ClassifyTileRow(MaskTileMap& map, int tileY)
+{
+	const int top = tileY * map.tileHeight;
+	const int rows = std::min(map.tileHeight, map.height - top);
+
+	for (int tileX = 0; tileX < map.tilesAcross; ++tileX)
+	{
+		const int left = tileX * map.tileWidth;
+		const uint32_t area = (uint32_t)(std::min(map.tileWidth, map.width - left) * rows);
+		const uint32_t packed = MaskTilePack(tileX, tileY);
+		const size_t index = (size_t)tileY * map.tilesAcross + tileX;
+
+		uint8_t tileClass = MaskTile_Partial;
+		if (map.coveredPixels[tileX] == 0)
+			tileClass = MaskTile_Empty;
+		else if (map.fullPixels[tileX] == area)
+			tileClass = MaskTile_Full;
+
+		if (tileClass == MaskTile_Full)
+			map.fullTiles.push_back(packed);
+		else if (tileClass == MaskTile_Partial)
+			map.partialTiles.push_back(packed);
+		else if (map.classes[index] != MaskTile_Empty && !map.clearPending[index])
+		{
+			map.clearedTiles.push_back(packed);
+			map.clearPending[index] = 1;
+		}
+
+		map.classes[index] = tileClass;
+	}
+}
+
+void MaskTileClassify(MaskTileMap& map, const CpuMask& mask)
+{
+	map.fullTiles.clear();
+	map.partialTiles.clear();
+
+	for (int tileY = 0; tileY < map.tilesDown; ++tileY)
+	{
+		std::fill(map.coveredPixels.begin(), map.coveredPixels.end(), 0);
+		std::fill(map.fullPixels.begin(), map.fullPixels.end(), 0);
+
+		const int top = tileY * map.tileHeight;
+		const int bottom = std::min(top + map.tileHeight, map.height);
+		for (int y = top; y < bottom; ++y)
+		{
+			for (int tileX = 0; tileX < map.tilesAcross; ++tileX)
+			{
+				const int left = tileX * map.tileWidth;
+				const int right = std::min(left + map.tileWidth, map.width);
+				uint32_t covered = 0, full = 0;
+				for (int x = left; x < right; ++x)
+				{
+					uint8_t coverage = CpuMaskCoverage(mask, x, y);
+					covered += coverage != 0;
+					full += coverage == 255;
+				}
+				map.coveredPixels[tileX] += covered;
+				map.fullPixels[tileX] += full;
+			}
+		}
+
+		ClassifyTileRow(map, tileY);
+	}
+}
+
+void MaskTileClassifyRle(MaskTileMap& map, const MaskRle& rle)
+{
+	map.fullTiles.clear();
+	map.partialTiles.clear();
+
+	// Rows and columns the layer doesn't have are empty
+	const int rleHeight = std::min(rle.height, map.height);
+	const int rleWidth = std::min(rle.width, map.width);
+
+	for (int tileY = 0; tileY < map.tilesDown; ++tileY)
+	{
+		std::fill(map.coveredPixels.begin(), map.coveredPixels.end(), 0);
+		std::fill(map.fullPixels.begin(), map.fullPixels.end(), 0);
+
+		const int top = tileY * map.tileHeight;
+		const int bottom = std::min(top + map.tileHeight, rleHeight);
+		for (int y = top; y < bottom; ++y)
+		{
+			for (uint32_t i = rle.rowStarts[y]; i < rle.rowStarts[y + 1]; ++i)
+			{
+				const MaskRun& run = rle.runs[i];
+				const int runEnd = std::min((int)run.left + run.length, rleWidth);
+
+				// Split the run at tile boundaries
+				for (int x = run.left; x < runEnd;)
+				{
+					const int tileX = x / map.tileWidth;
+					const int end = std::min(runEnd, (tileX + 1) * map.tileWidth);
+					map.coveredPixels[tileX] += (uint32_t)(end - x);
+					if (run.coverage == 255)
+						map.fullPixels[tileX] += (uint32_t)(end - x);
+					x = end;
+				}
+			}
+		}
+
+		ClassifyTileRow(map, tileY);
+	}
+}
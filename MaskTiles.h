@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "CpuBlur.h"
+#include "MaskLayer.h"
+
+// Classifies the window into tiles by mask coverage so the blur only runs where the mask
+// is non-zero. Empty tiles are skipped, full tiles take the path without the mask blend.
+enum MaskTileClass
+{
+	MaskTile_Empty,
+	MaskTile_Partial,
+	MaskTile_Full,
+};
+
+// One dispatch group of computeShaderSource
+static const int MaskTileDefaultSize = 8;
+
+// Tile lists hold packed positions, x in the low 16 bits and y in the high 16 (tile units)
+inline uint32_t MaskTilePack(int tileX, int tileY)
+{
+	return (uint32_t)tileX | ((uint32_t)tileY << 16);
+}
+
+struct MaskTileMap
+{
+	int width;
+	int height;
+	int tileWidth;
+	int tileHeight;
+	int tilesAcross;
+	int tilesDown;
+
+	std::vector<uint8_t> classes;		  // MaskTileClass per tile, row-major
+	std::vector<uint32_t> fullTiles;	  // Packed, rebuilt by every classify
+	std::vector<uint32_t> partialTiles;
+
+	// Tiles that became empty and still hold blurred pixels from before. Collected across
+	// classifies until MaskTileClearsDone, the first classify lists every empty tile.
+	std::vector<uint32_t> clearedTiles;
+	std::vector<uint8_t> clearPending;
+
+	std::vector<uint32_t> coveredPixels;  // Classify scratch, one tile row
+	std::vector<uint32_t> fullPixels;
+};
+
+void MaskTileMapReset(MaskTileMap& map, int width, int height,
+					  int tileWidth = MaskTileDefaultSize, int tileHeight = MaskTileDefaultSize);
+
+// Reads every pixel of the mask, a null mask is fully covered
+void MaskTileClassify(MaskTileMap& map, const CpuMask& mask);
+
+// Same result from the mask layer's runs, O(runs + tiles) instead of O(pixels)
+void MaskTileClassifyRle(MaskTileMap& map, const MaskRle& rle);
+
+// The caller wrote transparent black over clearedTiles
+inline void MaskTileClearsDone(MaskTileMap& map)
+{
+	for (uint32_t tile : map.clearedTiles)
+		map.clearPending[(tile >> 16) * map.tilesAcross + (tile & 0xffff)] = 0;
+	map.clearedTiles.clear();
+}
+
+// Pixels of a packed tile, clipped to the map
+inline BlurRect MaskTileRect(const MaskTileMap& map, uint32_t tile)
+{
+	int left = (int)(tile & 0xffff) * map.tileWidth;
+	int top = (int)(tile >> 16) * map.tileHeight;
+	int right = left + map.tileWidth < map.width ? left + map.tileWidth : map.width;
+	int bottom = top + map.tileHeight < map.height ? top + map.tileHeight : map.height;
+	return { left, top, right, bottom };
+}
@@ -0,0 +1,178 @@
+#include "ResourcePool.h"
+
+#include <algorithm>
+
+// Classes below this are not worth telling apart
+static const int ResourcePoolMinClass = 64;
+
+void ResourcePoolReset(ResourcePool& pool, ResourceAllocator* allocator, int64_t idleTimeoutUs)
+{
+	pool.allocator = allocator;
+	pool.idleTimeoutUs = idleTimeoutUs;
+	pool.slots.clear();
+	pool.allocations = 0;
+	pool.frees = 0;
+	pool.reuses = 0;
+	pool.keptOnResize = 0;
+	pool.liveElements = 0;
+	pool.peakElements = 0;
+}
+
+static void FreeSlot(ResourcePool& pool, PooledResource& slot)
+{
+	pool.allocator->Free(slot.resource);
+	pool.liveElements -= (uint64_t)slot.desc.width * slot.desc.height;
+	slot.resource = nullptr;
+	slot.leased = false;
+	++pool.frees;
+}
+
+void ResourcePoolDestroy(ResourcePool& pool)
+{
+	for (PooledResource& slot : pool.slots)
+		if (slot.resource)
+			FreeSlot(pool, slot);
+	pool.slots.clear();
+}
+
+int ResourcePoolSizeClass(int size)
+{
+	if (size <= ResourcePoolMinClass)
+		return ResourcePoolMinClass;
+
+	// p, 5p/4, 6p/4, 7p/4 for the power of two p at or below size
+	int octave = ResourcePoolMinClass;
+	while (octave * 2 <= size)
+		octave *= 2;
+	for (int step = 0; step < 4; ++step)
+	{
+		int sizeClass = octave + octave / 4 * step;
+		if (sizeClass >= size)
+			return sizeClass;
+	}
+	return octave * 2;
+}
+
+static bool SameKind(const PoolResourceDesc& a, const PoolResourceDesc& b)
+{
+	return a.type == b.type && a.format == b.format && a.bindFlags == b.bindFlags && a.usage == b.usage &&
+		   a.cpuAccessFlags == b.cpuAccessFlags && a.miscFlags == b.miscFlags;
+}
+
+static int ClassHeight(const PoolResourceDesc& desc, int height)
+{
+	return desc.type == PoolResource_Buffer ? 1 : ResourcePoolSizeClass(height);
+}
+
+// Fits width x height and wastes at most half of itself
+static bool Fits(const PoolResourceDesc& allocated, int width, int height)
+{
+	if (allocated.width < width || allocated.height < height)
+		return false;
+	uint64_t classArea = (uint64_t)ResourcePoolSizeClass(width) * ClassHeight(allocated, height);
+	return (uint64_t)allocated.width * allocated.height <= 2 * classArea;
+}
+
+static void Lease(PoolLease& lease, int slot, const PooledResource& resource, int width, int height)
+{
+	lease.slot = slot;
+	lease.resource = resource.resource;
+	lease.width = width;
+	lease.height = height;
+	lease.allocatedWidth = resource.desc.width;
+	lease.allocatedHeight = resource.desc.height;
+}
+
+bool ResourcePoolAcquire(ResourcePool& pool, const PoolResourceDesc& desc, int64_t nowUs, PoolLease& lease)
+{
+	lease = { -1, nullptr, 0, 0, 0, 0 };
+
+	int best = -1;
+	for (int i = 0; i < (int)pool.slots.size(); ++i)
+	{
+		const PooledResource& slot = pool.slots[i];
+		if (!slot.resource || slot.leased || !SameKind(slot.desc, desc) || !Fits(slot.desc, desc.width, desc.height))
+			continue;
+		if (best < 0 || (uint64_t)slot.desc.width * slot.desc.height < (uint64_t)pool.slots[best].desc.width * pool.slots[best].desc.height)
+			best = i;
+	}
+
+	if (best >= 0)
+	{
+		pool.slots[best].leased = true;
+		Lease(lease, best, pool.slots[best], desc.width, desc.height);
+		++pool.reuses;
+		return true;
+	}
+
+	PoolResourceDesc allocated = desc;
+	allocated.width = ResourcePoolSizeClass(desc.width);
+	allocated.height = ClassHeight(desc, desc.height);
+	void* resource = pool.allocator->Allocate(allocated);
+	if (!resource)
+		return false;
+
+	// Slots of trimmed resources are reused, leases keep their index
+	int index = 0;
+	while (index < (int)pool.slots.size() && pool.slots[index].resource)
+		++index;
+	if (index == (int)pool.slots.size())
+		pool.slots.push_back({});
+
+	pool.slots[index] = { allocated, resource, true, nowUs };
+	Lease(lease, index, pool.slots[index], desc.width, desc.height);
+
+	++pool.allocations;
+	pool.liveElements += (uint64_t)allocated.width * allocated.height;
+	pool.peakElements = std::max(pool.peakElements, pool.liveElements);
+	return true;
+}
+
+void ResourcePoolRelease(ResourcePool& pool, PoolLease& lease, int64_t nowUs)
+{
+	if (lease.resource)
+	{
+		PooledResource& slot = pool.slots[lease.slot];
+		slot.leased = false;
+		slot.idleSinceUs = nowUs;
+	}
+	lease = { -1, nullptr, 0, 0, 0, 0 };
+}
+
+bool ResourcePoolResize(ResourcePool& pool, PoolLease& lease, int width, int height, int64_t nowUs)
+{
+	if (!lease.resource)
+		return false;
+
+	const PoolResourceDesc allocated = pool.slots[lease.slot].desc;
+	if (Fits(allocated, width, height))
+	{
+		lease.width = width;
+		lease.height = height;
+		++pool.keptOnResize;
+		return false;
+	}
+
+	// Released first, it can't be picked again anyway and goes idle for a drag back
+	void* previous = lease.resource;
+	PoolResourceDesc desc = allocated;
+	desc.width = width;
+	desc.height = desc.type == PoolResource_Buffer ? 1 : height;
+	ResourcePoolRelease(pool, lease, nowUs);
+	ResourcePoolAcquire(pool, desc, nowUs, lease);
+	return lease.resource != previous;
+}
+
+int ResourcePoolTrim(ResourcePool& pool, int64_t nowUs)
+{
+	int freed = 0;
+	for (PooledResource& slot : pool.slots)
+	{
+		if (slot.resource && !slot.leased && nowUs - slot.idleSinceUs >= pool.idleTimeoutUs)
+		{
+			FreeSlot(pool, slot);
+			++freed;
+		}
+	}
+	return freed;
+}
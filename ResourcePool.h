@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Window-sized textures and buffers that survive resizes. Sizes are rounded up to size
+// classes, four per octave, so a resize drag only allocates when it crosses a class; the
+// resource is used through its top-left width x height and the shaders get that size in
+// their constants. Returned resources idle in the pool until a request fits them or the
+// idle timeout trims them. Devices plug in through ResourceAllocator, BackdropFilterBench
+// runs the same logic against a mock one.
+enum PoolResourceType
+{
+	PoolResource_Texture,
+	PoolResource_Buffer,
+};
+
+// Resources only stand in for each other when everything but the size matches
+struct PoolResourceDesc
+{
+	PoolResourceType type;
+	uint32_t format;  // DXGI_FORMAT, the structure stride for buffers
+	uint32_t bindFlags;
+	uint32_t usage;
+	uint32_t cpuAccessFlags;
+	uint32_t miscFlags;
+	int width;	 // Bytes for buffers
+	int height;	 // 1 for buffers
+};
+
+struct ResourceAllocator
+{
+	virtual ~ResourceAllocator() {}
+
+	// nullptr when the device can't
+	virtual void* Allocate(const PoolResourceDesc& desc) = 0;
+	virtual void Free(void* resource) = 0;
+};
+
+struct PooledResource
+{
+	PoolResourceDesc desc;	// As allocated, size class included
+	void* resource;			// nullptr for a free slot
+	bool leased;
+	int64_t idleSinceUs;
+};
+
+// A resource handed out by the pool, empty while resource is nullptr
+struct PoolLease
+{
+	int slot;
+	void* resource;
+	int width;	// The part in use
+	int height;
+	int allocatedWidth;
+	int allocatedHeight;
+};
+
+static const int64_t ResourcePoolDefaultIdleUs = 2000000;
+
+struct ResourcePool
+{
+	ResourceAllocator* allocator;
+	int64_t idleTimeoutUs;
+	std::vector<PooledResource> slots;
+
+	uint64_t allocations;
+	uint64_t frees;
+	uint64_t reuses;		   // Acquires served by an idle resource
+	uint64_t keptOnResize;	   // Resizes the leased resource still fit
+	uint64_t liveElements;	   // Pixels, bytes for buffers, allocated right now
+	uint64_t peakElements;
+};
+
+void ResourcePoolReset(ResourcePool& pool, ResourceAllocator* allocator, int64_t idleTimeoutUs = ResourcePoolDefaultIdleUs);
+
+// Frees everything, leased or not
+void ResourcePoolDestroy(ResourcePool& pool);
+
+// Pixels or bytes a request of `size` is rounded up to
+int ResourcePoolSizeClass(int size);
+
+// The smallest idle resource that fits, a new one otherwise. False when the allocator fails.
+bool ResourcePoolAcquire(ResourcePool& pool, const PoolResourceDesc& desc, int64_t nowUs, PoolLease& lease);
+void ResourcePoolRelease(ResourcePool& pool, PoolLease& lease, int64_t nowUs);
+
+// Keeps the leased resource while the new size fits without leaving more than half of it
+// unused, swaps it otherwise. Returns true when lease.resource changed and its views need
+// recreating, it is nullptr if the allocator failed.
+bool ResourcePoolResize(ResourcePool& pool, PoolLease& lease, int width, int height, int64_t nowUs);
+
+// Frees resources idle for longer than the timeout, returns how many
+int ResourcePoolTrim(ResourcePool& pool, int64_t nowUs);
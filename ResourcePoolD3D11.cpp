@@ -0,0 +1,50 @@
+#include "ResourcePoolD3D11.h"
+
+void* D3D11ResourceAllocator::Allocate(const PoolResourceDesc& desc)
+{
+	if (desc.type == PoolResource_Buffer)
+	{
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.ByteWidth = (UINT)desc.width;
+		bufferDesc.Usage = (D3D11_USAGE)desc.usage;
+		bufferDesc.BindFlags = desc.bindFlags;
+		bufferDesc.CPUAccessFlags = desc.cpuAccessFlags;
+		bufferDesc.MiscFlags = desc.miscFlags;
+		bufferDesc.StructureByteStride = desc.format;
+
+		ID3D11Buffer* buffer = nullptr;
+		return SUCCEEDED(device->CreateBuffer(&bufferDesc, nullptr, &buffer)) ? buffer : nullptr;
+	}
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = (UINT)desc.width;
+	textureDesc.Height = (UINT)desc.height;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = (DXGI_FORMAT)desc.format;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = (D3D11_USAGE)desc.usage;
+	textureDesc.BindFlags = desc.bindFlags;
+	textureDesc.CPUAccessFlags = desc.cpuAccessFlags;
+	textureDesc.MiscFlags = desc.miscFlags;
+
+	ID3D11Texture2D* texture = nullptr;
+	return SUCCEEDED(device->CreateTexture2D(&textureDesc, nullptr, &texture)) ? texture : nullptr;
+}
+
+void D3D11ResourceAllocator::Free(void* resource)
+{
+	((ID3D11Resource*)resource)->Release();
+}
+
+PoolResourceDesc PoolTextureDesc(const D3D11_TEXTURE2D_DESC& desc)
+{
+	return { PoolResource_Texture, (uint32_t)desc.Format, desc.BindFlags, (uint32_t)desc.Usage,
+			 desc.CPUAccessFlags, desc.MiscFlags, (int)desc.Width, (int)desc.Height };
+}
+
+PoolResourceDesc PoolBufferDesc(const D3D11_BUFFER_DESC& desc)
+{
+	return { PoolResource_Buffer, desc.StructureByteStride, desc.BindFlags, (uint32_t)desc.Usage,
+			 desc.CPUAccessFlags, desc.MiscFlags, (int)desc.ByteWidth, 1 };
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include "ResourcePool.h"
+
+// ResourcePool allocations on a D3D11 device, resources are ID3D11Texture2D or ID3D11Buffer
+struct D3D11ResourceAllocator : ResourceAllocator
+{
+	ID3D11Device* device = nullptr;
+
+	void* Allocate(const PoolResourceDesc& desc) override;
+	void Free(void* resource) override;
+};
+
+// Everything but the size is taken from `desc`, which has no mips or arrays
+PoolResourceDesc PoolTextureDesc(const D3D11_TEXTURE2D_DESC& desc);
+PoolResourceDesc PoolBufferDesc(const D3D11_BUFFER_DESC& desc);
@@ -0,0 +1,237 @@
+#include "ShaderCache.h"
+#include "BlurCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+// Blobs start 16-byte aligned, DXBC doesn't need it but a reader casting into it might
+static const size_t ShaderCacheBlobAlignment = 16;
+
+static uint64_t HashString(const char* text, uint64_t seed)
+{
+	// The terminator goes in too, "ab" + "c" and "a" + "bc" must not collide
+	return FrameHashBytes((const uint8_t*)(text ? text : ""), text ? strlen(text) + 1 : 0, seed);
+}
+
+uint64_t ShaderCacheKey(const ShaderCompileRequest& request, uint64_t compilerVersion)
+{
+	uint64_t key = HashString(request.source, compilerVersion);
+	key = HashString(request.entryPoint, key);
+	key = HashString(request.target, key);
+	for (const ShaderDefine* define = request.defines; define && define->name; ++define)
+	{
+		key = HashString(define->name, key);
+		key = HashString(define->value ? define->value : "1", key);
+	}
+	return key;
+}
+
+static uint64_t HeaderChecksum(const ShaderCacheFileHeader& header, const ShaderCacheFileEntry* entries)
+{
+	uint64_t seed = FrameHashBytes((const uint8_t*)&header, offsetof(ShaderCacheFileHeader, checksum));
+	return FrameHashBytes((const uint8_t*)entries, (size_t)header.entryCount * sizeof(ShaderCacheFileEntry), seed);
+}
+
+static void UnmapFile(ShaderCache& cache)
+{
+	MappedFileClose(cache.file);
+	cache.entries = nullptr;
+	cache.entryCount = 0;
+}
+
+// The header and entry table of the mapped file, false when it can't be used
+static bool ValidateFile(ShaderCache& cache)
+{
+	if (cache.file.size < sizeof(ShaderCacheFileHeader))
+		return false;
+
+	ShaderCacheFileHeader header;
+	memcpy(&header, cache.file.data, sizeof(header));
+	if (header.magic != ShaderCacheMagic || header.formatVersion != ShaderCacheFormatVersion || header.compilerVersion != cache.compilerVersion)
+		return false;
+	if (header.entryCount > (cache.file.size - sizeof(header)) / sizeof(ShaderCacheFileEntry))
+		return false;
+
+	const ShaderCacheFileEntry* entries = (const ShaderCacheFileEntry*)(cache.file.data + sizeof(header));
+	if (HeaderChecksum(header, entries) != header.checksum)
+		return false;
+
+	cache.entries = entries;
+	cache.entryCount = header.entryCount;
+	return true;
+}
+
+void ShaderCacheOpen(ShaderCache& cache, const char* path, ShaderCompiler* compiler)
+{
+	cache.compiler = compiler;
+	cache.compilerVersion = compiler->Version();
+	cache.file = {};
+	cache.entries = nullptr;
+	cache.entryCount = 0;
+	cache.compiled.clear();
+	cache.hits = 0;
+	cache.misses = 0;
+	cache.corrupt = 0;
+	cache.fileRejected = false;
+	cache.compileUs = 0;
+
+	if (!MappedFileOpen(cache.file, path))
+		return;
+	if (!ValidateFile(cache))
+	{
+		cache.fileRejected = true;
+		UnmapFile(cache);
+	}
+}
+
+// The entry's blob when it is inside the file and intact
+static bool ReadEntry(const ShaderCache& cache, const ShaderCacheFileEntry& entry, const uint8_t*& bytecode, size_t& size)
+{
+	if (entry.offset > cache.file.size || entry.size > cache.file.size - entry.offset)
+		return false;
+	if (FrameHashBytes(cache.file.data + entry.offset, (size_t)entry.size) != entry.checksum)
+		return false;
+
+	bytecode = cache.file.data + entry.offset;
+	size = (size_t)entry.size;
+	return true;
+}
+
+static const ShaderCacheFileEntry* FindEntry(const ShaderCache& cache, uint64_t key)
+{
+	const ShaderCacheFileEntry* end = cache.entries + cache.entryCount;
+	const ShaderCacheFileEntry* found = std::lower_bound(cache.entries, end, key,
+		[](const ShaderCacheFileEntry& entry, uint64_t value) { return entry.key < value; });
+	return found != end && found->key == key ? found : nullptr;
+}
+
+bool ShaderCacheGet(ShaderCache& cache, const ShaderCompileRequest& request, const uint8_t*& bytecode, size_t& size,
+					std::string* errors)
+{
+	const uint64_t key = ShaderCacheKey(request, cache.compilerVersion);
+
+	auto compiled = cache.compiled.find(key);
+	if (compiled != cache.compiled.end())
+	{
+		++cache.hits;
+		bytecode = compiled->second.data();
+		size = compiled->second.size();
+		return true;
+	}
+
+	if (const ShaderCacheFileEntry* entry = FindEntry(cache, key))
+	{
+		if (ReadEntry(cache, *entry, bytecode, size))
+		{
+			++cache.hits;
+			return true;
+		}
+		++cache.corrupt;
+	}
+
+	++cache.misses;
+	std::vector<uint8_t> blob;
+	std::string messages;
+	const auto start = std::chrono::steady_clock::now();
+	const bool ok = cache.compiler->Compile(request, blob, messages);
+	cache.compileUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	if (errors)
+		*errors = messages;
+	if (!ok)
+		return false;
+
+	std::vector<uint8_t>& kept = cache.compiled[key];
+	kept.swap(blob);
+	bytecode = kept.data();
+	size = kept.size();
+	return true;
+}
+
+static bool WriteCacheFile(const char* path, const std::vector<uint8_t>& data)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+	ok = fclose(file) == 0 && ok;
+	return ok;
+}
+
+static bool ReplaceCacheFile(const char* from, const char* to)
+{
+#if defined(_WIN32)
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(from, to) == 0;
+#endif
+}
+
+bool ShaderCacheSave(ShaderCache& cache, const char* path)
+{
+	if (cache.compiled.empty())
+		return true;
+
+	// Intact entries of the file, then this run's, ordered by key
+	std::map<uint64_t, std::pair<const uint8_t*, size_t>> blobs;
+	for (uint32_t i = 0; i < cache.entryCount; ++i)
+	{
+		const uint8_t* bytecode;
+		size_t size;
+		if (ReadEntry(cache, cache.entries[i], bytecode, size))
+			blobs[cache.entries[i].key] = { bytecode, size };
+	}
+	for (const auto& compiled : cache.compiled)
+		blobs[compiled.first] = { compiled.second.data(), compiled.second.size() };
+
+	ShaderCacheFileHeader header = {};
+	header.magic = ShaderCacheMagic;
+	header.formatVersion = ShaderCacheFormatVersion;
+	header.compilerVersion = cache.compilerVersion;
+	header.entryCount = (uint32_t)blobs.size();
+
+	std::vector<ShaderCacheFileEntry> entries;
+	size_t offset = sizeof(header) + blobs.size() * sizeof(ShaderCacheFileEntry);
+	for (const auto& blob : blobs)
+	{
+		offset = (offset + ShaderCacheBlobAlignment - 1) & ~(ShaderCacheBlobAlignment - 1);
+		entries.push_back({ blob.first, offset, blob.second.second, FrameHashBytes(blob.second.first, blob.second.second) });
+		offset += blob.second.second;
+	}
+	header.checksum = HeaderChecksum(header, entries.data());
+
+	std::vector<uint8_t> data(offset, 0);
+	memcpy(data.data(), &header, sizeof(header));
+	memcpy(data.data() + sizeof(header), entries.data(), entries.size() * sizeof(ShaderCacheFileEntry));
+	size_t index = 0;
+	for (const auto& blob : blobs)
+		memcpy(data.data() + entries[index++].offset, blob.second.first, blob.second.second);
+
+	// The old file can't be replaced while it is mapped, everything needed from it is copied
+	UnmapFile(cache);
+
+	std::string temporary = std::string(path) + ".tmp";
+	if (!WriteCacheFile(temporary.c_str(), data) || !ReplaceCacheFile(temporary.c_str(), path))
+	{
+		remove(temporary.c_str());
+		return false;
+	}
+	cache.compiled.clear();
+
+	if (MappedFileOpen(cache.file, path) && !ValidateFile(cache))
+		UnmapFile(cache);
+	return true;
+}
+
+void ShaderCacheClose(ShaderCache& cache)
+{
+	UnmapFile(cache);
+	cache.compiled.clear();
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+
+// Compiled shader bytecode kept on disk between launches. Entries are keyed by a hash of the
+// source, entry point, target profile, defines and the compiler's version, so editing any of
+// them just misses. The file is memory-mapped and looked up in place:
+//
+//   ShaderCacheFileHeader
+//   ShaderCacheFileEntry[entryCount]   sorted by key
+//   bytecode blobs
+//
+// A file with another magic, format or compiler version, or a header that fails its checksum,
+// is ignored as a whole. A blob that fails its checksum is compiled again. Only the compile
+// call sits behind ShaderCompiler, BackdropFilterBench runs the rest against a mock one.
+static const uint32_t ShaderCacheMagic = 0x43534642;  // "BFSC"
+static const uint32_t ShaderCacheFormatVersion = 1;
+
+struct ShaderCacheFileHeader
+{
+	uint32_t magic;
+	uint32_t formatVersion;
+	uint64_t compilerVersion;
+	uint32_t entryCount;
+	uint32_t padding;
+	uint64_t checksum;	// FrameHashBytes of the entry table, seeded with the fields above
+};
+
+struct ShaderCacheFileEntry
+{
+	uint64_t key;
+	uint64_t offset;  // From the start of the file
+	uint64_t size;
+	uint64_t checksum;	// FrameHashBytes of the blob
+};
+
+// Layout of D3D_SHADER_MACRO, an array ends with a null name
+struct ShaderDefine
+{
+	const char* name;
+	const char* value;
+};
+
+struct ShaderCompileRequest
+{
+	const char* source;
+	const char* entryPoint;
+	const char* target;			  // Profile, e.g. "cs_5_0"
+	const ShaderDefine* defines;  // nullptr for none
+};
+
+struct ShaderCompiler
+{
+	virtual ~ShaderCompiler() {}
+
+	// Changes whenever the same request could compile to different bytecode
+	virtual uint64_t Version() = 0;
+
+	// False with the compiler's messages in `errors` when the source doesn't compile
+	virtual bool Compile(const ShaderCompileRequest& request, std::vector<uint8_t>& bytecode, std::string& errors) = 0;
+};
+
+struct ShaderCache
+{
+	ShaderCompiler* compiler;
+	uint64_t compilerVersion;
+
+	// The mapped file, entries point into it. Empty when there was no usable file.
+	MappedFile file;
+	const ShaderCacheFileEntry* entries;
+	uint32_t entryCount;
+
+	// Compiled since the file was mapped, written out by ShaderCacheSave
+	std::unordered_map<uint64_t, std::vector<uint8_t>> compiled;
+
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t corrupt;	  // Entries whose blob failed its checksum
+	bool fileRejected;	  // A file was there but ignored
+	int64_t compileUs;	  // Spent in the compiler
+};
+
+uint64_t ShaderCacheKey(const ShaderCompileRequest& request, uint64_t compilerVersion);
+
+// Maps `path` when it exists and matches the compiler, an unusable file leaves the cache empty
+void ShaderCacheOpen(ShaderCache& cache, const char* path, ShaderCompiler* compiler);
+
+// Bytecode for `request`, from the file or compiled and kept for ShaderCacheSave. Stays valid
+// until the next ShaderCacheSave or ShaderCacheClose. False when the source doesn't compile.
+bool ShaderCacheGet(ShaderCache& cache, const ShaderCompileRequest& request, const uint8_t*& bytecode, size_t& size,
+					std::string* errors = nullptr);
+
+// Writes the mapped entries and the newly compiled ones to `path` through a temporary file
+// and maps the result. Does nothing when nothing was compiled.
+bool ShaderCacheSave(ShaderCache& cache, const char* path);
+
+void ShaderCacheClose(ShaderCache& cache);
@@ -0,0 +1,47 @@
+#include "ShaderCacheD3D.h"
+#include "BlurCache.h"
+
+#include <d3dcompiler.h>
+#include <string.h>
+
+uint64_t D3DShaderCompiler::Version()
+{
+	// Same-numbered DLLs get updated with Windows, their link time tells builds apart
+	uint32_t build = 0;
+	if (HMODULE module = GetModuleHandleA(D3DCOMPILER_DLL_A))
+	{
+		const IMAGE_DOS_HEADER* dos = (const IMAGE_DOS_HEADER*)module;
+		const IMAGE_NT_HEADERS* nt = (const IMAGE_NT_HEADERS*)((const uint8_t*)module + dos->e_lfanew);
+		build = nt->FileHeader.TimeDateStamp;
+	}
+
+	const uint32_t version[3] = { D3D_COMPILER_VERSION, build, flags };
+	return FrameHashBytes((const uint8_t*)version, sizeof(version));
+}
+
+bool D3DShaderCompiler::Compile(const ShaderCompileRequest& request, std::vector<uint8_t>& bytecode, std::string& errors)
+{
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (const ShaderDefine* define = request.defines; define && define->name; ++define)
+		macros.push_back({ define->name, define->value ? define->value : "1" });
+	macros.push_back({ nullptr, nullptr });
+
+	ID3DBlob* shaderBlob = nullptr;
+	ID3DBlob* errorBlob = nullptr;
+	HRESULT hr = D3DCompile(request.source, strlen(request.source), nullptr, macros.data(), nullptr, request.entryPoint, request.target,
+							flags, 0, &shaderBlob, &errorBlob);
+
+	errors.clear();
+	if (errorBlob)
+	{
+		errors.assign((const char*)errorBlob->GetBufferPointer(), errorBlob->GetBufferSize());
+		errorBlob->Release();
+	}
+	if (FAILED(hr))
+		return false;
+
+	const uint8_t* data = (const uint8_t*)shaderBlob->GetBufferPointer();
+	bytecode.assign(data, data + shaderBlob->GetBufferSize());
+	shaderBlob->Release();
+	return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <windows.h>
+
+#include "ShaderCache.h"
+
+// D3DCompile behind ShaderCompiler. The version covers D3D_COMPILER_VERSION, the build of
+// the d3dcompiler DLL that is loaded and the compile flags.
+struct D3DShaderCompiler : ShaderCompiler
+{
+	UINT flags = 0;
+
+	uint64_t Version() override;
+	bool Compile(const ShaderCompileRequest& request, std::vector<uint8_t>& bytecode, std::string& errors) override;
+};
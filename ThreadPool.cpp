@@ -0,0 +1,138 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+static bool PopOwn(ThreadPoolQueue& queue, int& index)
+{
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.items.empty()) return false;
+	index = queue.items.back();
+	queue.items.pop_back();
+	return true;
+}
+
+static bool Steal(ThreadPoolQueue& queue, int& index)
+{
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.items.empty()) return false;
+	index = queue.items.front();
+	queue.items.pop_front();
+	return true;
+}
+
+// No work is added while a ParallelFor is running, so one empty sweep means we are done
+static void RunTasks(ThreadPool& pool, int worker)
+{
+	const ThreadPoolTask& task = *pool.task;
+	const int workerCount = ThreadPoolWorkerCount(pool);
+
+	for (;;)
+	{
+		int index;
+		if (PopOwn(*pool.queues[worker], index))
+		{
+			task(index, worker);
+			continue;
+		}
+
+		bool stolen = false;
+		for (int i = 1; i < workerCount && !stolen; ++i)
+			stolen = Steal(*pool.queues[(worker + i) % workerCount], index);
+
+		if (!stolen)
+			return;
+
+		pool.steals.fetch_add(1, std::memory_order_relaxed);
+		task(index, worker);
+	}
+}
+
+static void WorkerMain(ThreadPool* pool, int worker)
+{
+	uint64_t seenGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(pool->mutex);
+			pool->wake.wait(lock, [&] { return pool->quitting || pool->generation != seenGeneration; });
+			if (pool->quitting) return;
+			seenGeneration = pool->generation;
+		}
+
+		RunTasks(*pool, worker);
+
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		if (--pool->activeWorkers == 0)
+			pool->done.notify_one();
+	}
+}
+
+void ThreadPoolStart(ThreadPool& pool, int threadCount)
+{
+	if (threadCount <= 0)
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+
+	pool.task = nullptr;
+	pool.generation = 0;
+	pool.activeWorkers = 0;
+	pool.quitting = false;
+	pool.steals = 0;
+
+	pool.queues.clear();
+	for (int i = 0; i < threadCount; ++i)
+		pool.queues.emplace_back(new ThreadPoolQueue());
+
+	// Worker 0 is whoever calls ThreadPoolParallelFor
+	for (int i = 1; i < threadCount; ++i)
+		pool.threads.emplace_back(WorkerMain, &pool, i);
+}
+
+void ThreadPoolStop(ThreadPool& pool)
+{
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.quitting = true;
+	}
+	pool.wake.notify_all();
+
+	for (std::thread& thread : pool.threads)
+		thread.join();
+
+	pool.threads.clear();
+	pool.queues.clear();
+}
+
+void ThreadPoolParallelFor(ThreadPool& pool, int count, const ThreadPoolTask& task)
+{
+	if (pool.threads.empty() || count <= 1)
+	{
+		for (int i = 0; i < count; ++i) task(i, 0);
+		return;
+	}
+
+	// Contiguous blocks per worker keep neighbouring tiles on the same core until stolen
+	const int workerCount = ThreadPoolWorkerCount(pool);
+	for (int worker = 0; worker < workerCount; ++worker)
+	{
+		int begin = (int)((int64_t)count * worker / workerCount);
+		int end = (int)((int64_t)count * (worker + 1) / workerCount);
+
+		std::lock_guard<std::mutex> lock(pool.queues[worker]->mutex);
+		for (int i = end - 1; i >= begin; --i)
+			pool.queues[worker]->items.push_back(i);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.task = &task;
+		pool.activeWorkers = (int)pool.threads.size();
+		pool.generation++;
+	}
+	pool.wake.notify_all();
+
+	RunTasks(pool, 0);
+
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	pool.done.wait(lock, [&] { return pool.activeWorkers == 0; });
+	pool.task = nullptr;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Task index and the worker running it (0 is the calling thread)
+typedef std::function<void(int index, int worker)> ThreadPoolTask;
+
+struct ThreadPoolQueue
+{
+	std::mutex mutex;
+	std::deque<int> items;
+};
+
+// Work-stealing pool: every worker pops from the back of its own queue and steals
+// from the front of the others once it runs dry.
+struct ThreadPool
+{
+	std::vector<std::thread> threads;
+	std::vector<std::unique_ptr<ThreadPoolQueue>> queues;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const ThreadPoolTask* task;
+	uint64_t generation;
+	int activeWorkers;
+	bool quitting;
+
+	std::atomic<uint64_t> steals;
+};
+
+// threadCount includes the calling thread, 0 uses every hardware thread
+void ThreadPoolStart(ThreadPool& pool, int threadCount = 0);
+void ThreadPoolStop(ThreadPool& pool);
+
+inline int ThreadPoolWorkerCount(const ThreadPool& pool)
+{
+	return (int)pool.queues.size();
+}
+
+// Runs task(i) for every i in [0, count) and returns once all of them finished
+void ThreadPoolParallelFor(ThreadPool& pool, int count, const ThreadPoolTask& task);
@@ -0,0 +1,204 @@
+#include "Trace.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+struct TraceBuffer
+{
+	TraceEvent events[TraceBufferEvents];
+	std::atomic<uint64_t> reserved;	  // Bumped before an event is written
+	std::atomic<uint64_t> committed;  // Bumped after
+	std::atomic<uint64_t> first;	  // Events before this one predate TraceEnable
+	int threadId;
+};
+
+std::atomic<bool> g_TraceEnabled;
+
+static std::mutex g_TraceMutex;
+static std::vector<TraceBuffer*> g_TraceBuffers;  // Never freed, threads may exit before the dump
+static std::atomic<uint64_t> g_TraceOrigin;
+static std::atomic<uint64_t> g_TraceFrame;
+static thread_local TraceBuffer* t_TraceBuffer;
+
+static uint64_t ClockNanoseconds()
+{
+	using namespace std::chrono;
+	return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static TraceBuffer* ThreadBuffer()
+{
+	if (!t_TraceBuffer)
+	{
+		TraceBuffer* buffer = new TraceBuffer();
+		std::lock_guard<std::mutex> lock(g_TraceMutex);
+		buffer->threadId = (int)g_TraceBuffers.size() + 1;
+		g_TraceBuffers.push_back(buffer);
+		t_TraceBuffer = buffer;
+	}
+	return t_TraceBuffer;
+}
+
+void TraceEnable(bool enable)
+{
+	if (enable)
+	{
+		std::lock_guard<std::mutex> lock(g_TraceMutex);
+		for (TraceBuffer* buffer : g_TraceBuffers)
+			buffer->first.store(buffer->committed.load(std::memory_order_acquire), std::memory_order_relaxed);
+		g_TraceOrigin.store(ClockNanoseconds(), std::memory_order_relaxed);
+		g_TraceFrame.store(0, std::memory_order_relaxed);
+	}
+	g_TraceEnabled.store(enable, std::memory_order_release);
+}
+
+uint64_t TraceNow()
+{
+	uint64_t now = ClockNanoseconds();
+	uint64_t origin = g_TraceOrigin.load(std::memory_order_relaxed);
+	return now > origin ? now - origin : 0;
+}
+
+uint64_t TraceBeginFrame()
+{
+	uint64_t frame = g_TraceFrame.fetch_add(1, std::memory_order_relaxed) + 1;
+	if (TraceIsEnabled())
+		TraceRecord(TraceEvent_Frame, "Frame", TraceNow(), frame);
+	return frame;
+}
+
+uint64_t TraceCurrentFrame()
+{
+	return g_TraceFrame.load(std::memory_order_relaxed);
+}
+
+void TraceRecord(TraceEventType type, const char* name, uint64_t start, uint64_t value)
+{
+	TraceBuffer* buffer = ThreadBuffer();
+	uint64_t index = buffer->committed.load(std::memory_order_relaxed);
+
+	buffer->reserved.store(index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	TraceEvent& event = buffer->events[index & (TraceBufferEvents - 1)];
+	event.name.store((uint64_t)(uintptr_t)name, std::memory_order_relaxed);
+	event.start.store(start, std::memory_order_relaxed);
+	event.value.store(value, std::memory_order_relaxed);
+	event.typeFrame.store((uint64_t)type | (TraceCurrentFrame() << 8), std::memory_order_relaxed);
+
+	buffer->committed.store(index + 1, std::memory_order_release);
+}
+
+struct TraceSnapshot
+{
+	int threadId;
+	const char* name;
+	uint64_t start;
+	uint64_t value;
+	TraceEventType type;
+	uint64_t frame;
+};
+
+// Copies the events of one buffer that were not overwritten while we read them
+static void SnapshotBuffer(TraceBuffer& buffer, std::vector<TraceSnapshot>& events)
+{
+	uint64_t committed = buffer.committed.load(std::memory_order_acquire);
+	uint64_t begin = std::max(buffer.first.load(std::memory_order_relaxed),
+							  committed > (uint64_t)TraceBufferEvents ? committed - TraceBufferEvents : 0);
+
+	size_t firstCopied = events.size();
+	for (uint64_t index = begin; index < committed; ++index)
+	{
+		const TraceEvent& event = buffer.events[index & (TraceBufferEvents - 1)];
+		TraceSnapshot snapshot;
+		snapshot.threadId = buffer.threadId;
+		snapshot.name = (const char*)(uintptr_t)event.name.load(std::memory_order_relaxed);
+		snapshot.start = event.start.load(std::memory_order_relaxed);
+		snapshot.value = event.value.load(std::memory_order_relaxed);
+		uint64_t typeFrame = event.typeFrame.load(std::memory_order_relaxed);
+		snapshot.type = (TraceEventType)(typeFrame & 0xff);
+		snapshot.frame = typeFrame >> 8;
+		events.push_back(snapshot);
+	}
+
+	// Slots the writer reserved meanwhile may hold torn events, drop them
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t reserved = buffer.reserved.load(std::memory_order_relaxed);
+	uint64_t valid = reserved > (uint64_t)TraceBufferEvents ? reserved - TraceBufferEvents : 0;
+	if (valid > begin)
+	{
+		size_t dropped = (size_t)std::min(valid - begin, committed - begin);
+		events.erase(events.begin() + firstCopied, events.begin() + firstCopied + dropped);
+	}
+}
+
+static void SnapshotAll(std::vector<TraceSnapshot>& events)
+{
+	std::lock_guard<std::mutex> lock(g_TraceMutex);
+	for (TraceBuffer* buffer : g_TraceBuffers)
+		SnapshotBuffer(*buffer, events);
+}
+
+int TraceEventCount()
+{
+	std::vector<TraceSnapshot> events;
+	SnapshotAll(events);
+	return (int)events.size();
+}
+
+bool TraceWriteChrome(const char* path)
+{
+	std::vector<TraceSnapshot> events;
+	SnapshotAll(events);
+
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return false;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	int threadCount;
+	{
+		std::lock_guard<std::mutex> lock(g_TraceMutex);
+		threadCount = (int)g_TraceBuffers.size();
+	}
+
+	// Every entry but the first starts with the separator
+	const char* separator = "";
+	for (int thread = 1; thread <= threadCount; ++thread)
+	{
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"Thread %d\"}}",
+				separator, thread, thread);
+		separator = ",\n";
+	}
+
+	for (const TraceSnapshot& event : events)
+	{
+		double timestamp = event.start / 1000.0;
+		switch (event.type)
+		{
+		  case TraceEvent_Zone:
+			  fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"frame\":%llu}}",
+					  separator, event.name, timestamp, event.value / 1000.0, event.threadId, (unsigned long long)event.frame);
+			  break;
+
+		  case TraceEvent_Counter:
+			  fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"value\":%lld}}",
+					  separator, event.name, timestamp, event.threadId, (long long)event.value);
+			  break;
+
+		  case TraceEvent_Frame:
+			  fprintf(file, "%s{\"name\":\"%s %llu\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+					  separator, event.name, (unsigned long long)event.value, timestamp, event.threadId);
+			  break;
+		}
+		separator = ",\n";
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
+}
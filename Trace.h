@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Frame tracing: scoped zones, counters and frame markers go into a lock-free ring buffer
+// per thread and are written out as Chrome trace_event JSON (chrome://tracing, Perfetto).
+// The TRACE_* macros compile to nothing unless BACKDROP_TRACE is defined; when compiled in,
+// a disabled trace costs one relaxed load per zone.
+static const int TraceBufferEvents = 1 << 16;  // Per thread, the oldest events are overwritten
+
+enum TraceEventType
+{
+	TraceEvent_Zone,
+	TraceEvent_Counter,
+	TraceEvent_Frame,
+};
+
+// Written relaxed by the owning thread only; readers on other threads validate what they
+// copied against the buffer's reservation counter, seqlock style
+struct TraceEvent
+{
+	std::atomic<uint64_t> name;		 // const char*, string literals only
+	std::atomic<uint64_t> start;	 // Nanoseconds since TraceEnable
+	std::atomic<uint64_t> value;	 // Zone duration in nanoseconds or counter value
+	std::atomic<uint64_t> typeFrame; // Type in the low 8 bits, frame id above
+};
+
+extern std::atomic<bool> g_TraceEnabled;
+
+inline bool TraceIsEnabled()
+{
+	return g_TraceEnabled.load(std::memory_order_relaxed);
+}
+
+// Enabling clears what was recorded before and restarts the clock
+void TraceEnable(bool enable);
+
+uint64_t TraceNow();
+
+// Starts frame `frame + 1` and returns its id, later events are tagged with it
+uint64_t TraceBeginFrame();
+uint64_t TraceCurrentFrame();
+
+void TraceRecord(TraceEventType type, const char* name, uint64_t start, uint64_t value);
+
+inline void TraceCounter(const char* name, int64_t value)
+{
+	if (TraceIsEnabled())
+		TraceRecord(TraceEvent_Counter, name, TraceNow(), (uint64_t)value);
+}
+
+struct TraceZone
+{
+	const char* name;
+	uint64_t start;
+	bool active;  // The trace was on when the zone opened
+
+	explicit TraceZone(const char* zoneName) : name(zoneName), start(0), active(TraceIsEnabled())
+	{
+		if (active)
+			start = TraceNow();
+	}
+
+	~TraceZone()
+	{
+		if (active && TraceIsEnabled())
+		{
+			uint64_t end = TraceNow();
+			TraceRecord(TraceEvent_Zone, name, start, end > start ? end - start : 0);
+		}
+	}
+};
+
+// Events still in the ring buffers of all threads, oldest first per thread
+int TraceEventCount();
+
+// Writes every buffered event as Chrome trace_event JSON, false when the file can't be written
+bool TraceWriteChrome(const char* path);
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#if defined(BACKDROP_TRACE)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_COUNTER(name, value) TraceCounter(name, (int64_t)(value))
+#define TRACE_FRAME() TraceBeginFrame()
+#else
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+#define TRACE_FRAME() ((void)0)
+#endif
@@ -1,71 +1,210 @@
-workspace "BackdropFilterWin32"
-
-configurations { "Debug", "Release" }
-platforms { "x64" }
-
-characterset 'MBCS'
-cppdialect "C++17"
-architecture "x86_64"
-rtti "Off"
-exceptionhandling "Off"
-vectorextensions "SSE"
-vectorextensions "SSE2"
-vectorextensions "AVX2"
-floatingpoint "Fast"
-pic "On"
-systemversion "latest"
-editandcontinue "Off"
-disablewarnings {
-   "4201",
-   "4100",
-   "4189",
-   "4505",
-   "4127",
-   "4245",
-   "4244",
-}
-warnings "Off"
-filter "files:**.rec"
-buildaction "ResourceCompile"
-filter{}
-
-filter "files:**.natvis"
-buildaction "Natvis"
-filter{}
-
-buildoptions {
-   "/permissive-",
-}
-
-project "BackdropFilterWin32"
-language "C++"
-kind "WindowedApp"
-
-targetdir "./Build/$(Configuration)/"
-objdir "./Build/$(Configuration)/$(ProjectName)"
-
-files {
-   "./BackdropFilterWin32.cpp",
-}
-
-links {
-   "kernel32.lib",
-   "user32.lib",
-   "gdi32.lib",
-   "winspool.lib",
-   "comdlg32.lib",
-   "advapi32.lib",
-   "shell32.lib",
-   "ole32.lib",
-   "oleaut32.lib",
-   "uuid.lib",
-   "odbc32.lib",
-   "odbccp32.lib",
-   "d3d11.lib",
-   "D3DCompiler.lib",
-   "shlwapi.lib",
-   "dxguid.lib",
-   "Mincore.lib",
-   "dxgi.lib",
-   "winmm.lib",
-}
+workspace "BackdropFilterWin32"
+
+configurations { "Debug", "Release" }
+platforms { "x64" }
+
+characterset 'MBCS'
+cppdialect "C++17"
+architecture "x86_64"
+rtti "Off"
+exceptionhandling "Off"
+vectorextensions "SSE"
+vectorextensions "SSE2"
+vectorextensions "AVX2"
+floatingpoint "Fast"
+pic "On"
+systemversion "latest"
+editandcontinue "Off"
+disablewarnings {
+   "4201",
+   "4100",
+   "4189",
+   "4505",
+   "4127",
+   "4245",
+   "4244",
+}
+warnings "Off"
+
+-- Frame tracing zones (Trace.h), idle until --trace turns them on; drop to compile them out
+defines {
+   "BACKDROP_TRACE",
+}
+filter "files:**.rec"
+buildaction "ResourceCompile"
+filter{}
+
+filter "files:**.natvis"
+buildaction "Natvis"
+filter{}
+
+filter "toolset:msc*"
+buildoptions {
+   "/permissive-",
+}
+filter{}
+
+project "BackdropFilterWin32"
+language "C++"
+kind "WindowedApp"
+
+targetdir "./Build/$(Configuration)/"
+objdir "./Build/$(Configuration)/$(ProjectName)"
+
+files {
+   "./BackdropFilterWin32.cpp",
+   "./CpuBlur.h",
+   "./CpuBlur.cpp",
+   "./CpuBlurFixed.h",
+   "./CpuBlurFixed.cpp",
+   "./CpuBlurTiled.h",
+   "./CpuBlurTiled.cpp",
+   "./ThreadPool.h",
+   "./ThreadPool.cpp",
+   "./CpuKawase.h",
+   "./CpuKawase.cpp",
+   "./CpuIirGaussian.h",
+   "./CpuIirGaussian.cpp",
+   "./BlurCache.h",
+   "./BlurCache.cpp",
+   "./FrameScheduler.h",
+   "./FrameScheduler.cpp",
+   "./DesktopLayout.h",
+   "./DesktopLayout.cpp",
+   "./ResourcePool.h",
+   "./ResourcePool.cpp",
+   "./ShaderCache.h",
+   "./ShaderCache.cpp",
+   "./BlurKernels.h",
+   "./BlurKernels.cpp",
+   "./EffectChain.h",
+   "./EffectChain.cpp",
+   "./ImageView.h",
+   "./ImageView.cpp",
+   "./MappedFile.h",
+   "./MappedFile.cpp",
+   "./CaptureRecording.h",
+   "./CaptureRecording.cpp",
+   "./BlurTuner.h",
+   "./BlurTuner.cpp",
+   "./CpuSummedArea.h",
+   "./CpuSummedArea.cpp",
+   "./CpuPlanar.h",
+   "./CpuPlanar.cpp",
+   "./DirtyRegion.h",
+   "./DirtyRegion.cpp",
+   "./MaskLayer.h",
+   "./MaskLayer.cpp",
+   "./MaskTiles.h",
+   "./MaskTiles.cpp",
+   "./FrameSource.h",
+   "./FrameSource.cpp",
+   "./FrameSourceDxgi.h",
+   "./FrameSourceDxgi.cpp",
+   "./ResourcePoolD3D11.h",
+   "./ResourcePoolD3D11.cpp",
+   "./ShaderCacheD3D.h",
+   "./ShaderCacheD3D.cpp",
+   "./Trace.h",
+   "./Trace.cpp",
+}
+
+links {
+   "kernel32.lib",
+   "user32.lib",
+   "gdi32.lib",
+   "winspool.lib",
+   "comdlg32.lib",
+   "advapi32.lib",
+   "shell32.lib",
+   "ole32.lib",
+   "oleaut32.lib",
+   "uuid.lib",
+   "odbc32.lib",
+   "odbccp32.lib",
+   "d3d11.lib",
+   "D3DCompiler.lib",
+   "shlwapi.lib",
+   "dxguid.lib",
+   "Mincore.lib",
+   "dxgi.lib",
+   "winmm.lib",
+}
+
+-- Fills <executable>.shadercache so the first launch after a build compiles nothing
+postbuildcommands {
+   "\"%{cfg.buildtarget.abspath}\" --build-shader-cache",
+}
+
+project "BackdropFilterBench"
+language "C++"
+kind "ConsoleApp"
+
+targetdir "./Build/%{cfg.buildcfg}/"
+objdir "./Build/%{cfg.buildcfg}/%{prj.name}"
+
+files {
+   "./BackdropFilterBench.cpp",
+   "./CpuBlur.h",
+   "./CpuBlur.cpp",
+   "./CpuBlurFixed.h",
+   "./CpuBlurFixed.cpp",
+   "./CpuKawase.h",
+   "./CpuKawase.cpp",
+   "./CpuIirGaussian.h",
+   "./CpuIirGaussian.cpp",
+   "./BlurCache.h",
+   "./BlurCache.cpp",
+   "./FrameScheduler.h",
+   "./FrameScheduler.cpp",
+   "./DesktopLayout.h",
+   "./DesktopLayout.cpp",
+   "./ResourcePool.h",
+   "./ResourcePool.cpp",
+   "./ShaderCache.h",
+   "./ShaderCache.cpp",
+   "./BlurKernels.h",
+   "./BlurKernels.cpp",
+   "./EffectChain.h",
+   "./EffectChain.cpp",
+   "./ImageView.h",
+   "./ImageView.cpp",
+   "./MappedFile.h",
+   "./MappedFile.cpp",
+   "./CaptureRecording.h",
+   "./CaptureRecording.cpp",
+   "./BlurTuner.h",
+   "./BlurTuner.cpp",
+   "./CpuSummedArea.h",
+   "./CpuSummedArea.cpp",
+   "./CpuPlanar.h",
+   "./CpuPlanar.cpp",
+   "./DirtyRegion.h",
+   "./DirtyRegion.cpp",
+   "./MaskLayer.h",
+   "./MaskLayer.cpp",
+   "./MaskTiles.h",
+   "./MaskTiles.cpp",
+   "./FrameSource.h",
+   "./FrameSource.cpp",
+   "./BlurPipeline.h",
+   "./BlurPipeline.cpp",
+   "./FramePipeline.h",
+   "./FramePipeline.cpp",
+   "./BlurRegions.h",
+   "./BlurRegions.cpp",
+   "./CpuComposite.h",
+   "./CpuComposite.cpp",
+   "./Trace.h",
+   "./Trace.cpp",
+   "./CpuBlurTiled.h",
+   "./CpuBlurTiled.cpp",
+   "./ThreadPool.h",
+   "./ThreadPool.cpp",
+}
+
+filter "system:linux"
+links {
+   "pthread",
+}
+filter{}